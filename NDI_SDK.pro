@@ -4,27 +4,106 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets multimedia
 
 CONFIG += c++11
 
+# The pixel format converters rely on their row loops being vectorized.
+gcc: QMAKE_CXXFLAGS_RELEASE += -ftree-vectorize
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    audioconvert.cpp \
     audioinfo.cpp \
+    audiomixer.cpp \
+    audioresampler.cpp \
+    audioring.cpp \
+    colorconvert.cpp \
+    colorconvert_avx2.cpp \
+    colorconvert_sse2.cpp \
+    cpufeatures.cpp \
+    daemon.cpp \
+    damagetracker.cpp \
+    devicecatalog.cpp \
+    framepacer.cpp \
+    framepool.cpp \
+    framescaler.cpp \
     global.cpp \
     main.cpp \
+    ndistream.cpp \
+    pipelinestats.cpp \
+    qualitygovernor.cpp \
+    replaysource.cpp \
+    senderthread.cpp \
+    stagescheduler.cpp \
+    statsreporter.cpp \
+    streamconfig.cpp \
+    streamengine.cpp \
+    streampreview.cpp \
+    streamrecorder.cpp \
+    stripepool.cpp \
+    syntheticsource.cpp \
     widget.cpp
 
 HEADERS += \
+    audioconvert.h \
     audioinfo.h \
+    audiomixer.h \
+    audioresampler.h \
+    audioring.h \
+    capturesource.h \
+    colorconvert.h \
+    colorconvert_p.h \
+    cpufeatures.h \
+    daemon.h \
+    damagetracker.h \
+    devicecatalog.h \
+    framepacer.h \
+    framepool.h \
+    framescaler.h \
     global.h \
-    utils.h \
+    ndistream.h \
+    pipelinestats.h \
+    qualitygovernor.h \
+    recordformat.h \
+    replaysource.h \
+    senderthread.h \
+    spscqueue.h \
+    stagescheduler.h \
+    statsreporter.h \
+    streamconfig.h \
+    streamengine.h \
+    streampreview.h \
+    streamrecorder.h \
+    stripepool.h \
+    syntheticsource.h \
+    waitevent.h \
     widget.h
 
 FORMS += \
     widget.ui
 
-INCLUDEPATH += "C:\Program Files\NDI\NDI 6 SDK\Include"
-LIBS += -L"C:\Program Files\NDI\NDI 6 SDK\Lib\x64" -lProcessing.NDI.Lib.x64 -lgdi32
+win32 {
+    SOURCES += gdicapturesource.cpp
+    HEADERS += gdicapturesource.h
+
+    INCLUDEPATH += "C:\Program Files\NDI\NDI 6 SDK\Include"
+    LIBS += -L"C:\Program Files\NDI\NDI 6 SDK\Lib\x64" -lProcessing.NDI.Lib.x64 -ldwmapi -lgdi32 -lwinmm
+}
+
+# Linux encode hosts: point NDI_SDK_DIR at the extracted NDI SDK for Linux.
+unix:!macx {
+    SOURCES += x11capturesource.cpp
+    HEADERS += x11capturesource.h
+
+    INCLUDEPATH += $$(NDI_SDK_DIR)/include
+    LIBS += -L$$(NDI_SDK_DIR)/lib/x86_64-linux-gnu -lndi -lX11 -lXext
+}
+
+# V4L2 cameras are read straight from their mmap'd driver buffers.
+linux {
+    SOURCES += v4l2camera.cpp
+    HEADERS += v4l2camera.h
+}
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
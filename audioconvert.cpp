@@ -0,0 +1,260 @@
+#include "audioconvert.h"
+
+#include <QtGlobal>
+#include <string.h>
+
+#include "cpufeatures.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+// Frames converted at a time when channels are remapped through the stack.
+static const int ScratchSamples = 4096;
+
+int sampleFormatBytes(SampleFormat format)
+{
+    switch (format) {
+    case SampleU8:
+        return 1;
+    case SampleS16:
+        return 2;
+    case SampleS32:
+    case SampleFloat:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+const char *sampleFormatName(SampleFormat format)
+{
+    switch (format) {
+    case SampleU8:
+        return "u8";
+    case SampleS16:
+        return "s16";
+    case SampleS32:
+        return "s32";
+    case SampleFloat:
+        return "float";
+    default:
+        return "unsupported";
+    }
+}
+
+static void convertSamples_C(const void *src, SampleFormat format, float *dst, int count)
+{
+    switch (format) {
+    case SampleU8: {
+        const uint8_t *s = static_cast<const uint8_t *>(src);
+        for (int i = 0; i < count; ++i)
+            dst[i] = (int(s[i]) - 128) * (1.0f / 128);
+        break;
+    }
+    case SampleS16: {
+        const int16_t *s = static_cast<const int16_t *>(src);
+        for (int i = 0; i < count; ++i)
+            dst[i] = s[i] * (1.0f / 32768);
+        break;
+    }
+    case SampleS32: {
+        const int32_t *s = static_cast<const int32_t *>(src);
+        for (int i = 0; i < count; ++i)
+            dst[i] = float(s[i]) * (1.0f / 2147483648.0f);
+        break;
+    }
+    case SampleFloat:
+        memcpy(dst, src, size_t(count) * sizeof(float));
+        break;
+    default:
+        memset(dst, 0, size_t(count) * sizeof(float));
+        break;
+    }
+}
+
+static void deinterleave_C(const float *src, int frames, int channels, float *dst, int channelStride)
+{
+    for (int c = 0; c < channels; ++c) {
+        float *out = dst + c * channelStride;
+        for (int i = 0; i < frames; ++i)
+            out[i] = src[i * channels + c];
+    }
+}
+
+static void mix_C(const float *src, float gain, float *dst, int count, bool accumulate)
+{
+    if (accumulate) {
+        for (int i = 0; i < count; ++i)
+            dst[i] += gain * src[i];
+    } else {
+        for (int i = 0; i < count; ++i)
+            dst[i] = gain * src[i];
+    }
+}
+
+#ifdef CPU_X86
+// 8 int16 samples per iteration: each is sign-extended by unpacking it into
+// the top half of a 32-bit lane and shifting back down.
+CPU_TARGET_SSE2 static void convertS16_SSE2(const int16_t *src, float *dst, int count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 32768);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    convertSamples_C(src + i, SampleS16, dst + i, count - i);
+}
+
+CPU_TARGET_SSE2 static void convertS32_SSE2(const int32_t *src, float *dst, int count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+    }
+    convertSamples_C(src + i, SampleS32, dst + i, count - i);
+}
+
+// 4 stereo frames per iteration, split with one shuffle per channel.
+CPU_TARGET_SSE2 static void deinterleaveStereo_SSE2(const float *src, int frames, float *left, float *right)
+{
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 a = _mm_loadu_ps(src + 2 * i);
+        const __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    for (; i < frames; ++i) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+CPU_TARGET_SSE2 static void mix_SSE2(const float *src, float gain, float *dst, int count, bool accumulate)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    if (accumulate) {
+        for (; i + 8 <= count; i += 8) {
+            const __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+            const __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), g);
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), a));
+            _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), b));
+        }
+    } else {
+        for (; i + 8 <= count; i += 8) {
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_loadu_ps(src + i + 4), g));
+        }
+    }
+    mix_C(src + i, gain, dst + i, count - i, accumulate);
+}
+#endif
+
+static void convertSamples(const void *src, SampleFormat format, float *dst, int count)
+{
+#ifdef CPU_X86
+    static const bool sse2 = cpuHasSSE2();
+    if (sse2 && format == SampleS16) {
+        convertS16_SSE2(static_cast<const int16_t *>(src), dst, count);
+        return;
+    }
+    if (sse2 && format == SampleS32) {
+        convertS32_SSE2(static_cast<const int32_t *>(src), dst, count);
+        return;
+    }
+#endif
+    convertSamples_C(src, format, dst, count);
+}
+
+static void remapChannels(const float *src, int srcChannels, float *dst, int dstChannels, int frames)
+{
+    if (dstChannels == 1) {
+        const float scale = 1.0f / srcChannels;
+        for (int i = 0; i < frames; ++i) {
+            float sum = 0;
+            for (int c = 0; c < srcChannels; ++c)
+                sum += src[i * srcChannels + c];
+            dst[i] = sum * scale;
+        }
+    } else if (srcChannels == 1) {
+        for (int i = 0; i < frames; ++i) {
+            for (int c = 0; c < dstChannels; ++c)
+                dst[i * dstChannels + c] = src[i];
+        }
+    } else {
+        for (int i = 0; i < frames; ++i) {
+            for (int c = 0; c < dstChannels; ++c)
+                dst[i * dstChannels + c] = src[i * srcChannels + c % srcChannels];
+        }
+    }
+}
+
+void convertAudioToFloat(const void *src, SampleFormat format, int srcChannels,
+                         float *dst, int dstChannels, int frames)
+{
+    if (srcChannels == dstChannels) {
+        convertSamples(src, format, dst, frames * srcChannels);
+        return;
+    }
+
+    float scratch[ScratchSamples];
+    const int chunk = qMax(1, ScratchSamples / srcChannels);
+    const uint8_t *in = static_cast<const uint8_t *>(src);
+    const int frameBytes = sampleFormatBytes(format) * srcChannels;
+    for (int done = 0; done < frames; done += chunk) {
+        const int n = qMin(chunk, frames - done);
+        convertSamples(in + size_t(done) * frameBytes, format, scratch, n * srcChannels);
+        remapChannels(scratch, srcChannels, dst + size_t(done) * dstChannels, dstChannels, n);
+    }
+}
+
+void deinterleaveAudio(const float *src, int frames, int channels, float *dst, int channelStride)
+{
+    if (channels == 1) {
+        memcpy(dst, src, size_t(frames) * sizeof(float));
+        return;
+    }
+#ifdef CPU_X86
+    static const bool sse2 = cpuHasSSE2();
+    if (sse2 && channels == 2) {
+        deinterleaveStereo_SSE2(src, frames, dst, dst + channelStride);
+        return;
+    }
+#endif
+    deinterleave_C(src, frames, channels, dst, channelStride);
+}
+
+void mixAudio(const float *src, float gain, float *dst, int count, bool accumulate)
+{
+    if (gain == 1.0f && !accumulate) {
+        memcpy(dst, src, size_t(count) * sizeof(float));
+        return;
+    }
+#ifdef CPU_X86
+    static const bool sse2 = cpuHasSSE2();
+    if (sse2) {
+        mix_SSE2(src, gain, dst, count, accumulate);
+        return;
+    }
+#endif
+    mix_C(src, gain, dst, count, accumulate);
+}
+
+const char *audioConvertBackend()
+{
+#ifdef CPU_X86
+    if (cpuHasSSE2())
+        return "sse2";
+#endif
+    return "scalar";
+}
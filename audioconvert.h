@@ -0,0 +1,35 @@
+#ifndef AUDIOCONVERT_H
+#define AUDIOCONVERT_H
+
+#include <stdint.h>
+
+// Little-endian PCM sample formats a capture device may negotiate.
+enum SampleFormat {
+    SampleUnsupported,
+    SampleU8,
+    SampleS16,
+    SampleS32,
+    SampleFloat
+};
+
+int sampleFormatBytes(SampleFormat format);
+const char *sampleFormatName(SampleFormat format);
+
+// Converts frames of interleaved srcChannels samples to interleaved float
+// with dstChannels channels, full scale at +-1. Fewer source channels are
+// repeated (mono to every channel), more are mixed down to mono or cut to
+// the first dstChannels.
+void convertAudioToFloat(const void *src, SampleFormat format, int srcChannels,
+                         float *dst, int dstChannels, int frames);
+
+// Interleaved float to planar: channel c starts at dst + c * channelStride.
+void deinterleaveAudio(const float *src, int frames, int channels, float *dst, int channelStride);
+
+// dst = gain * src, or dst += gain * src when accumulating; how inputs are
+// mixed, one planar channel at a time.
+void mixAudio(const float *src, float gain, float *dst, int count, bool accumulate);
+
+// "sse2" or "scalar", whichever the sample loops use on this CPU.
+const char *audioConvertBackend();
+
+#endif // AUDIOCONVERT_H
@@ -1,11 +1,40 @@
-
 #include "audioinfo.h"
 
-AudioInfo::AudioInfo(const QAudioDeviceInfo &deviceInfo)
+#include <QAudioInput>
+#include <QDebug>
+#include <QTimer>
+#include <string.h>
+
+#include "pipelinestats.h"
+
+// Half a second of slack between the capture thread and the block reader.
+static const int RingMs = 500;
+
+static SampleFormat sampleFormatOf(const QAudioFormat &format)
+{
+    if (format.codec() != "audio/pcm"
+            || (format.sampleSize() > 8 && format.byteOrder() != QAudioFormat::LittleEndian))
+        return SampleUnsupported;
+    if (format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32)
+        return SampleFloat;
+    if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16)
+        return SampleS16;
+    if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 32)
+        return SampleS32;
+    if (format.sampleType() == QAudioFormat::UnSignedInt && format.sampleSize() == 8)
+        return SampleU8;
+    return SampleUnsupported;
+}
+
+AudioInfo::AudioInfo(const QAudioDeviceInfo &deviceInfo, int sampleRate, int channels, int bufferMs, int periodMs)
+    : m_device(deviceInfo)
+    , m_bufferMs(bufferMs)
+    , m_periodMs(qMax(1, periodMs))
+    , m_pending(0)
 {
     QAudioFormat format;
-    format.setSampleRate(44100);
-    format.setChannelCount(1);
+    format.setSampleRate(sampleRate);
+    format.setChannelCount(channels);
     format.setSampleSize(32);
     format.setCodec("audio/pcm");
     format.setByteOrder(QAudioFormat::LittleEndian);
@@ -15,43 +44,93 @@ AudioInfo::AudioInfo(const QAudioDeviceInfo &deviceInfo)
         format = deviceInfo.nearestFormat(format);
     }
     m_format = format;
+    m_sampleFormat = sampleFormatOf(m_format);
+    if (m_sampleFormat == SampleUnsupported)
+        qWarning() << deviceInfo.deviceName() << "offers no little-endian 8, 16, 32-bit or float capture, audio is not sent";
+    m_ring.reset(channels, m_format.sampleRate() * RingMs / 1000);
 
-    open(QIODevice::WriteOnly);
-
-    m_audio = new QAudioInput(m_format, this);
+    // A read can find the whole device buffer waiting, and more if the
+    // backend rounded it up.
+    const int frameBytes = qMax(1, m_format.bytesPerFrame());
+    m_scratch.resize(m_format.bytesForDuration(qint64(qMax(bufferMs, 2 * m_periodMs)) * 1000) / frameBytes * frameBytes);
 }
 
-AudioInfo::~AudioInfo() {
-    m_audio->stop();
-    close();
-
-    delete m_audio;
+AudioInfo::~AudioInfo()
+{
+    Stop();
 }
 
-void AudioInfo::start()
+void AudioInfo::Start()
 {
-    m_audio->start(this);
+    if (isSupported() && !isRunning())
+        start(QThread::TimeCriticalPriority);
 }
 
-void AudioInfo::stop()
+void AudioInfo::Stop()
 {
-    m_audio->stop();
+    requestInterruption();
+    quit();
+    wait();
 }
 
-qint64 AudioInfo::readData(char *data, qint64 maxlen)
+// The device is created, read and destroyed on this thread, so its backend
+// timers and callbacks live here too.
+void AudioInfo::run()
 {
-    Q_UNUSED(data)
-    Q_UNUSED(maxlen)
+    QAudioInput input(m_device, m_format);
+    input.setBufferSize(m_format.bytesForDuration(qint64(m_bufferMs) * 1000));
+    QIODevice *source = input.start();
+    if (!source) {
+        qWarning() << m_device.deviceName() << "- cannot start audio capture, error" << input.error();
+        return;
+    }
+    m_pending = 0;
+
+    QTimer timer;
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, [&]() {
+        // Stop() can come before the event loop is running to hear quit().
+        if (isInterruptionRequested())
+            quit();
+        else
+            readPeriod(source);
+    });
+    timer.start(m_periodMs);
+    if (!isInterruptionRequested())
+        exec();
 
-    return 0;
+    timer.stop();
+    input.stop();
 }
 
-qint64 AudioInfo::writeData(const char *data, qint64 len)
+// Takes everything the device has buffered. The newest frame is stamped as
+// captured now; how long the backend held it before is not visible here,
+// which is why the buffer is kept short. A read can end partway through a
+// frame; those bytes stay at the front of the scratch buffer for the next.
+void AudioInfo::readPeriod(QIODevice *source)
 {
-    Q_UNUSED(data)
-    Q_UNUSED(len)
+    const int frameBytes = m_format.bytesPerFrame();
+    if (frameBytes <= 0)
+        return;
 
-    emit emitAudioData((float*)data, len / sizeof(float));
-
-    return len;
+    int frames = 0;
+    for (;;) {
+        const int wanted = m_scratch.size() - m_pending;
+        const qint64 bytes = source->read(m_scratch.data() + m_pending, wanted);
+        if (bytes <= 0)
+            break;
+        const int filled = m_pending + int(bytes);
+        const int n = filled / frameBytes;
+        m_ring.write(m_scratch.constData(), m_sampleFormat, m_format.channelCount(), n);
+        frames += n;
+        m_pending = filled - n * frameBytes;
+        if (m_pending)
+            memmove(m_scratch.data(), m_scratch.constData() + n * frameBytes, m_pending);
+        if (bytes < wanted)
+            break;
+    }
+    if (frames) {
+        m_ring.stamp(pipelineClockNs());
+        emit dataAvailable();
+    }
 }
@@ -1,31 +1,64 @@
 #ifndef AUDIOINFO_H
 #define AUDIOINFO_H
 
-#include <QIODevice>
-#include <QObject>
+#include <QAudioDeviceInfo>
 #include <QAudioFormat>
-#include <QAudioInput>
+#include <QByteArray>
+#include <QThread>
 
-class AudioInfo : public QIODevice
+#include "audioconvert.h"
+#include "audioring.h"
+
+class QIODevice;
+
+// Captures one input device into ring() from its own time-critical thread,
+// so nothing on the GUI thread, and no screen grab or conversion, delays a
+// read. The device is asked for sampleRate and channels as float, but any
+// PCM format it settles on instead is converted to float with the requested
+// channel count on the way into the ring; the sample rate stays the device's.
+//
+// The device buffers bufferMs and is read every periodMs, which between them
+// bound how long a sample waits before it reaches the ring: smaller is
+// sooner, until the device overruns between reads.
+class AudioInfo : public QThread
 {
     Q_OBJECT
 
 public:
-    AudioInfo(const QAudioDeviceInfo &deviceInfo);
+    static const int DefaultBufferMs = 40;
+    static const int DefaultPeriodMs = 10;
+
+    AudioInfo(const QAudioDeviceInfo &deviceInfo, int sampleRate = 48000, int channels = 2,
+              int bufferMs = DefaultBufferMs, int periodMs = DefaultPeriodMs);
     ~AudioInfo();
 
-    void start();
-    void stop();
+    void Start();
+    void Stop();
 
-    qint64 readData(char *data, qint64 maxlen) override;
-    qint64 writeData(const char *data, qint64 len) override;
+    // The format the device actually negotiated.
+    const QAudioFormat &format() const { return m_format; }
+    SampleFormat sampleFormat() const { return m_sampleFormat; }
+    bool isSupported() const { return m_sampleFormat != SampleUnsupported; }
+    AudioRing &ring() { return m_ring; }
+
+signals:
+    // Emitted on the capture thread after new samples were queued in ring().
+    void dataAvailable();
+
+protected:
+    void run() override;
 
 private:
-    QAudioFormat m_format;
-    QAudioInput* m_audio;
+    void readPeriod(QIODevice *source);
 
-signals:
-    void emitAudioData(float *data, qint64 len);
+    QAudioDeviceInfo m_device;
+    QAudioFormat m_format;
+    SampleFormat m_sampleFormat;
+    int m_bufferMs;
+    int m_periodMs;
+    AudioRing m_ring;
+    QByteArray m_scratch;       // one read, whole frames
+    int m_pending;              // bytes of a partial frame at its front
 };
 
 #endif // AUDIOINFO_H
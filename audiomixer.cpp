@@ -0,0 +1,148 @@
+#include "audiomixer.h"
+
+#include <QtGlobal>
+
+#include "audioring.h"
+#include "pipelinestats.h"
+
+AudioMixer::AudioMixer()
+    : m_sampleRate(48000)
+    , m_channels(2)
+    , m_blockFrames(960)
+    , m_realignments(0)
+    , m_underruns(0)
+{
+}
+
+void AudioMixer::reset(int sampleRate, int channels, int blockFrames)
+{
+    m_inputs.clear();
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_blockFrames = blockFrames;
+    m_realignments = 0;
+    m_underruns = 0;
+}
+
+bool AudioMixer::addInput(AudioRing *ring, int inputRate, float gain)
+{
+    Input input;
+    if (!input.resampler.reset(inputRate, m_sampleRate, m_channels, m_blockFrames))
+        return false;
+    input.ring = ring;
+    input.rate = inputRate;
+    input.gain = gain;
+    input.waitFrames = int(int64_t(inputRate) * MaxWaitMs / 1000);
+    input.needed = 0;
+    input.ready = false;
+    input.aligned = false;
+    input.outputNs = 0;
+    m_inputs.push_back(input);
+    return true;
+}
+
+// When the input's next output frame was captured, counting what its
+// resampler holds back; 0 until its ring has been stamped.
+int64_t AudioMixer::outputTimeNs(const Input &input) const
+{
+    const int64_t readNs = input.ring->readTimeNs(input.rate);
+    if (!readNs)
+        return 0;
+    return readNs - int64_t(input.resampler.latencyFrames()) * 1000000000 / input.rate;
+}
+
+bool AudioMixer::isReady()
+{
+    Input *inputs = m_inputs.data();
+    const int count = m_inputs.size();
+    bool all = count > 0;
+    bool overdue = false;
+    for (int i = 0; i < count; ++i) {
+        Input &input = inputs[i];
+        input.needed = input.resampler.inputNeeded(m_blockFrames);
+        const int available = input.ring->available();
+        input.ready = available >= input.needed;
+        all = all && input.ready;
+        overdue = overdue || available >= input.needed + input.waitFrames;
+    }
+    return all || overdue;
+}
+
+bool AudioMixer::mix(float *dst, int channelStride, int64_t *captureNs)
+{
+    if (!isReady())
+        return false;
+
+    // The first input with data dates the block; the others are moved to it.
+    Input *inputs = m_inputs.data();
+    const int count = m_inputs.size();
+    int reference = 0;
+    while (!inputs[reference].ready)
+        ++reference;
+    for (int i = 0; i < count; ++i)
+        inputs[i].outputNs = inputs[i].ready ? outputTimeNs(inputs[i]) : 0;
+    int64_t blockNs = inputs[reference].outputNs;
+    const int64_t toleranceNs = int64_t(DriftToleranceMs) * 1000000;
+
+    // An input further behind than it has buffered beyond this block cannot
+    // skip up to the reference: what it captured at that time has not come
+    // in yet. The block is then dated by what that input can reach, and the
+    // others, the reference too, wait for it with silence.
+    for (int i = 0; i < count && blockNs; ++i) {
+        const Input &input = inputs[i];
+        const int64_t inputNs = input.outputNs;
+        if (!inputNs || (input.aligned && qAbs(inputNs - blockNs) <= toleranceNs))
+            continue;
+        const int surplus = input.ring->available() - input.needed;
+        blockNs = qMin(blockNs, inputNs + int64_t(surplus) * 1000000000 / input.rate);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        Input &input = inputs[i];
+        if (!input.ready) {
+            m_underruns.fetch_add(1, std::memory_order_relaxed);
+            input.aligned = false;
+            continue;
+        }
+        if (!input.outputNs || !blockNs)
+            continue;
+        const int64_t offsetNs = input.outputNs - blockNs;
+        const int offset = int(offsetNs * input.rate / 1000000000);
+        if (offset == 0 || (input.aligned && qAbs(offsetNs) <= toleranceNs))
+            continue;
+
+        // Whatever cannot be skipped without leaving the input short of this
+        // block, or padded in one go, is left to the next block, unless it
+        // is within a millisecond: a drifting clock is never exact.
+        int corrected;
+        if (offset < 0) {
+            corrected = -qMin(-offset, input.ring->available() - input.needed);
+            input.ring->skip(-corrected);
+        } else {
+            corrected = input.resampler.insertSilence(offset);
+            input.needed = input.resampler.inputNeeded(m_blockFrames);
+        }
+        input.aligned = qAbs(offset - corrected) <= input.rate / 1000;
+        m_realignments.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The reference is always ready, so the first pass below overwrites
+    // whatever dst held and the rest add to it.
+    bool accumulate = false;
+    for (int i = 0; i < count; ++i) {
+        Input &input = inputs[i];
+        if (!input.ready)
+            continue;
+        if (!dst) {
+            input.ring->skip(input.needed);
+            continue;
+        }
+        input.ring->readPlanar(input.resampler.prepare(input.needed), input.needed, input.resampler.channelStride());
+        input.resampler.commit(input.needed);
+        input.resampler.process(dst, m_blockFrames, channelStride, input.gain, accumulate);
+        accumulate = true;
+    }
+
+    *captureNs = blockNs ? blockNs : pipelineClockNs();
+    return true;
+}
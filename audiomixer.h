@@ -0,0 +1,89 @@
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include <QVector>
+#include <atomic>
+#include <stdint.h>
+
+#include "audioresampler.h"
+
+class AudioRing;
+
+// Mixes any number of captured inputs into one planar block per NDI audio
+// frame. Each input is a ring at its device's rate with its own resampler
+// and gain; the gain is applied, and the mix summed, in the same pass that
+// resamples or copies the input out, so a block costs one pass per input
+// and nothing more as inputs are added.
+//
+// Inputs are kept aligned by the capture time of their samples, which the
+// rings date from their capture callbacks, against the first input with
+// data. An input that is behind skips the difference; one that is ahead has
+// it inserted as silence. One further behind than it has buffered, because
+// its samples come in later than the others', is waited for: the others are
+// delayed to it instead. Inputs are lined up exactly at the start, and again
+// once device clocks drifting apart, or an input that stalled and resumed,
+// have moved one more than DriftToleranceMs, so that the jitter of the
+// callbacks does not keep nudging them.
+//
+// mix() must not be called from two threads at once; the rings can be
+// written meanwhile.
+class AudioMixer
+{
+public:
+    static const int DriftToleranceMs = 15;
+    // How long a block waits for a stalled input before it goes out with
+    // that input silent.
+    static const int MaxWaitMs = 60;
+
+    AudioMixer();
+
+    // Drops every input; blocks are blockFrames per channel at sampleRate.
+    void reset(int sampleRate, int channels, int blockFrames);
+    // ring holds channels() interleaved channels at inputRate. Returns false
+    // if the rate cannot be converted.
+    bool addInput(AudioRing *ring, int inputRate, float gain);
+
+    int inputCount() const { return m_inputs.size(); }
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+    int blockFrames() const { return m_blockFrames; }
+    const AudioResampler &resampler(int input) const { return m_inputs[input].resampler; }
+
+    // Whether the next block can be taken: every input has its share, or
+    // one has waited MaxWaitMs.
+    bool isReady();
+    // Takes the next block out of the inputs, mixed into dst planar at
+    // channelStride, or discarded if dst is null. Returns false and takes
+    // nothing unless isReady(). captureNs gets when the block's first frame
+    // was captured.
+    bool mix(float *dst, int channelStride, int64_t *captureNs);
+
+    // Times an input skipped ahead or sat out to stay aligned.
+    quint64 realignments() const { return m_realignments.load(std::memory_order_relaxed); }
+    // Blocks an input was left out of because it had nothing.
+    quint64 underruns() const { return m_underruns.load(std::memory_order_relaxed); }
+
+private:
+    struct Input {
+        AudioRing *ring;
+        int rate;
+        float gain;
+        int waitFrames;         // MaxWaitMs at rate
+        AudioResampler resampler;
+        int needed;             // input frames for the next block
+        bool ready;
+        bool aligned;           // within DriftToleranceMs is close enough
+        int64_t outputNs;       // outputTimeNs() as the block is taken
+    };
+
+    int64_t outputTimeNs(const Input &input) const;
+
+    QVector<Input> m_inputs;
+    int m_sampleRate;
+    int m_channels;
+    int m_blockFrames;
+    std::atomic<quint64> m_realignments;
+    std::atomic<quint64> m_underruns;
+};
+
+#endif // AUDIOMIXER_H
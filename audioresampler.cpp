@@ -0,0 +1,252 @@
+#include "audioresampler.h"
+
+#include <cmath>
+#include <string.h>
+
+#include "audioconvert.h"
+#include "cpufeatures.h"
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+// Passband edge as a fraction of the lower Nyquist frequency, and the Kaiser
+// window shape: about 80 dB of stopband with the base tap count.
+static const double Rolloff = 0.9;
+static const double KaiserBeta = 8.0;
+// Taps stay a multiple of the widest SIMD kernel.
+static const int TapAlign = 8;
+static const int MaxTaps = 384;
+
+static const double Pi = 3.141592653589793;
+
+typedef float (*DotFn)(const float *a, const float *b, int n);
+
+static float dot_C(const float *a, const float *b, int n)
+{
+    float sum = 0;
+    for (int i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+#ifdef CPU_X86
+// Two accumulators hide the add latency; n is a multiple of 8.
+CPU_TARGET_SSE2 static float dot_SSE2(const float *a, const float *b, int n)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    const __m128 acc = _mm_add_ps(acc0, acc1);
+    const __m128 pairs = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+
+CPU_TARGET_AVX2 static float dot_AVX2(const float *a, const float *b, int n)
+{
+    __m256 acc = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 8)
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    const __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    const __m128 pairs = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+#endif
+
+static DotFn selectDot()
+{
+#ifdef CPU_X86
+    if (cpuHasAVX2())
+        return dot_AVX2;
+    if (cpuHasSSE2())
+        return dot_SSE2;
+#endif
+    return dot_C;
+}
+
+static int gcd(int a, int b)
+{
+    while (b) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function, by its power series.
+static double besselI0(double x)
+{
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50 && term > sum * 1e-12; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+AudioResampler::AudioResampler()
+    : m_inputRate(0)
+    , m_outputRate(0)
+    , m_channels(0)
+    , m_up(1)
+    , m_down(1)
+    , m_taps(1)
+    , m_capacity(0)
+    , m_frames(0)
+    , m_time(0)
+{
+}
+
+bool AudioResampler::reset(int inputRate, int outputRate, int channels, int maxOutputFrames)
+{
+    if (inputRate <= 0 || outputRate <= 0 || channels <= 0)
+        return false;
+    const int g = gcd(inputRate, outputRate);
+    if (outputRate / g > MaxPhases)
+        return false;
+
+    m_inputRate = inputRate;
+    m_outputRate = outputRate;
+    m_channels = channels;
+    m_up = outputRate / g;
+    m_down = inputRate / g;
+    makeFilter();
+
+    const int maxInput = int((int64_t(maxOutputFrames) * m_down + m_up - 1) / m_up) + 2;
+    m_capacity = m_taps + maxInput;
+    m_history.fill(0.0f, m_capacity * m_channels);
+    // Start with a history of silence, so the first output is the first
+    // input, delayed by the filter.
+    m_frames = m_taps - 1;
+    m_time = int64_t(m_taps - 1) * m_up;
+    return true;
+}
+
+void AudioResampler::makeFilter()
+{
+    if (isPassthrough()) {
+        m_taps = 1;
+        m_coeffs.fill(1.0f, 1);
+        return;
+    }
+
+    // Downsampling cuts below the output's Nyquist frequency, which takes
+    // proportionally more input samples for the same transition band.
+    int taps = m_down > m_up ? int(int64_t(BaseTaps) * m_down / m_up) : BaseTaps;
+    taps = qMin(MaxTaps, (taps + TapAlign - 1) / TapAlign * TapAlign);
+    m_taps = taps;
+
+    const int length = taps * m_up;
+    const double centre = (length - 1) / 2.0;
+    const double cutoff = Rolloff * qMin(1.0, double(m_up) / m_down) / (2.0 * m_up);
+    const double norm = besselI0(KaiserBeta);
+    QVector<double> prototype(length);
+    for (int k = 0; k < length; ++k) {
+        const double x = k - centre;
+        const double sinc = x == 0 ? 1.0 : std::sin(2 * Pi * cutoff * x) / (2 * Pi * cutoff * x);
+        const double r = x / (centre + 1);
+        prototype[k] = sinc * besselI0(KaiserBeta * std::sqrt(qMax(0.0, 1 - r * r))) / norm;
+    }
+
+    // Phase p weighs the newest input with prototype[p], the one before with
+    // prototype[p + L] and so on; stored oldest first so the dot product runs
+    // forwards over the history. Each phase is normalized to unity gain.
+    m_coeffs.resize(m_up * taps);
+    for (int p = 0; p < m_up; ++p) {
+        double sum = 0;
+        for (int j = 0; j < taps; ++j)
+            sum += prototype[p + j * m_up];
+        float *phase = m_coeffs.data() + p * taps;
+        for (int j = 0; j < taps; ++j)
+            phase[taps - 1 - j] = float(prototype[p + j * m_up] / sum);
+    }
+}
+
+int AudioResampler::inputNeeded(int outputFrames) const
+{
+    if (outputFrames <= 0)
+        return 0;
+    const int64_t last = m_time + int64_t(outputFrames - 1) * m_down;
+    return qMax(0, int(last / m_up + 1 - m_frames));
+}
+
+float *AudioResampler::prepare(int frames)
+{
+    Q_ASSERT(m_frames + frames <= m_capacity);
+    return m_history.data() + m_frames;
+}
+
+void AudioResampler::commit(int frames)
+{
+    m_frames = qMin(m_capacity, m_frames + frames);
+}
+
+int AudioResampler::insertSilence(int frames)
+{
+    const int n = qBound(0, frames, m_capacity - m_frames);
+    for (int c = 0; c < m_channels; ++c)
+        memset(m_history.data() + c * m_capacity + m_frames, 0, size_t(n) * sizeof(float));
+    m_frames += n;
+    return n;
+}
+
+void AudioResampler::process(float *dst, int outputFrames, int channelStride, float gain, bool accumulate)
+{
+    Q_ASSERT(inputNeeded(outputFrames) == 0);
+
+    int64_t newest = m_time / m_up;
+    if (isPassthrough()) {
+        for (int c = 0; c < m_channels; ++c)
+            mixAudio(m_history.constData() + c * m_capacity + newest, gain, dst + c * channelStride, outputFrames, accumulate);
+        m_time += outputFrames;
+    } else {
+        static const DotFn dot = selectDot();
+        const int stepWhole = m_down / m_up;
+        const int stepPhase = m_down % m_up;
+        int phase = int(m_time % m_up);
+        for (int i = 0; i < outputFrames; ++i) {
+            const float *coeffs = m_coeffs.constData() + phase * m_taps;
+            const float *window = m_history.constData() + newest - (m_taps - 1);
+            for (int c = 0; c < m_channels; ++c) {
+                const float sample = gain * dot(window + c * m_capacity, coeffs, m_taps);
+                float &out = dst[c * channelStride + i];
+                out = accumulate ? out + sample : sample;
+            }
+            newest += stepWhole;
+            phase += stepPhase;
+            if (phase >= m_up) {
+                phase -= m_up;
+                ++newest;
+            }
+        }
+        m_time = newest * m_up + phase;
+    }
+
+    // Keep only the history the next output still reaches back to.
+    const int drop = int(qMin<int64_t>(m_frames, m_time / m_up - (m_taps - 1)));
+    if (drop > 0) {
+        for (int c = 0; c < m_channels; ++c) {
+            float *channel = m_history.data() + c * m_capacity;
+            memmove(channel, channel + drop, size_t(m_frames - drop) * sizeof(float));
+        }
+        m_frames -= drop;
+        m_time -= int64_t(drop) * m_up;
+    }
+}
+
+int AudioResampler::latencyFrames() const
+{
+    // Copying through reads the history without the filter's delay.
+    return int(m_frames - 1 - m_time / m_up) + (isPassthrough() ? 0 : m_taps / 2);
+}
+
+// The prototype is symmetric around its middle, (taps * L - 1) / 2 of the
+// 1/L input frames it is sampled at.
+double AudioResampler::filterDelayMs() const
+{
+    return m_inputRate > 0 && !isPassthrough() ? (double(m_taps) * m_up - 1) / (2.0 * m_up) * 1000 / m_inputRate : 0;
+}
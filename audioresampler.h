@@ -0,0 +1,73 @@
+#ifndef AUDIORESAMPLER_H
+#define AUDIORESAMPLER_H
+
+#include <QVector>
+#include <stdint.h>
+
+// Streaming polyphase sample rate converter for planar float audio. The
+// rate ratio is reduced to L/M, and every output sample is one dot product
+// of taps() input samples with one of L precomputed phases of a
+// Kaiser-windowed sinc, so the cost per sample does not depend on the
+// ratio. Equal rates are copied through.
+//
+// Input is written straight into the filter history: prepare() room for
+// inputNeeded() frames, fill it, commit(), then process() one block.
+class AudioResampler
+{
+public:
+    // Per phase when upsampling; downsampling widens the filter by the ratio.
+    static const int BaseTaps = 48;
+    // Ratios needing more phases than this are refused.
+    static const int MaxPhases = 1024;
+
+    AudioResampler();
+
+    // maxOutputFrames bounds a process() call, which bounds the input held.
+    // Returns false if the ratio cannot be reduced to MaxPhases.
+    bool reset(int inputRate, int outputRate, int channels, int maxOutputFrames);
+
+    int inputRate() const { return m_inputRate; }
+    int outputRate() const { return m_outputRate; }
+    int channels() const { return m_channels; }
+    int taps() const { return m_taps; }
+    bool isPassthrough() const { return m_up == m_down; }
+
+    // Input frames still to be committed before outputFrames can be made.
+    int inputNeeded(int outputFrames) const;
+    // Room for frames more input frames per channel, planar at channelStride().
+    float *prepare(int frames);
+    int channelStride() const { return m_capacity; }
+    void commit(int frames);
+    // Commits up to frames of silence, as much as there is room for, and
+    // returns how many; delays the input by that much.
+    int insertSilence(int frames);
+
+    // Writes outputFrames per channel to dst, planar at channelStride, scaled
+    // by gain, or adds them to what dst holds when accumulating, which is how
+    // AudioMixer mixes without a pass of its own. inputNeeded(outputFrames)
+    // must be 0.
+    void process(float *dst, int outputFrames, int channelStride, float gain = 1.0f, bool accumulate = false);
+
+    // How far behind the newest committed input frame the next output
+    // frame is, in input frames: what is buffered plus half the filter.
+    int latencyFrames() const;
+    // Half the filter, the delay it adds by itself; 0 when copying through.
+    double filterDelayMs() const;
+
+private:
+    void makeFilter();
+
+    int m_inputRate;
+    int m_outputRate;
+    int m_channels;
+    int m_up;                   // L
+    int m_down;                 // M
+    int m_taps;
+    QVector<float> m_coeffs;    // m_up phases of m_taps, oldest sample first
+    QVector<float> m_history;   // planar, m_capacity per channel
+    int m_capacity;
+    int m_frames;               // held per channel
+    int64_t m_time;             // next output, in 1/L input frames from m_history[0]
+};
+
+#endif // AUDIORESAMPLER_H
@@ -0,0 +1,111 @@
+#include "audioring.h"
+
+#include "audioconvert.h"
+
+AudioRing::AudioRing()
+    : m_channels(1)
+    , m_capacity(0)
+    , m_readPos(0)
+    , m_writePos(0)
+    , m_overruns(0)
+    , m_stampSeq(0)
+    , m_stampPos(0)
+    , m_stampNs(0)
+{
+}
+
+void AudioRing::reset(int channels, int capacityFrames)
+{
+    m_channels = qMax(1, channels);
+    m_capacity = qMax(1, capacityFrames);
+    m_data.fill(0.0f, m_channels * m_capacity);
+    m_readPos = 0;
+    m_writePos = 0;
+    m_overruns = 0;
+    m_stampSeq = 0;
+    m_stampPos = 0;
+    m_stampNs = 0;
+}
+
+int AudioRing::available() const
+{
+    return int(m_writePos.load(std::memory_order_acquire) - m_readPos.load(std::memory_order_acquire));
+}
+
+int AudioRing::write(const float *interleaved, int frames)
+{
+    return write(interleaved, SampleFloat, m_channels, frames);
+}
+
+int AudioRing::write(const void *interleaved, SampleFormat format, int srcChannels, int frames)
+{
+    const uint64_t writePos = m_writePos.load(std::memory_order_relaxed);
+    const int space = m_capacity - int(writePos - m_readPos.load(std::memory_order_acquire));
+    const int n = qMin(frames, space);
+    if (n < frames)
+        m_overruns.fetch_add(frames - n, std::memory_order_relaxed);
+
+    // At most two contiguous pieces around the wrap point.
+    const int start = int(writePos % m_capacity);
+    const int first = qMin(n, m_capacity - start);
+    float *data = m_data.data();
+    const uint8_t *src = static_cast<const uint8_t *>(interleaved);
+    const size_t srcFrameBytes = size_t(sampleFormatBytes(format)) * srcChannels;
+    convertAudioToFloat(src, format, srcChannels, data + start * m_channels, m_channels, first);
+    convertAudioToFloat(src + first * srcFrameBytes, format, srcChannels, data, m_channels, n - first);
+
+    m_writePos.store(writePos + n, std::memory_order_release);
+    return n;
+}
+
+bool AudioRing::readPlanar(float *dst, int frames, int channelStride)
+{
+    const uint64_t readPos = m_readPos.load(std::memory_order_relaxed);
+    if (int(m_writePos.load(std::memory_order_acquire) - readPos) < frames)
+        return false;
+
+    const int start = int(readPos % m_capacity);
+    const int first = qMin(frames, m_capacity - start);
+    const float *data = m_data.constData();
+    deinterleaveAudio(data + start * m_channels, first, m_channels, dst, channelStride);
+    deinterleaveAudio(data, frames - first, m_channels, dst + first, channelStride);
+
+    m_readPos.store(readPos + frames, std::memory_order_release);
+    return true;
+}
+
+void AudioRing::skip(int frames)
+{
+    const uint64_t readPos = m_readPos.load(std::memory_order_relaxed);
+    const int n = qMin(frames, int(m_writePos.load(std::memory_order_acquire) - readPos));
+    m_readPos.store(readPos + n, std::memory_order_release);
+}
+
+void AudioRing::stamp(int64_t captureNs)
+{
+    const uint32_t seq = m_stampSeq.load(std::memory_order_relaxed);
+    m_stampSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_stampPos.store(m_writePos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_stampNs.store(captureNs, std::memory_order_relaxed);
+    m_stampSeq.store(seq + 2, std::memory_order_release);
+}
+
+int64_t AudioRing::readTimeNs(int sampleRate) const
+{
+    uint32_t seq;
+    uint64_t pos;
+    int64_t ns;
+    do {
+        seq = m_stampSeq.load(std::memory_order_acquire);
+        pos = m_stampPos.load(std::memory_order_relaxed);
+        ns = m_stampNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != m_stampSeq.load(std::memory_order_relaxed));
+
+    if (!ns || sampleRate <= 0)
+        return 0;
+    // Signed: the reader may already be past a write that is not stamped yet.
+    const int64_t behind = int64_t(pos - m_readPos.load(std::memory_order_relaxed));
+    return ns - behind * 1000000000 / sampleRate;
+}
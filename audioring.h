@@ -0,0 +1,62 @@
+#ifndef AUDIORING_H
+#define AUDIORING_H
+
+#include <QVector>
+#include <atomic>
+#include <stdint.h>
+
+#include "audioconvert.h"
+
+// Single-producer/single-consumer ring of interleaved float audio frames.
+// The capture callback writes whatever it was handed, converted to float
+// and the ring's channel count on the way in; the sender side reads
+// fixed-size blocks back out as planar float, which is what NDI sends.
+class AudioRing
+{
+public:
+    AudioRing();
+
+    // Not thread-safe; call while neither side is running.
+    void reset(int channels, int capacityFrames);
+
+    int channels() const { return m_channels; }
+    int capacity() const { return m_capacity; }
+
+    // Producer. Writes as many whole frames as fit and returns that count;
+    // the rest is dropped and counted as an overrun.
+    int write(const float *interleaved, int frames);
+    // The same for frames of srcChannels samples in any format.
+    int write(const void *interleaved, SampleFormat format, int srcChannels, int frames);
+    // Records that the newest frame written so far was captured at
+    // captureNs, which dates every frame in the ring.
+    void stamp(int64_t captureNs);
+
+    // Consumer.
+    int available() const;
+    // Reads frames into dst as planar float: channel c starts at
+    // dst + c * channelStride. Returns false if fewer frames are available.
+    bool readPlanar(float *dst, int frames, int channelStride);
+    void skip(int frames);
+    // When the next frame to be read was captured, counting back from the
+    // last stamp at sampleRate; 0 before the first stamp.
+    int64_t readTimeNs(int sampleRate) const;
+
+    quint64 overrunFrames() const { return m_overruns.load(std::memory_order_relaxed); }
+
+private:
+    QVector<float> m_data;
+    int m_channels;
+    int m_capacity;
+
+    std::atomic<uint64_t> m_readPos;
+    std::atomic<uint64_t> m_writePos;
+    std::atomic<quint64> m_overruns;
+
+    // Written by stamp() under a sequence count, odd while it is writing,
+    // so the reader never pairs one stamp's position with another's time.
+    std::atomic<uint32_t> m_stampSeq;
+    std::atomic<uint64_t> m_stampPos;
+    std::atomic<int64_t> m_stampNs;
+};
+
+#endif // AUDIORING_H
@@ -0,0 +1,79 @@
+# Benchmark build: the application's pipeline linked against the stub NDI
+# library in ndistub/, so it builds and runs without the NDI SDK, a display or
+# capture devices.
+#
+#   qmake bench.pro && make && ./ndi_bench --output results.jsonl
+
+QT       += core gui multimedia
+QT       -= widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+# The pixel format converters rely on their row loops being vectorized.
+gcc: QMAKE_CXXFLAGS_RELEASE += -ftree-vectorize
+
+TARGET = ndi_bench
+
+# The stub header shadows the SDK's Processing.NDI.Lib.h.
+INCLUDEPATH += ndistub ..
+DEPENDPATH += ..
+
+SOURCES += \
+    benchmain.cpp \
+    ndistub/ndistub.cpp \
+    ../audioconvert.cpp \
+    ../audioinfo.cpp \
+    ../audiomixer.cpp \
+    ../audioresampler.cpp \
+    ../audioring.cpp \
+    ../colorconvert.cpp \
+    ../colorconvert_avx2.cpp \
+    ../colorconvert_sse2.cpp \
+    ../cpufeatures.cpp \
+    ../damagetracker.cpp \
+    ../devicecatalog.cpp \
+    ../framepacer.cpp \
+    ../framepool.cpp \
+    ../framescaler.cpp \
+    ../ndistream.cpp \
+    ../pipelinestats.cpp \
+    ../qualitygovernor.cpp \
+    ../replaysource.cpp \
+    ../senderthread.cpp \
+    ../stagescheduler.cpp \
+    ../statsreporter.cpp \
+    ../streamconfig.cpp \
+    ../streamengine.cpp \
+    ../streampreview.cpp \
+    ../streamrecorder.cpp \
+    ../stripepool.cpp \
+    ../syntheticsource.cpp
+
+HEADERS += \
+    ndistub/Processing.NDI.Lib.h \
+    ndistub/ndistub.h \
+    ../audioinfo.h \
+    ../devicecatalog.h \
+    ../framepacer.h \
+    ../ndistream.h \
+    ../replaysource.h \
+    ../senderthread.h \
+    ../statsreporter.h \
+    ../streamengine.h \
+    ../streamrecorder.h
+
+win32 {
+    SOURCES += ../gdicapturesource.cpp
+    LIBS += -ldwmapi -lgdi32 -lwinmm
+}
+
+unix:!macx {
+    SOURCES += ../x11capturesource.cpp
+    LIBS += -lX11 -lXext
+}
+
+linux {
+    SOURCES += ../v4l2camera.cpp
+    HEADERS += ../v4l2camera.h
+}
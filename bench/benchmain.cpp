@@ -0,0 +1,1458 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+
+#include "audioconvert.h"
+#include "audiomixer.h"
+#include "audioresampler.h"
+#include "audioring.h"
+#include "colorconvert.h"
+#include "colorconvert_p.h"
+#include "cpufeatures.h"
+#include "framepool.h"
+#include "framescaler.h"
+#include "ndistream.h"
+#include "ndistub.h"
+#include "pipelinestats.h"
+#include "senderthread.h"
+#include "stagescheduler.h"
+#include "statsreporter.h"
+#include "streamengine.h"
+#include "streampreview.h"
+#include "stripepool.h"
+#include "syntheticsource.h"
+
+// Benchmarks the conversion kernels, the stream preview, the sender queue, the
+// audio block path and the whole capture-to-send pipeline against the stub
+// NDI library. Every result is one JSON object per line so runs can be diffed
+// and graphed. The check bench asserts behaviour instead, and fails the run.
+
+struct Resolution {
+    const char *name;
+    int width;
+    int height;
+};
+
+static const Resolution resolutions[] = {
+    { "720p", 1280, 720 },
+    { "1080p", 1920, 1080 },
+    { "4k", 3840, 2160 },
+    { "8k", 7680, 4320 }
+};
+
+static QFile output;
+
+static void emitResult(QJsonObject result)
+{
+    result["ts"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    output.write(QJsonDocument(result).toJson(QJsonDocument::Compact) + '\n');
+    output.flush();
+}
+
+// Per-iteration wall times in ns, summarised.
+static QJsonObject timing(QVector<int64_t> samples)
+{
+    QJsonObject o;
+    if (samples.isEmpty())
+        return o;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (int64_t s : samples)
+        sum += s;
+    o["iterations"] = samples.size();
+    o["mean_us"] = sum / samples.size() / 1000.0;
+    o["p50_us"] = samples[samples.size() / 2] / 1000.0;
+    o["p99_us"] = samples[qMin(samples.size() - 1, samples.size() * 99 / 100)] / 1000.0;
+    o["min_us"] = samples.first() / 1000.0;
+    o["max_us"] = samples.last() / 1000.0;
+    return o;
+}
+
+static QJsonObject latency(const LatencyHistogram::Snapshot &counts)
+{
+    QJsonObject o;
+    o["count"] = double(LatencyHistogram::total(counts));
+    o["p50_us"] = LatencyHistogram::percentile(counts, 50) / 1000.0;
+    o["p99_us"] = LatencyHistogram::percentile(counts, 99) / 1000.0;
+    o["max_us"] = LatencyHistogram::percentile(counts, 100) / 1000.0;
+    return o;
+}
+
+static LatencyHistogram::Snapshot delta(const LatencyHistogram::Snapshot &now, const LatencyHistogram::Snapshot &before)
+{
+    LatencyHistogram::Snapshot d(now);
+    for (int i = 0; i < d.size() && i < before.size(); ++i)
+        d[i] -= before[i];
+    return d;
+}
+
+typedef void (*ConvertFn)(const uint8_t *, int, uint8_t *, int, int, int);
+
+static void benchConvert(const Resolution &res, int iterations, double maxSeconds, StripePool *stripes)
+{
+    SyntheticVideoSource source;
+    source.open(QRect(0, 0, res.width, res.height));
+
+    // Converts rows [y0, y1) of a frame into dst.
+    typedef std::function<void(const CaptureFrame &, uint8_t *, int, int)> RowsFn;
+    auto legacy = [](ConvertFn fn, int bytesPerPixel) -> RowsFn {
+        return [=](const CaptureFrame &frame, uint8_t *dst, int y0, int y1) {
+            const int dstStride = bytesPerPixel == 2 ? ((frame.width + 1) / 2) * 4 : frame.width * 4;
+            fn(frame.data + y0 * frame.stride, frame.stride, dst + y0 * dstStride, dstStride, frame.width, y1 - y0);
+        };
+    };
+    auto specialized = [](VideoFormat format) -> RowsFn {
+        const ConvertRGB32Fn fn = selectRGB32Converter(format, MatrixBT709, LimitedRange, false);
+        return [=](const CaptureFrame &frame, uint8_t *dst, int y0, int y1) {
+            fn(frame.data + y0 * frame.stride, frame.stride, dst, frame.width, frame.height, 0, y0, frame.width, y1 - y0);
+        };
+    };
+
+    struct Case {
+        QString format;
+        QString variant;
+        RowsFn fn;
+        bool striped;
+    };
+    QList<Case> cases;
+    cases << Case { "UYVY", "reference", legacy(convertRGB32ToUYVY_Reference, 2), false }
+          << Case { "UYVY", colorConvertBackend(), legacy(convertRGB32ToUYVY, 2), false }
+          << Case { "UYVY", "stripes", legacy(convertRGB32ToUYVY, 2), true }
+          << Case { "RGBA", "reference", legacy(convertRGB32ToRGBA_Reference, 4), false }
+          << Case { "RGBA", colorConvertBackend(), legacy(convertRGB32ToRGBA, 4), false }
+          << Case { "RGBA", "stripes", legacy(convertRGB32ToRGBA, 4), true };
+    // Every format through its BT.709 converter.
+    for (int f = VideoUYVY; f <= VideoRGBA; ++f) {
+        const QString name = QString(videoFormatName(VideoFormat(f))) + " bt709";
+        cases << Case { name, "specialized", specialized(VideoFormat(f)), false }
+              << Case { name, "stripes", specialized(VideoFormat(f)), true };
+    }
+    // Downscaling fused into the UYVY conversion, to each smaller resolution.
+    auto scaledTo = [&](const Resolution &out, FrameScaler::Filter filter) -> RowsFn {
+        std::shared_ptr<FrameScaler> scaler(new FrameScaler);
+        scaler->reset(QSize(res.width, res.height), QSize(out.width, out.height), filter);
+        const ConvertRGB32Fn fn = selectRGB32Converter(VideoUYVY, MatrixBT709, LimitedRange, false);
+        return [=](const CaptureFrame &frame, uint8_t *dst, int y0, int y1) {
+            // Stripes are cut in source rows; scale the output rows they cover.
+            const int h = scaler->size().height();
+            const int oy0 = (int64_t(y0) * h / frame.height) & ~1;
+            const int oy1 = y1 == frame.height ? h : (int64_t(y1) * h / frame.height) & ~1;
+            if (oy0 < oy1)
+                scaler->scaleConvert(frame.data, frame.stride, dst, fn, oy0, oy1);
+        };
+    };
+    for (const Resolution &out : resolutions) {
+        if (out.width >= res.width)
+            continue;
+        const QString name = QString("UYVY bt709 to %1").arg(out.name);
+        cases << Case { name, "box", scaledTo(out, FrameScaler::Box), false }
+              << Case { name, "box stripes", scaledTo(out, FrameScaler::Box), true }
+              << Case { name, "bilinear", scaledTo(out, FrameScaler::Bilinear), false }
+              << Case { name, "bilinear stripes", scaledTo(out, FrameScaler::Bilinear), true };
+    }
+
+    FramePool pool;
+    pool.reset(1, videoFrameSize(VideoP216, res.width, res.height));
+    FrameBuffer *buffer = pool.acquire();
+
+    for (const Case &c : cases) {
+        QVector<int64_t> samples;
+        const int64_t deadline = pipelineClockNs() + int64_t(maxSeconds * 1e9);
+        for (int i = 0; i < iterations; ++i) {
+            CaptureFrame frame;
+            source.grab(frame);
+            const int64_t t0 = pipelineClockNs();
+            if (c.striped) {
+                stripes->run(frame.height, [&](int y0, int y1) {
+                    c.fn(frame, buffer->data, y0, y1);
+                });
+            } else {
+                c.fn(frame, buffer->data, 0, frame.height);
+            }
+            const int64_t t1 = pipelineClockNs();
+            samples.push_back(t1 - t0);
+            // Always a few samples, but never let the scalar 8K cases run for minutes.
+            if (i >= 4 && t1 > deadline)
+                break;
+        }
+
+        QJsonObject result = timing(samples);
+        const double meanSeconds = result["mean_us"].toDouble() / 1e6;
+        result["bench"] = "convert";
+        result["resolution"] = res.name;
+        result["format"] = c.format;
+        result["variant"] = c.variant;
+        result["threads"] = c.striped ? stripes->threadCount() : 1;
+        result["mpixel_per_s"] = meanSeconds > 0 ? res.width * res.height / meanSeconds / 1e6 : 0.0;
+        result["fps"] = meanSeconds > 0 ? 1.0 / meanSeconds : 0.0;
+        emitResult(result);
+    }
+
+    pool.release(buffer);
+}
+
+static void benchQueue(int frames)
+{
+    // Tiny frames, so the numbers are the queue and thread hand-off alone.
+    const int depths[] = { 2, 8 };
+    const SenderThread::OverflowPolicy policies[] = { SenderThread::Block, SenderThread::DropOldest };
+    const char *policyNames[] = { "block", "drop_oldest" };
+
+    NDIlib_send_create_t desc("bench queue");
+    NDIlib_send_instance_t instance = NDIlib_send_create(&desc);
+
+    for (int depth : depths) {
+        for (int p = 0; p < 2; ++p) {
+            NDIlib_video_frame_v2_t videoFrame;
+            StreamStats stats;
+            SenderThread sender(instance, &videoFrame, NULL);
+            sender.SetQueue(depth, policies[p]);
+            sender.SetStats(&stats);
+
+            FramePool pool;
+            pool.reset(depth + 2, 64 * 64 * 2);
+            sender.Start();
+
+            quint64 starved = 0;
+            const int64_t t0 = pipelineClockNs();
+            for (int i = 0; i < frames; ++i) {
+                FrameBuffer *buffer = pool.acquire();
+                if (!buffer) {
+                    ++starved;
+                    QThread::yieldCurrentThread();
+                    continue;
+                }
+                buffer->xres = 64;
+                buffer->yres = 64;
+                buffer->stride = 128;
+                buffer->len = 64 * 128;
+                buffer->captureNs = pipelineClockNs();
+                sender.Push(buffer);
+            }
+            const int64_t t1 = pipelineClockNs();
+            sender.Stop();
+
+            QJsonObject result;
+            result["bench"] = "queue";
+            result["depth"] = depth;
+            result["policy"] = policyNames[p];
+            result["attempts"] = frames;
+            result["sent"] = double(stats.frames.load());
+            result["dropped"] = double(stats.queueDrops.load());
+            result["pool_empty"] = double(starved);
+            result["push_per_s"] = frames / ((t1 - t0) / 1e9);
+            result["queue_wait"] = latency(stats.queueWait.snapshot());
+            result["send"] = latency(stats.send.snapshot());
+            emitResult(result);
+        }
+    }
+
+    NDIlib_send_destroy(instance);
+}
+
+// A thumbnail of a frame in each format NDI is sent, against converting the
+// frame in the first place. share_pct is what the preview adds to the
+// conversion work of a stream at rate, with one thumbnail per interval.
+static void benchPreview(const Resolution &res, int iterations, FrameRate rate)
+{
+    const NDIlib_FourCC_video_type_e fourCCs[] = {
+        NDIlib_FourCC_video_type_UYVY, NDIlib_FourCC_video_type_UYVA, NDIlib_FourCC_video_type_P216,
+        NDIlib_FourCC_video_type_NV12, NDIlib_FourCC_video_type_I420, NDIlib_FourCC_video_type_RGBA
+    };
+
+    SyntheticVideoSource source;
+    source.open(QRect(0, 0, res.width, res.height));
+    CaptureFrame frame;
+    source.grab(frame);
+
+    FramePool pool;
+    pool.reset(1, videoFrameSize(VideoP216, res.width, res.height));
+    FrameBuffer *buffer = pool.acquire();
+
+    for (int f = VideoUYVY; f <= VideoRGBA; ++f) {
+        const VideoFormat format = VideoFormat(f);
+        const ConvertRGB32Fn convert = selectRGB32Converter(format, MatrixBT709, LimitedRange, false);
+        QVector<int64_t> converts;
+        for (int i = 0; i < qMax(4, iterations / 4); ++i) {
+            const int64_t t0 = pipelineClockNs();
+            convert(frame.data, frame.stride, buffer->data, res.width, res.height, 0, 0, res.width, res.height);
+            converts.push_back(pipelineClockNs() - t0);
+        }
+
+        NDIlib_video_frame_v2_t videoFrame(res.width, res.height, fourCCs[f]);
+        videoFrame.p_data = buffer->data;
+        videoFrame.line_stride_in_bytes = videoLineStride(format, res.width);
+        StreamPreview preview;
+        QVector<int64_t> thumbnails;
+        for (int i = 0; i < iterations; ++i) {
+            const int64_t t0 = pipelineClockNs();
+            preview.capture(videoFrame);
+            thumbnails.push_back(pipelineClockNs() - t0);
+        }
+        QImage image;
+        quint64 serial = 0;
+        preview.latest(&image, &serial);
+
+        QJsonObject result = timing(thumbnails);
+        const double convertUs = timing(converts)["mean_us"].toDouble();
+        const double framesPerSecond = double(rate.num) / rate.den;
+        const double thumbnailsPerSecond = qMin(framesPerSecond, 1000.0 / StreamPreview::DefaultIntervalMs);
+        result["bench"] = "preview";
+        result["resolution"] = res.name;
+        result["format"] = videoFormatName(format);
+        result["thumbnail"] = QString("%1x%2").arg(image.width()).arg(image.height());
+        result["convert_mean_us"] = convertUs;
+        result["share_pct"] = convertUs > 0
+            ? 100.0 * result["mean_us"].toDouble() * thumbnailsPerSecond / (convertUs * framesPerSecond) : 0.0;
+        emitResult(result);
+    }
+
+    pool.release(buffer);
+}
+
+static void benchAudio(int seconds)
+{
+    // 48 kHz stereo captured in 10 ms callbacks, read back as 20 ms planar
+    // blocks like the sender path does.
+    const int sampleRates[] = { 44100, 48000 };
+    for (int rate : sampleRates) {
+        SyntheticAudioSource tone(rate, 2);
+        AudioRing ring;
+        ring.reset(2, rate / 2);
+        const int callbackFrames = rate / 100;
+        const int blockFrames = rate / 50;
+        QVector<float> interleaved(callbackFrames * 2);
+        QVector<float> planar(blockFrames * 2);
+
+        QVector<int64_t> samples;
+        for (int i = 0; i < seconds * 100; ++i) {
+            tone.generate(interleaved.data(), callbackFrames);
+            ring.write(interleaved.constData(), callbackFrames);
+            while (ring.available() >= blockFrames) {
+                const int64_t t0 = pipelineClockNs();
+                ring.readPlanar(planar.data(), blockFrames, blockFrames);
+                samples.push_back(pipelineClockNs() - t0);
+            }
+        }
+
+        QJsonObject result = timing(samples);
+        result["bench"] = "audio_block";
+        result["sample_rate"] = rate;
+        result["channels"] = 2;
+        result["block_frames"] = blockFrames;
+        emitResult(result);
+    }
+
+    // Whatever a device might negotiate, taken to 48 kHz stereo float the way
+    // NdiStream does: converted into the ring in 10 ms callbacks, then each
+    // 20 ms block deinterleaved into the resampler and filtered.
+    struct DeviceFormat {
+        int rate;
+        int channels;
+        SampleFormat format;
+    };
+    const DeviceFormat devices[] = {
+        { 44100, 1, SampleS16 }, { 44100, 2, SampleFloat }, { 48000, 2, SampleS16 },
+        { 48000, 2, SampleFloat }, { 96000, 2, SampleS32 }, { 16000, 1, SampleS16 }
+    };
+    const int outRate = 48000, outChannels = 2, blockFrames = outRate / 50;
+    for (const DeviceFormat &device : devices) {
+        SyntheticAudioSource tone(device.rate, device.channels);
+        const int callbackFrames = device.rate / 100;
+        QVector<float> tones(callbackFrames * device.channels);
+        QVector<char> captured(callbackFrames * device.channels * sampleFormatBytes(device.format));
+        AudioRing ring;
+        ring.reset(outChannels, device.rate / 2);
+        AudioResampler resampler;
+        resampler.reset(device.rate, outRate, outChannels, blockFrames);
+        QVector<float> planar(blockFrames * outChannels);
+
+        QVector<int64_t> writes, blocks;
+        for (int i = 0; i < seconds * 100; ++i) {
+            tone.generate(tones.data(), callbackFrames);
+            for (int s = 0; s < tones.size(); ++s) {
+                const float v = tones[s];
+                if (device.format == SampleS16)
+                    reinterpret_cast<int16_t *>(captured.data())[s] = int16_t(v * 32767);
+                else if (device.format == SampleS32)
+                    reinterpret_cast<int32_t *>(captured.data())[s] = int32_t(v * 2147483647.0);
+                else
+                    reinterpret_cast<float *>(captured.data())[s] = v;
+            }
+
+            int64_t t0 = pipelineClockNs();
+            ring.write(captured.constData(), device.format, device.channels, callbackFrames);
+            writes.push_back(pipelineClockNs() - t0);
+            for (int needed = resampler.inputNeeded(blockFrames); ring.available() >= needed;
+                 needed = resampler.inputNeeded(blockFrames)) {
+                t0 = pipelineClockNs();
+                ring.readPlanar(resampler.prepare(needed), needed, resampler.channelStride());
+                resampler.commit(needed);
+                resampler.process(planar.data(), blockFrames, blockFrames);
+                blocks.push_back(pipelineClockNs() - t0);
+            }
+        }
+
+        QJsonObject result = timing(blocks);
+        result["bench"] = "audio_resample";
+        result["device_rate"] = device.rate;
+        result["device_channels"] = device.channels;
+        result["device_format"] = sampleFormatName(device.format);
+        result["sample_rate"] = outRate;
+        result["channels"] = outChannels;
+        result["block_frames"] = blockFrames;
+        result["taps"] = resampler.taps();
+        result["filter_delay_ms"] = resampler.filterDelayMs();
+        result["callback_write"] = timing(writes);
+        emitResult(result);
+    }
+
+    // Several inputs mixed into one stream, half of them at 44.1 kHz so both
+    // the copy and the filter paths are counted. Every input is written and
+    // stamped each 10 ms, then the blocks that completes are mixed.
+    const int inputCounts[] = { 1, 2, 4, 8 };
+    for (int inputs : inputCounts) {
+        AudioMixer mixer;
+        mixer.reset(outRate, outChannels, blockFrames);
+        std::unique_ptr<AudioRing[]> rings(new AudioRing[inputs]);
+        QVector<SyntheticAudioSource *> tones;
+        QVector<QVector<float> > captured(inputs);
+        for (int i = 0; i < inputs; ++i) {
+            const int rate = i % 2 ? 44100 : outRate;
+            rings[i].reset(outChannels, rate / 2);
+            tones.push_back(new SyntheticAudioSource(rate, outChannels));
+            captured[i].resize(rate / 100 * outChannels);
+            mixer.addInput(&rings[i], rate, 0.5f);
+        }
+        QVector<float> planar(blockFrames * outChannels);
+
+        QVector<int64_t> blocks;
+        int64_t captureNs;
+        for (int tick = 0; tick < seconds * 100; ++tick) {
+            const int64_t now = pipelineClockNs();
+            for (int i = 0; i < inputs; ++i) {
+                const int frames = captured[i].size() / outChannels;
+                tones[i]->generate(captured[i].data(), frames);
+                rings[i].write(captured[i].constData(), frames);
+                rings[i].stamp(now);
+            }
+            while (mixer.isReady()) {
+                const int64_t t0 = pipelineClockNs();
+                mixer.mix(planar.data(), blockFrames, &captureNs);
+                blocks.push_back(pipelineClockNs() - t0);
+            }
+        }
+        qDeleteAll(tones);
+
+        QJsonObject result = timing(blocks);
+        result["bench"] = "audio_mix";
+        result["inputs"] = inputs;
+        result["sample_rate"] = outRate;
+        result["channels"] = outChannels;
+        result["block_frames"] = blockFrames;
+        result["realignments"] = double(mixer.realignments());
+        result["underruns"] = double(mixer.underruns());
+        emitResult(result);
+    }
+}
+
+static void benchPipeline(const Resolution &res, int streams, FrameRate rate, const char *format, int seconds,
+                          int workers, bool pinCores)
+{
+    StreamEngine engine;
+    engine.statsReporter()->setLogFile(QString());
+    engine.setStageWorkers(workers, pinCores);
+
+    for (int i = 0; i < streams; ++i) {
+        StreamConfig config;
+        config.ndiName = QString("bench %1 %2").arg(res.name).arg(i);
+        config.video = StreamConfig::TestPatternVideo;
+        config.videoDevice = QString("%1x%2").arg(res.width).arg(res.height);
+        config.format = qstrcmp(format, "RGBA") == 0 ? VideoRGBA : VideoUYVY;
+        config.frameRate = rate;
+        // Test patterns move every frame, but measure the send path even if not.
+        config.unchangedPolicy = ResendUnchanged;
+        engine.addStream(config);
+    }
+
+    // A receiver is connected, or the streams would sit idle.
+    ndiStubSetConnections(1);
+    NdiStubCounters &stub = ndiStubCounters();
+    const quint64 stubFrames = stub.videoFrames;
+    const LatencyHistogram::Snapshot stubCall = stub.videoCall.snapshot();
+    const LatencyHistogram::Snapshot stubInterval = stub.videoInterval.snapshot();
+
+    const int started = engine.start();
+    QTimer::singleShot(seconds * 1000, qApp, SLOT(quit()));
+    QCoreApplication::exec();
+
+    QJsonArray perStream;
+    double totalFps = 0;
+    quint64 totalDrops = 0;
+    LatencyHistogram::Snapshot glassToWire(LatencyHistogram::BucketCount, 0);
+    LatencyHistogram::Snapshot convert(LatencyHistogram::BucketCount, 0);
+    for (NdiStream *stream : engine.streams()) {
+        StreamStats &stats = stream->videoStats();
+        const LatencyHistogram::Snapshot g2w = stats.glassToWire.snapshot();
+        const LatencyHistogram::Snapshot conv = stats.convert.snapshot();
+        for (int i = 0; i < g2w.size(); ++i) {
+            glassToWire[i] += g2w[i];
+            convert[i] += conv[i];
+        }
+        const double fps = double(stats.frames.load()) / seconds;
+        const quint64 drops = stats.captureDrops + stats.queueDrops;
+        totalFps += fps;
+        totalDrops += drops;
+
+        QJsonObject s;
+        s["name"] = stream->config().ndiName;
+        s["fps"] = fps;
+        s["drops"] = double(drops);
+        s["glass_to_wire"] = latency(g2w);
+        perStream.append(s);
+    }
+    engine.stop();
+    const StageScheduler *scheduler = engine.scheduler();
+
+    QJsonObject result;
+    result["bench"] = "pipeline";
+    result["resolution"] = res.name;
+    result["format"] = format;
+    result["streams"] = streams;
+    result["started"] = started;
+    result["stage_workers"] = scheduler->threadCount();
+    result["pinned"] = pinCores;
+    result["stage_tasks"] = double(scheduler->TasksRun());
+    result["stage_steals"] = double(scheduler->Steals());
+    result["target_fps"] = double(rate.num) / rate.den;
+    result["seconds"] = seconds;
+    result["fps_total"] = totalFps;
+    result["fps_per_stream"] = streams ? totalFps / streams : 0.0;
+    result["drops"] = double(totalDrops);
+    result["convert"] = latency(convert);
+    result["glass_to_wire"] = latency(glassToWire);
+    result["stub_frames"] = double(stub.videoFrames - stubFrames);
+    result["stub_call"] = latency(delta(stub.videoCall.snapshot(), stubCall));
+    result["stub_interval"] = latency(delta(stub.videoInterval.snapshot(), stubInterval));
+    result["per_stream"] = perStream;
+    emitResult(result);
+}
+
+// Streams with no receivers for the first half of the run, then one receiver:
+// process CPU time in each half and how long the first frame took to arrive
+// after the connection.
+static void benchIdle(const Resolution &res, int streams, FrameRate rate, int seconds)
+{
+    StreamEngine engine;
+    engine.statsReporter()->setLogFile(QString());
+    for (int i = 0; i < streams; ++i) {
+        StreamConfig config;
+        config.ndiName = QString("bench idle %1 %2").arg(res.name).arg(i);
+        config.video = StreamConfig::TestPatternVideo;
+        config.videoDevice = QString("%1x%2").arg(res.width).arg(res.height);
+        config.frameRate = rate;
+        config.unchangedPolicy = ResendUnchanged;
+        engine.addStream(config);
+    }
+
+    NdiStubCounters &stub = ndiStubCounters();
+    ndiStubSetConnections(0);
+    const quint64 framesBefore = stub.videoFrames;
+    const int started = engine.start();
+
+    const int halfMs = seconds * 500;
+    std::clock_t cpu0 = std::clock();
+    std::clock_t cpuIdle = 0, cpuActive = 0;
+    quint64 idleFrames = 0;
+    int64_t connectedNs = 0, wakeNs = -1;
+    quint64 framesAtConnect = 0;
+
+    QTimer poll;
+    poll.setInterval(1);
+    QObject::connect(&poll, &QTimer::timeout, [&]() {
+        if (wakeNs < 0 && stub.videoFrames > framesAtConnect)
+            wakeNs = pipelineClockNs() - connectedNs;
+    });
+    QTimer::singleShot(halfMs, [&]() {
+        cpuIdle = std::clock() - cpu0;
+        cpu0 = std::clock();
+        idleFrames = stub.videoFrames - framesBefore;
+        framesAtConnect = stub.videoFrames;
+        connectedNs = pipelineClockNs();
+        ndiStubSetConnections(1);
+        poll.start();
+    });
+    QTimer::singleShot(2 * halfMs, qApp, SLOT(quit()));
+    QCoreApplication::exec();
+    cpuActive = std::clock() - cpu0;
+    engine.stop();
+
+    QJsonObject result;
+    result["bench"] = "idle";
+    result["resolution"] = res.name;
+    result["streams"] = streams;
+    result["started"] = started;
+    result["target_fps"] = double(rate.num) / rate.den;
+    result["seconds"] = seconds;
+    result["cpu_idle_pct"] = 100.0 * cpuIdle / CLOCKS_PER_SEC / (halfMs / 1000.0);
+    result["cpu_active_pct"] = 100.0 * cpuActive / CLOCKS_PER_SEC / (halfMs / 1000.0);
+    result["frames_while_idle"] = double(idleFrames);
+    result["wake_ms"] = wakeNs >= 0 ? wakeNs / 1e6 : -1.0;
+    result["frame_interval_ms"] = 1000.0 * rate.den / rate.num;
+    emitResult(result);
+}
+
+// Two streams; one is reconfigured every half second while the other is
+// watched for lost frames. Reports how long each kind of change took.
+static void benchReconfigure(const Resolution &res, FrameRate rate)
+{
+    StreamEngine engine;
+    engine.statsReporter()->setLogFile(QString());
+
+    StreamConfig config;
+    config.video = StreamConfig::TestPatternVideo;
+    config.videoDevice = QString("%1x%2").arg(res.width).arg(res.height);
+    config.frameRate = rate;
+    config.unchangedPolicy = ResendUnchanged;
+    config.ndiName = QString("bench reconfigure %1").arg(res.name);
+    NdiStream *changing = engine.addStream(config);
+    StreamConfig otherConfig = config;
+    otherConfig.ndiName = QString("bench bystander %1").arg(res.name);
+    NdiStream *other = engine.addStream(otherConfig);
+
+    struct Step {
+        const char *change;
+        StreamConfig config;
+    };
+    QList<Step> steps;
+    StreamConfig c = config;
+    c.frameRate = FrameRate{ rate.num, rate.den * 2 };
+    steps << Step { "frame_rate", c };
+    c.format = VideoRGBA;
+    steps << Step { "format", c };
+    c.outputSize = QSize(0, res.height / 2);
+    steps << Step { "output_size", c };
+    c.videoDevice = QString("%1x%2").arg(res.width / 2).arg(res.height / 2);
+    steps << Step { "video_source", c };
+    c.ndiName += " renamed";
+    steps << Step { "sender", c };
+    steps << Step { "back", config };
+
+    ndiStubSetConnections(1);
+    engine.start();
+    StreamStats &bystander = other->videoStats();
+    const quint64 framesBefore = bystander.frames;
+    const quint64 dropsBefore = bystander.captureDrops + bystander.queueDrops;
+    const int64_t t0 = pipelineClockNs();
+
+    QJsonObject applyMs;
+    int next = 0;
+    QTimer timer;
+    QObject::connect(&timer, &QTimer::timeout, [&]() {
+        if (next == steps.size()) {
+            qApp->quit();
+            return;
+        }
+        applyMs[steps[next].change] = engine.reconfigure(changing, steps[next].config);
+        ++next;
+    });
+    timer.start(500);
+    QCoreApplication::exec();
+    const double seconds = (pipelineClockNs() - t0) / 1e9;
+    const quint64 frames = bystander.frames - framesBefore;
+    const quint64 drops = bystander.captureDrops + bystander.queueDrops - dropsBefore;
+    engine.stop();
+
+    QJsonObject result;
+    result["bench"] = "reconfigure";
+    result["resolution"] = res.name;
+    result["target_fps"] = double(rate.num) / rate.den;
+    result["apply_ms"] = applyMs;
+    result["bystander_fps"] = frames / seconds;
+    result["bystander_drops"] = double(drops);
+    emitResult(result);
+}
+
+// One stream recorded to a temporary file, then the file replayed as fast as
+// the stub takes it, looping. The first half shows what recording adds to
+// the send path, the second how fast a recording can drive a sender.
+static void benchReplay(const Resolution &res, FrameRate rate, int seconds)
+{
+    const QString path = QDir::temp().filePath(QString("ndi_bench_%1.ndirec").arg(res.name));
+    ndiStubSetConnections(1);
+
+    StreamConfig config;
+    config.ndiName = QString("bench record %1").arg(res.name);
+    config.video = StreamConfig::TestPatternVideo;
+    config.videoDevice = QString("%1x%2").arg(res.width).arg(res.height);
+    config.frameRate = rate;
+    config.unchangedPolicy = ResendUnchanged;
+    config.recordPath = path;
+
+    QJsonObject record;
+    {
+        StreamEngine engine;
+        engine.statsReporter()->setLogFile(QString());
+        NdiStream *stream = engine.addStream(config);
+        engine.start();
+        QTimer::singleShot(seconds * 1000, qApp, SLOT(quit()));
+        QCoreApplication::exec();
+        StreamStats &stats = stream->videoStats();
+        record["fps"] = double(stats.frames.load()) / seconds;
+        record["drops"] = double(stats.captureDrops + stats.queueDrops);
+        record["send"] = latency(stats.send.snapshot());
+        record["glass_to_wire"] = latency(stats.glassToWire.snapshot());
+        engine.stop();
+        record["file_mb"] = QFile(path).size() / double(1 << 20);
+    }
+
+    QJsonObject replay;
+    {
+        StreamConfig replayConfig;
+        replayConfig.ndiName = QString("bench replay %1").arg(res.name);
+        replayConfig.video = StreamConfig::ReplayVideo;
+        replayConfig.videoDevice = path;
+        replayConfig.replayPacing = StreamConfig::FastPace;
+        replayConfig.replayLoop = true;
+
+        StreamEngine engine;
+        engine.statsReporter()->setLogFile(QString());
+        NdiStream *stream = engine.addStream(replayConfig);
+        const int started = engine.start();
+        QTimer::singleShot(seconds * 1000, qApp, SLOT(quit()));
+        QCoreApplication::exec();
+        StreamStats &stats = stream->videoStats();
+        replay["started"] = started;
+        replay["fps"] = double(stats.frames.load()) / seconds;
+        replay["drops"] = double(stats.captureDrops + stats.queueDrops);
+        replay["send"] = latency(stats.send.snapshot());
+        engine.stop();
+    }
+    QFile::remove(path);
+
+    QJsonObject result;
+    result["bench"] = "replay";
+    result["resolution"] = res.name;
+    result["target_fps"] = double(rate.num) / rate.den;
+    result["seconds"] = seconds;
+    result["record"] = record;
+    result["replay_fast"] = replay;
+    emitResult(result);
+}
+
+// Behavioural checks, run as the "check" bench. Each emits a result with
+// "passed" and makes the run exit non-zero if that is false, so the bench
+// also catches what timings would not: a SIMD kernel that differs from its
+// scalar reference, strand tasks reordered or run together, a worker that
+// missed a wake-up, a resampler that bends its tone, inputs mixed out of
+// step, a box filter whose average overflows.
+
+static const double TwoPi = 6.283185307179586;
+
+// Widths that leave a tail after every SIMD block size, odd ones included.
+static const int CheckWidths[] = { 1, 2, 3, 7, 15, 16, 17, 31, 33, 47, 63, 65, 127, 1921 };
+static const int MaxCheckWidth = 1921;
+
+// Writes two rows of width pixels, at most 16 bytes per pixel in all, to dst.
+typedef std::function<void(uint8_t *dst, int width)> KernelRun;
+
+// Fixed-seed noise, so a failure repeats.
+static QVector<uint8_t> noise(int bytes, quint32 seed)
+{
+    QVector<uint8_t> v(bytes);
+    for (int i = 0; i < bytes; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        v[i] = uint8_t(seed >> 24);
+    }
+    return v;
+}
+
+// Runs a kernel and its reference at every check width into buffers that
+// start out alike and compares them whole, so a write past the end of the
+// rows fails as well as a wrong byte within them.
+static bool checkKernel(const QString &kernel, const QString &variant, const KernelRun &run, const KernelRun &reference)
+{
+    QJsonArray failedWidths;
+    for (int width : CheckWidths) {
+        QVector<uint8_t> out(width * 16 + 64, 0xa5);
+        QVector<uint8_t> expected(out);
+        run(out.data(), width);
+        reference(expected.data(), width);
+        if (memcmp(out.constData(), expected.constData(), out.size()) != 0)
+            failedWidths.append(width);
+    }
+
+    const bool passed = failedWidths.isEmpty();
+    QJsonObject result;
+    result["bench"] = "check_kernel";
+    result["passed"] = passed;
+    result["kernel"] = kernel;
+    result["variant"] = variant;
+    result["failed_widths"] = failedWidths;
+    emitResult(result);
+    return passed;
+}
+
+// The dispatched converters against their _Reference versions, and every
+// SIMD row kernel this CPU can run against the scalar one. Returns how many
+// failed.
+static int checkConverters()
+{
+    const int srcStride = MaxCheckWidth * 8;
+    const QVector<uint8_t> src = noise(srcStride * 2, 0x9e3779b9u);
+    const uint8_t *s = src.constData();
+
+    auto frame = [=](ConvertFn fn, bool packed422) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            fn(s, srcStride, dst, packed422 ? ((width + 1) / 2) * 4 : width * 4, width, 2);
+        };
+    };
+    auto row = [=](RowRGB32ToUYVYFn fn) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            fn(s, dst, width);
+        };
+    };
+    // Two NV12 rows share one chroma row, taken from the second source row.
+    typedef void (*NV12ConvertFn)(const uint8_t *, int, const uint8_t *, int, uint8_t *, int, int, int);
+    auto nv12Frame = [=](NV12ConvertFn fn) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            fn(s, srcStride, s + srcStride, srcStride, dst, ((width + 1) / 2) * 4, width, 2);
+        };
+    };
+    auto nv12Row = [=](RowNV12ToUYVYFn fn) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            fn(s, s + srcStride, dst, width);
+        };
+    };
+    // Two rows into a frame of format; rows() with its row kernel, converted()
+    // with a converter from selectRGB32Converter(), optionally in two
+    // rectangles side by side.
+    auto rows = [=](RowRGB32ToUYVYFn fn, VideoFormat format) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            const int stride = videoLineStride(format, width);
+            for (int y = 0; y < 2; ++y)
+                fn(s + y * srcStride, dst + y * stride, width);
+        };
+    };
+    auto converted = [=](ConvertRGB32Fn fn, bool split) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            // Rectangles start on even columns.
+            const int x = split ? (width / 2) & ~1 : 0;
+            if (x > 0)
+                fn(s, srcStride, dst, width, 2, 0, 0, x, 2);
+            fn(s + x * 4, srcStride, dst, width, 2, x, 0, width - x, 2);
+        };
+    };
+
+    int failed = 0;
+    failed += !checkKernel("RGB32 to UYVY", colorConvertBackend(),
+                           frame(convertRGB32ToUYVY, true), frame(convertRGB32ToUYVY_Reference, true));
+    failed += !checkKernel("RGB32 to RGBA", colorConvertBackend(),
+                           frame(convertRGB32ToRGBA, false), frame(convertRGB32ToRGBA_Reference, false));
+    failed += !checkKernel("YUYV to UYVY", colorConvertBackend(),
+                           frame(convertYUYVToUYVY, true), frame(convertYUYVToUYVY_Reference, true));
+    failed += !checkKernel("NV12 to UYVY", colorConvertBackend(),
+                           nv12Frame(convertNV12ToUYVY), nv12Frame(convertNV12ToUYVY_Reference));
+
+    // Limited-range UYVY and opaque RGBA are the specialized converters that
+    // take the dispatched kernels.
+    struct MatrixKernels {
+        ColorMatrix matrix;
+        const char *name;
+        RowRGB32ToUYVYFn scalar;
+        RowRGB32ToUYVYFn sse2;
+        RowRGB32ToUYVYFn avx2;
+    };
+    const MatrixKernels matrices[] = {
+#ifdef CPU_X86
+        { MatrixBT601, "bt601", convertRowRGB32ToUYVY_C<MatrixBT601>,
+          convertRowRGB32ToUYVY_SSE2<MatrixBT601>, convertRowRGB32ToUYVY_AVX2<MatrixBT601> },
+        { MatrixBT709, "bt709", convertRowRGB32ToUYVY_C<MatrixBT709>,
+          convertRowRGB32ToUYVY_SSE2<MatrixBT709>, convertRowRGB32ToUYVY_AVX2<MatrixBT709> },
+        { MatrixBT2020, "bt2020", convertRowRGB32ToUYVY_C<MatrixBT2020>,
+          convertRowRGB32ToUYVY_SSE2<MatrixBT2020>, convertRowRGB32ToUYVY_AVX2<MatrixBT2020> }
+#else
+        { MatrixBT601, "bt601", convertRowRGB32ToUYVY_C<MatrixBT601>, nullptr, nullptr },
+        { MatrixBT709, "bt709", convertRowRGB32ToUYVY_C<MatrixBT709>, nullptr, nullptr },
+        { MatrixBT2020, "bt2020", convertRowRGB32ToUYVY_C<MatrixBT2020>, nullptr, nullptr }
+#endif
+    };
+    for (const MatrixKernels &m : matrices) {
+        const QString kernel = QString("RGB32 to UYVY %1").arg(m.name);
+        failed += !checkKernel(kernel, "specialized",
+                               converted(selectRGB32Converter(VideoUYVY, m.matrix, LimitedRange, false), false),
+                               rows(m.scalar, VideoUYVY));
+        if (m.sse2 && cpuHasSSE2())
+            failed += !checkKernel(kernel, "sse2", row(m.sse2), row(m.scalar));
+        if (m.avx2 && cpuHasAVX2())
+            failed += !checkKernel(kernel, "avx2", row(m.avx2), row(m.scalar));
+    }
+    failed += !checkKernel("RGB32 to RGBA", "specialized",
+                           converted(selectRGB32Converter(VideoRGBA, MatrixBT709, LimitedRange, false), false),
+                           rows(convertRowRGB32ToRGBA_C, VideoRGBA));
+    failed += !checkKernel("ARGB32 to RGBA", "specialized",
+                           converted(selectRGB32Converter(VideoRGBA, MatrixBT709, LimitedRange, true), false),
+                           rows(convertRowARGB32ToRGBA_C, VideoRGBA));
+
+    // A frame converted in two rectangles must come out as converted whole,
+    // in every format, with and without source alpha.
+    for (int f = VideoUYVY; f <= VideoRGBA; ++f) {
+        for (int alpha = 0; alpha < 2; ++alpha) {
+            const ConvertRGB32Fn fn = selectRGB32Converter(VideoFormat(f), MatrixBT709, LimitedRange, alpha);
+            failed += !checkKernel(QString("RGB32 to %1%2").arg(videoFormatName(VideoFormat(f))).arg(alpha ? " alpha" : ""),
+                                   "rectangles", converted(fn, true), converted(fn, false));
+        }
+    }
+
+#ifdef CPU_X86
+    if (cpuHasSSE2()) {
+        failed += !checkKernel("RGB32 to RGBA", "sse2", row(convertRowRGB32ToRGBA_SSE2), row(convertRowRGB32ToRGBA_C));
+        failed += !checkKernel("YUYV to UYVY", "sse2", row(convertRowYUYVToUYVY_SSE2), row(convertRowYUYVToUYVY_C));
+        failed += !checkKernel("NV12 to UYVY", "sse2", nv12Row(convertRowNV12ToUYVY_SSE2), nv12Row(convertRowNV12ToUYVY_C));
+    }
+    if (cpuHasAVX2()) {
+        failed += !checkKernel("RGB32 to RGBA", "avx2", row(convertRowRGB32ToRGBA_AVX2), row(convertRowRGB32ToRGBA_C));
+        failed += !checkKernel("YUYV to UYVY", "avx2", row(convertRowYUYVToUYVY_AVX2), row(convertRowYUYVToUYVY_C));
+        failed += !checkKernel("NV12 to UYVY", "avx2", nv12Row(convertRowNV12ToUYVY_AVX2), nv12Row(convertRowNV12ToUYVY_C));
+    }
+#endif
+    return failed;
+}
+
+// FrameScaler's vertical passes and its SIMD box pass against the scalar
+// ones, over rows of width pixels. Returns how many failed.
+static int checkScalerKernels()
+{
+    const int srcStride = MaxCheckWidth * 8;
+    const QVector<uint8_t> src = noise(srcStride * 2, 0x85ebca6bu);
+    const uint8_t *s = src.constData();
+
+    auto widen = [=](ScaleWidenRowFn fn) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            fn(s, reinterpret_cast<uint16_t *>(dst), width * 4);
+        };
+    };
+    auto accumulate = [=](ScaleAccumulateRowFn fn) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            uint16_t *acc = reinterpret_cast<uint16_t *>(dst);
+            scaleWidenRow_C(s, acc, width * 4);
+            fn(s + srcStride, acc, width * 4);
+        };
+    };
+    // The weight changes with the width, so the widths cover a spread of them.
+    auto blend = [=](ScaleBlendRowsFn fn) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            fn(s, s + srcStride, dst, width * 4, (width * 37) % 255 + 1);
+        };
+    };
+    // Column sums as rows source rows of a box factor columns wide leave them.
+    auto boxColumns = [=](ScaleBoxColumnsFn fn, int factor, int rows) -> KernelRun {
+        return [=](uint8_t *dst, int width) {
+            QVector<uint16_t> acc(width * factor * 4);
+            for (int i = 0; i < acc.size(); ++i)
+                acc[i] = uint16_t((quint32(i) * 2654435761u >> 12) % (255 * rows + 1));
+            const int n = factor * rows;
+            fn(acc.constData(), reinterpret_cast<uint32_t *>(dst), width, factor, n, (65536 + n / 2) / n);
+        };
+    };
+
+    int failed = 0;
+#ifdef CPU_X86
+    if (cpuHasSSE2()) {
+        failed += !checkKernel("scale widen", "sse2", widen(scaleWidenRow_SSE2), widen(scaleWidenRow_C));
+        failed += !checkKernel("scale accumulate", "sse2", accumulate(scaleAccumulateRow_SSE2),
+                               accumulate(scaleAccumulateRow_C));
+        failed += !checkKernel("scale blend", "sse2", blend(scaleBlendRows_SSE2), blend(scaleBlendRows_C));
+        const int factors[] = { 2, 3, 4, 8 };
+        for (int factor : factors) {
+            for (int rows : { 1, 256 / factor }) {
+                failed += !checkKernel(QString("scale box columns %1x%2").arg(factor).arg(rows), "sse2",
+                                       boxColumns(scaleBoxColumns_SSE2, factor, rows),
+                                       boxColumns(scaleBoxColumns_C, factor, rows));
+            }
+        }
+    }
+    if (cpuHasAVX2()) {
+        failed += !checkKernel("scale widen", "avx2", widen(scaleWidenRow_AVX2), widen(scaleWidenRow_C));
+        failed += !checkKernel("scale accumulate", "avx2", accumulate(scaleAccumulateRow_AVX2),
+                               accumulate(scaleAccumulateRow_C));
+        failed += !checkKernel("scale blend", "avx2", blend(scaleBlendRows_AVX2), blend(scaleBlendRows_C));
+    }
+#endif
+    return failed;
+}
+
+struct StrandProbe {
+    StrandProbe() : strand(nullptr), chained(nullptr), last(-1), running(0), disorder(0), overlaps(0), ran(0) {}
+    StageScheduler::Strand *strand;
+    StrandProbe *chained;           // posted to from this strand's tasks
+    std::atomic<qint64> last;
+    std::atomic<int> running;
+    std::atomic<int> disorder;
+    std::atomic<int> overlaps;
+    std::atomic<qint64> ran;
+};
+
+static void probeTask(void *ctx, qint64 seq, qint64 spin)
+{
+    StrandProbe *probe = static_cast<StrandProbe *>(ctx);
+    if (probe->running.fetch_add(1) != 0)
+        probe->overlaps.fetch_add(1);
+    if (probe->last.exchange(seq) != seq - 1)
+        probe->disorder.fetch_add(1);
+    // Uneven task lengths leave some workers without work, so they steal.
+    for (volatile qint64 i = 0; i < spin; ++i) {}
+    if (probe->chained && !probe->chained->strand->post(&probeTask, probe->chained, seq, spin))
+        probe->chained->disorder.fetch_add(1);
+    probe->ran.fetch_add(1);
+    probe->running.fetch_sub(1);
+}
+
+static bool checkStrands(int workers)
+{
+    // Half the strands are fed by this thread, the other half from the
+    // tasks of the first half, as a stage posts to the next.
+    const int fed = 8, tasks = 20000, wakes = 200;
+    const int64_t limitNs = int64_t(10) * 1000000000;
+    StageScheduler scheduler;
+    std::unique_ptr<StrandProbe[]> probes(new StrandProbe[2 * fed]);
+    for (int s = 0; s < 2 * fed; ++s)
+        probes[s].strand = new StageScheduler::Strand(&scheduler, QString("check"), s < fed ? 64 : tasks + wakes);
+    for (int s = 0; s < fed; ++s)
+        probes[s].chained = &probes[fed + s];
+
+    // Progress is watched with a time limit rather than drain(), so a lost
+    // wake-up fails the check instead of hanging it.
+    const int64_t t0 = pipelineClockNs();
+    auto waitFor = [&](const std::atomic<qint64> &ran, qint64 count, int64_t untilNs) {
+        while (ran < count && pipelineClockNs() < untilNs)
+            QThread::yieldCurrentThread();
+        return ran >= count;
+    };
+
+    // Posted while stopped, these wait for start().
+    for (int s = 0; s < fed; ++s)
+        probes[s].strand->post(&probeTask, &probes[s], 0, 0);
+    // More workers than cores is fine here, and stealing needs several.
+    scheduler.start(workers > 0 ? workers : qMax(4, QThread::idealThreadCount()));
+
+    bool woken = true;
+    for (qint64 seq = 1; seq < tasks && woken; ++seq) {
+        for (int s = 0; s < fed && woken; ++s) {
+            while (!probes[s].strand->post(&probeTask, &probes[s], seq, (seq * 7 + s * 13) % 4000)) {
+                if (pipelineClockNs() - t0 > limitNs) {
+                    woken = false;
+                    break;
+                }
+                QThread::yieldCurrentThread();
+            }
+        }
+    }
+    for (int s = 0; s < 2 * fed && woken; ++s)
+        woken = waitFor(probes[s].ran, tasks, t0 + limitNs);
+
+    // One task at a time into an idle scheduler: each must wake a worker.
+    int64_t slowestWakeNs = 0;
+    for (int w = 0; w < wakes && woken; ++w) {
+        QThread::usleep(w % 10 ? 100 : 20000);
+        StrandProbe &probe = probes[w % fed];
+        const int64_t posted = pipelineClockNs();
+        probe.strand->post(&probeTask, &probe, tasks + w / fed, 0);
+        woken = waitFor(probe.chained->ran, tasks + w / fed + 1, posted + limitNs);
+        slowestWakeNs = qMax(slowestWakeNs, pipelineClockNs() - posted);
+    }
+
+    // Stopping runs whatever a missed wake-up left queued.
+    const int threads = scheduler.threadCount();
+    scheduler.stop();
+    qint64 ran = 0;
+    int disorder = 0, overlaps = 0;
+    for (int s = 0; s < 2 * fed; ++s) {
+        ran += probes[s].ran;
+        disorder += probes[s].disorder;
+        overlaps += probes[s].overlaps;
+        delete probes[s].strand;
+    }
+
+    const bool passed = woken && !disorder && !overlaps && ran == 2 * fed * (tasks + wakes / fed)
+            && scheduler.TasksRun() == quint64(ran);
+    QJsonObject result;
+    result["bench"] = "check_strands";
+    result["passed"] = passed;
+    result["workers"] = threads;
+    result["tasks"] = double(ran);
+    result["out_of_order"] = disorder;
+    result["overlapping"] = overlaps;
+    result["steals"] = double(scheduler.Steals());
+    result["slowest_wake_us"] = slowestWakeNs / 1000.0;
+    emitResult(result);
+    return passed;
+}
+
+// Fits a sine at freq to the samples by least squares; returns its
+// amplitude and sets residualDb to what is left, relative to it.
+static double fitTone(const float *samples, int count, double freq, int rate, double *residualDb)
+{
+    double ss = 0, cc = 0, sc = 0, xs = 0, xc = 0;
+    for (int i = 0; i < count; ++i) {
+        const double phase = TwoPi * freq * i / rate;
+        const double s = std::sin(phase), c = std::cos(phase);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        xs += samples[i] * s;
+        xc += samples[i] * c;
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (xs * cc - xc * sc) / det;
+    const double b = (xc * ss - xs * sc) / det;
+    double residual = 0;
+    for (int i = 0; i < count; ++i) {
+        const double phase = TwoPi * freq * i / rate;
+        const double e = samples[i] - a * std::sin(phase) - b * std::cos(phase);
+        residual += e * e;
+    }
+    const double amplitude = std::sqrt(a * a + b * b);
+    const double rms = std::sqrt(residual / count);
+    *residualDb = 20 * std::log10(qMax(rms, 1e-12) / qMax(amplitude / std::sqrt(2.0), 1e-12));
+    return amplitude;
+}
+
+// A second of a tone per channel through the resampler, in 20 ms blocks.
+// Returns the output per channel, planar, less the filter's start-up.
+static QVector<float> resampleTones(int inRate, int outRate, const double *freqs, int channels)
+{
+    const int blockFrames = outRate / 50;
+    AudioResampler resampler;
+    resampler.reset(inRate, outRate, channels, blockFrames);
+    const int skip = resampler.taps() * 2;
+    const int frames = outRate - skip;
+    QVector<float> block(blockFrames * channels);
+    QVector<float> out(frames * channels);
+    qint64 in = 0;
+    int made = 0;
+    for (int b = 0; b < 50; ++b) {
+        const int needed = resampler.inputNeeded(blockFrames);
+        float *dst = resampler.prepare(needed);
+        for (int c = 0; c < channels; ++c) {
+            for (int i = 0; i < needed; ++i)
+                dst[c * resampler.channelStride() + i] = float(0.5 * std::sin(TwoPi * freqs[c] * (in + i) / inRate));
+        }
+        resampler.commit(needed);
+        in += needed;
+        resampler.process(block.data(), blockFrames, blockFrames);
+        for (int i = 0; i < blockFrames; ++i, ++made) {
+            if (made < skip)
+                continue;
+            for (int c = 0; c < channels; ++c)
+                out[c * frames + made - skip] = block[c * blockFrames + i];
+        }
+    }
+    return out;
+}
+
+static bool checkResampler()
+{
+    struct Case {
+        int inRate;
+        int outRate;
+        double freqs[2];
+        bool passes[2];     // the tone is below both Nyquist rates
+    };
+    const Case cases[] = {
+        { 48000, 48000, { 1000, 17000 }, { true, true } },
+        { 44100, 48000, { 1000, 15000 }, { true, true } },
+        { 48000, 44100, { 1000, 23500 }, { true, false } },
+        { 96000, 48000, { 5000, 30000 }, { true, false } },
+        { 16000, 48000, { 440, 6000 }, { true, true } }
+    };
+    // A tone within the band keeps its level and shape; one above the
+    // output's Nyquist rate is filtered out rather than folded back.
+    const double maxGainErrorDb = 0.1, maxResidualDb = -60, minRejectionDb = 50;
+
+    bool allPassed = true;
+    for (const Case &test : cases) {
+        const QVector<float> out = resampleTones(test.inRate, test.outRate, test.freqs, 2);
+        const int frames = out.size() / 2;
+        bool passed = true;
+        QJsonArray tones;
+        for (int c = 0; c < 2; ++c) {
+            const float *samples = out.constData() + c * frames;
+            QJsonObject tone;
+            tone["frequency"] = test.freqs[c];
+            if (test.passes[c]) {
+                double residualDb;
+                const double gainDb = 20 * std::log10(fitTone(samples, frames, test.freqs[c], test.outRate, &residualDb) / 0.5);
+                passed = passed && qAbs(gainDb) <= maxGainErrorDb && residualDb <= maxResidualDb;
+                tone["gain_db"] = gainDb;
+                tone["residual_db"] = residualDb;
+            } else {
+                double energy = 0;
+                for (int i = 0; i < frames; ++i)
+                    energy += double(samples[i]) * samples[i];
+                const double rejectionDb = -20 * std::log10(qMax(std::sqrt(energy / frames), 1e-12) / (0.5 / std::sqrt(2.0)));
+                passed = passed && rejectionDb >= minRejectionDb;
+                tone["rejection_db"] = rejectionDb;
+            }
+            tones.append(tone);
+        }
+        allPassed = allPassed && passed;
+
+        QJsonObject result;
+        result["bench"] = "check_resampler";
+        result["passed"] = passed;
+        result["input_rate"] = test.inRate;
+        result["output_rate"] = test.outRate;
+        result["tones"] = tones;
+        emitResult(result);
+    }
+    return allPassed;
+}
+
+// The same noise captured by two inputs whose first frames were captured
+// offsetMs apart, mixed with opposite gains: once aligned, they cancel.
+static bool checkMixerAlignment(int offsetMs)
+{
+    const int rate = 48000, channels = 2, blockFrames = rate / 50, callbackFrames = rate / 100;
+    const int64_t startNs = int64_t(1000) * 1000000000;
+    const int offsetFrames = rate / 1000 * offsetMs;
+    // Noise, so that no shift but the right one cancels it.
+    auto signal = [](qint64 frame, int channel) {
+        quint32 x = quint32(frame * 2 + channel) * 2654435761u;
+        x ^= x >> 15;
+        x *= 2246822519u;
+        x ^= x >> 13;
+        return float(x & 0xffff) / 65536.0f - 0.5f;
+    };
+
+    AudioMixer mixer;
+    mixer.reset(rate, channels, blockFrames);
+    AudioRing rings[2];
+    qint64 written[2];
+    for (int i = 0; i < 2; ++i) {
+        rings[i].reset(channels, rate / 2);
+        mixer.addInput(&rings[i], rate, i ? -1.0f : 1.0f);
+        // The late input's first frame is the early one's frame offset.
+        written[i] = (i == 1) == (offsetFrames > 0) ? qAbs(offsetFrames) : 0;
+    }
+
+    QVector<float> interleaved(callbackFrames * channels);
+    QVector<float> block(blockFrames * channels);
+    const int settleBlocks = 2 + qAbs(offsetMs) / 20;
+    int blocks = 0;
+    quint64 settledRealignments = 0;
+    float worst = 0;
+    int64_t captureNs;
+    for (int tick = 0; tick < 200; ++tick) {
+        for (int i = 0; i < 2; ++i) {
+            for (int f = 0; f < callbackFrames; ++f) {
+                for (int c = 0; c < channels; ++c)
+                    interleaved[f * channels + c] = signal(written[i] + f, c);
+            }
+            rings[i].write(interleaved.constData(), callbackFrames);
+            written[i] += callbackFrames;
+            rings[i].stamp(startNs + (written[i] - 1) * 1000000000 / rate);
+        }
+        while (mixer.isReady()) {
+            mixer.mix(block.data(), blockFrames, &captureNs);
+            if (++blocks == settleBlocks)
+                settledRealignments = mixer.realignments();
+            if (blocks > settleBlocks) {
+                for (float v : block)
+                    worst = qMax(worst, qAbs(v));
+            }
+        }
+    }
+
+    // Lined up once, they stay so.
+    const bool passed = blocks > settleBlocks && worst < 1e-6f && mixer.realignments() == settledRealignments;
+    QJsonObject result;
+    result["bench"] = "check_mix_alignment";
+    result["passed"] = passed;
+    result["offset_ms"] = offsetMs;
+    result["blocks"] = blocks;
+    result["max_residual"] = worst;
+    result["realignments"] = double(mixer.realignments());
+    emitResult(result);
+    return passed;
+}
+
+// White through box reductions whose boxes hold 512 pixels and more, the
+// largest at the 256 times limit: every byte, alpha too, must stay 255.
+static bool checkScalerSaturation()
+{
+    struct Case {
+        QSize from;
+        QSize to;
+    };
+    const Case cases[] = {
+        { QSize(1024, 1024), QSize(32, 32) },
+        { QSize(1000, 600), QSize(30, 18) },
+        { QSize(7680, 4320), QSize(30, 18) }
+    };
+    const ConvertRGB32Fn convert = selectRGB32Converter(VideoRGBA, MatrixBT709, FullRange, true);
+
+    bool allPassed = true;
+    for (const Case &test : cases) {
+        QVector<uint32_t> src(test.from.width() * test.from.height(), 0xffffffffu);
+        FrameScaler scaler;
+        scaler.reset(test.from, test.to, FrameScaler::Box);
+        const QSize size = scaler.size();
+        QVector<uint8_t> dst(videoFrameSize(VideoRGBA, size.width(), size.height()), 0);
+        scaler.scaleConvert(reinterpret_cast<const uint8_t *>(src.constData()), test.from.width() * 4, dst.data(),
+                            convert, 0, size.height());
+        int wrong = 0;
+        for (uint8_t v : dst)
+            wrong += v != 255;
+        const bool passed = size == test.to && wrong == 0;
+        allPassed = allPassed && passed;
+
+        QJsonObject result;
+        result["bench"] = "check_scaler_saturation";
+        result["passed"] = passed;
+        result["from"] = QString("%1x%2").arg(test.from.width()).arg(test.from.height());
+        result["to"] = QString("%1x%2").arg(size.width()).arg(size.height());
+        result["wrong_bytes"] = wrong;
+        emitResult(result);
+    }
+    return allPassed;
+}
+
+// Returns how many checks failed.
+static int runChecks(int workers)
+{
+    int failed = 0;
+    failed += checkConverters();
+    failed += checkScalerKernels();
+    failed += !checkStrands(workers);
+    failed += !checkScalerSaturation();
+    failed += !checkResampler();
+    const int offsetsMs[] = { 0, 20, -20, 45 };
+    for (int offsetMs : offsetsMs)
+        failed += !checkMixerAlignment(offsetMs);
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("ndi_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Throughput and latency benchmarks against a stub NDI library.");
+    parser.addHelpOption();
+    QCommandLineOption benchOption("bench", "Comma-separated benches: check, convert, preview, queue, audio, pipeline, idle, "
+                                   "reconfigure, replay.", "list", "check,convert,preview,queue,audio,pipeline,idle,reconfigure,replay");
+    QCommandLineOption sizesOption("sizes", "Comma-separated resolutions: 720p, 1080p, 4k, 8k.", "list",
+                                   "720p,1080p,4k,8k");
+    QCommandLineOption iterationsOption("iterations", "Frames per conversion case.", "n", "60");
+    QCommandLineOption secondsOption("seconds", "Run time of each pipeline case.", "s", "5");
+    QCommandLineOption streamsOption("streams", "Comma-separated stream counts for the pipeline bench.", "list", "1,4");
+    QCommandLineOption rateOption("rate", "Pipeline frame rate as num/den.", "rate", "60/1");
+    QCommandLineOption costOption("ndi-cost", "Simulated NDI send cost in microseconds per MB.", "us", "0");
+    QCommandLineOption workersOption("workers", "Stage worker threads for the pipeline bench, 0 for one per core.", "n", "0");
+    QCommandLineOption pinOption("pin-cores", "Pin each stage worker to a core.");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write results to <file> instead of stdout.", "file");
+    parser.addOption(benchOption);
+    parser.addOption(sizesOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(secondsOption);
+    parser.addOption(streamsOption);
+    parser.addOption(rateOption);
+    parser.addOption(costOption);
+    parser.addOption(workersOption);
+    parser.addOption(pinOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            qCritical() << "Cannot write" << output.fileName();
+            return 1;
+        }
+    } else {
+        output.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+
+    const QStringList benches = parser.value(benchOption).split(',', QString::SkipEmptyParts);
+    const QStringList sizes = parser.value(sizesOption).split(',', QString::SkipEmptyParts);
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    const int seconds = qMax(1, parser.value(secondsOption).toInt());
+    const QStringList rateParts = parser.value(rateOption).split('/');
+    FrameRate rate = { rateParts.value(0).toInt(), rateParts.size() > 1 ? rateParts[1].toInt() : 1 };
+    if (rate.num <= 0 || rate.den <= 0)
+        rate = FrameRate{ 60, 1 };
+    ndiStubSetVideoCostUsPerMB(parser.value(costOption).toInt());
+
+    StripePool stripes;
+
+    QJsonObject info;
+    info["bench"] = "info";
+    info["backend"] = colorConvertBackend();
+    info["audio_backend"] = audioConvertBackend();
+    info["threads"] = stripes.threadCount();
+    info["qt"] = qVersion();
+    info["ndi_cost_us_per_mb"] = parser.value(costOption).toInt();
+    emitResult(info);
+
+    QList<Resolution> selected;
+    for (const Resolution &res : resolutions) {
+        if (sizes.contains(res.name, Qt::CaseInsensitive))
+            selected.push_back(res);
+    }
+
+    int failed = 0;
+    if (benches.contains("check"))
+        failed += runChecks(parser.value(workersOption).toInt());
+    if (benches.contains("convert")) {
+        for (const Resolution &res : selected)
+            benchConvert(res, iterations, 3.0, &stripes);
+    }
+    if (benches.contains("preview")) {
+        for (const Resolution &res : selected)
+            benchPreview(res, iterations, rate);
+    }
+    if (benches.contains("queue"))
+        benchQueue(200000);
+    if (benches.contains("audio"))
+        benchAudio(60);
+    if (benches.contains("pipeline")) {
+        for (const QString &count : parser.value(streamsOption).split(',', QString::SkipEmptyParts)) {
+            for (const Resolution &res : selected)
+                benchPipeline(res, qMax(1, count.toInt()), rate, "UYVY", seconds,
+                              parser.value(workersOption).toInt(), parser.isSet(pinOption));
+        }
+    }
+    if (benches.contains("idle")) {
+        for (const Resolution &res : selected)
+            benchIdle(res, 4, rate, seconds);
+    }
+    if (benches.contains("reconfigure")) {
+        for (const Resolution &res : selected)
+            benchReconfigure(res, rate);
+    }
+    if (benches.contains("replay")) {
+        for (const Resolution &res : selected)
+            benchReplay(res, rate, seconds);
+    }
+
+    if (failed)
+        qCritical() << failed << "checks failed";
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#ifndef PROCESSING_NDI_LIB_STUB_H
+#define PROCESSING_NDI_LIB_STUB_H
+
+// Stand-in for the NDI SDK header used by the benchmark build. It declares the
+// subset of the SDK this project calls, with the same names, layouts and
+// defaults, so the application sources compile against it unchanged. The
+// definitions in ndistub.cpp send nothing; they only account for the calls.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define NDI_LIB_FOURCC(ch0, ch1, ch2, ch3) \
+    ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) | ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24))
+
+typedef enum NDIlib_FourCC_video_type_e {
+    NDIlib_FourCC_video_type_UYVY = NDI_LIB_FOURCC('U', 'Y', 'V', 'Y'),
+    NDIlib_FourCC_video_type_UYVA = NDI_LIB_FOURCC('U', 'Y', 'V', 'A'),
+    NDIlib_FourCC_video_type_P216 = NDI_LIB_FOURCC('P', '2', '1', '6'),
+    NDIlib_FourCC_video_type_PA16 = NDI_LIB_FOURCC('P', 'A', '1', '6'),
+    NDIlib_FourCC_video_type_YV12 = NDI_LIB_FOURCC('Y', 'V', '1', '2'),
+    NDIlib_FourCC_video_type_I420 = NDI_LIB_FOURCC('I', '4', '2', '0'),
+    NDIlib_FourCC_video_type_NV12 = NDI_LIB_FOURCC('N', 'V', '1', '2'),
+    NDIlib_FourCC_video_type_BGRA = NDI_LIB_FOURCC('B', 'G', 'R', 'A'),
+    NDIlib_FourCC_video_type_BGRX = NDI_LIB_FOURCC('B', 'G', 'R', 'X'),
+    NDIlib_FourCC_video_type_RGBA = NDI_LIB_FOURCC('R', 'G', 'B', 'A'),
+    NDIlib_FourCC_video_type_RGBX = NDI_LIB_FOURCC('R', 'G', 'B', 'X'),
+    NDIlib_FourCC_video_type_max = 0x7fffffff
+} NDIlib_FourCC_video_type_e;
+
+typedef enum NDIlib_frame_format_type_e {
+    NDIlib_frame_format_type_progressive = 1,
+    NDIlib_frame_format_type_interleaved = 0,
+    NDIlib_frame_format_type_field_0 = 2,
+    NDIlib_frame_format_type_field_1 = 3,
+    NDIlib_frame_format_type_max = 0x7fffffff
+} NDIlib_frame_format_type_e;
+
+static const int64_t NDIlib_send_timecode_synthesize = INT64_MAX;
+
+typedef void *NDIlib_send_instance_t;
+
+struct NDIlib_send_create_t {
+    const char *p_ndi_name;
+    const char *p_groups;
+    bool clock_video;
+    bool clock_audio;
+
+    NDIlib_send_create_t(const char *p_ndi_name_ = NULL, const char *p_groups_ = NULL,
+                         bool clock_video_ = true, bool clock_audio_ = true)
+        : p_ndi_name(p_ndi_name_), p_groups(p_groups_), clock_video(clock_video_), clock_audio(clock_audio_) {}
+};
+
+struct NDIlib_video_frame_v2_t {
+    int xres, yres;
+    NDIlib_FourCC_video_type_e FourCC;
+    int frame_rate_N, frame_rate_D;
+    float picture_aspect_ratio;
+    NDIlib_frame_format_type_e frame_format_type;
+    int64_t timecode;
+    uint8_t *p_data;
+    union {
+        int line_stride_in_bytes;
+        int data_size_in_bytes;
+    };
+    const char *p_metadata;
+    int64_t timestamp;
+
+    NDIlib_video_frame_v2_t(int xres_ = 0, int yres_ = 0,
+                            NDIlib_FourCC_video_type_e FourCC_ = NDIlib_FourCC_video_type_UYVY,
+                            int frame_rate_N_ = 30000, int frame_rate_D_ = 1001,
+                            float picture_aspect_ratio_ = 0.0f,
+                            NDIlib_frame_format_type_e frame_format_type_ = NDIlib_frame_format_type_progressive,
+                            int64_t timecode_ = NDIlib_send_timecode_synthesize,
+                            uint8_t *p_data_ = NULL, int line_stride_in_bytes_ = 0,
+                            const char *p_metadata_ = NULL, int64_t timestamp_ = 0)
+        : xres(xres_), yres(yres_), FourCC(FourCC_), frame_rate_N(frame_rate_N_), frame_rate_D(frame_rate_D_),
+          picture_aspect_ratio(picture_aspect_ratio_), frame_format_type(frame_format_type_),
+          timecode(timecode_), p_data(p_data_), line_stride_in_bytes(line_stride_in_bytes_),
+          p_metadata(p_metadata_), timestamp(timestamp_) {}
+};
+
+struct NDIlib_audio_frame_v2_t {
+    int sample_rate;
+    int no_channels;
+    int no_samples;
+    int64_t timecode;
+    float *p_data;
+    int channel_stride_in_bytes;
+    const char *p_metadata;
+    int64_t timestamp;
+
+    NDIlib_audio_frame_v2_t(int sample_rate_ = 48000, int no_channels_ = 2, int no_samples_ = 0,
+                            int64_t timecode_ = NDIlib_send_timecode_synthesize, float *p_data_ = NULL,
+                            int channel_stride_in_bytes_ = 0, const char *p_metadata_ = NULL, int64_t timestamp_ = 0)
+        : sample_rate(sample_rate_), no_channels(no_channels_), no_samples(no_samples_), timecode(timecode_),
+          p_data(p_data_), channel_stride_in_bytes(channel_stride_in_bytes_), p_metadata(p_metadata_),
+          timestamp(timestamp_) {}
+};
+
+bool NDIlib_initialize(void);
+void NDIlib_destroy(void);
+
+NDIlib_send_instance_t NDIlib_send_create(const NDIlib_send_create_t *p_create_settings);
+void NDIlib_send_destroy(NDIlib_send_instance_t p_instance);
+void NDIlib_send_send_video_v2(NDIlib_send_instance_t p_instance, const NDIlib_video_frame_v2_t *p_video_data);
+void NDIlib_send_send_video_async_v2(NDIlib_send_instance_t p_instance, const NDIlib_video_frame_v2_t *p_video_data);
+void NDIlib_send_send_audio_v2(NDIlib_send_instance_t p_instance, const NDIlib_audio_frame_v2_t *p_audio_data);
+int NDIlib_send_get_no_connections(NDIlib_send_instance_t p_instance, uint32_t timeout_in_ms);
+
+#endif // PROCESSING_NDI_LIB_STUB_H
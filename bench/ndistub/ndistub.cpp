@@ -0,0 +1,122 @@
+#include <Processing.NDI.Lib.h>
+
+#include "ndistub.h"
+
+namespace {
+
+struct StubSender {
+    std::atomic<int64_t> lastVideoNs;
+    const void *pendingAsync;
+
+    StubSender() : lastVideoNs(0), pendingAsync(NULL) {}
+};
+
+std::atomic<int> videoCostUsPerMB(0);
+std::atomic<int> connections(0);
+
+}
+
+NdiStubCounters &ndiStubCounters()
+{
+    static NdiStubCounters counters;
+    return counters;
+}
+
+void ndiStubSetVideoCostUsPerMB(int microseconds)
+{
+    videoCostUsPerMB = microseconds;
+}
+
+void ndiStubSetConnections(int count)
+{
+    connections = count;
+}
+
+static void accountVideo(StubSender *sender, const NDIlib_video_frame_v2_t *frame, int64_t entered)
+{
+    NdiStubCounters &counters = ndiStubCounters();
+    const int bytes = frame->line_stride_in_bytes * frame->yres;
+
+    // Read one byte per cache line, roughly what an encoder pulling the frame
+    // through the cache costs, and burn the configured encode time.
+    if (frame->p_data) {
+        volatile uint8_t sink = 0;
+        for (int i = 0; i < bytes; i += 64)
+            sink ^= frame->p_data[i];
+        (void)sink;
+    }
+    const int cost = videoCostUsPerMB.load(std::memory_order_relaxed);
+    if (cost > 0) {
+        const int64_t until = entered + int64_t(bytes) * cost / 1000;
+        while (pipelineClockNs() < until) {}
+    }
+
+    const int64_t previous = sender->lastVideoNs.exchange(entered, std::memory_order_relaxed);
+    if (previous)
+        counters.videoInterval.record(entered - previous);
+    counters.videoFrames.fetch_add(1, std::memory_order_relaxed);
+    counters.videoBytes.fetch_add(bytes, std::memory_order_relaxed);
+    counters.lastXres.store(frame->xres, std::memory_order_relaxed);
+    counters.lastYres.store(frame->yres, std::memory_order_relaxed);
+    counters.videoCall.record(pipelineClockNs() - entered);
+}
+
+bool NDIlib_initialize(void)
+{
+    return true;
+}
+
+void NDIlib_destroy(void)
+{
+}
+
+NDIlib_send_instance_t NDIlib_send_create(const NDIlib_send_create_t *p_create_settings)
+{
+    (void)p_create_settings;
+    return new StubSender;
+}
+
+void NDIlib_send_destroy(NDIlib_send_instance_t p_instance)
+{
+    delete static_cast<StubSender *>(p_instance);
+}
+
+void NDIlib_send_send_video_v2(NDIlib_send_instance_t p_instance, const NDIlib_video_frame_v2_t *p_video_data)
+{
+    const int64_t entered = pipelineClockNs();
+    if (p_instance && p_video_data)
+        accountVideo(static_cast<StubSender *>(p_instance), p_video_data, entered);
+}
+
+void NDIlib_send_send_video_async_v2(NDIlib_send_instance_t p_instance, const NDIlib_video_frame_v2_t *p_video_data)
+{
+    // A NULL frame only flushes; like the SDK, the previous frame is done
+    // with once this returns.
+    const int64_t entered = pipelineClockNs();
+    StubSender *sender = static_cast<StubSender *>(p_instance);
+    if (!sender)
+        return;
+    if (p_video_data)
+        accountVideo(sender, p_video_data, entered);
+    sender->pendingAsync = p_video_data ? p_video_data->p_data : NULL;
+}
+
+void NDIlib_send_send_audio_v2(NDIlib_send_instance_t p_instance, const NDIlib_audio_frame_v2_t *p_audio_data)
+{
+    const int64_t entered = pipelineClockNs();
+    if (!p_instance || !p_audio_data)
+        return;
+
+    NdiStubCounters &counters = ndiStubCounters();
+    counters.audioFrames.fetch_add(1, std::memory_order_relaxed);
+    counters.audioBytes.fetch_add(quint64(p_audio_data->channel_stride_in_bytes) * p_audio_data->no_channels,
+                                  std::memory_order_relaxed);
+    counters.audioCall.record(pipelineClockNs() - entered);
+}
+
+int NDIlib_send_get_no_connections(NDIlib_send_instance_t p_instance, uint32_t timeout_in_ms)
+{
+    (void)p_instance;
+    (void)timeout_in_ms;
+    return connections.load(std::memory_order_relaxed);
+}
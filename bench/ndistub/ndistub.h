@@ -0,0 +1,34 @@
+#ifndef NDISTUB_H
+#define NDISTUB_H
+
+#include <atomic>
+
+#include "pipelinestats.h"
+
+// What the stub NDI library saw, summed over every sender instance.
+struct NdiStubCounters {
+    std::atomic<quint64> videoFrames;
+    std::atomic<quint64> videoBytes;
+    std::atomic<quint64> audioFrames;
+    std::atomic<quint64> audioBytes;
+    std::atomic<int> lastXres;
+    std::atomic<int> lastYres;
+
+    LatencyHistogram videoCall;         // time spent inside a video send call
+    LatencyHistogram videoInterval;     // between consecutive video sends of one instance
+    LatencyHistogram audioCall;
+
+    NdiStubCounters()
+        : videoFrames(0), videoBytes(0), audioFrames(0), audioBytes(0), lastXres(0), lastYres(0) {}
+};
+
+NdiStubCounters &ndiStubCounters();
+
+// Busy time a video send spends per megabyte of frame data, standing in for
+// the SDK's own encode. 0, the default, returns immediately.
+void ndiStubSetVideoCostUsPerMB(int microseconds);
+
+// What NDIlib_send_get_no_connections() reports.
+void ndiStubSetConnections(int connections);
+
+#endif // NDISTUB_H
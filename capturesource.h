@@ -0,0 +1,56 @@
+#ifndef CAPTURESOURCE_H
+#define CAPTURESOURCE_H
+
+#include <QList>
+#include <QRect>
+#include <QString>
+#include <stdint.h>
+
+// A captured frame of 32-bit pixels laid out like QImage::Format_RGB32
+// (B, G, R, X in memory). The fourth byte is undefined. The memory belongs to
+// the source and stays valid until the next grab() or close().
+struct CaptureFrame {
+    const uint8_t *data;
+    int stride;
+    int width;
+    int height;
+};
+
+// A top-level window CaptureSource::openWindow() can follow.
+struct CaptureWindow {
+    quintptr id;
+    QString title;
+};
+
+// Something that produces screen-sized frames on demand. Implementations keep
+// their capture buffers across grabs so the steady state allocates nothing.
+class CaptureSource
+{
+public:
+    virtual ~CaptureSource() {}
+
+    // geometry is the captured area in virtual desktop coordinates. Only
+    // that area is read.
+    virtual bool open(const QRect &geometry) = 0;
+    // Follows a top-level window instead: every grab reads just the part of
+    // the desktop the window covers at that moment, so frames move and
+    // resize with it, up to maxSize. Returns false if there is no such
+    // window or the source cannot follow one.
+    virtual bool openWindow(quintptr window, const QSize &maxSize)
+    {
+        Q_UNUSED(window)
+        Q_UNUSED(maxSize)
+        return false;
+    }
+    virtual void close() = 0;
+    virtual bool grab(CaptureFrame &frame) = 0;
+
+    virtual const char *name() const = 0;
+
+    // The native screen grabber for this platform, or nullptr if there is none.
+    static CaptureSource *create();
+    // The top-level windows the native grabber can follow.
+    static QList<CaptureWindow> windows();
+};
+
+#endif // CAPTURESOURCE_H
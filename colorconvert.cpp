@@ -0,0 +1,310 @@
+#include "colorconvert.h"
+#include "colorconvert_p.h"
+#include "cpufeatures.h"
+
+struct ColorConvertKernels {
+    const char *name;
+    RowRGB32ToUYVYFn rgb32ToUYVY[MatrixBT2020 + 1];    // limited range, by matrix
+    RowRGB32ToRGBAFn rgb32ToRGBA;
+    RowYUYVToUYVYFn yuyvToUYVY;
+    RowNV12ToUYVYFn nv12ToUYVY;
+};
+
+static ColorConvertKernels selectKernels()
+{
+    ColorConvertKernels k = { "scalar",
+                              { nullptr, convertRowRGB32ToUYVY_C<MatrixBT601>, convertRowRGB32ToUYVY_C<MatrixBT709>,
+                                convertRowRGB32ToUYVY_C<MatrixBT2020> },
+                              convertRowRGB32ToRGBA_C, convertRowYUYVToUYVY_C, convertRowNV12ToUYVY_C };
+#ifdef CPU_X86
+    if (cpuHasAVX2()) {
+        k.name = "avx2";
+        k.rgb32ToUYVY[MatrixBT601] = convertRowRGB32ToUYVY_AVX2<MatrixBT601>;
+        k.rgb32ToUYVY[MatrixBT709] = convertRowRGB32ToUYVY_AVX2<MatrixBT709>;
+        k.rgb32ToUYVY[MatrixBT2020] = convertRowRGB32ToUYVY_AVX2<MatrixBT2020>;
+        k.rgb32ToRGBA = convertRowRGB32ToRGBA_AVX2;
+        k.yuyvToUYVY = convertRowYUYVToUYVY_AVX2;
+        k.nv12ToUYVY = convertRowNV12ToUYVY_AVX2;
+    } else if (cpuHasSSE2()) {
+        k.name = "sse2";
+        k.rgb32ToUYVY[MatrixBT601] = convertRowRGB32ToUYVY_SSE2<MatrixBT601>;
+        k.rgb32ToUYVY[MatrixBT709] = convertRowRGB32ToUYVY_SSE2<MatrixBT709>;
+        k.rgb32ToUYVY[MatrixBT2020] = convertRowRGB32ToUYVY_SSE2<MatrixBT2020>;
+        k.rgb32ToRGBA = convertRowRGB32ToRGBA_SSE2;
+        k.yuyvToUYVY = convertRowYUYVToUYVY_SSE2;
+        k.nv12ToUYVY = convertRowNV12ToUYVY_SSE2;
+    }
+#endif
+    return k;
+}
+
+static const ColorConvertKernels &kernels()
+{
+    static const ColorConvertKernels k = selectKernels();
+    return k;
+}
+
+void convertRGB32ToUYVY(const uint8_t *src, int srcStride,
+                        uint8_t *dst, int dstStride,
+                        int width, int height)
+{
+    const RowRGB32ToUYVYFn row = kernels().rgb32ToUYVY[MatrixBT601];
+    for (int y = 0; y < height; ++y)
+        row(src + y * srcStride, dst + y * dstStride, width);
+}
+
+void convertRGB32ToUYVY_Reference(const uint8_t *src, int srcStride,
+                                  uint8_t *dst, int dstStride,
+                                  int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+        convertRowRGB32ToUYVY_C<MatrixBT601>(src + y * srcStride, dst + y * dstStride, width);
+}
+
+void convertRGB32ToRGBA(const uint8_t *src, int srcStride,
+                        uint8_t *dst, int dstStride,
+                        int width, int height)
+{
+    const RowRGB32ToRGBAFn row = kernels().rgb32ToRGBA;
+    for (int y = 0; y < height; ++y)
+        row(src + y * srcStride, dst + y * dstStride, width);
+}
+
+void convertRGB32ToRGBA_Reference(const uint8_t *src, int srcStride,
+                                  uint8_t *dst, int dstStride,
+                                  int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+        convertRowRGB32ToRGBA_C(src + y * srcStride, dst + y * dstStride, width);
+}
+
+void convertYUYVToUYVY(const uint8_t *src, int srcStride,
+                       uint8_t *dst, int dstStride,
+                       int width, int height)
+{
+    const RowYUYVToUYVYFn row = kernels().yuyvToUYVY;
+    for (int y = 0; y < height; ++y)
+        row(src + y * srcStride, dst + y * dstStride, width);
+}
+
+void convertYUYVToUYVY_Reference(const uint8_t *src, int srcStride,
+                                 uint8_t *dst, int dstStride,
+                                 int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+        convertRowYUYVToUYVY_C(src + y * srcStride, dst + y * dstStride, width);
+}
+
+void convertNV12ToUYVY(const uint8_t *srcY, int strideY,
+                       const uint8_t *srcUV, int strideUV,
+                       uint8_t *dst, int dstStride,
+                       int width, int height)
+{
+    const RowNV12ToUYVYFn row = kernels().nv12ToUYVY;
+    for (int y = 0; y < height; ++y)
+        row(srcY + y * strideY, srcUV + (y / 2) * strideUV, dst + y * dstStride, width);
+}
+
+void convertNV12ToUYVY_Reference(const uint8_t *srcY, int strideY,
+                                 const uint8_t *srcUV, int strideUV,
+                                 uint8_t *dst, int dstStride,
+                                 int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+        convertRowNV12ToUYVY_C(srcY + y * strideY, srcUV + (y / 2) * strideUV, dst + y * dstStride, width);
+}
+
+const char *videoFormatName(VideoFormat format)
+{
+    switch (format) {
+    case VideoUYVY: return "UYVY";
+    case VideoUYVA: return "UYVA";
+    case VideoP216: return "P216";
+    case VideoNV12: return "NV12";
+    case VideoI420: return "I420";
+    case VideoRGBA: return "RGBA";
+    }
+    return "unknown";
+}
+
+int videoLineStride(VideoFormat format, int width)
+{
+    switch (format) {
+    case VideoUYVY:
+    case VideoUYVA:
+    case VideoP216:
+        return ((width + 1) / 2) * 4;
+    case VideoNV12:
+    case VideoI420:
+        return (width + 1) & ~1;
+    case VideoRGBA:
+        return width * 4;
+    }
+    return 0;
+}
+
+int videoFrameSize(VideoFormat format, int width, int height)
+{
+    const int stride = videoLineStride(format, width);
+    const int chromaRows = (height + 1) / 2;
+    switch (format) {
+    case VideoUYVA:
+        return stride * height + width * height;
+    case VideoP216:
+        return stride * height * 2;
+    case VideoNV12:
+    case VideoI420:
+        return stride * height + stride * chromaRows;
+    default:
+        return stride * height;
+    }
+}
+
+ColorMatrix resolveColorMatrix(ColorMatrix matrix, int height)
+{
+    if (matrix != MatrixAuto)
+        return matrix;
+    return height < 720 ? MatrixBT601 : MatrixBT709;
+}
+
+// One converter per format, matrix, range and source alpha. Each walks the
+// rectangle row by row with the row kernels resolved at compile time; only
+// limited-range UYVY goes through the runtime-dispatched SIMD kernels.
+template <VideoFormat F, ColorMatrix M, ColorRange R, bool A>
+struct RGB32Converter;
+
+template <ColorMatrix M, bool A>
+struct RGB32Converter<VideoUYVY, M, LimitedRange, A> {
+    static void convert(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height, int x, int y, int w, int h)
+    {
+        (void)height;
+        const RowRGB32ToUYVYFn row = kernels().rgb32ToUYVY[M];
+        const int stride = videoLineStride(VideoUYVY, width);
+        for (int j = y; j < y + h; ++j)
+            row(src + (j - y) * srcStride, dst + j * stride + x * 2, w);
+    }
+};
+
+template <ColorMatrix M, bool A>
+struct RGB32Converter<VideoUYVY, M, FullRange, A> {
+    static void convert(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height, int x, int y, int w, int h)
+    {
+        (void)height;
+        const int stride = videoLineStride(VideoUYVY, width);
+        for (int j = y; j < y + h; ++j)
+            convertRowRGB32ToUYVYFull_C<M>(src + (j - y) * srcStride, dst + j * stride + x * 2, w);
+    }
+};
+
+template <ColorMatrix M, ColorRange R, bool A>
+struct RGB32Converter<VideoUYVA, M, R, A> {
+    static void convert(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height, int x, int y, int w, int h)
+    {
+        RGB32Converter<VideoUYVY, M, R, A>::convert(src, srcStride, dst, width, height, x, y, w, h);
+        uint8_t *alpha = dst + videoLineStride(VideoUYVA, width) * height;
+        for (int j = y; j < y + h; ++j)
+            convertRowRGB32ToAlpha_C<A>(src + (j - y) * srcStride, alpha + j * width + x, w);
+    }
+};
+
+template <ColorMatrix M, ColorRange R, bool A>
+struct RGB32Converter<VideoP216, M, R, A> {
+    static void convert(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height, int x, int y, int w, int h)
+    {
+        const int stride = videoLineStride(VideoP216, width);
+        uint8_t *uv = dst + stride * height;
+        for (int j = y; j < y + h; ++j)
+            convertRowRGB32ToP216_C<M, R>(src + (j - y) * srcStride,
+                                          reinterpret_cast<uint16_t *>(dst + j * stride) + x,
+                                          reinterpret_cast<uint16_t *>(uv + j * stride) + x, w);
+    }
+};
+
+// An odd last row is paired with itself.
+template <ColorMatrix M, ColorRange R, bool A>
+struct RGB32Converter<VideoNV12, M, R, A> {
+    static void convert(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height, int x, int y, int w, int h)
+    {
+        const int stride = videoLineStride(VideoNV12, width);
+        uint8_t *uv = dst + stride * height;
+        for (int j = y; j < y + h; j += 2) {
+            const int j1 = j + 1 < y + h ? j + 1 : j;
+            uint8_t *chroma = uv + (j / 2) * stride + x;
+            convertRowsRGB32To420_C<M, R, 2>(src + (j - y) * srcStride, src + (j1 - y) * srcStride,
+                                             dst + j * stride + x, dst + j1 * stride + x,
+                                             chroma, chroma + 1, w);
+        }
+    }
+};
+
+template <ColorMatrix M, ColorRange R, bool A>
+struct RGB32Converter<VideoI420, M, R, A> {
+    static void convert(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height, int x, int y, int w, int h)
+    {
+        const int stride = videoLineStride(VideoI420, width);
+        const int chromaStride = stride / 2;
+        uint8_t *u = dst + stride * height;
+        uint8_t *v = u + chromaStride * ((height + 1) / 2);
+        for (int j = y; j < y + h; j += 2) {
+            const int j1 = j + 1 < y + h ? j + 1 : j;
+            const int offset = (j / 2) * chromaStride + x / 2;
+            convertRowsRGB32To420_C<M, R, 1>(src + (j - y) * srcStride, src + (j1 - y) * srcStride,
+                                             dst + j * stride + x, dst + j1 * stride + x,
+                                             u + offset, v + offset, w);
+        }
+    }
+};
+
+template <ColorMatrix M, ColorRange R, bool A>
+struct RGB32Converter<VideoRGBA, M, R, A> {
+    static void convert(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height, int x, int y, int w, int h)
+    {
+        (void)height;
+        const RowRGB32ToRGBAFn row = A ? convertRowARGB32ToRGBA_C : kernels().rgb32ToRGBA;
+        const int stride = videoLineStride(VideoRGBA, width);
+        for (int j = y; j < y + h; ++j)
+            row(src + (j - y) * srcStride, dst + j * stride + x * 4, w);
+    }
+};
+
+template <VideoFormat F, ColorMatrix M, ColorRange R>
+static ConvertRGB32Fn selectForAlpha(bool sourceAlpha)
+{
+    return sourceAlpha ? RGB32Converter<F, M, R, true>::convert : RGB32Converter<F, M, R, false>::convert;
+}
+
+template <VideoFormat F, ColorMatrix M>
+static ConvertRGB32Fn selectForRange(ColorRange range, bool sourceAlpha)
+{
+    return range == FullRange ? selectForAlpha<F, M, FullRange>(sourceAlpha)
+                              : selectForAlpha<F, M, LimitedRange>(sourceAlpha);
+}
+
+template <VideoFormat F>
+static ConvertRGB32Fn selectForMatrix(ColorMatrix matrix, ColorRange range, bool sourceAlpha)
+{
+    switch (matrix) {
+    case MatrixBT601: return selectForRange<F, MatrixBT601>(range, sourceAlpha);
+    case MatrixBT709: return selectForRange<F, MatrixBT709>(range, sourceAlpha);
+    case MatrixBT2020: return selectForRange<F, MatrixBT2020>(range, sourceAlpha);
+    default: return nullptr;
+    }
+}
+
+ConvertRGB32Fn selectRGB32Converter(VideoFormat format, ColorMatrix matrix, ColorRange range, bool sourceAlpha)
+{
+    switch (format) {
+    case VideoUYVY: return selectForMatrix<VideoUYVY>(matrix, range, sourceAlpha);
+    case VideoUYVA: return selectForMatrix<VideoUYVA>(matrix, range, sourceAlpha);
+    case VideoP216: return selectForMatrix<VideoP216>(matrix, range, sourceAlpha);
+    case VideoNV12: return selectForMatrix<VideoNV12>(matrix, range, sourceAlpha);
+    case VideoI420: return selectForMatrix<VideoI420>(matrix, range, sourceAlpha);
+    case VideoRGBA: return selectForMatrix<VideoRGBA>(matrix, range, sourceAlpha);
+    }
+    return nullptr;
+}
+
+const char *colorConvertBackend()
+{
+    return kernels().name;
+}
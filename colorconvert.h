@@ -0,0 +1,107 @@
+#ifndef COLORCONVERT_H
+#define COLORCONVERT_H
+
+#include <stdint.h>
+
+// Destination layouts NDI accepts, as it expects them in memory. Planes follow
+// each other without gaps:
+//   UYVY  8-bit 4:2:2 packed
+//   UYVA  UYVY followed by an 8-bit alpha plane with a stride of the width
+//   P216  16-bit Y plane followed by a 16-bit interleaved 4:2:2 UV plane
+//   NV12  8-bit Y plane followed by a half-height interleaved UV plane
+//   I420  8-bit Y plane followed by half-size U and V planes
+//   RGBA  8-bit R, G, B, A
+enum VideoFormat {
+    VideoUYVY,
+    VideoUYVA,
+    VideoP216,
+    VideoNV12,
+    VideoI420,
+    VideoRGBA
+};
+
+// MatrixAuto is resolved with resolveColorMatrix() before converting.
+enum ColorMatrix {
+    MatrixAuto,
+    MatrixBT601,
+    MatrixBT709,
+    MatrixBT2020
+};
+
+enum ColorRange {
+    LimitedRange,
+    FullRange
+};
+
+const char *videoFormatName(VideoFormat format);
+// Stride of the first plane and size of the whole frame in bytes.
+int videoLineStride(VideoFormat format, int width);
+int videoFrameSize(VideoFormat format, int width, int height);
+
+// What NDI receivers assume when they are not told: BT.601 for SD and
+// BT.709 for HD and up.
+ColorMatrix resolveColorMatrix(ColorMatrix matrix, int height);
+
+// Converts a w x h rectangle of RGB32 pixels into the rectangle at (x, y) of a
+// width x height destination frame at dst. src points at the rectangle's
+// first pixel, so scaled rows can come from a scratch buffer, while dst is the
+// frame's origin, which locates the chroma and alpha planes. The rectangle
+// must start on even coordinates so subsampled chroma is never shared with
+// another rectangle.
+typedef void (*ConvertRGB32Fn)(const uint8_t *src, int srcStride, uint8_t *dst,
+                               int width, int height, int x, int y, int w, int h);
+
+// The converter specialized for one format, matrix and range. With sourceAlpha
+// the fourth source byte is carried into UYVA and RGBA; otherwise they are
+// made opaque. Returns nullptr for MatrixAuto.
+ConvertRGB32Fn selectRGB32Converter(VideoFormat format, ColorMatrix matrix, ColorRange range, bool sourceAlpha);
+
+// Source pixels are 32-bit QRgb words as stored by QImage::Format_RGB32
+// (B, G, R, X in memory). The fourth byte is ignored. Strides are in bytes.
+//
+// UYVY uses BT.601 limited-range coefficients. Each destination row must hold
+// ((width + 1) / 2) * 4 bytes; an odd last pixel is paired with itself.
+// selectRGB32Converter() covers the other formats, matrices and ranges.
+void convertRGB32ToUYVY(const uint8_t *src, int srcStride,
+                        uint8_t *dst, int dstStride,
+                        int width, int height);
+
+// Reorders to NDI RGBA byte order with alpha forced opaque; screen grabbers
+// leave the fourth byte undefined.
+void convertRGB32ToRGBA(const uint8_t *src, int srcStride,
+                        uint8_t *dst, int dstStride,
+                        int width, int height);
+
+// Camera formats that are already 4:2:2 or 4:2:0 YUV are only repacked.
+// YUYV source rows hold ((width + 1) / 2) * 4 bytes like UYVY.
+void convertYUYVToUYVY(const uint8_t *src, int srcStride,
+                       uint8_t *dst, int dstStride,
+                       int width, int height);
+
+// NV12 is a full-size Y plane plus a half-height plane of interleaved U/V
+// pairs; each chroma row is used for two output rows. Callers converting in
+// stripes pass srcUV already offset to row y0 / 2, with y0 even.
+void convertNV12ToUYVY(const uint8_t *srcY, int strideY,
+                       const uint8_t *srcUV, int strideUV,
+                       uint8_t *dst, int dstStride,
+                       int width, int height);
+
+// Portable scalar implementations the SIMD kernels must match byte for byte.
+void convertRGB32ToUYVY_Reference(const uint8_t *src, int srcStride,
+                                  uint8_t *dst, int dstStride,
+                                  int width, int height);
+void convertRGB32ToRGBA_Reference(const uint8_t *src, int srcStride,
+                                  uint8_t *dst, int dstStride,
+                                  int width, int height);
+void convertYUYVToUYVY_Reference(const uint8_t *src, int srcStride,
+                                 uint8_t *dst, int dstStride,
+                                 int width, int height);
+void convertNV12ToUYVY_Reference(const uint8_t *srcY, int strideY,
+                                 const uint8_t *srcUV, int strideUV,
+                                 uint8_t *dst, int dstStride,
+                                 int width, int height);
+
+// Name of the kernel picked for this CPU ("avx2", "sse2" or "scalar").
+const char *colorConvertBackend();
+
+#endif // COLORCONVERT_H
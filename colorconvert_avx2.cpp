@@ -0,0 +1,163 @@
+#include "colorconvert_p.h"
+#include "cpufeatures.h"
+
+#ifdef CPU_X86
+#include <immintrin.h>
+
+// Same arithmetic as the SSE2 kernel on 16 pixels per iteration. The 256-bit
+// packs work per 128-bit lane, so the result is permuted back into pixel order.
+template <ColorMatrix M>
+CPU_TARGET_AVX2 void convertRowRGB32ToUYVY_AVX2(const uint8_t *src, uint8_t *dst, int width)
+{
+    typedef Uyvy8Coefficients<M> K;
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const __m256i evenMask = _mm256_set1_epi32(0xffff);
+    const __m256i round = _mm256_set1_epi16(128);
+    const __m256i yOffset = _mm256_set1_epi16(16);
+    const __m256i cOffset = _mm256_set1_epi16(128);
+    const __m256i yR = _mm256_set1_epi16(K::yr), yG = _mm256_set1_epi16(K::yg), yB = _mm256_set1_epi16(K::yb);
+    const __m256i uR = _mm256_set1_epi16(K::ur), uG = _mm256_set1_epi16(K::ug), uB = _mm256_set1_epi16(K::ub);
+    const __m256i vR = _mm256_set1_epi16(K::vr), vG = _mm256_set1_epi16(K::vg), vB = _mm256_set1_epi16(K::vb);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+        const __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4 + 32));
+
+        const __m256i b = _mm256_permute4x64_epi64(
+                    _mm256_packs_epi32(_mm256_and_si256(p0, byteMask),
+                                       _mm256_and_si256(p1, byteMask)), 0xd8);
+        const __m256i g = _mm256_permute4x64_epi64(
+                    _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), byteMask),
+                                       _mm256_and_si256(_mm256_srli_epi32(p1, 8), byteMask)), 0xd8);
+        const __m256i r = _mm256_permute4x64_epi64(
+                    _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), byteMask),
+                                       _mm256_and_si256(_mm256_srli_epi32(p1, 16), byteMask)), 0xd8);
+
+        __m256i y = _mm256_add_epi16(_mm256_mullo_epi16(r, yR), _mm256_mullo_epi16(g, yG));
+        y = _mm256_add_epi16(y, _mm256_add_epi16(_mm256_mullo_epi16(b, yB), round));
+        y = _mm256_add_epi16(_mm256_srli_epi16(y, 8), yOffset);
+
+        __m256i u = _mm256_add_epi16(_mm256_mullo_epi16(r, uR), _mm256_mullo_epi16(g, uG));
+        u = _mm256_add_epi16(u, _mm256_add_epi16(_mm256_mullo_epi16(b, uB), round));
+        u = _mm256_add_epi16(_mm256_srai_epi16(u, 8), cOffset);
+
+        __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(r, vR), _mm256_mullo_epi16(g, vG));
+        v = _mm256_add_epi16(v, _mm256_add_epi16(_mm256_mullo_epi16(b, vB), round));
+        v = _mm256_add_epi16(_mm256_srai_epi16(v, 8), cOffset);
+
+        // The byte shift stays within each lane; the word it zeroes is even and
+        // masked out anyway.
+        const __m256i c = _mm256_or_si256(_mm256_and_si256(u, evenMask),
+                                          _mm256_andnot_si256(evenMask, _mm256_slli_si256(v, 2)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 2),
+                            _mm256_or_si256(c, _mm256_slli_epi16(y, 8)));
+    }
+
+    if (x < width)
+        convertRowRGB32ToUYVY_SSE2<M>(src + x * 4, dst + x * 2, width - x);
+}
+
+template void convertRowRGB32ToUYVY_AVX2<MatrixBT601>(const uint8_t *, uint8_t *, int);
+template void convertRowRGB32ToUYVY_AVX2<MatrixBT709>(const uint8_t *, uint8_t *, int);
+template void convertRowRGB32ToUYVY_AVX2<MatrixBT2020>(const uint8_t *, uint8_t *, int);
+
+CPU_TARGET_AVX2 void convertRowRGB32ToRGBA_AVX2(const uint8_t *src, uint8_t *dst, int width)
+{
+    const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), _mm256_or_si256(_mm256_shuffle_epi8(p, swap), alpha));
+    }
+
+    if (x < width)
+        convertRowRGB32ToRGBA_SSE2(src + x * 4, dst + x * 4, width - x);
+}
+
+CPU_TARGET_AVX2 void convertRowYUYVToUYVY_AVX2(const uint8_t *src, uint8_t *dst, int width)
+{
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 2), _mm256_shuffle_epi8(p, swap));
+    }
+
+    if (x < width)
+        convertRowYUYVToUYVY_SSE2(src + x * 2, dst + x * 2, width - x);
+}
+
+// The unpacks work per 128-bit lane, so the halves are put back in pixel order.
+CPU_TARGET_AVX2 void convertRowNV12ToUYVY_AVX2(const uint8_t *srcY, const uint8_t *srcUV, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(srcY + x));
+        const __m256i uv = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(srcUV + x));
+        const __m256i lo = _mm256_unpacklo_epi8(uv, y);
+        const __m256i hi = _mm256_unpackhi_epi8(uv, y);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 2 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    if (x < width)
+        convertRowNV12ToUYVY_SSE2(srcY + x, srcUV + x, dst + x * 2, width - x);
+}
+
+// Widening from 128-bit loads keeps the accumulators in byte order, which the
+// in-lane 256-bit unpacks would not.
+CPU_TARGET_AVX2 void scaleWidenRow_AVX2(const uint8_t *src, uint16_t *acc, int bytes)
+{
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + i), _mm256_cvtepu8_epi16(p));
+    }
+
+    if (i < bytes)
+        scaleWidenRow_C(src + i, acc + i, bytes - i);
+}
+
+CPU_TARGET_AVX2 void scaleAccumulateRow_AVX2(const uint8_t *src, uint16_t *acc, int bytes)
+{
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m256i *a = reinterpret_cast<__m256i *>(acc + i);
+        _mm256_storeu_si256(a, _mm256_add_epi16(_mm256_loadu_si256(a), _mm256_cvtepu8_epi16(p)));
+    }
+
+    if (i < bytes)
+        scaleAccumulateRow_C(src + i, acc + i, bytes - i);
+}
+
+CPU_TARGET_AVX2 void scaleBlendRows_AVX2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int bytes, int weight)
+{
+    const __m256i wa = _mm256_set1_epi16(static_cast<short>(256 - weight));
+    const __m256i wb = _mm256_set1_epi16(static_cast<short>(weight));
+    const __m256i round = _mm256_set1_epi16(128);
+    int i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        const __m256i pa0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+        const __m256i pa1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 16)));
+        const __m256i pb0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        const __m256i pb1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 16)));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(pa0, wa), _mm256_mullo_epi16(pb0, wb));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(pa1, wa), _mm256_mullo_epi16(pb1, wb));
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, round), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, round), 8);
+        // packus interleaves the lanes; put the 64-bit quarters back in order.
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8));
+    }
+
+    if (i < bytes)
+        scaleBlendRows_SSE2(a + i, b + i, dst + i, bytes - i, weight);
+}
+#endif // CPU_X86
@@ -0,0 +1,288 @@
+#ifndef COLORCONVERT_P_H
+#define COLORCONVERT_P_H
+
+#include <stdint.h>
+
+#include "colorconvert.h"
+#include "cpufeatures.h"
+
+// Row kernels shared by the dispatcher in colorconvert.cpp and the SIMD
+// translation units. Not part of the public API.
+//
+// Kernels that depend on the colour matrix or range are templates, so every
+// instantiation has its coefficients as constants and no per-pixel branches.
+
+typedef void (*RowRGB32ToUYVYFn)(const uint8_t *src, uint8_t *dst, int width);
+typedef void (*RowRGB32ToRGBAFn)(const uint8_t *src, uint8_t *dst, int width);
+typedef void (*RowYUYVToUYVYFn)(const uint8_t *src, uint8_t *dst, int width);
+typedef void (*RowNV12ToUYVYFn)(const uint8_t *srcY, const uint8_t *srcUV, uint8_t *dst, int width);
+
+constexpr int roundToInt(double v)
+{
+    return v < 0 ? int(v - 0.5) : int(v + 0.5);
+}
+
+template <ColorMatrix M> struct MatrixWeights;
+template <> struct MatrixWeights<MatrixBT601> { static constexpr double kr = 0.299, kb = 0.114; };
+template <> struct MatrixWeights<MatrixBT709> { static constexpr double kr = 0.2126, kb = 0.0722; };
+template <> struct MatrixWeights<MatrixBT2020> { static constexpr double kr = 0.2627, kb = 0.0593; };
+
+// 8-bit limited range with 8 fractional bits, small enough for the 16-bit
+// SIMD arithmetic. Green absorbs the rounding so the luma weights sum to 220
+// (219/255 at 8 bits) and the chroma weights to 0, which keeps greys exact.
+template <ColorMatrix M>
+struct Uyvy8Coefficients {
+    static constexpr double kr = MatrixWeights<M>::kr;
+    static constexpr double kb = MatrixWeights<M>::kb;
+    static constexpr double kg = 1.0 - kr - kb;
+    static constexpr double cScale = 224.0 * 256 / 255;
+
+    static constexpr int yr = roundToInt(kr * 219 * 256 / 255);
+    static constexpr int yb = roundToInt(kb * 219 * 256 / 255);
+    static constexpr int yg = 220 - yr - yb;
+    static constexpr int ur = roundToInt(-kr / (2 * (1 - kb)) * cScale);
+    static constexpr int ub = 112;
+    static constexpr int ug = -ur - ub;
+    static constexpr int vr = 112;
+    static constexpr int vb = roundToInt(-kb / (2 * (1 - kr)) * cScale);
+    static constexpr int vg = -vr - vb;
+};
+
+// Any range at 8 or 16 bits, in 32-bit arithmetic with 14 fractional bits;
+// 16-bit full-range luma only just fits.
+template <ColorMatrix M, ColorRange R, int Bits>
+struct YuvCoefficients {
+    static constexpr double kr = MatrixWeights<M>::kr;
+    static constexpr double kb = MatrixWeights<M>::kb;
+    static constexpr double kg = 1.0 - kr - kb;
+
+    static constexpr int Shift = 14;
+    static constexpr int Round = 1 << (Shift - 1);
+    static constexpr int Max = (1 << Bits) - 1;
+    static constexpr int YOffset = R == LimitedRange ? 16 << (Bits - 8) : 0;
+    static constexpr int COffset = 1 << (Bits - 1);
+    static constexpr double yScale = (R == LimitedRange ? 219 << (Bits - 8) : Max) * double(1 << Shift) / 255;
+    static constexpr double cScale = (R == LimitedRange ? 224 << (Bits - 8) : Max) * double(1 << Shift) / 255;
+
+    static constexpr int yr = roundToInt(kr * yScale);
+    static constexpr int yg = roundToInt(kg * yScale);
+    static constexpr int yb = roundToInt(kb * yScale);
+    static constexpr int ur = roundToInt(-kr / (2 * (1 - kb)) * cScale);
+    static constexpr int ug = roundToInt(-kg / (2 * (1 - kb)) * cScale);
+    static constexpr int ub = roundToInt(0.5 * cScale);
+    static constexpr int vr = roundToInt(0.5 * cScale);
+    static constexpr int vg = roundToInt(-kg / (2 * (1 - kr)) * cScale);
+    static constexpr int vb = roundToInt(-kb / (2 * (1 - kr)) * cScale);
+
+    // Full-range chroma can overshoot by half a step.
+    static inline int clamp(int v) { return v < 0 ? 0 : v > Max ? Max : v; }
+    static inline int y(int r, int g, int b) { return clamp(YOffset + ((yr * r + yg * g + yb * b + Round) >> Shift)); }
+    static inline int u(int r, int g, int b) { return clamp(COffset + ((ur * r + ug * g + ub * b + Round) >> Shift)); }
+    static inline int v(int r, int g, int b) { return clamp(COffset + ((vr * r + vg * g + vb * b + Round) >> Shift)); }
+};
+
+// 4:2:2 chroma is co-sited with the first pixel of each pair, 4:2:0 chroma
+// with the first pixel of each pair averaged over the two rows.
+template <ColorMatrix M>
+inline void convertRowRGB32ToUYVY_C(const uint8_t *src, uint8_t *dst, int width)
+{
+    typedef Uyvy8Coefficients<M> K;
+    const uint32_t *px = reinterpret_cast<const uint32_t *>(src);
+    for (int x = 0; x < width; x += 2) {
+        const uint32_t p1 = px[x];
+        const uint32_t p2 = x + 1 < width ? px[x + 1] : p1;
+
+        const int r1 = (p1 >> 16) & 0xff, g1 = (p1 >> 8) & 0xff, b1 = p1 & 0xff;
+        const int r2 = (p2 >> 16) & 0xff, g2 = (p2 >> 8) & 0xff, b2 = p2 & 0xff;
+
+        dst[0] = static_cast<uint8_t>(((K::ur * r1 + K::ug * g1 + K::ub * b1 + 128) >> 8) + 128);
+        dst[1] = static_cast<uint8_t>(((K::yr * r1 + K::yg * g1 + K::yb * b1 + 128) >> 8) +  16);
+        dst[2] = static_cast<uint8_t>(((K::vr * r1 + K::vg * g1 + K::vb * b1 + 128) >> 8) + 128);
+        dst[3] = static_cast<uint8_t>(((K::yr * r2 + K::yg * g2 + K::yb * b2 + 128) >> 8) +  16);
+        dst += 4;
+    }
+}
+
+template <ColorMatrix M>
+inline void convertRowRGB32ToUYVYFull_C(const uint8_t *src, uint8_t *dst, int width)
+{
+    typedef YuvCoefficients<M, FullRange, 8> K;
+    const uint32_t *px = reinterpret_cast<const uint32_t *>(src);
+    for (int x = 0; x < width; x += 2) {
+        const uint32_t p1 = px[x];
+        const uint32_t p2 = px[x + 1 < width ? x + 1 : x];
+
+        const int r1 = (p1 >> 16) & 0xff, g1 = (p1 >> 8) & 0xff, b1 = p1 & 0xff;
+        const int r2 = (p2 >> 16) & 0xff, g2 = (p2 >> 8) & 0xff, b2 = p2 & 0xff;
+
+        dst[0] = static_cast<uint8_t>(K::u(r1, g1, b1));
+        dst[1] = static_cast<uint8_t>(K::y(r1, g1, b1));
+        dst[2] = static_cast<uint8_t>(K::v(r1, g1, b1));
+        dst[3] = static_cast<uint8_t>(K::y(r2, g2, b2));
+        dst += 4;
+    }
+}
+
+// The UYVA alpha plane; opaque unless the source carries alpha.
+template <bool SourceAlpha>
+inline void convertRowRGB32ToAlpha_C(const uint8_t *src, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; ++x)
+        dst[x] = SourceAlpha ? src[x * 4 + 3] : 0xff;
+}
+
+template <ColorMatrix M, ColorRange R>
+inline void convertRowRGB32ToP216_C(const uint8_t *src, uint16_t *dstY, uint16_t *dstUV, int width)
+{
+    typedef YuvCoefficients<M, R, 16> K;
+    const uint32_t *px = reinterpret_cast<const uint32_t *>(src);
+    for (int x = 0; x < width; ++x) {
+        const uint32_t p = px[x];
+        dstY[x] = static_cast<uint16_t>(K::y((p >> 16) & 0xff, (p >> 8) & 0xff, p & 0xff));
+    }
+    for (int x = 0; x < width; x += 2) {
+        const uint32_t p = px[x];
+        const int r = (p >> 16) & 0xff, g = (p >> 8) & 0xff, b = p & 0xff;
+        dstUV[x] = static_cast<uint16_t>(K::u(r, g, b));
+        dstUV[x + 1] = static_cast<uint16_t>(K::v(r, g, b));
+    }
+}
+
+// Two source rows into two luma rows and one row of chroma. U and V samples
+// are ChromaStep apart: 2 for interleaved NV12, 1 for separate I420 planes.
+template <ColorMatrix M, ColorRange R, int ChromaStep>
+inline void convertRowsRGB32To420_C(const uint8_t *src0, const uint8_t *src1,
+                                    uint8_t *dstY0, uint8_t *dstY1,
+                                    uint8_t *dstU, uint8_t *dstV, int width)
+{
+    typedef YuvCoefficients<M, R, 8> K;
+    const uint32_t *px0 = reinterpret_cast<const uint32_t *>(src0);
+    const uint32_t *px1 = reinterpret_cast<const uint32_t *>(src1);
+    for (int x = 0; x < width; ++x) {
+        const uint32_t p0 = px0[x];
+        const uint32_t p1 = px1[x];
+        dstY0[x] = static_cast<uint8_t>(K::y((p0 >> 16) & 0xff, (p0 >> 8) & 0xff, p0 & 0xff));
+        dstY1[x] = static_cast<uint8_t>(K::y((p1 >> 16) & 0xff, (p1 >> 8) & 0xff, p1 & 0xff));
+    }
+    for (int x = 0; x < width; x += 2) {
+        const uint32_t p0 = px0[x];
+        const uint32_t p1 = px1[x];
+        const int r = (((p0 >> 16) & 0xff) + ((p1 >> 16) & 0xff) + 1) >> 1;
+        const int g = (((p0 >> 8) & 0xff) + ((p1 >> 8) & 0xff) + 1) >> 1;
+        const int b = ((p0 & 0xff) + (p1 & 0xff) + 1) >> 1;
+        dstU[(x / 2) * ChromaStep] = static_cast<uint8_t>(K::u(r, g, b));
+        dstV[(x / 2) * ChromaStep] = static_cast<uint8_t>(K::v(r, g, b));
+    }
+}
+
+inline void convertRowRGB32ToRGBA_C(const uint8_t *src, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = 0xff;
+        src += 4;
+        dst += 4;
+    }
+}
+
+inline void convertRowARGB32ToRGBA_C(const uint8_t *src, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = src[3];
+        src += 4;
+        dst += 4;
+    }
+}
+
+inline void convertRowYUYVToUYVY_C(const uint8_t *src, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; x += 2) {
+        dst[0] = src[1];
+        dst[1] = src[0];
+        dst[2] = src[3];
+        dst[3] = src[2];
+        src += 4;
+        dst += 4;
+    }
+}
+
+inline void convertRowNV12ToUYVY_C(const uint8_t *srcY, const uint8_t *srcUV, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; x += 2) {
+        dst[0] = srcUV[x];
+        dst[1] = srcY[x];
+        dst[2] = srcUV[x + 1];
+        dst[3] = x + 1 < width ? srcY[x + 1] : srcY[x];
+        dst += 4;
+    }
+}
+
+// Vertical passes of FrameScaler over whole source rows of bytes. Box sums
+// rows into 16-bit accumulators, bilinear blends two rows with an 8-bit weight.
+typedef void (*ScaleWidenRowFn)(const uint8_t *src, uint16_t *acc, int bytes);
+typedef void (*ScaleAccumulateRowFn)(const uint8_t *src, uint16_t *acc, int bytes);
+typedef void (*ScaleBlendRowsFn)(const uint8_t *a, const uint8_t *b, uint8_t *dst, int bytes, int weight);
+
+inline void scaleWidenRow_C(const uint8_t *src, uint16_t *acc, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        acc[i] = src[i];
+}
+
+inline void scaleAccumulateRow_C(const uint8_t *src, uint16_t *acc, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        acc[i] = static_cast<uint16_t>(acc[i] + src[i]);
+}
+
+inline void scaleBlendRows_C(const uint8_t *a, const uint8_t *b, uint8_t *dst, int bytes, int weight)
+{
+    for (int i = 0; i < bytes; ++i)
+        dst[i] = static_cast<uint8_t>((a[i] * (256 - weight) + b[i] * weight + 128) >> 8);
+}
+
+// Horizontal box pass for a whole-number reduction: sums factor neighbouring
+// accumulated pixels and divides by the n pixels they hold, n <= 256, as
+// (sum + n / 2) * reciprocal >> 16 with reciprocal = 65536 / n rounded.
+typedef void (*ScaleBoxColumnsFn)(const uint16_t *acc, uint32_t *out, int width, int factor, int n, int reciprocal);
+
+inline void scaleBoxColumns_C(const uint16_t *acc, uint32_t *out, int width, int factor, int n, int reciprocal)
+{
+    for (int x = 0; x < width; ++x) {
+        uint32_t pixel = 0;
+        for (int c = 0; c < 4; ++c) {
+            uint32_t sum = n / 2;
+            for (int i = 0; i < factor; ++i)
+                sum += acc[i * 4 + c];
+            pixel |= ((sum * reciprocal) >> 16) << (c * 8);
+        }
+        out[x] = pixel;
+        acc += factor * 4;
+    }
+}
+
+void scaleBoxColumns_SSE2(const uint16_t *acc, uint32_t *out, int width, int factor, int n, int reciprocal);
+void scaleWidenRow_SSE2(const uint8_t *src, uint16_t *acc, int bytes);
+void scaleWidenRow_AVX2(const uint8_t *src, uint16_t *acc, int bytes);
+void scaleAccumulateRow_SSE2(const uint8_t *src, uint16_t *acc, int bytes);
+void scaleAccumulateRow_AVX2(const uint8_t *src, uint16_t *acc, int bytes);
+void scaleBlendRows_SSE2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int bytes, int weight);
+void scaleBlendRows_AVX2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int bytes, int weight);
+
+// Instantiated for every matrix except MatrixAuto. Unlike plain functions,
+// templates only pick up the target attribute from their first declaration.
+template <ColorMatrix M> CPU_TARGET_SSE2 void convertRowRGB32ToUYVY_SSE2(const uint8_t *src, uint8_t *dst, int width);
+template <ColorMatrix M> CPU_TARGET_AVX2 void convertRowRGB32ToUYVY_AVX2(const uint8_t *src, uint8_t *dst, int width);
+void convertRowRGB32ToRGBA_SSE2(const uint8_t *src, uint8_t *dst, int width);
+void convertRowRGB32ToRGBA_AVX2(const uint8_t *src, uint8_t *dst, int width);
+void convertRowYUYVToUYVY_SSE2(const uint8_t *src, uint8_t *dst, int width);
+void convertRowYUYVToUYVY_AVX2(const uint8_t *src, uint8_t *dst, int width);
+void convertRowNV12ToUYVY_SSE2(const uint8_t *srcY, const uint8_t *srcUV, uint8_t *dst, int width);
+void convertRowNV12ToUYVY_AVX2(const uint8_t *srcY, const uint8_t *srcUV, uint8_t *dst, int width);
+
+#endif // COLORCONVERT_P_H
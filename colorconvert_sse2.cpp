@@ -0,0 +1,192 @@
+#include "colorconvert_p.h"
+#include "cpufeatures.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+
+// 8 pixels per iteration. Channels are widened to 16 bits; the luma sum can
+// exceed 32767 so it is accumulated with wrapping adds and shifted logically,
+// chroma stays within the signed range and uses an arithmetic shift so both
+// round exactly like the scalar reference.
+template <ColorMatrix M>
+CPU_TARGET_SSE2 void convertRowRGB32ToUYVY_SSE2(const uint8_t *src, uint8_t *dst, int width)
+{
+    typedef Uyvy8Coefficients<M> K;
+    const __m128i byteMask = _mm_set1_epi32(0xff);
+    const __m128i evenMask = _mm_set1_epi32(0xffff);
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i yOffset = _mm_set1_epi16(16);
+    const __m128i cOffset = _mm_set1_epi16(128);
+    const __m128i yR = _mm_set1_epi16(K::yr), yG = _mm_set1_epi16(K::yg), yB = _mm_set1_epi16(K::yb);
+    const __m128i uR = _mm_set1_epi16(K::ur), uG = _mm_set1_epi16(K::ug), uB = _mm_set1_epi16(K::ub);
+    const __m128i vR = _mm_set1_epi16(K::vr), vG = _mm_set1_epi16(K::vg), vB = _mm_set1_epi16(K::vb);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+        const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4 + 16));
+
+        const __m128i b = _mm_packs_epi32(_mm_and_si128(p0, byteMask),
+                                          _mm_and_si128(p1, byteMask));
+        const __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), byteMask),
+                                          _mm_and_si128(_mm_srli_epi32(p1, 8), byteMask));
+        const __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), byteMask),
+                                          _mm_and_si128(_mm_srli_epi32(p1, 16), byteMask));
+
+        __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, yR), _mm_mullo_epi16(g, yG));
+        y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, yB), round));
+        y = _mm_add_epi16(_mm_srli_epi16(y, 8), yOffset);
+
+        __m128i u = _mm_add_epi16(_mm_mullo_epi16(r, uR), _mm_mullo_epi16(g, uG));
+        u = _mm_add_epi16(u, _mm_add_epi16(_mm_mullo_epi16(b, uB), round));
+        u = _mm_add_epi16(_mm_srai_epi16(u, 8), cOffset);
+
+        __m128i v = _mm_add_epi16(_mm_mullo_epi16(r, vR), _mm_mullo_epi16(g, vG));
+        v = _mm_add_epi16(v, _mm_add_epi16(_mm_mullo_epi16(b, vB), round));
+        v = _mm_add_epi16(_mm_srai_epi16(v, 8), cOffset);
+
+        // Even words take U of their own pixel, odd words V of the pixel before.
+        const __m128i c = _mm_or_si128(_mm_and_si128(u, evenMask),
+                                       _mm_andnot_si128(evenMask, _mm_slli_si128(v, 2)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 2),
+                         _mm_or_si128(c, _mm_slli_epi16(y, 8)));
+    }
+
+    if (x < width)
+        convertRowRGB32ToUYVY_C<M>(src + x * 4, dst + x * 2, width - x);
+}
+
+template void convertRowRGB32ToUYVY_SSE2<MatrixBT601>(const uint8_t *, uint8_t *, int);
+template void convertRowRGB32ToUYVY_SSE2<MatrixBT709>(const uint8_t *, uint8_t *, int);
+template void convertRowRGB32ToUYVY_SSE2<MatrixBT2020>(const uint8_t *, uint8_t *, int);
+
+// Swaps bytes 0 and 2 of every pixel with shifts and masks; SSE2 has no byte
+// shuffle. Alpha is set rather than copied.
+CPU_TARGET_SSE2 void convertRowRGB32ToRGBA_SSE2(const uint8_t *src, uint8_t *dst, int width)
+{
+    const __m128i green = _mm_set1_epi32(0x0000ff00);
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    const __m128i low = _mm_set1_epi32(0x000000ff);
+    const __m128i high = _mm_set1_epi32(0x00ff0000);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+        const __m128i out = _mm_or_si128(_mm_or_si128(_mm_and_si128(p, green), alpha),
+                                         _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), low),
+                                                      _mm_and_si128(_mm_slli_epi32(p, 16), high)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), out);
+    }
+
+    if (x < width)
+        convertRowRGB32ToRGBA_C(src + x * 4, dst + x * 4, width - x);
+}
+
+// YUYV and UYVY differ only in the byte order of every 16-bit word.
+CPU_TARGET_SSE2 void convertRowYUYVToUYVY_SSE2(const uint8_t *src, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 2),
+                         _mm_or_si128(_mm_slli_epi16(p, 8), _mm_srli_epi16(p, 8)));
+    }
+
+    if (x < width)
+        convertRowYUYVToUYVY_C(src + x * 2, dst + x * 2, width - x);
+}
+
+// 16 pixels per iteration: 16 luma bytes and 8 UV pairs interleave straight
+// into U Y V Y order.
+CPU_TARGET_SSE2 void convertRowNV12ToUYVY_SSE2(const uint8_t *srcY, const uint8_t *srcUV, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcY + x));
+        const __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcUV + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 2), _mm_unpacklo_epi8(uv, y));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 2 + 16), _mm_unpackhi_epi8(uv, y));
+    }
+
+    if (x < width)
+        convertRowNV12ToUYVY_C(srcY + x, srcUV + x, dst + x * 2, width - x);
+}
+
+CPU_TARGET_SSE2 void scaleWidenRow_SSE2(const uint8_t *src, uint16_t *acc, int bytes)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i), _mm_unpacklo_epi8(p, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i + 8), _mm_unpackhi_epi8(p, zero));
+    }
+
+    if (i < bytes)
+        scaleWidenRow_C(src + i, acc + i, bytes - i);
+}
+
+CPU_TARGET_SSE2 void scaleAccumulateRow_SSE2(const uint8_t *src, uint16_t *acc, int bytes)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i *lo = reinterpret_cast<__m128i *>(acc + i);
+        __m128i *hi = reinterpret_cast<__m128i *>(acc + i + 8);
+        _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(p, zero)));
+        _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(p, zero)));
+    }
+
+    if (i < bytes)
+        scaleAccumulateRow_C(src + i, acc + i, bytes - i);
+}
+
+// Two output pixels per iteration, one in each 64-bit half.
+CPU_TARGET_SSE2 void scaleBoxColumns_SSE2(const uint16_t *acc, uint32_t *out, int width, int factor, int n, int reciprocal)
+{
+    const __m128i half = _mm_set1_epi16(static_cast<short>(n / 2));
+    const __m128i scale = _mm_set1_epi16(static_cast<short>(reciprocal));
+    const int step = factor * 4;
+    int x = 0;
+    for (; x + 2 <= width; x += 2) {
+        const uint16_t *a = acc + x * step;
+        __m128i sum = half;
+        for (int i = 0; i < factor; ++i) {
+            const __m128i p0 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i * 4));
+            const __m128i p1 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + step + i * 4));
+            sum = _mm_add_epi16(sum, _mm_unpacklo_epi64(p0, p1));
+        }
+        const __m128i avg = _mm_mulhi_epu16(sum, scale);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(avg, avg));
+    }
+
+    if (x < width)
+        scaleBoxColumns_C(acc + x * step, out + x, width - x, factor, n, reciprocal);
+}
+
+// The weights sum to 256, so a * (256 - w) + b * w + 128 stays below 65536
+// and the logical shift matches the scalar reference.
+CPU_TARGET_SSE2 void scaleBlendRows_SSE2(const uint8_t *a, const uint8_t *b, uint8_t *dst, int bytes, int weight)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wa = _mm_set1_epi16(static_cast<short>(256 - weight));
+    const __m128i wb = _mm_set1_epi16(static_cast<short>(weight));
+    const __m128i round = _mm_set1_epi16(128);
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i pa = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const __m128i pb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pa, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(pb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pa, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(pb, zero), wb));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+    if (i < bytes)
+        scaleBlendRows_C(a + i, b + i, dst + i, bytes - i, weight);
+}
+#endif // CPU_X86
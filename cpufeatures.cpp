@@ -0,0 +1,73 @@
+#include "cpufeatures.h"
+
+#ifdef CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef CPU_X86
+static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, subleaf);
+    for (int i = 0; i < 4; ++i)
+        regs[i] = r[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+bool cpuHasSSE2()
+{
+#ifdef CPU_X86
+    static const bool has = [] {
+        unsigned int regs[4];
+        cpuid(1, 0, regs);
+        return (regs[3] & (1u << 26)) != 0;
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
+
+bool cpuHasAVX2()
+{
+#ifdef CPU_X86
+    static const bool has = [] {
+        unsigned int regs[4];
+        cpuid(0, 0, regs);
+        if (regs[0] < 7)
+            return false;
+
+        // AVX needs OS support for saving the YMM registers (OSXSAVE + XCR0).
+        cpuid(1, 0, regs);
+        const bool osxsave = (regs[2] & (1u << 27)) != 0;
+        const bool avx = (regs[2] & (1u << 28)) != 0;
+        if (!osxsave || !avx || (xgetbv0() & 0x6) != 0x6)
+            return false;
+
+        cpuid(7, 0, regs);
+        return (regs[1] & (1u << 5)) != 0;
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,22 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86 1
+#endif
+
+// GCC and Clang only allow SSE/AVX intrinsics inside functions compiled for
+// that instruction set, so the SIMD kernels are tagged per function instead of
+// building the whole project with -mavx2. MSVC accepts the intrinsics as is.
+#if defined(CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_TARGET_SSE2 __attribute__((target("sse2")))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_TARGET_SSE2
+#define CPU_TARGET_AVX2
+#endif
+
+bool cpuHasSSE2();
+bool cpuHasAVX2();
+
+#endif // CPUFEATURES_H
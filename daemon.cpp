@@ -0,0 +1,102 @@
+#include "daemon.h"
+
+#include <QAudioDeviceInfo>
+#include <QCameraInfo>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QTextStream>
+#include <QTimer>
+#include <csignal>
+
+#include "capturesource.h"
+#include "ndistream.h"
+#include "statsreporter.h"
+#include "streamengine.h"
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+bool daemonNeedsGui(const QString &configPath)
+{
+    QList<StreamConfig> configs;
+    if (!loadStreamConfigs(configPath, configs, nullptr))
+        return false;
+    for (const StreamConfig &config : configs) {
+        if (config.video == StreamConfig::ScreenVideo || config.video == StreamConfig::WindowVideo
+                || config.video == StreamConfig::CameraVideo)
+            return true;
+    }
+    return false;
+}
+
+int runDaemon(const QString &configPath, const QString &statsPath, int workers, bool pinCores)
+{
+    QList<StreamConfig> configs;
+    QString error;
+    if (!loadStreamConfigs(configPath, configs, &error)) {
+        qCritical() << configPath << ":" << error;
+        return 1;
+    }
+
+    StreamEngine engine;
+    engine.setStageWorkers(workers, pinCores);
+    for (const StreamConfig &config : configs)
+        engine.addStream(config);
+    if (!statsPath.isEmpty())
+        engine.statsReporter()->setLogFile(statsPath);
+
+    QTextStream out(stdout);
+    QObject::connect(engine.statsReporter(), &StatsReporter::updated, [&out](const QString &summary) {
+        out << summary << "\n\n";
+        out.flush();
+    });
+
+    if (engine.start() == 0) {
+        qCritical() << "No stream could be started";
+        return 1;
+    }
+
+    // Signal handlers may only set a flag; the event loop polls it.
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, [] {
+        if (stopRequested)
+            QCoreApplication::quit();
+    });
+    poll.start(100);
+
+    const int ret = QCoreApplication::exec();
+    engine.stop();
+    return ret;
+}
+
+void listSources()
+{
+    QTextStream out(stdout);
+
+    out << "Screens (\"video\": \"screen\", \"device\": index or name):\n";
+    const QList<QScreen*> screens = QGuiApplication::screens();
+    for (int i = 0; i < screens.size(); ++i) {
+        const QRect geometry = screens[i]->geometry();
+        out << "  " << i << "  " << screens[i]->name() << "  " << geometry.width() << "x" << geometry.height() << "\n";
+    }
+
+    out << "Windows (\"video\": \"window\", \"device\": id or title):\n";
+    for (const CaptureWindow &window : CaptureSource::windows())
+        out << "  0x" << QString::number(window.id, 16) << "  " << window.title << "\n";
+
+    out << "Cameras (\"video\": \"camera\", \"device\": name or description):\n";
+    for (const QCameraInfo &camera : QCameraInfo::availableCameras())
+        out << "  " << camera.deviceName() << "  " << camera.description() << "\n";
+
+    out << "Audio inputs (\"audio\": name, \"default\" or a list to mix):\n";
+    for (const QAudioDeviceInfo &device : QAudioDeviceInfo::availableDevices(QAudio::AudioInput))
+        out << "  " << device.deviceName() << "\n";
+}
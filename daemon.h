@@ -0,0 +1,19 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <QString>
+
+// Whether the streams in a config file capture screens, windows or cameras,
+// which need a QGuiApplication. Test patterns, replays and audio run on a
+// QCoreApplication, without a display.
+bool daemonNeedsGui(const QString &configPath);
+
+// Windowless mode: streams everything the config file describes until SIGINT
+// or SIGTERM, on workers stage threads (0 for one per core), each pinned to
+// a core if pinCores is set. Returns the process exit code.
+int runDaemon(const QString &configPath, const QString &statsPath, int workers = 0, bool pinCores = false);
+
+// Prints the screen, camera and audio input names a config file can refer to.
+void listSources();
+
+#endif // DAEMON_H
@@ -0,0 +1,231 @@
+#include "damagetracker.h"
+#include "cpufeatures.h"
+#include "stripepool.h"
+
+#include <string.h>
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+// Tiles of a tile row are hashed together, walking the rows top to bottom,
+// so the frame is read sequentially rather than 64 rows apart per tile.
+//
+// The hash follows XXH3's accumulate/scramble steps: every 16 bytes are mixed
+// into two 64-bit lanes with a position-dependent key and a 32x32->64 multiply,
+// and the lanes are scrambled after each row so rows can't cancel out.
+static const int KeyWords = 32;
+static const uint64_t Key[KeyWords] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+    0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+    0xcb00c391bb52283cull, 0xa32e531b8b65d088ull, 0x4ef90da297486471ull, 0xd8acdea946ef1938ull,
+    0x3f349ce33f76faa8ull, 0x1d4f0bc7c7bbdcf9ull, 0x3159b4cd4be0518aull, 0x647378d9c97e9fc8ull,
+    0xc3ebd33483acc5eaull, 0xeb6313faffa081c5ull, 0x49daf0b751dd0d17ull, 0x9e68d429265516d3ull,
+    0xfca1477d58be162bull, 0xce31d07ad1b8f88full, 0x280416958f3acb45ull, 0x7e404bbbcafbd7afull,
+    0x9e3779b185ebca87ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0x85ebca77c2b2ae63ull,
+    0x27d4eb2f165667c5ull, 0xff51afd7ed558ccdull, 0xc4ceb9fe1a85ec53ull, 0x94d049bb133111ebull
+};
+static const uint64_t Prime32 = 0x9e3779b1ull;
+
+static inline uint64_t load64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t mixTile(uint64_t a, uint64_t b, int width, int height)
+{
+    uint64_t h = a ^ (b * 0xff51afd7ed558ccdull) ^ (uint64_t(width) << 32 | uint32_t(height));
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline void accumulate_C(uint64_t acc[2], const uint8_t *p, int keyIndex)
+{
+    const uint64_t d0 = load64(p), d1 = load64(p + 8);
+    const uint64_t k0 = d0 ^ Key[keyIndex % KeyWords];
+    const uint64_t k1 = d1 ^ Key[(keyIndex + 1) % KeyWords];
+    acc[0] += d1 + (k0 & 0xffffffffull) * (k0 >> 32);
+    acc[1] += d0 + (k1 & 0xffffffffull) * (k1 >> 32);
+}
+
+static inline void scramble_C(uint64_t acc[2])
+{
+    for (int i = 0; i < 2; ++i) {
+        const uint64_t a = (acc[i] ^ (acc[i] >> 47)) ^ Key[KeyWords - 2 + i];
+        acc[i] = (a & 0xffffffffull) * Prime32 + (((a >> 32) * Prime32) << 32);
+    }
+}
+
+static inline void hashRow_C(uint64_t acc[2], const uint8_t *row, int bytes)
+{
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16)
+        accumulate_C(acc, row + i, i / 8);
+    if (i < bytes) {
+        uint8_t tail[16] = {};
+        memcpy(tail, row + i, bytes - i);
+        accumulate_C(acc, tail, i / 8);
+    }
+    scramble_C(acc);
+}
+
+void hashTileRow_Reference(const uint8_t *src, int stride, int width, int height, uint64_t *hashes)
+{
+    const int tilesX = (width + DamageTracker::TileSize - 1) / DamageTracker::TileSize;
+    uint64_t acc[DamageTracker::MaxTilesX][2];
+    for (int tx = 0; tx < tilesX; ++tx) {
+        acc[tx][0] = Key[0];
+        acc[tx][1] = Key[1];
+    }
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *row = src + y * stride;
+        for (int tx = 0; tx < tilesX; ++tx) {
+            const int x = tx * DamageTracker::TileSize;
+            hashRow_C(acc[tx], row + x * 4, qMin(DamageTracker::TileSize, width - x) * 4);
+        }
+    }
+
+    for (int tx = 0; tx < tilesX; ++tx) {
+        const int x = tx * DamageTracker::TileSize;
+        hashes[tx] = mixTile(acc[tx][0], acc[tx][1], qMin(DamageTracker::TileSize, width - x), height);
+    }
+}
+
+#ifdef CPU_X86
+// Key words are consumed in pairs starting at an even index, so each 16-byte
+// chunk's key is two adjacent entries of Key.
+CPU_TARGET_SSE2 static inline __m128i accumulate_SSE2(__m128i acc, __m128i data, int offset)
+{
+    const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Key + (offset / 8) % KeyWords));
+    const __m128i dataKey = _mm_xor_si128(data, key);
+    const __m128i product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, 0x31));
+    return _mm_add_epi64(acc, _mm_add_epi64(_mm_shuffle_epi32(data, 0x4e), product));
+}
+
+CPU_TARGET_SSE2 static inline __m128i hashRow_SSE2(__m128i acc, const uint8_t *row, int bytes)
+{
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16)
+        acc = accumulate_SSE2(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i)), i);
+    if (i < bytes) {
+        uint8_t tail[16] = {};
+        memcpy(tail, row + i, bytes - i);
+        acc = accumulate_SSE2(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(tail)), i);
+    }
+
+    const __m128i a = _mm_xor_si128(_mm_xor_si128(acc, _mm_srli_epi64(acc, 47)),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(Key + KeyWords - 2)));
+    const __m128i prime = _mm_set1_epi32(int(Prime32));
+    const __m128i lo = _mm_mul_epu32(a, prime);
+    const __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, 0x31), prime);
+    return _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+}
+
+CPU_TARGET_SSE2 static void hashTileRow_SSE2(const uint8_t *src, int stride, int width, int height, uint64_t *hashes)
+{
+    const int tilesX = (width + DamageTracker::TileSize - 1) / DamageTracker::TileSize;
+    __m128i acc[DamageTracker::MaxTilesX];
+    for (int tx = 0; tx < tilesX; ++tx)
+        acc[tx] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Key));
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *row = src + y * stride;
+        for (int tx = 0; tx < tilesX; ++tx) {
+            const int x = tx * DamageTracker::TileSize;
+            acc[tx] = hashRow_SSE2(acc[tx], row + x * 4, qMin(DamageTracker::TileSize, width - x) * 4);
+        }
+    }
+
+    for (int tx = 0; tx < tilesX; ++tx) {
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc[tx]);
+        const int x = tx * DamageTracker::TileSize;
+        hashes[tx] = mixTile(lanes[0], lanes[1], qMin(DamageTracker::TileSize, width - x), height);
+    }
+}
+#endif
+
+void hashTileRow(const uint8_t *src, int stride, int width, int height, uint64_t *hashes)
+{
+#ifdef CPU_X86
+    static const bool sse2 = cpuHasSSE2();
+    if (sse2) {
+        hashTileRow_SSE2(src, stride, width, height, hashes);
+        return;
+    }
+#endif
+    hashTileRow_Reference(src, stride, width, height, hashes);
+}
+
+DamageTracker::DamageTracker()
+{
+    reset();
+}
+
+void DamageTracker::reset()
+{
+    m_width = 0;
+    m_height = 0;
+    m_tilesX = 0;
+    m_tilesY = 0;
+    m_generation = 0;
+    m_tileHash.clear();
+    m_tileGeneration.clear();
+    m_tileDirty.clear();
+    m_lastDirty = 0;
+    m_dirtyTotal = 0;
+    m_tilesTotal = 0;
+}
+
+int DamageTracker::update(const uint8_t *src, int stride, int width, int height, StripePool *pool)
+{
+    width = qMin(width, MaxTilesX * TileSize);
+    bool resized = false;
+    if (width != m_width || height != m_height) {
+        m_width = width;
+        m_height = height;
+        m_tilesX = (width + TileSize - 1) / TileSize;
+        m_tilesY = (height + TileSize - 1) / TileSize;
+        m_tileHash.fill(0, tileCount());
+        m_tileGeneration.fill(0, tileCount());
+        m_tileDirty.fill(0, tileCount());
+        resized = true;
+    }
+
+    const uint64_t next = m_generation + 1;
+    auto hashRows = [&](int ty0, int ty1) {
+        uint64_t hashes[MaxTilesX];
+        for (int ty = ty0; ty < ty1; ++ty) {
+            const int y = ty * TileSize;
+            hashTileRow(src + y * stride, stride, width, qMin(TileSize, height - y), hashes);
+            for (int tx = 0; tx < m_tilesX; ++tx) {
+                const int index = ty * m_tilesX + tx;
+                m_tileDirty[index] = resized || hashes[tx] != m_tileHash[index];
+                if (m_tileDirty[index]) {
+                    m_tileHash[index] = hashes[tx];
+                    m_tileGeneration[index] = next;
+                }
+            }
+        }
+    };
+    if (pool)
+        pool->run(m_tilesY, hashRows, 1);
+    else
+        hashRows(0, m_tilesY);
+
+    int dirty = 0;
+    for (uint8_t d : m_tileDirty)
+        dirty += d;
+    if (dirty > 0)
+        m_generation = next;
+
+    m_lastDirty = dirty;
+    m_dirtyTotal += dirty;
+    m_tilesTotal += tileCount();
+    return dirty;
+}
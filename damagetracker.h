@@ -0,0 +1,69 @@
+#ifndef DAMAGETRACKER_H
+#define DAMAGETRACKER_H
+
+#include <QVector>
+#include <stdint.h>
+
+class StripePool;
+
+// What a screen stream does with a frame in which no tile changed.
+enum UnchangedFramePolicy {
+    SkipUnchanged,      // send nothing, receivers keep showing the last frame
+    ResendUnchanged     // send an up-to-date pooled buffer without converting
+};
+
+// Splits 32-bit frames into square tiles and fingerprints each one, so only
+// tiles that changed need converting. Every update() that finds a change bumps
+// generation() and stamps the changed tiles with it; a destination buffer that
+// remembers the generation it was last filled at only needs the tiles stamped
+// after that.
+class DamageTracker
+{
+public:
+    static const int TileSize = 64;
+    // Wide enough for 16K; pixels past it are not tracked.
+    static const int MaxTilesX = 256;
+
+    DamageTracker();
+
+    void reset();
+
+    // Hashes every tile of the frame and returns how many changed since the
+    // previous call. A size change marks everything dirty.
+    int update(const uint8_t *src, int stride, int width, int height, StripePool *pool);
+
+    uint64_t generation() const { return m_generation; }
+    int tilesX() const { return m_tilesX; }
+    int tilesY() const { return m_tilesY; }
+    int tileCount() const { return m_tilesX * m_tilesY; }
+    bool tileChangedSince(int tx, int ty, uint64_t generation) const
+    {
+        return m_tileGeneration[ty * m_tilesX + tx] > generation;
+    }
+
+    int lastDirtyTiles() const { return m_lastDirty; }
+    uint64_t dirtyTilesTotal() const { return m_dirtyTotal; }
+    uint64_t tilesTotal() const { return m_tilesTotal; }
+    double dirtyFraction() const { return m_tilesTotal ? double(m_dirtyTotal) / m_tilesTotal : 0.0; }
+
+private:
+    int m_width;
+    int m_height;
+    int m_tilesX;
+    int m_tilesY;
+    uint64_t m_generation;
+    QVector<uint64_t> m_tileHash;
+    QVector<uint64_t> m_tileGeneration;
+    QVector<uint8_t> m_tileDirty;
+
+    int m_lastDirty;
+    uint64_t m_dirtyTotal;
+    uint64_t m_tilesTotal;
+};
+
+// 64-bit fingerprints of the TileSize-wide tiles of one tile row of 32-bit
+// pixels, written to hashes[0 .. tilesX). height is at most TileSize.
+void hashTileRow(const uint8_t *src, int stride, int width, int height, uint64_t *hashes);
+void hashTileRow_Reference(const uint8_t *src, int stride, int width, int height, uint64_t *hashes);
+
+#endif // DAMAGETRACKER_H
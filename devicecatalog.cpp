@@ -0,0 +1,338 @@
+#include "devicecatalog.h"
+
+#include <QAudioDeviceInfo>
+#include <QCameraInfo>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+#endif
+
+// Plugging one device makes several nodes appear one after another.
+static const int SettleMs = 500;
+
+Q_GLOBAL_STATIC(QMutex, enumerationMutex)
+
+#ifdef Q_OS_LINUX
+// The card name a capture node reports, which is how Qt Multimedia
+// describes it, or an empty string for a node that does not capture.
+static QString v4l2CardName(const QString &node)
+{
+    const int fd = ::open(node.toLocal8Bit().constData(), O_RDWR | O_NONBLOCK);
+    if (fd < 0)
+        return QString();
+    v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    QString name;
+    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) == 0) {
+        const quint32 caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+        if (caps & V4L2_CAP_VIDEO_CAPTURE)
+            name = QString::fromUtf8(reinterpret_cast<const char *>(cap.card));
+    }
+    ::close(fd);
+    return name;
+}
+#endif
+
+namespace {
+
+// Runs one enumeration into the catalog's found lists, which nothing else
+// touches until finished().
+class EnumerationThread : public QThread
+{
+public:
+    EnumerationThread(int kinds, QList<DeviceEntry> *cameras, QList<DeviceEntry> *audioInputs, QObject *parent)
+        : QThread(parent), m_kinds(kinds), m_cameras(cameras), m_audioInputs(audioInputs), m_probeNodes(false) {}
+
+    // Instead of enumerating cameras, keeps the entries of the nodes in known
+    // and queries only the others.
+    void setCameraNodes(const QStringList &nodes, const QStringList &known)
+    {
+        m_probeNodes = true;
+        m_nodes = nodes;
+        m_knownNodes = known;
+    }
+
+protected:
+    void run() override
+    {
+        if (m_probeNodes) {
+            probeCameraNodes();
+            return;
+        }
+
+        QMutexLocker lock(DeviceCatalog::enumerationLock());
+        if (m_kinds & DeviceCatalog::Cameras) {
+            m_cameras->clear();
+            for (const QCameraInfo &camera : QCameraInfo::availableCameras()) {
+                DeviceEntry entry;
+                entry.name = camera.deviceName();
+                entry.description = camera.description();
+                m_cameras->push_back(entry);
+            }
+        }
+        if (m_kinds & DeviceCatalog::AudioInputs) {
+            m_audioInputs->clear();
+            for (const QAudioDeviceInfo &device : QAudioDeviceInfo::availableDevices(QAudio::AudioInput)) {
+                DeviceEntry entry;
+                entry.name = device.deviceName();
+                entry.description = device.deviceName();
+                m_audioInputs->push_back(entry);
+            }
+        }
+    }
+
+private:
+    void probeCameraNodes()
+    {
+#ifdef Q_OS_LINUX
+        QList<DeviceEntry> cameras;
+        for (const QString &node : m_nodes) {
+            DeviceEntry entry;
+            entry.name = "/dev/" + node;
+            if (m_knownNodes.contains(node)) {
+                for (const DeviceEntry &known : *m_cameras) {
+                    if (known.name == entry.name) {
+                        cameras.push_back(known);
+                        break;
+                    }
+                }
+                continue;
+            }
+            entry.description = v4l2CardName(entry.name);
+            if (!entry.description.isEmpty())
+                cameras.push_back(entry);
+        }
+        *m_cameras = cameras;
+#endif
+    }
+
+    int m_kinds;
+    QList<DeviceEntry> *m_cameras;
+    QList<DeviceEntry> *m_audioInputs;
+    bool m_probeNodes;
+    QStringList m_nodes;
+    QStringList m_knownNodes;
+};
+
+}
+
+static QJsonArray entriesJson(const QList<DeviceEntry> &entries)
+{
+    QJsonArray array;
+    for (const DeviceEntry &entry : entries) {
+        QJsonObject object;
+        object["name"] = entry.name;
+        object["description"] = entry.description;
+        array.append(object);
+    }
+    return array;
+}
+
+static QList<DeviceEntry> entriesFromJson(const QJsonArray &array)
+{
+    QList<DeviceEntry> entries;
+    for (const QJsonValue &value : array) {
+        DeviceEntry entry;
+        entry.name = value.toObject().value("name").toString();
+        entry.description = value.toObject().value("description").toString(entry.name);
+        if (!entry.name.isEmpty())
+            entries.push_back(entry);
+    }
+    return entries;
+}
+
+DeviceCatalog::DeviceCatalog(QObject *parent)
+    : QObject(parent)
+    , m_worker(nullptr)
+    , m_running(0)
+    , m_pending(0)
+    , m_lastEnumerationMs(-1)
+    , m_watcher(nullptr)
+    , m_dirty(0)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    m_snapshotPath = dir + "/devices.json";
+
+    m_settle.setSingleShot(true);
+    m_settle.setInterval(SettleMs);
+    connect(&m_settle, SIGNAL(timeout()), this, SLOT(on_settled()));
+}
+
+DeviceCatalog::~DeviceCatalog()
+{
+    // A device driver cannot be interrupted mid-query; this waits it out.
+    if (m_worker)
+        m_worker->wait();
+}
+
+QMutex *DeviceCatalog::enumerationLock()
+{
+    return enumerationMutex();
+}
+
+void DeviceCatalog::setSnapshotFile(const QString &path)
+{
+    m_snapshotPath = path;
+}
+
+bool DeviceCatalog::loadSnapshot()
+{
+    QFile file(m_snapshotPath);
+    if (m_snapshotPath.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root.isEmpty())
+        return false;
+    m_cameras = entriesFromJson(root.value("cameras").toArray());
+    m_audioInputs = entriesFromJson(root.value("audioInputs").toArray());
+    return true;
+}
+
+void DeviceCatalog::saveSnapshot() const
+{
+    if (m_snapshotPath.isEmpty())
+        return;
+    QDir().mkpath(QFileInfo(m_snapshotPath).absolutePath());
+    QFile file(m_snapshotPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot save the device list to" << m_snapshotPath;
+        return;
+    }
+    QJsonObject root;
+    root["cameras"] = entriesJson(m_cameras);
+    root["audioInputs"] = entriesJson(m_audioInputs);
+    file.write(QJsonDocument(root).toJson());
+}
+
+void DeviceCatalog::refresh(int kinds)
+{
+    if (m_running) {
+        m_pending |= kinds;
+        return;
+    }
+    if (!kinds)
+        return;
+
+    startWorker(kinds, nullptr);
+}
+
+// Nothing but the worker touches the found lists until on_enumerated().
+void DeviceCatalog::startWorker(int kinds, const QStringList *cameraNodes)
+{
+    m_running = kinds;
+    m_foundCameras = m_cameras;
+    m_foundAudioInputs = m_audioInputs;
+    m_enumerationTimer.start();
+    EnumerationThread *worker = new EnumerationThread(kinds, &m_foundCameras, &m_foundAudioInputs, this);
+    if (cameraNodes)
+        worker->setCameraNodes(*cameraNodes, m_cameraNodes);
+    m_worker = worker;
+    connect(m_worker, SIGNAL(finished()), this, SLOT(on_enumerated()));
+    m_worker->start(QThread::LowPriority);
+}
+
+void DeviceCatalog::on_enumerated()
+{
+    m_worker->deleteLater();
+    m_worker = nullptr;
+    m_lastEnumerationMs = m_enumerationTimer.elapsed();
+
+    int changed = 0;
+    if ((m_running & Cameras) && m_foundCameras != m_cameras) {
+        m_cameras = m_foundCameras;
+        changed |= Cameras;
+    }
+    if ((m_running & AudioInputs) && m_foundAudioInputs != m_audioInputs) {
+        m_audioInputs = m_foundAudioInputs;
+        changed |= AudioInputs;
+    }
+    m_running = 0;
+    if (changed) {
+        saveSnapshot();
+        emit devicesChanged(changed);
+    }
+    emit enumerationFinished(m_lastEnumerationMs);
+
+    const int pending = m_pending;
+    m_pending = 0;
+    refresh(pending);
+}
+
+void DeviceCatalog::watch()
+{
+#ifdef Q_OS_LINUX
+    if (m_watcher)
+        return;
+    m_cameraNodes = deviceNodes(Cameras);
+    m_audioNodes = deviceNodes(AudioInputs);
+    m_watcher = new QFileSystemWatcher(this);
+    m_watcher->addPath("/dev");
+    if (QDir("/dev/snd").exists())
+        m_watcher->addPath("/dev/snd");
+    connect(m_watcher, SIGNAL(directoryChanged(const QString&)), this, SLOT(on_node_changed()));
+#endif
+}
+
+// V4L2 capture nodes, and ALSA capture PCMs such as pcmC0D0c.
+QStringList DeviceCatalog::deviceNodes(int kind) const
+{
+    if (kind == Cameras)
+        return QDir("/dev").entryList(QStringList() << "video*", QDir::System);
+    return QDir("/dev/snd").entryList(QStringList() << "pcmC*c", QDir::System);
+}
+
+void DeviceCatalog::on_node_changed()
+{
+    m_settle.start();
+}
+
+void DeviceCatalog::devicesMayHaveChanged()
+{
+    m_dirty = AllDevices;
+    m_settle.start();
+}
+
+void DeviceCatalog::on_settled()
+{
+    // Only a kind whose nodes changed is looked at again, so the churn of
+    // unrelated /dev entries costs a directory listing. ALSA nodes do not
+    // map to Qt's audio device names, so audio inputs are enumerated again.
+    if (m_watcher) {
+        const QStringList cameraNodes = deviceNodes(Cameras);
+        const QStringList audioNodes = deviceNodes(AudioInputs);
+        if (cameraNodes != m_cameraNodes) {
+            // New nodes are queried on the worker, as a driver can block
+            // there as long as it can in an enumeration. A worker that is
+            // busy already means a full enumeration after it.
+            if (m_running || (m_dirty & Cameras))
+                m_dirty |= Cameras;
+            else
+                startWorker(Cameras, &cameraNodes);
+        }
+        if (audioNodes != m_audioNodes)
+            m_dirty |= AudioInputs;
+        m_cameraNodes = cameraNodes;
+        m_audioNodes = audioNodes;
+    }
+
+    const int dirty = m_dirty;
+    m_dirty = 0;
+    refresh(dirty);
+}
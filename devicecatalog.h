@@ -0,0 +1,103 @@
+#ifndef DEVICECATALOG_H
+#define DEVICECATALOG_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+class QFileSystemWatcher;
+class QMutex;
+class QThread;
+
+// A capture device as StreamConfig names it, and as a person would.
+struct DeviceEntry {
+    QString name;
+    QString description;
+
+    bool operator==(const DeviceEntry &other) const { return name == other.name && description == other.description; }
+};
+
+// The cameras and audio inputs there are to pick from, without waiting for
+// them to be enumerated. Enumerating can take seconds on machines with many
+// capture cards, so the lists start as the snapshot the last run saved and
+// are enumerated again on a worker thread, which saves a new snapshot.
+//
+// After that, only a kind of device that came or went is enumerated again:
+// on Linux the device nodes under /dev are watched, on Windows the window
+// forwards WM_DEVICECHANGE to devicesMayHaveChanged(). On Linux a camera
+// node that came is queried alone on the worker thread and one that went is
+// dropped, rather than enumerating every camera again.
+class DeviceCatalog : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind {
+        Cameras = 1,
+        AudioInputs = 2,
+        AllDevices = Cameras | AudioInputs
+    };
+
+    explicit DeviceCatalog(QObject *parent = nullptr);
+    ~DeviceCatalog();
+
+    // Defaults to devices.json in the app data directory.
+    void setSnapshotFile(const QString &path);
+    // Takes the lists from the snapshot. False if there is none yet.
+    bool loadSnapshot();
+    // Enumerates kinds in the background; devicesChanged() follows if a
+    // list differs. A refresh asked for while one runs follows it.
+    void refresh(int kinds = AllDevices);
+    // Refreshes a kind whenever its devices come or go.
+    void watch();
+    // Something was plugged or unplugged, kind unknown.
+    void devicesMayHaveChanged();
+
+    const QList<DeviceEntry> &cameras() const { return m_cameras; }
+    const QList<DeviceEntry> &audioInputs() const { return m_audioInputs; }
+    bool isEnumerating() const { return m_running != 0; }
+    // How long the last enumeration took, -1 before one finished.
+    qint64 lastEnumerationMs() const { return m_lastEnumerationMs; }
+
+    // Qt Multimedia's device lists are not safe to build from two threads
+    // at once; whoever builds one outside the catalog holds this.
+    static QMutex *enumerationLock();
+
+signals:
+    // On the thread the catalog lives on.
+    void devicesChanged(int kinds);
+    void enumerationFinished(qint64 ms);
+
+private slots:
+    void on_enumerated();
+    void on_node_changed();
+    void on_settled();
+
+private:
+    void saveSnapshot() const;
+    QStringList deviceNodes(int kind) const;
+    void startWorker(int kinds, const QStringList *cameraNodes);
+
+    QList<DeviceEntry> m_cameras;
+    QList<DeviceEntry> m_audioInputs;
+    QString m_snapshotPath;
+
+    QThread *m_worker;
+    int m_running;              // kinds the worker is enumerating
+    int m_pending;              // kinds to enumerate after it
+    QList<DeviceEntry> m_foundCameras;
+    QList<DeviceEntry> m_foundAudioInputs;
+    QElapsedTimer m_enumerationTimer;
+    qint64 m_lastEnumerationMs;
+
+    QFileSystemWatcher *m_watcher;
+    QTimer m_settle;            // coalesces the burst of events one plug makes
+    int m_dirty;
+    QStringList m_cameraNodes;
+    QStringList m_audioNodes;
+};
+
+#endif // DEVICECATALOG_H
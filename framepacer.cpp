@@ -0,0 +1,126 @@
+#include "framepacer.h"
+
+#include <QDateTime>
+#include <chrono>
+#include <thread>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// Sleep until this close to the deadline, then yield-spin the rest; OS sleeps
+// overshoot by up to a scheduler quantum.
+static const std::chrono::microseconds SpinMargin(1500);
+
+FramePacer::FramePacer(QObject *parent)
+    : QThread(parent)
+    , m_isRunning(false)
+    , m_startTimecode(0)
+    , m_ticks(0)
+    , m_missed(0)
+    , m_jitterSumNs(0)
+    , m_jitterMaxNs(0)
+{
+    m_rate.num = 30000;
+    m_rate.den = 1001;
+}
+
+FramePacer::~FramePacer()
+{
+    Stop();
+}
+
+void FramePacer::Start(FrameRate rate)
+{
+    Stop();
+
+    m_rate = rate;
+    m_ticks = 0;
+    m_missed = 0;
+    m_jitterSumNs = 0;
+    m_jitterMaxNs = 0;
+    m_startTimecode = QDateTime::currentMSecsSinceEpoch() * 10000;
+    m_isRunning = true;
+    start(QThread::TimeCriticalPriority);
+}
+
+void FramePacer::Stop()
+{
+    m_isRunning = false;
+    wait();
+}
+
+FramePacer::Stats FramePacer::GetStats() const
+{
+    Stats stats;
+    stats.ticks = m_ticks.load();
+    stats.missed = m_missed.load();
+    stats.jitterMeanUs = stats.ticks ? m_jitterSumNs.load() / 1000.0 / stats.ticks : 0.0;
+    stats.jitterMaxUs = m_jitterMaxNs.load() / 1000.0;
+    return stats;
+}
+
+void FramePacer::run()
+{
+#ifdef Q_OS_WIN
+    timeBeginPeriod(1);
+#endif
+
+    const qint64 num = m_rate.num;
+    const qint64 den = m_rate.den;
+
+    // Every num frames take exactly den seconds, so the epoch advances by
+    // whole seconds and the in-epoch offset n * den * 1e9 / num stays small.
+    Clock::time_point epoch = Clock::now();
+    qint64 epochTimecode = m_startTimecode;
+    qint64 frame = 0;   // index since Start()
+    qint64 n = 0;       // index within the current epoch
+
+    while (m_isRunning) {
+        const qint64 offsetNs = n * den * 1000000000 / num;
+        const Clock::time_point deadline = epoch + std::chrono::nanoseconds(offsetNs);
+
+        Clock::time_point now = Clock::now();
+        if (deadline - now > SpinMargin)
+            std::this_thread::sleep_until(deadline - SpinMargin);
+        while ((now = Clock::now()) < deadline && m_isRunning)
+            std::this_thread::yield();
+        if (!m_isRunning)
+            break;
+
+        const quint64 lateNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - deadline).count();
+        m_jitterSumNs += lateNs;
+        if (lateNs > m_jitterMaxNs)
+            m_jitterMaxNs = lateNs;
+        m_ticks++;
+
+        emit tick(frame, epochTimecode + offsetNs / 100);
+
+        // Skip deadlines that already passed while the tick ran instead of
+        // firing a burst of catch-up frames. A deadline only counts as missed
+        // once it is more than half a period old; anything less is a late tick.
+        qint64 next = n + 1;
+        const qint64 periodNs = den * 1000000000;    // one period is periodNs / num
+        const qint64 elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+        const qint64 due = (2 * elapsedNs * num - periodNs) / (2 * periodNs);
+        if (due >= next) {
+            m_missed += due - next + 1;
+            next = due + 1;
+        }
+        frame += next - n;
+        n = next;
+
+        while (n >= num) {
+            n -= num;
+            epoch += std::chrono::seconds(den);
+            epochTimecode += den * 10000000;
+        }
+    }
+
+#ifdef Q_OS_WIN
+    timeEndPeriod(1);
+#endif
+}
@@ -0,0 +1,56 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <QThread>
+#include <atomic>
+
+// Exact frame rate as NDI expresses it, e.g. 30000/1001 for 29.97p.
+struct FrameRate {
+    int num;
+    int den;
+};
+
+// Ticks at an exact rational rate from its own thread. Deadlines are absolute
+// points on the monotonic clock computed from the frame index, so a late tick
+// never pushes the following ones back and rounding never accumulates.
+class FramePacer : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        quint64 ticks;
+        quint64 missed;         // deadlines skipped because a tick ran too long
+        double jitterMeanUs;    // wake-up lateness against the deadline
+        double jitterMaxUs;
+    };
+
+    explicit FramePacer(QObject *parent = nullptr);
+    ~FramePacer();
+
+    void Start(FrameRate rate);
+    void Stop();
+
+    FrameRate Rate() const { return m_rate; }
+    Stats GetStats() const;
+
+signals:
+    // Emitted on the pacing thread. timecode is the frame's ideal time in NDI
+    // units (100 ns since the Unix epoch), anchored when Start() was called.
+    void tick(qint64 frameIndex, qint64 timecode);
+
+protected:
+    void run() override;
+
+private:
+    FrameRate m_rate;
+    std::atomic<bool> m_isRunning;
+    qint64 m_startTimecode;
+
+    std::atomic<quint64> m_ticks;
+    std::atomic<quint64> m_missed;
+    std::atomic<quint64> m_jitterSumNs;
+    std::atomic<quint64> m_jitterMaxNs;
+};
+
+#endif // FRAMEPACER_H
@@ -0,0 +1,101 @@
+#include "framepool.h"
+
+#include <string.h>
+
+static const size_t PageSize = 4096;
+
+FramePool::FramePool()
+    : m_bufferSize(0)
+{
+}
+
+FramePool::~FramePool()
+{
+    clear();
+}
+
+void FramePool::reset(int count, int bufferSize)
+{
+    clear();
+    if (count <= 0 || bufferSize <= 0)
+        return;
+
+    m_bufferSize = bufferSize;
+    m_buffers.reserve(count);
+    m_free.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const size_t size = (size_t(bufferSize) + PageSize - 1) & ~(PageSize - 1);
+        FrameBuffer *buffer = new FrameBuffer;
+        buffer->data = static_cast<uint8_t *>(qMallocAligned(size, PageSize));
+        // Touch every page now so the first frames don't pay for page faults.
+        memset(buffer->data, 0, size);
+        buffer->capacity = bufferSize;
+        buffer->len = 0;
+        buffer->xres = 0;
+        buffer->yres = 0;
+        buffer->stride = 0;
+        buffer->fourCC = 0;
+        buffer->frameRateN = 0;
+        buffer->frameRateD = 0;
+        buffer->generation = 0;
+        buffer->timecode = 0;
+        buffer->captureNs = 0;
+        buffer->enqueueNs = 0;
+        buffer->owner = nullptr;
+        buffer->holder = nullptr;
+        buffer->pool = this;
+        m_buffers.push_back(buffer);
+        m_free.push_back(buffer);
+    }
+}
+
+void FramePool::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    Q_ASSERT(m_free.size() == m_buffers.size());
+
+    for (FrameBuffer *buffer : m_buffers) {
+        qFreeAligned(buffer->data);
+        delete buffer;
+    }
+    m_buffers.clear();
+    m_free.clear();
+    m_held.clear();
+    m_bufferSize = 0;
+}
+
+FrameBuffer *FramePool::acquire(const void *holder, int limit)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_free.isEmpty())
+        return nullptr;
+    if (holder && limit > 0 && m_held.value(holder) >= limit)
+        return nullptr;
+
+    FrameBuffer *buffer = m_free.back();
+    m_free.pop_back();
+    buffer->len = 0;
+    buffer->holder = holder;
+    if (holder)
+        ++m_held[holder];
+    return buffer;
+}
+
+int FramePool::available() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_free.size();
+}
+
+void FramePool::release(FrameBuffer *buffer)
+{
+    if (!buffer)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    if (buffer->holder) {
+        --m_held[buffer->holder];
+        buffer->holder = nullptr;
+    }
+    m_free.push_back(buffer);
+}
@@ -0,0 +1,69 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <stdint.h>
+
+class FramePool;
+
+// One preallocated frame. The capture side fills data and the frame geometry,
+// the sender hands data to NDI unchanged and gives the buffer back to its pool
+// once the SDK no longer references it.
+struct FrameBuffer {
+    uint8_t *data;
+    int capacity;   // bytes allocated
+    int len;        // bytes filled
+    int xres;
+    int yres;
+    int stride;     // line stride for video, channel stride for planar audio
+    // Video only; 0 keeps what the sender's frame template says.
+    int fourCC;
+    int frameRateN;
+    int frameRateD;
+    uint64_t generation;    // damage generation the content matches, 0 if none
+    int64_t timecode;       // NDI timecode, 100 ns units
+    int64_t captureNs;      // pipelineClockNs() when the source data was captured
+    int64_t enqueueNs;      // pipelineClockNs() when pushed to the sender
+    const void *owner;      // stream that last filled data; pools may be shared
+    const void *holder;     // stream that has it checked out, nullptr when free
+    FramePool *pool;
+};
+
+// Fixed set of page-aligned, pre-faulted buffers, shared by the streams whose
+// buffers have the same size. Buffers are only allocated in reset(), so
+// acquire()/release() never touch the heap once a stream has drawn a buffer.
+// Sources that hand out memory they do not own, such as driver buffers,
+// override release() to give it back.
+class FramePool
+{
+public:
+    FramePool();
+    virtual ~FramePool();
+
+    // Must only be called while no buffer is checked out.
+    void reset(int count, int bufferSize);
+    void clear();
+
+    // Returns nullptr when every buffer is queued or in flight, or when
+    // holder already has limit buffers checked out. A limit of 0 means none.
+    FrameBuffer *acquire(const void *holder = nullptr, int limit = 0);
+    virtual void release(FrameBuffer *buffer);
+
+    int bufferSize() const { return m_bufferSize; }
+    int count() const { return m_buffers.size(); }
+    // Buffers not checked out right now.
+    int available() const;
+
+private:
+    Q_DISABLE_COPY(FramePool)
+
+    QVector<FrameBuffer *> m_buffers;
+    QVector<FrameBuffer *> m_free;
+    QHash<const void *, int> m_held;    // buffers checked out, by holder; kept at 0
+    int m_bufferSize;
+    mutable QMutex m_mutex;
+};
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,205 @@
+#include "framescaler.h"
+
+#include <vector>
+
+#include "colorconvert_p.h"
+#include "cpufeatures.h"
+
+// Rows scaled per conversion call; two keep 4:2:0 chroma pairs together.
+static const int ScratchRows = 2;
+
+struct ScaleKernels {
+    ScaleBoxColumnsFn boxColumns;
+    ScaleWidenRowFn widen;
+    ScaleAccumulateRowFn accumulate;
+    ScaleBlendRowsFn blend;
+};
+
+static ScaleKernels selectKernels()
+{
+    ScaleKernels k = { scaleBoxColumns_C, scaleWidenRow_C, scaleAccumulateRow_C, scaleBlendRows_C };
+#ifdef CPU_X86
+    if (cpuHasAVX2()) {
+        k.widen = scaleWidenRow_AVX2;
+        k.accumulate = scaleAccumulateRow_AVX2;
+        k.blend = scaleBlendRows_AVX2;
+    }
+    if (cpuHasSSE2())
+        k.boxColumns = scaleBoxColumns_SSE2;
+    if (cpuHasSSE2() && !cpuHasAVX2()) {
+        k.widen = scaleWidenRow_SSE2;
+        k.accumulate = scaleAccumulateRow_SSE2;
+        k.blend = scaleBlendRows_SSE2;
+    }
+#endif
+    return k;
+}
+
+static const ScaleKernels &kernels()
+{
+    static const ScaleKernels k = selectKernels();
+    return k;
+}
+
+// Source rows [first, end) covered by output row y of a box filter.
+static void boxRows(int y, int srcHeight, int dstHeight, int &first, int &end)
+{
+    first = int(int64_t(y) * srcHeight / dstHeight);
+    end = qMax(first + 1, int(int64_t(y + 1) * srcHeight / dstHeight));
+}
+
+// Source row and weight of the next one for output row y, 16.16 fixed point
+// with pixel centres aligned.
+static void bilinearTap(int y, int srcSize, int dstSize, int &index, int &weight)
+{
+    const int64_t pos = ((int64_t(y) * 2 + 1) * srcSize * 65536 / dstSize - 65536) / 2;
+    if (pos <= 0) {
+        index = 0;
+        weight = 0;
+        return;
+    }
+    index = int(pos >> 16);
+    weight = int((pos & 0xffff) >> 8);
+    if (index >= srcSize - 1) {
+        index = srcSize - 1;
+        weight = 0;
+    }
+}
+
+FrameScaler::FrameScaler()
+    : m_filter(Box)
+    , m_useBox(true)
+    , m_boxFactor(0)
+{
+}
+
+void FrameScaler::reset(const QSize &srcSize, const QSize &dstSize, Filter filter)
+{
+    // The box filter's 16-bit column sums hold at most 257 rows.
+    m_srcSize = srcSize;
+    m_dstSize = dstSize.boundedTo(srcSize).expandedTo(QSize((srcSize.width() + 255) / 256, (srcSize.height() + 255) / 256));
+    // Centre-aligned bilinear taps at exactly half size fall midway between
+    // two pixels each way, which is the 2x2 box and its faster column pass.
+    m_filter = filter;
+    m_useBox = filter == Box
+            || (m_dstSize.width() * 2 == srcSize.width() && m_dstSize.height() * 2 == srcSize.height());
+
+    const int width = m_dstSize.width();
+    m_boxStart.resize(width);
+    m_boxCount.resize(width);
+    m_tapIndex.resize(width);
+    m_tapWeight.resize(width);
+    int maxCount = 1;
+    for (int x = 0; x < width; ++x) {
+        int end;
+        boxRows(x, srcSize.width(), width, m_boxStart[x], end);
+        m_boxCount[x] = end - m_boxStart[x];
+        maxCount = qMax(maxCount, m_boxCount[x]);
+        bilinearTap(x, srcSize.width(), width, m_tapIndex[x], m_tapWeight[x]);
+    }
+
+    int maxRows = 1;
+    for (int y = 0; y < m_dstSize.height(); ++y) {
+        int first, end;
+        boxRows(y, srcSize.height(), m_dstSize.height(), first, end);
+        maxRows = qMax(maxRows, end - first);
+    }
+    m_boxFactor = m_srcSize.width() % width == 0 ? m_srcSize.width() / width : 0;
+
+    m_reciprocal.resize(maxCount * maxRows + 1);
+    m_reciprocal[0] = 0;
+    for (int n = 1; n < m_reciprocal.size(); ++n)
+        m_reciprocal[n] = (uint64_t(1) << 32) / n;
+}
+
+void FrameScaler::boxRow(const uint8_t *src, int srcStride, int y, uint32_t *out, uint16_t *acc) const
+{
+    const ScaleKernels &k = kernels();
+    const int bytes = m_srcSize.width() * 4;
+    int first, end;
+    boxRows(y, m_srcSize.height(), m_dstSize.height(), first, end);
+
+    k.widen(src + first * srcStride, acc, bytes);
+    for (int row = first + 1; row < end; ++row)
+        k.accumulate(src + row * srcStride, acc, bytes);
+
+    // Whole-number reductions, such as 4K to 1080p or 720p, sum fixed groups
+    // of columns in SIMD registers.
+    const int rows = end - first;
+    const int n = m_boxFactor * rows;
+    if (m_boxFactor > 0 && n >= 2 && n <= 256) {
+        k.boxColumns(acc, out, m_dstSize.width(), m_boxFactor, n, (65536 + n / 2) / n);
+        return;
+    }
+
+    for (int x = 0; x < m_dstSize.width(); ++x) {
+        const uint16_t *a = acc + m_boxStart[x] * 4;
+        const int count = m_boxCount[x];
+        uint32_t b = 0, g = 0, r = 0, alpha = 0;
+        for (int i = 0; i < count; ++i) {
+            b += a[0];
+            g += a[1];
+            r += a[2];
+            alpha += a[3];
+            a += 4;
+        }
+        // Rounded down, the reciprocal never takes a full box above 255.
+        const uint64_t scale = m_reciprocal[count * rows];
+        const uint64_t half = uint64_t(1) << 31;
+        out[x] = uint32_t((b * scale + half) >> 32) | uint32_t((g * scale + half) >> 32) << 8
+                | uint32_t((r * scale + half) >> 32) << 16 | uint32_t((alpha * scale + half) >> 32) << 24;
+    }
+}
+
+void FrameScaler::bilinearRow(const uint8_t *src, int srcStride, int y, uint32_t *out, uint8_t *blend) const
+{
+    int row, weight;
+    bilinearTap(y, m_srcSize.height(), m_dstSize.height(), row, weight);
+
+    const uint32_t *px = reinterpret_cast<const uint32_t *>(src + row * srcStride);
+    if (weight > 0) {
+        kernels().blend(src + row * srcStride, src + (row + 1) * srcStride, blend, m_srcSize.width() * 4, weight);
+        px = reinterpret_cast<const uint32_t *>(blend);
+    }
+
+    // Two channels at a time: each 16-bit half of the products holds one
+    // channel and never carries into the next, as the weights sum to 256.
+    const int last = m_srcSize.width() - 1;
+    for (int x = 0; x < m_dstSize.width(); ++x) {
+        const int i = m_tapIndex[x];
+        const uint32_t w = m_tapWeight[x];
+        const uint32_t p0 = px[i];
+        const uint32_t p1 = px[i < last ? i + 1 : i];
+        const uint32_t rb = ((p0 & 0xff00ff) * (256 - w) + (p1 & 0xff00ff) * w + 0x800080) >> 8;
+        const uint32_t ag = ((p0 >> 8) & 0xff00ff) * (256 - w) + ((p1 >> 8) & 0xff00ff) * w + 0x800080;
+        out[x] = (rb & 0xff00ff) | (ag & 0xff00ff00);
+    }
+}
+
+void FrameScaler::scaleConvert(const uint8_t *src, int srcStride, uint8_t *dst, ConvertRGB32Fn convert, int y0, int y1) const
+{
+    // Each stripe worker keeps its own scratch; it only grows.
+    thread_local std::vector<uint32_t> scaled;
+    thread_local std::vector<uint16_t> acc;
+    thread_local std::vector<uint8_t> blend;
+
+    const int width = m_dstSize.width();
+    const int height = m_dstSize.height();
+    if (int(scaled.size()) < width * ScratchRows)
+        scaled.resize(width * ScratchRows);
+    if (m_useBox && int(acc.size()) < m_srcSize.width() * 4)
+        acc.resize(m_srcSize.width() * 4);
+    if (!m_useBox && int(blend.size()) < m_srcSize.width() * 4)
+        blend.resize(m_srcSize.width() * 4);
+
+    for (int y = y0; y < y1; y += ScratchRows) {
+        const int rows = qMin(ScratchRows, y1 - y);
+        for (int r = 0; r < rows; ++r) {
+            if (m_useBox)
+                boxRow(src, srcStride, y + r, scaled.data() + r * width, acc.data());
+            else
+                bilinearRow(src, srcStride, y + r, scaled.data() + r * width, blend.data());
+        }
+        convert(reinterpret_cast<const uint8_t *>(scaled.data()), width * 4, dst, width, height, 0, y, width, rows);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef FRAMESCALER_H
+#define FRAMESCALER_H
+
+#include <QSize>
+#include <QVector>
+#include <stdint.h>
+
+#include "colorconvert.h"
+
+// Downscales RGB32 frames on the way into a format converter. Each pair of
+// output rows is scaled into a small per-thread scratch buffer that is
+// converted while still in cache, so the source is read once and no
+// full-size intermediate frame exists.
+//
+// Box averages every source pixel an output pixel covers and is the filter
+// of choice for large reductions; bilinear reads only the nearest 2x2 pixels
+// and is cheaper but aliases below half size.
+class FrameScaler
+{
+public:
+    enum Filter {
+        Box,
+        Bilinear
+    };
+
+    FrameScaler();
+
+    // Prepares the per-column tables. Only downscaling by up to 256 times is
+    // supported; dstSize is clamped to that.
+    void reset(const QSize &srcSize, const QSize &dstSize, Filter filter);
+
+    QSize sourceSize() const { return m_srcSize; }
+    QSize size() const { return m_dstSize; }
+    Filter filter() const { return m_filter; }
+
+    // Scales and converts output rows [y0, y1), y0 even, of a frame laid out
+    // for convert. Safe to call from several threads for disjoint rows.
+    void scaleConvert(const uint8_t *src, int srcStride, uint8_t *dst, ConvertRGB32Fn convert, int y0, int y1) const;
+
+private:
+    void boxRow(const uint8_t *src, int srcStride, int y, uint32_t *out, uint16_t *acc) const;
+    void bilinearRow(const uint8_t *src, int srcStride, int y, uint32_t *out, uint8_t *blend) const;
+
+    QSize m_srcSize;
+    QSize m_dstSize;
+    Filter m_filter;
+    bool m_useBox;
+
+    // Box: first source column and column count per output pixel, and
+    // 2^32 / n for every pixel count n a box can have.
+    QVector<int> m_boxStart;
+    QVector<int> m_boxCount;
+    QVector<uint64_t> m_reciprocal;
+    int m_boxFactor;    // columns per output pixel if that is a whole number
+    // Bilinear: left source column and weight of the right one, out of 256.
+    QVector<int> m_tapIndex;
+    QVector<int> m_tapWeight;
+};
+
+#endif // FRAMESCALER_H
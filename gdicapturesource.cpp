@@ -0,0 +1,176 @@
+#include "gdicapturesource.h"
+
+#include <QVector>
+#include <dwmapi.h>
+
+GdiCaptureSource::GdiCaptureSource()
+    : m_screenDC(nullptr)
+    , m_memDC(nullptr)
+    , m_bitmap(nullptr)
+    , m_oldBitmap(nullptr)
+    , m_bits(nullptr)
+    , m_window(nullptr)
+{
+}
+
+GdiCaptureSource::~GdiCaptureSource()
+{
+    close();
+}
+
+bool GdiCaptureSource::openDCs()
+{
+    m_screenDC = GetDC(nullptr);
+    m_memDC = m_screenDC ? CreateCompatibleDC(m_screenDC) : nullptr;
+    return m_memDC;
+}
+
+bool GdiCaptureSource::open(const QRect &geometry)
+{
+    close();
+    if (geometry.isEmpty())
+        return false;
+
+    m_geometry = geometry;
+    if (!openDCs() || !createBitmap(geometry.size())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool GdiCaptureSource::openWindow(quintptr window, const QSize &maxSize)
+{
+    close();
+    m_window = reinterpret_cast<HWND>(window);
+    m_maxSize = maxSize;
+    if (maxSize.isEmpty() || !followWindow() || !openDCs() || !createBitmap(m_geometry.size())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Takes the window's current area of the desktop as the captured geometry.
+// False if it is gone, minimized or entirely off screen.
+bool GdiCaptureSource::followWindow()
+{
+    if (!IsWindow(m_window) || !IsWindowVisible(m_window) || IsIconic(m_window))
+        return false;
+
+    // The extended frame bounds leave out the invisible resize borders that
+    // GetWindowRect includes since Windows 10.
+    RECT r;
+    if (FAILED(DwmGetWindowAttribute(m_window, DWMWA_EXTENDED_FRAME_BOUNDS, &r, sizeof(r))) && !GetWindowRect(m_window, &r))
+        return false;
+
+    const QRect desktop(GetSystemMetrics(SM_XVIRTUALSCREEN), GetSystemMetrics(SM_YVIRTUALSCREEN),
+                        GetSystemMetrics(SM_CXVIRTUALSCREEN), GetSystemMetrics(SM_CYVIRTUALSCREEN));
+    QRect area = QRect(QPoint(r.left, r.top), QPoint(r.right - 1, r.bottom - 1)).intersected(desktop);
+    area.setSize(area.size().boundedTo(m_maxSize));
+    if (area.isEmpty())
+        return false;
+    m_geometry = area;
+    return true;
+}
+
+bool GdiCaptureSource::createBitmap(const QSize &size)
+{
+    BITMAPINFO info;
+    ZeroMemory(&info, sizeof(info));
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = size.width();
+    info.bmiHeader.biHeight = -size.height();   // top-down rows
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    void *bits = nullptr;
+    m_bitmap = CreateDIBSection(m_memDC, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (!m_bitmap)
+        return false;
+    m_bits = static_cast<uint8_t *>(bits);
+    m_oldBitmap = SelectObject(m_memDC, m_bitmap);
+    m_bitmapSize = size;
+    return true;
+}
+
+void GdiCaptureSource::destroyBitmap()
+{
+    if (m_memDC && m_oldBitmap)
+        SelectObject(m_memDC, m_oldBitmap);
+    if (m_bitmap)
+        DeleteObject(m_bitmap);
+
+    m_bitmap = nullptr;
+    m_oldBitmap = nullptr;
+    m_bits = nullptr;
+    m_bitmapSize = QSize();
+}
+
+void GdiCaptureSource::close()
+{
+    destroyBitmap();
+    if (m_memDC)
+        DeleteDC(m_memDC);
+    if (m_screenDC)
+        ReleaseDC(nullptr, m_screenDC);
+
+    m_screenDC = nullptr;
+    m_memDC = nullptr;
+    m_window = nullptr;
+}
+
+bool GdiCaptureSource::grab(CaptureFrame &frame)
+{
+    if (m_window) {
+        if (!followWindow())
+            return false;
+        if (m_geometry.size() != m_bitmapSize) {
+            destroyBitmap();
+            if (!createBitmap(m_geometry.size()))
+                return false;
+        }
+    }
+    if (!m_bits)
+        return false;
+
+    if (!BitBlt(m_memDC, 0, 0, m_geometry.width(), m_geometry.height(),
+                m_screenDC, m_geometry.x(), m_geometry.y(), SRCCOPY))
+        return false;
+    GdiFlush();
+
+    frame.data = m_bits;
+    frame.stride = m_geometry.width() * 4;
+    frame.width = m_geometry.width();
+    frame.height = m_geometry.height();
+    return true;
+}
+
+CaptureSource *CaptureSource::create()
+{
+    return new GdiCaptureSource;
+}
+
+static BOOL CALLBACK addWindow(HWND window, LPARAM param)
+{
+    // Visible, titled, unowned windows are the ones on the taskbar.
+    const int length = GetWindowTextLengthW(window);
+    if (!IsWindowVisible(window) || length == 0 || GetWindow(window, GW_OWNER))
+        return TRUE;
+
+    QVector<wchar_t> title(length + 1);
+    GetWindowTextW(window, title.data(), title.size());
+    CaptureWindow entry;
+    entry.id = reinterpret_cast<quintptr>(window);
+    entry.title = QString::fromWCharArray(title.constData());
+    reinterpret_cast<QList<CaptureWindow> *>(param)->push_back(entry);
+    return TRUE;
+}
+
+QList<CaptureWindow> CaptureSource::windows()
+{
+    QList<CaptureWindow> result;
+    EnumWindows(addWindow, reinterpret_cast<LPARAM>(&result));
+    return result;
+}
@@ -0,0 +1,45 @@
+#ifndef GDICAPTURESOURCE_H
+#define GDICAPTURESOURCE_H
+
+#include "capturesource.h"
+
+#include <QSize>
+
+#include <windows.h>
+
+// BitBlt from the desktop into a persistent top-down DIB section, whose bits
+// are handed out directly. A followed window's bounds are read on every grab,
+// which costs no round trip, and the DIB is only reallocated when its size
+// changed.
+class GdiCaptureSource : public CaptureSource
+{
+public:
+    GdiCaptureSource();
+    ~GdiCaptureSource() override;
+
+    bool open(const QRect &geometry) override;
+    bool openWindow(quintptr window, const QSize &maxSize) override;
+    void close() override;
+    bool grab(CaptureFrame &frame) override;
+
+    const char *name() const override { return "gdi"; }
+
+private:
+    bool openDCs();
+    bool createBitmap(const QSize &size);
+    void destroyBitmap();
+    bool followWindow();
+
+    QRect m_geometry;
+    QSize m_bitmapSize;
+    HDC m_screenDC;
+    HDC m_memDC;
+    HBITMAP m_bitmap;
+    HGDIOBJ m_oldBitmap;
+    uint8_t *m_bits;
+
+    HWND m_window;
+    QSize m_maxSize;
+};
+
+#endif // GDICAPTURESOURCE_H
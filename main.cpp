@@ -1,7 +1,12 @@
 
 #include "widget.h"
+#include "daemon.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QPainterPath>
+#include <QScopedPointer>
 #include <Processing.NDI.Lib.h>
 
 #ifdef _WIN32
@@ -15,11 +20,58 @@
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer launch;
+    launch.start();
+
     if (!NDIlib_initialize())
         return 0;
 
-    QApplication a(argc, argv);
-    Widget w;
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sends screens, cameras and audio inputs as NDI sources.");
+    parser.addHelpOption();
+    QCommandLineOption configOption(QStringList() << "c" << "config",
+                                    "Run without a window, streaming what <file> describes.", "file");
+    QCommandLineOption statsOption("stats", "Append per-stream statistics to <file>.", "file");
+    QCommandLineOption listOption("list-sources", "Print the sources a config file can use.");
+    QCommandLineOption workersOption("workers", "Capture, convert and send on <n> threads, by default one per core.", "n", "0");
+    QCommandLineOption pinOption("pin-cores", "Pin each of those threads to a core.");
+    parser.addOption(configOption);
+    parser.addOption(statsOption);
+    parser.addOption(listOption);
+    parser.addOption(workersOption);
+    parser.addOption(pinOption);
+
+    // parse() needs no application yet, so the options pick which one to
+    // build: the window needs widgets, screens, windows and cameras need a
+    // display, and a config that captures none of them runs without one.
+    // process() below reports any errors.
+    QStringList arguments;
+    for (int i = 0; i < argc; ++i)
+        arguments << QString::fromLocal8Bit(argv[i]);
+    parser.parse(arguments);
+    QScopedPointer<QCoreApplication> a;
+    if (parser.isSet(listOption) || (parser.isSet(configOption) && daemonNeedsGui(parser.value(configOption))))
+        a.reset(new QGuiApplication(argc, argv));
+    else if (parser.isSet(configOption))
+        a.reset(new QCoreApplication(argc, argv));
+    else
+        a.reset(new QApplication(argc, argv));
+    a->setApplicationName("NDI Streamer");
+    parser.process(*a);
+
+    if (parser.isSet(listOption)) {
+        listSources();
+        NDIlib_destroy();
+        return 0;
+    }
+    if (parser.isSet(configOption)) {
+        const int ret = runDaemon(parser.value(configOption), parser.value(statsOption),
+                                  parser.value(workersOption).toInt(), parser.isSet(pinOption));
+        NDIlib_destroy();
+        return ret;
+    }
+
+    Widget w(launch);
 
     const int radius = 10;
 
@@ -29,7 +81,7 @@ int main(int argc, char *argv[])
     w.setMask(mask);
 
     w.show();
-    int ret = a.exec();
+    int ret = a->exec();
 
     NDIlib_destroy();
     return ret;
@@ -0,0 +1,1203 @@
+#include "ndistream.h"
+
+#include <QAudioDeviceInfo>
+#include <QCamera>
+#include <QCameraImageCapture>
+#include <QCameraInfo>
+#include <QDebug>
+#include <QGuiApplication>
+#include <QMutexLocker>
+#include <QScreen>
+#include <QStringList>
+#include <cmath>
+
+#include "audioinfo.h"
+#include "colorconvert.h"
+#include "devicecatalog.h"
+#include "framepacer.h"
+#include "replaysource.h"
+#include "senderthread.h"
+#include "streamrecorder.h"
+#include "stripepool.h"
+#include "syntheticsource.h"
+#ifdef Q_OS_LINUX
+#include "v4l2camera.h"
+#endif
+
+// Queue depths bound the latency a stream can build up.
+static const int VideoQueueDepth = 2;
+static const int AudioQueueDepth = 8;
+// Video: the queue, one being converted, one being sent and the one before
+// it, which NDI holds until the next async send returns. Audio: the queue,
+// one being filled and one being sent.
+const int NdiStream::VideoBufferCount = VideoQueueDepth + 3;
+const int NdiStream::AudioBufferCount = AudioQueueDepth + 2;
+// NDI audio frames carry a fixed 20 ms block of planar float per channel.
+static const int AudioBlocksPerSecond = 50;
+
+// Unchanged screens are still re-sent this often so late receivers get a frame.
+static const int UnchangedKeepAliveMs = 1000;
+
+static NDIlib_FourCC_video_type_e videoFourCC(VideoFormat format)
+{
+    switch (format) {
+    case VideoUYVA: return NDIlib_FourCC_video_type_UYVA;
+    case VideoP216: return NDIlib_FourCC_video_type_P216;
+    case VideoNV12: return NDIlib_FourCC_video_type_NV12;
+    case VideoI420: return NDIlib_FourCC_video_type_I420;
+    case VideoRGBA: return NDIlib_FourCC_video_type_RGBA;
+    default: return NDIlib_FourCC_video_type_UYVY;
+    }
+}
+
+NdiStream::NdiStream(const StreamConfig &config, StripePool *stripePool, StageScheduler *scheduler, QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_stripePool(stripePool)
+    , m_instance(NULL)
+    , m_captureStrand(NULL)
+    , m_videoPool(NULL)
+    , m_audioPool(NULL)
+    , m_videoBufferSize(0)
+    , m_audioBufferSize(0)
+    , m_convert(nullptr)
+    , m_convertFormat(VideoUYVY)
+    , m_convertHeight(0)
+    , m_screenCapture(NULL)
+    , m_camera(NULL)
+    , m_imageCapture(NULL)
+    , m_v4l2(NULL)
+    , m_replay(NULL)
+    , m_mixPending(false)
+    , m_recorder(NULL)
+    , m_skipped(0)
+    , m_idle(false)
+    , m_idleEnabled(true)
+    , m_pendingChanges(NoChange)
+    , m_pendingReopen(false)
+    , m_opened(false)
+    , m_running(false)
+{
+    createSender();
+
+    m_videoSender = new SenderThread(m_instance, &m_videoFrame, NULL, this);
+    m_audioSender = new SenderThread(m_instance, NULL, &m_audioFrame, this);
+    m_videoSender->setObjectName(m_config.ndiName + " video");
+    m_audioSender->setObjectName(m_config.ndiName + " audio");
+
+    // Video favours latency over completeness; audio drops whole blocks
+    // rather than blocking the capture callback.
+    m_videoSender->SetQueue(VideoQueueDepth, SenderThread::DropOldest);
+    m_audioSender->SetQueue(AudioQueueDepth, SenderThread::DropNewest);
+    m_videoSender->SetStats(&m_videoStats);
+    m_audioSender->SetStats(&m_audioStats);
+    m_videoSender->SetPreview(&m_preview);
+
+    m_pacer = new FramePacer(this);
+
+    if (scheduler) {
+        m_videoSender->SetScheduler(scheduler);
+        m_audioSender->SetScheduler(scheduler);
+        // One frame waiting behind the one being converted; more would only
+        // add latency.
+        m_captureStrand = new StageScheduler::Strand(scheduler, m_config.ndiName + " capture", 1);
+    }
+}
+
+NdiStream::~NdiStream()
+{
+    stop();
+    delete m_captureStrand;
+
+    if (m_instance)
+        NDIlib_send_destroy(m_instance);
+}
+
+void NdiStream::createSender()
+{
+    const QByteArray name = m_config.ndiName.toUtf8();
+    NDIlib_send_create_t desc;
+    desc.p_ndi_name = name.constData();
+    m_instance = NDIlib_send_create(&desc);
+    if (!m_instance)
+        qWarning() << "Cannot create NDI sender" << m_config.ndiName;
+}
+
+void NdiStream::setConfig(const StreamConfig &config)
+{
+    Q_ASSERT(!m_running && !m_opened);
+
+    const bool renamed = config.ndiName != m_config.ndiName;
+    m_config = config;
+    if (!renamed)
+        return;
+
+    if (m_instance)
+        NDIlib_send_destroy(m_instance);
+    createSender();
+    m_videoSender->SetInstance(m_instance);
+    m_audioSender->SetInstance(m_instance);
+    m_videoSender->setObjectName(m_config.ndiName + " video");
+    m_audioSender->setObjectName(m_config.ndiName + " audio");
+}
+
+bool NdiStream::open()
+{
+    Q_ASSERT(!m_opened);
+    if (!m_instance)
+        return false;
+
+    m_opened = true;
+    const bool ok = openVideo() && openAudio();
+    if (!ok)
+        stop();
+    return ok;
+}
+
+bool NdiStream::openVideo()
+{
+    m_videoBufferSize = 0;
+    // Camera and replayed frames say nothing of how their YUV was encoded;
+    // converted frames are described by selectConverter().
+    m_preview.setColorimetry(MatrixAuto, LimitedRange);
+    if (m_config.video == StreamConfig::ScreenVideo)
+        return openScreen();
+    if (m_config.video == StreamConfig::WindowVideo)
+        return openWindow();
+    if (m_config.video == StreamConfig::CameraVideo)
+        return openCamera();
+    if (m_config.video == StreamConfig::TestPatternVideo)
+        return openTestPattern();
+    if (m_config.video == StreamConfig::ReplayVideo)
+        return openReplay();
+    return true;
+}
+
+bool NdiStream::hasVideo() const
+{
+    return m_videoBufferSize || m_v4l2 || (m_replay && m_replay->hasVideo());
+}
+
+bool NdiStream::hasAudio() const
+{
+    return m_audioBufferSize || (m_replay && m_replay->hasAudio());
+}
+
+bool NdiStream::openScreen()
+{
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (!m_config.videoDevice.isEmpty()) {
+        const QList<QScreen*> screens = QGuiApplication::screens();
+        bool isIndex = false;
+        const int index = m_config.videoDevice.toInt(&isIndex);
+        screen = NULL;
+        for (int i = 0; i < screens.size() && !screen; ++i) {
+            if (isIndex ? i == index : screens[i]->name() == m_config.videoDevice)
+                screen = screens[i];
+        }
+    }
+    if (!screen) {
+        qWarning() << m_config.ndiName << "- no screen" << m_config.videoDevice;
+        return false;
+    }
+
+    // A region is cropped by the grab itself, so nothing outside it is read.
+    QRect area = screen->geometry();
+    if (!m_config.region.isEmpty())
+        area = m_config.region.translated(area.topLeft()).intersected(area);
+    m_screenCapture = CaptureSource::create();
+    if (area.isEmpty() || !m_screenCapture || !m_screenCapture->open(area)) {
+        qWarning() << "Cannot capture screen" << screen->name() << "with" << (m_screenCapture ? m_screenCapture->name() : "nothing");
+        delete m_screenCapture;
+        m_screenCapture = NULL;
+        return false;
+    }
+
+    return openCaptureSource(area.size());
+}
+
+bool NdiStream::openWindow()
+{
+    bool isId = false;
+    quintptr id = m_config.videoDevice.toULongLong(&isId, 0);
+    if (!isId) {
+        id = 0;
+        for (const CaptureWindow &window : CaptureSource::windows()) {
+            if (window.title.contains(m_config.videoDevice, Qt::CaseInsensitive)) {
+                id = window.id;
+                break;
+            }
+        }
+    }
+    if (!id) {
+        qWarning() << m_config.ndiName << "- no window" << m_config.videoDevice;
+        return false;
+    }
+
+    // Frames follow the window's size, so buffers are sized for the largest
+    // screen it could fill.
+    QSize maxSize;
+    for (QScreen *screen : QGuiApplication::screens())
+        maxSize = maxSize.expandedTo(screen->size());
+
+    m_screenCapture = CaptureSource::create();
+    if (maxSize.isEmpty() || !m_screenCapture || !m_screenCapture->openWindow(id, maxSize)) {
+        qWarning() << "Cannot capture window" << m_config.videoDevice << "with" << (m_screenCapture ? m_screenCapture->name() : "nothing");
+        delete m_screenCapture;
+        m_screenCapture = NULL;
+        return false;
+    }
+
+    return openCaptureSource(maxSize);
+}
+
+bool NdiStream::openTestPattern()
+{
+    QSize size(1920, 1080);
+    if (!m_config.videoDevice.isEmpty()) {
+        const QStringList parts = m_config.videoDevice.split('x');
+        if (parts.size() == 2)
+            size = QSize(parts[0].toInt(), parts[1].toInt());
+    }
+
+    m_screenCapture = new SyntheticVideoSource;
+    if (size.isEmpty() || !m_screenCapture->open(QRect(QPoint(0, 0), size))) {
+        qWarning() << m_config.ndiName << "- bad test pattern size" << m_config.videoDevice;
+        delete m_screenCapture;
+        m_screenCapture = NULL;
+        return false;
+    }
+
+    return openCaptureSource(size);
+}
+
+bool NdiStream::openReplay()
+{
+    m_replay = new ReplaySource(this);
+    if (!m_replay->open(m_config.videoDevice)) {
+        delete m_replay;
+        m_replay = NULL;
+        return false;
+    }
+
+    // Frames go out exactly as recorded, straight from the mapped file, so
+    // there is nothing to convert and no pool; the format, size and rate of
+    // each frame come with it.
+    if (m_replay->hasVideo()) {
+        m_videoFrame.xres = m_replay->videoSize().width();
+        m_videoFrame.yres = m_replay->videoSize().height();
+        m_videoFrame.FourCC = NDIlib_FourCC_video_type_e(m_replay->videoFourCC());
+    }
+    if (m_replay->hasAudio()) {
+        m_audioFrame.sample_rate = m_replay->sampleRate();
+        m_audioFrame.no_channels = m_replay->channels();
+    }
+    qDebug() << m_config.ndiName << "- replaying" << m_replay->chunkCount() << "frames from" << m_config.videoDevice;
+
+    connect(m_replay, SIGNAL(frameReady(FrameBuffer*, bool, qint64)), this, SLOT(on_replay_frame(FrameBuffer*, bool, qint64)),
+            Qt::DirectConnection);
+    return true;
+}
+
+bool NdiStream::openCaptureSource(const QSize &size)
+{
+    setVideoFormat(size);
+
+    m_damage.reset();
+    m_lastSent.invalidate();
+    m_skipped = 0;
+
+    // Frames are grabbed and converted on the stage workers, or on the pacing
+    // thread itself without a scheduler.
+    if (m_captureStrand)
+        connect(m_pacer, SIGNAL(tick(qint64, qint64)), this, SLOT(on_pacer_tick(qint64, qint64)), Qt::DirectConnection);
+    else
+        connect(m_pacer, SIGNAL(tick(qint64, qint64)), this, SLOT(on_screen_tick(qint64, qint64)), Qt::DirectConnection);
+    return true;
+}
+
+// The configured output size for a source of the given size, never larger
+// than the source and even in both directions for the 4:2:x formats.
+QSize NdiStream::outputSize(const QSize &source) const
+{
+    QSize size = m_config.outputSize;
+    if (size.height() <= 0)
+        return source;
+    if (size.width() <= 0)
+        size.setWidth(qRound(double(source.width()) * size.height() / qMax(1, source.height())));
+
+    size = size.boundedTo(source);
+    if (size == source)
+        return source;
+    return QSize(qMax(2, size.width() & ~1), qMax(2, size.height() & ~1));
+}
+
+void NdiStream::setVideoFormat(const QSize &source)
+{
+    m_sourceSize = source;
+    const QSize size = outputSize(source);
+    m_videoFrame.xres = size.width();
+    m_videoFrame.yres = size.height();
+    m_videoFrame.FourCC = videoFourCC(m_config.format);
+    sizeVideoBuffers();
+}
+
+// Buffer size and converter for the configured format at the output size.
+void NdiStream::sizeVideoBuffers()
+{
+    const QSize size = outputSize(m_sourceSize);
+    m_videoBufferSize = videoFrameSize(m_config.format, size.width(), size.height());
+    selectConverter(m_config.format, size.height());
+}
+
+void NdiStream::selectConverter(VideoFormat format, int height)
+{
+    const ColorMatrix matrix = resolveColorMatrix(m_config.matrix, height);
+    // Captured pixels have no meaningful alpha, so UYVA and RGBA are opaque.
+    m_convert = selectRGB32Converter(format, matrix, m_config.range, false);
+    m_preview.setColorimetry(matrix, m_config.range);
+    m_convertFormat = format;
+    m_convertHeight = height;
+}
+
+bool NdiStream::openCamera()
+{
+#ifdef Q_OS_LINUX
+    // Device nodes are read directly; Qt Multimedia is only the fallback.
+    if (m_config.videoDevice.startsWith("/dev/video") && openV4l2Camera(m_config.videoDevice))
+        return true;
+#endif
+
+    QMutexLocker lock(DeviceCatalog::enumerationLock());
+    QCameraInfo info = QCameraInfo::defaultCamera();
+    if (!m_config.videoDevice.isEmpty()) {
+        info = QCameraInfo();
+        for (const QCameraInfo &camera : QCameraInfo::availableCameras()) {
+            if (camera.deviceName() == m_config.videoDevice || camera.description() == m_config.videoDevice) {
+                info = camera;
+                break;
+            }
+        }
+    }
+
+    lock.unlock();
+
+#ifdef Q_OS_LINUX
+    // A camera named by its description.
+    const QString device = info.deviceName();
+    if (device != m_config.videoDevice && device.startsWith("/dev/video") && openV4l2Camera(device))
+        return true;
+#endif
+
+    if (info.isNull()) {
+        qWarning() << m_config.ndiName << "- no camera" << m_config.videoDevice;
+        return false;
+    }
+
+    m_camera = new QCamera(info);
+    m_imageCapture = new QCameraImageCapture(m_camera);
+    m_imageCapture->setCaptureDestination(QCameraImageCapture::CaptureToBuffer);
+    connect(m_imageCapture, SIGNAL(imageCaptured(int, const QImage&)), this, SLOT(on_camera_image(int, const QImage&)));
+    m_camera->start();
+
+    QSize camSize = m_camera->viewfinderSettings().resolution();
+    // Captured stills can come back at any supported size, so size the pool
+    // for the largest one.
+    for (const QSize &size : m_camera->supportedViewfinderResolutions()) {
+        if (size.width() * size.height() > camSize.width() * camSize.height())
+            camSize = size;
+    }
+    if (camSize.isEmpty())
+        camSize = QSize(1920, 1080);
+    setVideoFormat(camSize);
+
+    // QCameraImageCapture has to be driven from the GUI thread.
+    connect(m_pacer, SIGNAL(tick(qint64, qint64)), this, SLOT(on_camera_tick(qint64, qint64)), Qt::QueuedConnection);
+    return true;
+}
+
+bool NdiStream::openV4l2Camera(const QString &device)
+{
+#ifdef Q_OS_LINUX
+    // Scaling YUV is left to the driver: ask it for the output size of its
+    // largest frames directly.
+    QSize source = V4l2Camera::largestSize(device);
+    if (source.isEmpty())
+        source = QSize(1920, 1080);
+    m_v4l2 = new V4l2Camera(this);
+    if (!m_v4l2->open(device, outputSize(source), m_config.frameRate)) {
+        delete m_v4l2;
+        m_v4l2 = NULL;
+        return false;
+    }
+
+    // Cameras deliver YUV already; other formats would only add a conversion.
+    if (m_config.format != VideoUYVY)
+        qDebug() << m_config.ndiName << "- sending" << device << "as UYVY";
+    m_videoFrame.xres = m_v4l2->size().width();
+    m_videoFrame.yres = m_v4l2->size().height();
+    m_videoFrame.FourCC = NDIlib_FourCC_video_type_UYVY;
+    // UYVY driver buffers go to NDI as they are and need no pool.
+    if (m_v4l2->format() != V4l2Camera::UYVY)
+        m_videoBufferSize = videoFrameSize(VideoUYVY, m_videoFrame.xres, m_videoFrame.yres);
+
+    // Frames are converted and queued at sensor rate, on the stage workers so
+    // the camera thread can dequeue the next one meanwhile, or on the camera
+    // thread without a scheduler.
+    connect(m_v4l2, SIGNAL(frameReady(int, qint64)), this, SLOT(on_v4l2_frame(int, qint64)), Qt::DirectConnection);
+    connect(m_v4l2, SIGNAL(frameBroken()), this, SLOT(on_v4l2_broken()), Qt::DirectConnection);
+    return true;
+#else
+    Q_UNUSED(device)
+    return false;
+#endif
+}
+
+static QAudioDeviceInfo findAudioInput(const QString &name)
+{
+    QMutexLocker lock(DeviceCatalog::enumerationLock());
+    if (name == "default")
+        return QAudioDeviceInfo::defaultInputDevice();
+    for (const QAudioDeviceInfo &input : QAudioDeviceInfo::availableDevices(QAudio::AudioInput)) {
+        if (input.deviceName() == name)
+            return input;
+    }
+    return QAudioDeviceInfo();
+}
+
+bool NdiStream::openAudio()
+{
+    m_audioBufferSize = 0;
+    if (m_config.audioInputs.isEmpty())
+        return true;
+    if (m_replay && m_replay->hasAudio()) {
+        qDebug() << m_config.ndiName << "- replaying the recorded audio instead of the audio inputs";
+        return true;
+    }
+
+    // Whatever the devices settle on is mixed and sent at the configured
+    // rate and channel count.
+    m_audioFrame.sample_rate = m_config.audioRate;
+    m_audioFrame.no_channels = m_config.audioChannels;
+    m_audioFrame.no_samples = m_config.audioRate / AudioBlocksPerSecond;
+    m_audioFrame.channel_stride_in_bytes = m_audioFrame.no_samples * sizeof(float);
+    m_mixer.reset(m_config.audioRate, m_config.audioChannels, m_audioFrame.no_samples);
+
+    for (const AudioInput &input : m_config.audioInputs) {
+        const QAudioDeviceInfo device = findAudioInput(input.device);
+        if (device.isNull()) {
+            qWarning() << m_config.ndiName << "- no audio input" << input.device;
+            return false;
+        }
+
+        AudioInfo *audio = new AudioInfo(device, m_config.audioRate, m_config.audioChannels,
+                                         m_config.audioBufferMs, m_config.audioPeriodMs);
+        const QAudioFormat &format = audio->format();
+        const float gain = float(std::pow(10.0, input.gainDb / 20));
+        if (!audio->isSupported() || !m_mixer.addInput(&audio->ring(), format.sampleRate(), gain)) {
+            // The others are still sent without it.
+            qWarning() << m_config.ndiName << "- cannot send audio from" << input.device << "captured as"
+                       << format.sampleRate() << "Hz" << sampleFormatName(audio->sampleFormat());
+            delete audio;
+            continue;
+        }
+        const AudioResampler &resampler = m_mixer.resampler(m_mixer.inputCount() - 1);
+        if (!resampler.isPassthrough() || format.channelCount() != m_config.audioChannels
+                || audio->sampleFormat() != SampleFloat) {
+            qDebug() << m_config.ndiName << "- converting" << format.sampleRate() << "Hz" << format.channelCount()
+                     << "channel" << sampleFormatName(audio->sampleFormat()) << "audio from" << input.device << "to"
+                     << m_config.audioRate << "Hz" << m_config.audioChannels << "channel float,"
+                     << resampler.filterDelayMs() << "ms filter delay";
+        }
+        m_audioInputs.push_back(audio);
+        connect(audio, SIGNAL(dataAvailable()), this, SLOT(on_audio()), Qt::DirectConnection);
+    }
+    if (m_audioInputs.isEmpty())
+        return true;
+    m_audioBufferSize = m_audioFrame.channel_stride_in_bytes * m_audioFrame.no_channels;
+    return true;
+}
+
+void NdiStream::start(FramePool *videoPool, FramePool *audioPool)
+{
+    Q_ASSERT(m_opened && !m_running);
+
+    m_idle = false;
+    m_videoStats.idle = false;
+    m_audioStats.idle = false;
+    m_idleEnabled = m_config.idleWithoutReceivers;
+    m_running = true;
+
+    if (!m_config.recordPath.isEmpty()) {
+        // Room for a few of the largest frames this stream sends: converted
+        // ones fill a pool buffer, others are at most four bytes a pixel.
+        const qint64 frameBytes = m_videoBufferSize ? m_videoBufferSize : qint64(m_videoFrame.xres) * m_videoFrame.yres * 4;
+        m_recorder = new StreamRecorder(this);
+        if (!m_recorder->Start(m_config.recordPath, StreamRecorder::ringBytesFor(frameBytes))) {
+            delete m_recorder;
+            m_recorder = NULL;
+        }
+    }
+    m_videoSender->SetRecorder(m_recorder);
+    m_audioSender->SetRecorder(m_recorder);
+
+    startAudio(audioPool);
+    startVideo(videoPool);
+}
+
+void NdiStream::startVideo(FramePool *pool)
+{
+    Q_ASSERT(!m_videoBufferSize || (pool && pool->bufferSize() >= m_videoBufferSize));
+
+    m_videoPool = pool;
+    m_governor.reset(m_config);
+    m_videoStats.qualityLevel = 0;
+    if (m_replay) {
+        startReplay();
+        return;
+    }
+    if (!hasVideo())
+        return;
+
+    m_videoFrame.frame_rate_N = m_config.frameRate.num;
+    m_videoFrame.frame_rate_D = m_config.frameRate.den;
+    m_videoSender->Start();
+#ifdef Q_OS_LINUX
+    if (m_v4l2) {
+        m_videoFrame.frame_rate_N = m_v4l2->rate().num;
+        m_videoFrame.frame_rate_D = m_v4l2->rate().den;
+        m_v4l2->Start();
+        return;
+    }
+#endif
+    m_pacer->Start(m_config.frameRate);
+}
+
+void NdiStream::startAudio(FramePool *pool)
+{
+    Q_ASSERT(!m_audioBufferSize || (pool && pool->bufferSize() >= m_audioBufferSize));
+
+    m_audioPool = pool;
+    if (!m_audioInputs.isEmpty()) {
+        m_audioSender->Start();
+        for (AudioInfo *audio : m_audioInputs)
+            audio->Start();
+    }
+}
+
+// A replay drives both senders itself, the audio one only if the recording
+// has audio, since that replaces the stream's audio device.
+void NdiStream::startReplay()
+{
+    // Fast replay is a load test: senders hold the replay back instead of
+    // dropping what it sends.
+    const bool fast = m_config.replayPacing == StreamConfig::FastPace;
+    m_videoSender->SetQueue(VideoQueueDepth, fast ? SenderThread::Block : SenderThread::DropOldest);
+    if (m_replay->hasVideo())
+        m_videoSender->Start();
+    if (m_replay->hasAudio()) {
+        m_audioSender->SetQueue(AudioQueueDepth, fast ? SenderThread::Block : SenderThread::DropNewest);
+        m_audioSender->Start();
+    }
+    m_replay->Start(fast ? ReplaySource::FastPacing : ReplaySource::RecordedPacing, m_config.replayLoop);
+}
+
+void NdiStream::stop()
+{
+    if (!m_opened)
+        return;
+
+    closeVideo();
+    closeAudio();
+
+    // Only once both senders are stopped and have nothing left to record.
+    if (m_recorder) {
+        m_recorder->Stop();
+        delete m_recorder;
+        m_recorder = NULL;
+    }
+    m_videoSender->SetRecorder(NULL);
+    m_audioSender->SetRecorder(NULL);
+    m_opened = false;
+    m_running = false;
+}
+
+// Stops the producer first so nothing is pushed to a stopped sender, then
+// the sender, then releases the device.
+void NdiStream::closeVideo()
+{
+    m_pacer->Stop();
+    disconnect(m_pacer, 0, this, 0);
+#ifdef Q_OS_LINUX
+    if (m_v4l2)
+        m_v4l2->Stop();
+#endif
+    if (m_captureStrand)
+        m_captureStrand->drain();
+    if (m_replay)
+        m_replay->Stop();
+    if (m_running)
+        m_videoSender->Stop();
+    if (m_replay && m_replay->hasAudio() && m_running)
+        m_audioSender->Stop();
+
+    const FramePacer::Stats pacing = m_pacer->GetStats();
+    if (m_running && pacing.ticks > 0)
+        qDebug() << m_config.ndiName << "pacing:" << pacing.ticks << "ticks," << pacing.missed << "missed, jitter mean"
+                 << pacing.jitterMeanUs << "us, max" << pacing.jitterMaxUs << "us";
+
+    if (m_screenCapture && m_damage.tilesTotal() > 0)
+        qDebug() << m_config.ndiName << "video:" << qRound(m_damage.dirtyFraction() * 100) << "% of tiles dirty,"
+                 << m_skipped << "unchanged frames skipped";
+    delete m_screenCapture;
+    m_screenCapture = NULL;
+
+    if (m_camera) {
+        m_camera->stop();
+        m_camera->unload();
+    }
+    if (m_imageCapture) {
+        m_imageCapture->cancelCapture();
+        delete m_imageCapture;
+    }
+    m_imageCapture = NULL;
+    delete m_camera;
+    m_camera = NULL;
+
+#ifdef Q_OS_LINUX
+    // Only now that the video sender has requeued every driver buffer.
+    delete m_v4l2;
+    m_v4l2 = NULL;
+#endif
+
+    // Likewise the replay's mapped frames.
+    if (m_replay) {
+        if (m_replay->hasAudio())
+            m_audioSender->SetQueue(AudioQueueDepth, SenderThread::DropNewest);
+        m_videoSender->SetQueue(VideoQueueDepth, SenderThread::DropOldest);
+        delete m_replay;
+        m_replay = NULL;
+    }
+
+    // The sender has flushed NDI and returned every buffer by now.
+    m_videoPool = NULL;
+    m_videoBufferSize = 0;
+    m_preview.clear();
+}
+
+void NdiStream::closeAudio()
+{
+    // Without a device the audio sender is either idle or the replay's.
+    if (!m_audioInputs.isEmpty()) {
+        for (AudioInfo *audio : m_audioInputs)
+            audio->Stop();
+        if (m_running)
+            m_audioSender->Stop();
+        if (m_mixer.realignments() || m_mixer.underruns())
+            qDebug() << m_config.ndiName << "- audio inputs realigned" << m_mixer.realignments() << "times,"
+                     << m_mixer.underruns() << "blocks mixed without a stalled input";
+    }
+
+    qDeleteAll(m_audioInputs);
+    m_audioInputs.clear();
+    m_mixer.reset(m_config.audioRate, m_config.audioChannels, m_config.audioRate / AudioBlocksPerSecond);
+    m_audioPool = NULL;
+    m_audioBufferSize = 0;
+}
+
+int NdiStream::configChanges(const StreamConfig &from, const StreamConfig &to)
+{
+    int changes = NoChange;
+    // A recording spans both senders, so starting or stopping one restarts
+    // the stream.
+    if (from.ndiName != to.ndiName || from.recordPath != to.recordPath)
+        changes |= SenderChange;
+    if (from.video != to.video || from.videoDevice != to.videoDevice || from.region != to.region
+            || from.replayPacing != to.replayPacing || from.replayLoop != to.replayLoop)
+        changes |= VideoChange;
+    if (qint64(from.frameRate.num) * to.frameRate.den != qint64(to.frameRate.num) * from.frameRate.den)
+        changes |= RateChange;
+    if (from.format != to.format || from.matrix != to.matrix || from.range != to.range
+            || from.outputSize != to.outputSize || from.scaleFilter != to.scaleFilter
+            || from.unchangedPolicy != to.unchangedPolicy || from.latencyBudgetMs != to.latencyBudgetMs
+            || from.idleWithoutReceivers != to.idleWithoutReceivers)
+        changes |= ProcessingChange;
+    if (from.audioInputs != to.audioInputs || from.audioRate != to.audioRate || from.audioChannels != to.audioChannels
+            || from.audioBufferMs != to.audioBufferMs || from.audioPeriodMs != to.audioPeriodMs)
+        changes |= AudioChange;
+    return changes;
+}
+
+QString NdiStream::describeChanges(int changes)
+{
+    QStringList parts;
+    if (changes & SenderChange)
+        parts << "sender";
+    if (changes & VideoChange)
+        parts << "video source";
+    if (changes & RateChange)
+        parts << "frame rate";
+    if (changes & ProcessingChange)
+        parts << "processing";
+    if (changes & AudioChange)
+        parts << "audio source";
+    return parts.isEmpty() ? QString("nothing") : parts.join(", ");
+}
+
+void NdiStream::reconfigure(const StreamConfig &config, int changes)
+{
+    Q_ASSERT(m_running && !(changes & SenderChange));
+
+    // V4L2 applies rate and size in the driver and a replay sends frames as
+    // recorded, so any video change reopens either.
+    const bool reopenVideo = (changes & VideoChange)
+            || ((m_v4l2 || m_replay) && (changes & (RateChange | ProcessingChange)));
+    const bool pauseVideo = !reopenVideo && (changes & (RateChange | ProcessingChange));
+    if (reopenVideo) {
+        closeVideo();
+    } else if (pauseVideo) {
+        m_pacer->Stop();
+        if (m_captureStrand)
+            m_captureStrand->drain();
+    }
+    if (changes & AudioChange)
+        closeAudio();
+
+    // Audio that keeps running may be logging the name; sharing the string it
+    // already holds keeps that read safe.
+    StreamConfig next = config;
+    next.ndiName = m_config.ndiName;
+    m_config = next;
+    m_idleEnabled = m_config.idleWithoutReceivers;
+
+    if (reopenVideo && !openVideo()) {
+        qWarning() << m_config.ndiName << "- video source unavailable after reconfiguration";
+        closeVideo();
+    } else if (pauseVideo && hasVideo()) {
+        sizeVideoBuffers();
+    }
+    if ((changes & AudioChange) && !openAudio()) {
+        qWarning() << m_config.ndiName << "- audio source unavailable after reconfiguration";
+        closeAudio();
+    }
+    m_pendingChanges = changes;
+    m_pendingReopen = reopenVideo;
+}
+
+void NdiStream::resume(FramePool *videoPool, FramePool *audioPool)
+{
+    Q_ASSERT(m_running);
+
+    if (m_pendingChanges & AudioChange)
+        startAudio(audioPool);
+    if (m_pendingReopen) {
+        startVideo(videoPool);
+    } else if (m_pendingChanges & (RateChange | ProcessingChange)) {
+        Q_ASSERT(!m_videoBufferSize || (videoPool && videoPool->bufferSize() >= m_videoBufferSize));
+        // The sender keeps running and returns earlier buffers to whichever
+        // pool they came from.
+        m_videoPool = videoPool;
+        m_governor.reset(m_config);
+        m_videoStats.qualityLevel = 0;
+        if (hasVideo())
+            m_pacer->Start(m_config.frameRate);
+    }
+    m_pendingChanges = NoChange;
+    m_pendingReopen = false;
+}
+
+// Asks NDI for the receiver count on every frame or audio block; with no
+// wait that is only a counter read, and it lets a stream resume on the very
+// next tick after a receiver connects.
+bool NdiStream::checkIdle()
+{
+    const bool idle = m_idleEnabled && NDIlib_send_get_no_connections(m_instance, 0) <= 0;
+    // The stats reporter tells of the change.
+    if (m_idle.exchange(idle) != idle) {
+        m_videoStats.idle.store(idle, std::memory_order_relaxed);
+        m_audioStats.idle.store(idle, std::memory_order_relaxed);
+    }
+    return idle;
+}
+
+bool NdiStream::makeVideoFrame(FrameBuffer *buffer, const CaptureFrame &frame, const DamageTracker *damage)
+{
+    const uint8_t *src = frame.data;
+    const int srcStride = frame.stride;
+    const QSize source(frame.width, frame.height);
+    const QualityGovernor::Level &quality = m_governor.level();
+    const VideoFormat format = quality.format;
+    QSize output = outputSize(source);
+    if (quality.sizePercent < 100) {
+        output = QSize(qMax(2, (output.width() * quality.sizePercent / 100) & ~1),
+                       qMax(2, (output.height() * quality.sizePercent / 100) & ~1));
+    }
+    const bool scaled = output != source;
+    if (scaled) {
+        if (m_scaler.sourceSize() != source || m_scaler.filter() != m_config.scaleFilter
+                || m_scaler.size() != output) {
+            m_scaler.reset(source, output, m_config.scaleFilter);
+        }
+        output = m_scaler.size();
+        // Damage is tracked in source tiles, which do not map onto whole
+        // output tiles, so scaled frames are always converted in full.
+        damage = NULL;
+    }
+
+    const int width = output.width();
+    const int height = output.height();
+    const int stride = videoLineStride(format, width);
+    const int size = videoFrameSize(format, width, height);
+    if (size > buffer->capacity)
+        return false;
+    // The matrix follows the height, so a governed size can change it too.
+    if (format != m_convertFormat || height != m_convertHeight)
+        selectConverter(format, height);
+
+    // Whatever a buffer held for another stream or at another geometry is of
+    // no use.
+    if (buffer->owner != this || buffer->xres != width || buffer->yres != height || buffer->stride != stride
+            || buffer->fourCC != int(videoFourCC(format))) {
+        buffer->generation = 0;
+    }
+
+    buffer->owner = this;
+    buffer->xres = width;
+    buffer->yres = height;
+    buffer->stride = stride;
+    buffer->len = size;
+    buffer->fourCC = videoFourCC(format);
+    buffer->frameRateN = m_config.frameRate.num;
+    buffer->frameRateD = m_config.frameRate.den * quality.rateDivisor;
+    uint8_t *dst = buffer->data;
+
+    if (scaled) {
+        m_stripePool->run(height, [&](int y0, int y1) {
+            m_scaler.scaleConvert(src, srcStride, dst, m_convert, y0, y1);
+        });
+        buffer->generation = 0;
+        return true;
+    }
+
+    auto convert = [&](int x, int y, int w, int h) {
+        m_convert(src + y * srcStride + x * 4, srcStride, dst, width, height, x, y, w, h);
+    };
+
+    if (!damage || buffer->generation == 0) {
+        m_stripePool->run(height, [&](int y0, int y1) {
+            convert(0, y0, width, y1 - y0);
+        });
+    } else if (buffer->generation != damage->generation()) {
+        // Only tiles that changed since this buffer was last filled.
+        const uint64_t since = buffer->generation;
+        const int tile = DamageTracker::TileSize;
+        const int tilesX = damage->tilesX();
+        m_stripePool->run(damage->tilesY(), [&](int ty0, int ty1) {
+            for (int ty = ty0; ty < ty1; ++ty) {
+                const int y = ty * tile;
+                const int h = qMin(tile, height - y);
+                int tx = 0;
+                while (tx < tilesX) {
+                    if (!damage->tileChangedSince(tx, ty, since)) {
+                        ++tx;
+                        continue;
+                    }
+                    int end = tx + 1;
+                    while (end < tilesX && damage->tileChangedSince(end, ty, since))
+                        ++end;
+                    convert(tx * tile, y, qMin(end * tile, width) - tx * tile, h);
+                    tx = end;
+                }
+            }
+        }, 1);
+    }
+
+    buffer->generation = damage ? damage->generation() : 0;
+    return true;
+}
+
+// The pacer only keeps time. A tick that finds the previous one still
+// waiting for a worker is dropped rather than queued behind it.
+void NdiStream::on_pacer_tick(qint64 frameIndex, qint64 timecode)
+{
+    if (!m_captureStrand->post(&NdiStream::screenTickTask, this, frameIndex, timecode))
+        m_videoStats.captureDrops.fetch_add(1, std::memory_order_relaxed);
+}
+
+void NdiStream::screenTickTask(void *ctx, qint64 frameIndex, qint64 timecode)
+{
+    static_cast<NdiStream *>(ctx)->on_screen_tick(frameIndex, timecode);
+}
+
+void NdiStream::on_screen_tick(qint64 frameIndex, qint64 timecode)
+{
+    // Nothing is grabbed while idle, and the first frame after is sent even
+    // if unchanged, since the new receiver has never seen it.
+    if (checkIdle()) {
+        m_videoStats.idleSkips.fetch_add(1, std::memory_order_relaxed);
+        m_lastSent.invalidate();
+        return;
+    }
+    // A new level changes what is sent, so an unchanged screen is sent too.
+    if (m_governor.update(m_videoStats, pipelineClockNs()))
+        m_lastSent.invalidate();
+    if (frameIndex % m_governor.level().rateDivisor)
+        return;
+
+    const int64_t captured = pipelineClockNs();
+    CaptureFrame frame;
+    if (!m_screenCapture || !m_screenCapture->grab(frame))
+        return;
+    // Windows and regions can have odd sizes, which 4:2:x cannot carry.
+    frame.width &= ~1;
+    frame.height &= ~1;
+    if (frame.width == 0 || frame.height == 0)
+        return;
+
+    const bool tracked = frame.width <= DamageTracker::MaxTilesX * DamageTracker::TileSize;
+    const int dirty = tracked ? m_damage.update(frame.data, frame.stride, frame.width, frame.height, m_stripePool) : -1;
+
+    if (dirty == 0 && m_config.unchangedPolicy == SkipUnchanged
+            && m_lastSent.isValid() && m_lastSent.elapsed() < UnchangedKeepAliveMs) {
+        ++m_skipped;
+        return;
+    }
+
+    // No free buffer means NDI is still holding the previous frames.
+    FrameBuffer *buffer = m_videoPool->acquire(this, VideoBufferCount);
+    if (!buffer) {
+        m_videoStats.captureDrops.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (makeVideoFrame(buffer, frame, tracked ? &m_damage : NULL)) {
+        m_videoStats.convert.record(pipelineClockNs() - captured);
+        buffer->captureNs = captured;
+        buffer->timecode = timecode;
+        m_videoSender->Push(buffer);
+        m_lastSent.start();
+    } else {
+        m_videoPool->release(buffer);
+    }
+}
+
+void NdiStream::on_camera_tick(qint64 frameIndex, qint64 timecode)
+{
+    Q_UNUSED(timecode)
+
+    // The camera keeps streaming its viewfinder; only stills are skipped.
+    if (checkIdle()) {
+        m_videoStats.idleSkips.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_governor.update(m_videoStats, pipelineClockNs());
+    if (frameIndex % m_governor.level().rateDivisor)
+        return;
+
+    if (m_imageCapture && m_imageCapture->isReadyForCapture()) {
+        m_imageCapture->capture();
+    }
+}
+
+void NdiStream::on_camera_image(int id, const QImage& img)
+{
+    Q_UNUSED(id)
+
+    if (!m_running)
+        return;
+
+    const int64_t captured = pipelineClockNs();
+    FrameBuffer *buffer = m_videoPool->acquire(this, VideoBufferCount);
+    if (!buffer) {
+        m_videoStats.captureDrops.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    QImage rgb = img;
+    if (rgb.format() != QImage::Format_RGB32 && rgb.format() != QImage::Format_ARGB32)
+        rgb = rgb.convertToFormat(QImage::Format_RGB32);
+
+    CaptureFrame frame;
+    frame.data = rgb.constBits();
+    frame.stride = rgb.bytesPerLine();
+    frame.width = rgb.width();
+    frame.height = rgb.height();
+    if (makeVideoFrame(buffer, frame, NULL)) {
+        m_videoStats.convert.record(pipelineClockNs() - captured);
+        buffer->captureNs = captured;
+        buffer->timecode = NDIlib_send_timecode_synthesize;
+        m_videoSender->Push(buffer);
+    } else {
+        m_videoPool->release(buffer);
+    }
+}
+
+void NdiStream::on_v4l2_frame(int index, qint64 captureNs)
+{
+#ifdef Q_OS_LINUX
+    if (!m_captureStrand) {
+        convertV4l2Frame(index, captureNs);
+    } else if (!m_captureStrand->post(&NdiStream::v4l2FrameTask, this, index, captureNs)) {
+        m_v4l2->requeue(index);
+        m_videoStats.captureDrops.fetch_add(1, std::memory_order_relaxed);
+    }
+#else
+    Q_UNUSED(index)
+    Q_UNUSED(captureNs)
+#endif
+}
+
+// The camera already gave the buffer back.
+void NdiStream::on_v4l2_broken()
+{
+    m_videoStats.captureDrops.fetch_add(1, std::memory_order_relaxed);
+}
+
+void NdiStream::v4l2FrameTask(void *ctx, qint64 index, qint64 captureNs)
+{
+    static_cast<NdiStream *>(ctx)->convertV4l2Frame(int(index), captureNs);
+}
+
+void NdiStream::convertV4l2Frame(int index, qint64 captureNs)
+{
+#ifdef Q_OS_LINUX
+    // Keep the device streaming so resuming costs nothing, but hand the
+    // buffer straight back.
+    if (checkIdle()) {
+        m_v4l2->requeue(index);
+        m_videoStats.idleSkips.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    FrameBuffer *frame = m_v4l2->driverBuffer(index);
+    const V4l2Camera::PixelFormat format = m_v4l2->format();
+    const int64_t converting = pipelineClockNs();
+
+    if (format == V4l2Camera::UYVY) {
+        frame->captureNs = captureNs;
+        frame->timecode = NDIlib_send_timecode_synthesize;
+        m_videoStats.convert.record(pipelineClockNs() - converting);
+        m_videoSender->Push(frame);
+        return;
+    }
+
+    FrameBuffer *buffer = m_videoPool->acquire(this, VideoBufferCount);
+    if (!buffer) {
+        m_v4l2->requeue(index);
+        m_videoStats.captureDrops.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const int width = frame->xres;
+    const int height = frame->yres;
+    const int srcStride = frame->stride;
+    const int stride = videoLineStride(VideoUYVY, width);
+    const uint8_t *src = frame->data;
+    uint8_t *dst = buffer->data;
+    if (format == V4l2Camera::YUYV) {
+        m_stripePool->run(height, [&](int y0, int y1) {
+            convertYUYVToUYVY(src + y0 * srcStride, srcStride, dst + y0 * stride, stride, width, y1 - y0);
+        });
+    } else {
+        // Single-plane NV12: the interleaved chroma plane follows the luma.
+        const uint8_t *uv = src + srcStride * height;
+        m_stripePool->run(height, [&](int y0, int y1) {
+            convertNV12ToUYVY(src + y0 * srcStride, srcStride, uv + (y0 / 2) * srcStride, srcStride,
+                              dst + y0 * stride, stride, width, y1 - y0);
+        });
+    }
+    m_v4l2->requeue(index);
+    m_videoStats.convert.record(pipelineClockNs() - converting);
+
+    buffer->owner = this;
+    buffer->generation = 0;
+    buffer->xres = width;
+    buffer->yres = height;
+    buffer->stride = stride;
+    buffer->len = stride * height;
+    // Pools are shared, so clear what another stream's governor may have set.
+    buffer->fourCC = 0;
+    buffer->frameRateN = 0;
+    buffer->captureNs = captureNs;
+    buffer->timecode = NDIlib_send_timecode_synthesize;
+    m_videoSender->Push(buffer);
+#else
+    Q_UNUSED(index)
+    Q_UNUSED(captureNs)
+#endif
+}
+
+void NdiStream::on_replay_frame(FrameBuffer *frame, bool video, qint64 captureNs)
+{
+    StreamStats &stats = video ? m_videoStats : m_audioStats;
+    if (checkIdle()) {
+        frame->pool->release(frame);
+        stats.idleSkips.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Measured from the scheduled send, so glass-to-wire is the queue and
+    // send time the replay adds.
+    frame->captureNs = captureNs;
+    if (video)
+        m_videoSender->Push(frame);
+    else
+        m_audioSender->Push(frame);
+}
+
+void NdiStream::on_audio()
+{
+    // Every input signals; whichever gets the mixer mixes for all of them.
+    // One that finds it busy only leaves a note, and the holder looks again
+    // after unlocking, so a block completed meanwhile goes out now rather
+    // than at the next signal.
+    m_mixPending.store(true);
+    while (m_mixPending.load() && m_mixMutex.tryLock()) {
+        m_mixPending.store(false);
+        mixAudio();
+        m_mixMutex.unlock();
+        // Orders the unlock before the load, so a signal whose tryLock
+        // failed is seen here.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+// With m_mixMutex held.
+void NdiStream::mixAudio()
+{
+    const int blockSamples = m_audioFrame.no_samples;
+    const int channelStride = blockSamples * sizeof(float);
+    int64_t captureNs;
+
+    // Drain whole blocks unmixed so the rings cannot overrun while idle.
+    // Skipped input leaves a gap in the filter history, which is only heard
+    // as the same click the gap itself makes.
+    if (checkIdle()) {
+        while (m_mixer.mix(NULL, blockSamples, &captureNs))
+            m_audioStats.idleSkips.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    while (m_mixer.isReady()) {
+        FrameBuffer* buffer = m_audioPool->acquire(this, AudioBufferCount);
+        if (!buffer) {
+            // The sender is behind; drop the block rather than let the
+            // rings fill up and overrun mid-block.
+            m_mixer.mix(NULL, blockSamples, &captureNs);
+            m_audioStats.captureDrops.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // Like video, convert runs from capture: the wait for the device to
+        // be read and for the block to fill is most of what audio lags by.
+        m_mixer.mix((float*)buffer->data, blockSamples, &captureNs);
+        m_audioStats.convert.record(pipelineClockNs() - captureNs);
+        buffer->captureNs = captureNs;
+        buffer->owner = this;
+        buffer->generation = 0;
+        buffer->len = channelStride * m_mixer.channels();
+        buffer->stride = channelStride;
+        buffer->timecode = NDIlib_send_timecode_synthesize;
+        m_audioSender->Push(buffer);
+    }
+}
@@ -0,0 +1,191 @@
+#ifndef NDISTREAM_H
+#define NDISTREAM_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <Processing.NDI.Lib.h>
+#include <atomic>
+
+#include "audiomixer.h"
+#include "capturesource.h"
+#include "colorconvert.h"
+#include "damagetracker.h"
+#include "framepool.h"
+#include "framescaler.h"
+#include "pipelinestats.h"
+#include "qualitygovernor.h"
+#include "stagescheduler.h"
+#include "streamconfig.h"
+#include "streampreview.h"
+
+class AudioInfo;
+class FramePacer;
+class QCamera;
+class QCameraImageCapture;
+class ReplaySource;
+class SenderThread;
+class StreamRecorder;
+class StripePool;
+class V4l2Camera;
+
+// One NDI source: captures, converts and sends the video and audio its
+// StreamConfig describes. Conversion workers, buffer pools and the stage
+// scheduler belong to the StreamEngine so any number of streams can share
+// them. With a scheduler, screen and V4L2 frames are captured and converted
+// on its workers and the senders run there too; without one each stage has
+// a thread of its own.
+class NdiStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    // The most buffers one stream can have checked out at once: a full
+    // queue, one being filled, one being sent and, for async video, the one
+    // NDI still holds.
+    static const int VideoBufferCount;
+    static const int AudioBufferCount;
+
+    NdiStream(const StreamConfig &config, StripePool *stripePool, StageScheduler *scheduler = nullptr,
+              QObject *parent = nullptr);
+    ~NdiStream();
+
+    // What differs between two configurations, as flags.
+    enum ConfigChange {
+        NoChange = 0,
+        ProcessingChange = 1,   // format, size, matrix and other conversion settings
+        RateChange = 2,         // frame rate: retimes the pacing clock
+        VideoChange = 4,        // video source: reopens the capture device
+        AudioChange = 8,        // audio inputs, their gains or the sent format
+        SenderChange = 16       // NDI name or recording: a full restart
+    };
+    static int configChanges(const StreamConfig &from, const StreamConfig &to);
+    static QString describeChanges(int changes);
+
+    const StreamConfig &config() const { return m_config; }
+    // Only while stopped. A new ndiName recreates the NDI sender.
+    void setConfig(const StreamConfig &config);
+
+    NDIlib_send_instance_t instance() const { return m_instance; }
+    StreamStats &videoStats() { return m_videoStats; }
+    StreamStats &audioStats() { return m_audioStats; }
+    // Thumbnails of the video as sent, once enabled.
+    StreamPreview &preview() { return m_preview; }
+
+    // Starting takes two steps so the engine can size shared pools: open()
+    // acquires the devices and fixes the buffer sizes (0 for a stream without
+    // video or audio, or one sending driver buffers as they are), start()
+    // streams into pools of at least those sizes.
+    bool open();
+    bool hasVideo() const;
+    bool hasAudio() const;
+    int videoBufferSize() const { return m_videoBufferSize; }
+    int audioBufferSize() const { return m_audioBufferSize; }
+    void start(FramePool *videoPool, FramePool *audioPool);
+    // Also closes an opened stream that was never started.
+    void stop();
+
+    // Live changes short of SenderChange, again in two steps: reconfigure()
+    // stops and reopens only the parts that changed and sizes their buffers,
+    // resume() restarts them with pools of at least those sizes. Anything
+    // unchanged, such as the audio of a stream whose frame rate changes,
+    // keeps running throughout.
+    void reconfigure(const StreamConfig &config, int changes);
+    void resume(FramePool *videoPool, FramePool *audioPool);
+    FramePool *videoPool() const { return m_videoPool; }
+    FramePool *audioPool() const { return m_audioPool; }
+
+    bool isRunning() const { return m_running; }
+    // True while the stream is suspended for lack of receivers.
+    bool isIdle() const { return m_idle; }
+
+private slots:
+    void on_pacer_tick(qint64 frameIndex, qint64 timecode);
+    void on_screen_tick(qint64 frameIndex, qint64 timecode);
+    void on_camera_tick(qint64 frameIndex, qint64 timecode);
+    void on_camera_image(int id, const QImage&);
+    void on_v4l2_frame(int index, qint64 captureNs);
+    void on_v4l2_broken();
+    void on_replay_frame(FrameBuffer *frame, bool video, qint64 captureNs);
+    void on_audio();
+
+private:
+    void createSender();
+    bool openVideo();
+    bool openScreen();
+    bool openWindow();
+    bool openCamera();
+    bool openV4l2Camera(const QString &device);
+    bool openTestPattern();
+    bool openReplay();
+    bool openCaptureSource(const QSize &size);
+    void setVideoFormat(const QSize &source);
+    void sizeVideoBuffers();
+    QSize outputSize(const QSize &source) const;
+    void selectConverter(VideoFormat format, int height);
+    bool openAudio();
+    void startVideo(FramePool *pool);
+    void startAudio(FramePool *pool);
+    void startReplay();
+    void closeVideo();
+    void closeAudio();
+    bool checkIdle();
+    void convertV4l2Frame(int index, qint64 captureNs);
+    void mixAudio();
+    static void screenTickTask(void *ctx, qint64 frameIndex, qint64 timecode);
+    static void v4l2FrameTask(void *ctx, qint64 index, qint64 captureNs);
+    bool makeVideoFrame(FrameBuffer* buffer, const CaptureFrame& frame, const DamageTracker* damage);
+
+    StreamConfig m_config;
+    StripePool* m_stripePool;
+
+    NDIlib_send_instance_t m_instance;
+    NDIlib_video_frame_v2_t m_videoFrame;
+    NDIlib_audio_frame_v2_t m_audioFrame;
+
+    FramePacer* m_pacer;
+    StageScheduler::Strand* m_captureStrand;
+    SenderThread* m_videoSender;
+    SenderThread* m_audioSender;
+
+    FramePool* m_videoPool;
+    FramePool* m_audioPool;
+    int m_videoBufferSize;
+    int m_audioBufferSize;
+    ConvertRGB32Fn m_convert;
+    VideoFormat m_convertFormat;
+    int m_convertHeight;
+    QSize m_sourceSize;
+    FrameScaler m_scaler;
+    QualityGovernor m_governor;
+
+    CaptureSource* m_screenCapture;
+    QCamera* m_camera;
+    QCameraImageCapture* m_imageCapture;
+    V4l2Camera* m_v4l2;
+    ReplaySource* m_replay;
+    QList<AudioInfo*> m_audioInputs;
+    AudioMixer m_mixer;
+    QMutex m_mixMutex;          // inputs signal from their own capture threads
+    std::atomic<bool> m_mixPending;
+    StreamRecorder* m_recorder;
+
+    DamageTracker m_damage;
+    QElapsedTimer m_lastSent;
+    quint64 m_skipped;
+
+    StreamStats m_videoStats;
+    StreamStats m_audioStats;
+    StreamPreview m_preview;
+
+    std::atomic<bool> m_idle;
+    std::atomic<bool> m_idleEnabled;
+    int m_pendingChanges;
+    bool m_pendingReopen;
+    bool m_opened;
+    bool m_running;
+};
+
+#endif // NDISTREAM_H
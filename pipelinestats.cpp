@@ -0,0 +1,94 @@
+#include "pipelinestats.h"
+
+#include <QMutexLocker>
+#include <chrono>
+
+int64_t pipelineClockNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (int i = 0; i < BucketCount; ++i)
+        m_counts[i].store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketIndex(int64_t ns)
+{
+    uint64_t v = ns > 0 ? uint64_t(ns) >> MinShift : 0;
+    if (v < SubBuckets)
+        return int(v);
+
+    // Magnitude m holds [SubBuckets << (m - 1), SubBuckets << m).
+    int magnitude = 0;
+    while ((v >> magnitude) >= uint64_t(SubBuckets) * 2)
+        ++magnitude;
+    ++magnitude;
+    if (magnitude >= Magnitudes)
+        return BucketCount - 1;
+
+    const int sub = int(v >> (magnitude - 1)) - SubBuckets;
+    return magnitude * SubBuckets + sub;
+}
+
+int64_t LatencyHistogram::bucketValue(int index)
+{
+    const int magnitude = index / SubBuckets;
+    const int sub = index % SubBuckets;
+    if (magnitude == 0)
+        return int64_t(sub) << MinShift;
+    return int64_t(SubBuckets + sub) << (magnitude - 1 + MinShift);
+}
+
+void LatencyHistogram::record(int64_t ns)
+{
+    m_counts[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot counts(BucketCount);
+    for (int i = 0; i < BucketCount; ++i)
+        counts[i] = m_counts[i].load(std::memory_order_relaxed);
+    return counts;
+}
+
+quint64 LatencyHistogram::total(const Snapshot &counts)
+{
+    quint64 sum = 0;
+    for (quint64 c : counts)
+        sum += c;
+    return sum;
+}
+
+int64_t LatencyHistogram::percentile(const Snapshot &counts, double p)
+{
+    const quint64 sum = total(counts);
+    if (sum == 0)
+        return 0;
+
+    const quint64 rank = quint64(p / 100.0 * (sum - 1)) + 1;
+    quint64 seen = 0;
+    for (int i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank)
+            return bucketValue(i);
+    }
+    return bucketValue(counts.size() - 1);
+}
+
+void StreamStats::addQualityChange(const QualityChange &change)
+{
+    QMutexLocker locker(&m_qualityMutex);
+    m_qualityChanges.push_back(change);
+}
+
+QVector<QualityChange> StreamStats::takeQualityChanges()
+{
+    QMutexLocker locker(&m_qualityMutex);
+    QVector<QualityChange> changes;
+    changes.swap(m_qualityChanges);
+    return changes;
+}
@@ -0,0 +1,92 @@
+#ifndef PIPELINESTATS_H
+#define PIPELINESTATS_H
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <stdint.h>
+
+// Monotonic nanoseconds shared by every stage timestamp.
+int64_t pipelineClockNs();
+
+// Log-linear latency histogram in the spirit of HdrHistogram: each power of
+// two of nanoseconds is split into SubBuckets linear buckets, giving ~3%
+// relative precision from 1 us to over half an hour in a fixed 7 KB.
+// record() is a single relaxed atomic increment, safe from any thread.
+class LatencyHistogram
+{
+public:
+    static const int SubBucketBits = 5;
+    static const int SubBuckets = 1 << SubBucketBits;
+    static const int MinShift = 10;    // values below ~1 us share bucket 0
+    static const int Magnitudes = 27;
+    static const int BucketCount = Magnitudes * SubBuckets;
+
+    LatencyHistogram();
+
+    void record(int64_t ns);
+
+    // Cumulative counts; percentiles over an interval come from the
+    // difference of two snapshots.
+    typedef QVector<quint64> Snapshot;
+    Snapshot snapshot() const;
+    static int64_t percentile(const Snapshot &counts, double p);
+    static quint64 total(const Snapshot &counts);
+
+private:
+    static int bucketIndex(int64_t ns);
+    static int64_t bucketValue(int index);
+
+    std::atomic<quint64> m_counts[BucketCount];
+};
+
+// One QualityGovernor step and the window that decided it.
+struct QualityChange {
+    int64_t timeNs;         // pipelineClockNs() of the decision
+    int from;
+    int to;
+    QString level;          // QualityGovernor::describe() after the step
+    QString trigger;        // "latency", "drops" or "headroom"
+    double value;           // the triggering p95 in ms, or drops in % of frames
+    double limit;           // what value was held against, in the same unit
+    double budgetMs;
+    double convertMs;       // stage p95s over the window
+    double queueMs;
+    double sendMs;
+    quint64 frames;
+    quint64 drops;
+};
+
+// Per-stream counters and stage histograms. The capture side records
+// convert time, the sender records the rest when the frame leaves.
+struct StreamStats {
+    std::atomic<quint64> frames;
+    std::atomic<quint64> bytes;
+    std::atomic<quint64> captureDrops;  // no free buffer when a frame was ready
+    std::atomic<quint64> queueDrops;    // dropped by the sender queue's policy
+    std::atomic<quint64> idleSkips;     // not captured or discarded, no receivers
+    std::atomic<int> queueDepth;
+    std::atomic<int> queueHighWater;
+    std::atomic<int> qualityLevel;      // QualityGovernor step, 0 is as configured
+    std::atomic<bool> idle;             // holding off for want of receivers
+
+    LatencyHistogram convert;       // capture -> converted into a send buffer
+    LatencyHistogram queueWait;     // enqueue -> dequeue
+    LatencyHistogram send;          // dequeue -> NDI send call returned
+    LatencyHistogram glassToWire;   // capture -> NDI send call returned
+
+    StreamStats()
+        : frames(0), bytes(0), captureDrops(0), queueDrops(0), idleSkips(0), queueDepth(0), queueHighWater(0), qualityLevel(0), idle(false) {}
+
+    // Quality changes are queued rather than sampled like the counters, so
+    // the reporter sees every one however close together they come.
+    void addQualityChange(const QualityChange &change);
+    QVector<QualityChange> takeQualityChanges();
+
+private:
+    QMutex m_qualityMutex;
+    QVector<QualityChange> m_qualityChanges;
+};
+
+#endif // PIPELINESTATS_H
@@ -0,0 +1,163 @@
+#include "qualitygovernor.h"
+
+#include "streamconfig.h"
+
+static const int64_t WindowNs = 1000000000;
+// Windows in a row the stream has to be well within budget before a step up.
+static const int UpgradeWindows = 5;
+// Up only once p95 latency is below this fraction of the budget.
+static const double HeadroomFraction = 0.5;
+// Occasional drops are jitter; more than this share of frames is overload.
+static const double MaxDropFraction = 0.02;
+// Halving the frame rate below this is no longer worth it.
+static const double MinReducedFps = 12;
+
+static LatencyHistogram::Snapshot delta(const LatencyHistogram::Snapshot &now, const LatencyHistogram::Snapshot &before)
+{
+    LatencyHistogram::Snapshot d(now);
+    for (int i = 0; i < d.size() && i < before.size(); ++i)
+        d[i] -= before[i];
+    return d;
+}
+
+QualityGovernor::QualityGovernor()
+    : m_budgetNs(0)
+    , m_level(0)
+    , m_calmWindows(0)
+    , m_settleWindows(0)
+    , m_windowStart(0)
+    , m_frames(0)
+    , m_drops(0)
+{
+    m_rate.num = 30;
+    m_rate.den = 1;
+    m_levels.push_back(Level { 1, 100, VideoUYVY });
+}
+
+void QualityGovernor::reset(const StreamConfig &config)
+{
+    m_rate = config.frameRate;
+    m_budgetNs = int64_t(config.latencyBudgetMs) * 1000000;
+    m_level = 0;
+    m_calmWindows = 0;
+    m_settleWindows = 0;
+    m_windowStart = 0;
+
+    Level level = { 1, 100, config.format };
+    m_levels.clear();
+    m_levels.push_back(level);
+
+    if (double(m_rate.num) / m_rate.den / 2 >= MinReducedFps) {
+        level.rateDivisor = 2;
+        m_levels.push_back(level);
+    }
+    // 1080p to 720p, then to 540p.
+    level.sizePercent = 67;
+    m_levels.push_back(level);
+    level.sizePercent = 50;
+    m_levels.push_back(level);
+    // UYVY is the cheapest format to convert to that keeps full 4:2:2 chroma.
+    if (config.format == VideoRGBA || config.format == VideoUYVA || config.format == VideoP216) {
+        level.format = VideoUYVY;
+        m_levels.push_back(level);
+    }
+}
+
+QString QualityGovernor::describe() const
+{
+    const Level &l = level();
+    const double fps = double(m_rate.num) / m_rate.den / l.rateDivisor;
+    return QString("level %1/%2 (%3 fps, %4% size, %5)")
+            .arg(m_level)
+            .arg(m_levels.size() - 1)
+            .arg(fps, 0, 'f', 2)
+            .arg(l.sizePercent)
+            .arg(videoFormatName(l.format));
+}
+
+void QualityGovernor::startWindow(StreamStats &stats, int64_t nowNs)
+{
+    m_windowStart = nowNs;
+    m_frames = stats.frames;
+    m_drops = stats.captureDrops + stats.queueDrops;
+    m_convert = stats.convert.snapshot();
+    m_queueWait = stats.queueWait.snapshot();
+    m_send = stats.send.snapshot();
+    m_glassToWire = stats.glassToWire.snapshot();
+}
+
+bool QualityGovernor::update(StreamStats &stats, int64_t nowNs)
+{
+    if (!isEnabled())
+        return false;
+    if (m_windowStart == 0) {
+        startWindow(stats, nowNs);
+        return false;
+    }
+    if (nowNs - m_windowStart < WindowNs)
+        return false;
+
+    const LatencyHistogram::Snapshot glassToWire = delta(stats.glassToWire.snapshot(), m_glassToWire);
+    const LatencyHistogram::Snapshot convert = delta(stats.convert.snapshot(), m_convert);
+    const LatencyHistogram::Snapshot queueWait = delta(stats.queueWait.snapshot(), m_queueWait);
+    const LatencyHistogram::Snapshot send = delta(stats.send.snapshot(), m_send);
+    const quint64 frames = stats.frames - m_frames;
+    const quint64 drops = stats.captureDrops + stats.queueDrops - m_drops;
+    startWindow(stats, nowNs);
+
+    // The window after a change still holds frames made at the old level.
+    if (m_settleWindows > 0) {
+        --m_settleWindows;
+        return false;
+    }
+    if (LatencyHistogram::total(glassToWire) == 0 && drops == 0)
+        return false;
+
+    const int64_t p95 = LatencyHistogram::percentile(glassToWire, 95);
+    const bool overBudget = p95 > m_budgetNs;
+    const bool dropping = drops > MaxDropFraction * (frames + drops);
+    const bool headroom = p95 < m_budgetNs * HeadroomFraction && drops == 0;
+
+    int next = m_level;
+    if (overBudget || dropping) {
+        m_calmWindows = 0;
+        if (m_level + 1 < m_levels.size())
+            next = m_level + 1;
+    } else if (headroom) {
+        if (++m_calmWindows >= UpgradeWindows && m_level > 0) {
+            next = m_level - 1;
+            m_calmWindows = 0;
+        }
+    } else {
+        m_calmWindows = 0;
+    }
+    if (next == m_level)
+        return false;
+
+    QualityChange change;
+    change.timeNs = nowNs;
+    change.from = m_level;
+    change.to = next;
+    if (overBudget || !dropping) {
+        change.trigger = overBudget ? "latency" : "headroom";
+        change.value = p95 / 1e6;
+        change.limit = (overBudget ? m_budgetNs : m_budgetNs * HeadroomFraction) / 1e6;
+    } else {
+        change.trigger = "drops";
+        change.value = 100.0 * drops / (frames + drops);
+        change.limit = 100 * MaxDropFraction;
+    }
+    change.budgetMs = m_budgetNs / 1e6;
+    change.convertMs = LatencyHistogram::percentile(convert, 95) / 1e6;
+    change.queueMs = LatencyHistogram::percentile(queueWait, 95) / 1e6;
+    change.sendMs = LatencyHistogram::percentile(send, 95) / 1e6;
+    change.frames = frames;
+    change.drops = drops;
+
+    m_level = next;
+    m_settleWindows = 1;
+    change.level = describe();
+    stats.qualityLevel.store(m_level, std::memory_order_relaxed);
+    stats.addQualityChange(change);
+    return true;
+}
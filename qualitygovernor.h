@@ -0,0 +1,68 @@
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+#include <QString>
+#include <QVector>
+#include <stdint.h>
+
+#include "colorconvert.h"
+#include "framepacer.h"
+#include "pipelinestats.h"
+
+struct StreamConfig;
+
+// Keeps one stream's glass-to-wire latency within a budget by trading
+// quality for time. Once a second it looks at the convert, queue and send
+// histograms and the drop counters. If the p95 latency is over budget or
+// more than a few frames are being dropped, it steps down: first the frame
+// rate, then the output size, then the format to UYVY. It steps back up one
+// level at a time after several calm windows, so a stream does not flap at
+// the edge of the budget.
+//
+// Every step is queued on the stream's StreamStats with the window that
+// caused it, for the stats reporter to log.
+//
+// update() is meant for the thread that produces the stream's frames, and
+// level() is only read from that thread too.
+class QualityGovernor
+{
+public:
+    struct Level {
+        int rateDivisor;    // send every nth frame
+        int sizePercent;    // of the configured output size
+        VideoFormat format;
+    };
+
+    QualityGovernor();
+
+    // Builds the steps the stream's configuration allows and returns to full
+    // quality. A zero latency budget disables the governor.
+    void reset(const StreamConfig &config);
+
+    bool isEnabled() const { return m_budgetNs > 0; }
+    const Level &level() const { return m_levels[m_level]; }
+    QString describe() const;
+
+    // Returns true if the level changed.
+    bool update(StreamStats &stats, int64_t nowNs);
+
+private:
+    void startWindow(StreamStats &stats, int64_t nowNs);
+
+    FrameRate m_rate;
+    int64_t m_budgetNs;
+    QVector<Level> m_levels;
+    int m_level;
+    int m_calmWindows;
+    int m_settleWindows;
+
+    int64_t m_windowStart;
+    quint64 m_frames;
+    quint64 m_drops;
+    LatencyHistogram::Snapshot m_convert;
+    LatencyHistogram::Snapshot m_queueWait;
+    LatencyHistogram::Snapshot m_send;
+    LatencyHistogram::Snapshot m_glassToWire;
+};
+
+#endif // QUALITYGOVERNOR_H
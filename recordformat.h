@@ -0,0 +1,75 @@
+#ifndef RECORDFORMAT_H
+#define RECORDFORMAT_H
+
+#include <stdint.h>
+
+// Layout of the files StreamRecorder writes and ReplaySource reads:
+//
+//   FileHeader
+//   ChunkHeader + payload, repeated, each padded to ChunkAlign
+//   ChunkHeader of type IndexChunk + IndexEntry[count]
+//   IndexTrailer
+//
+// Payloads are exactly what was handed to NDI: video lines at their stride,
+// audio as planar float channels. All fields are little-endian. A file cut
+// short by a crash has no index; readers then walk the chunks instead.
+namespace RecordFormat {
+
+static const char FileMagic[8] = { 'N', 'D', 'I', 'R', 'E', 'C', '1', '\0' };
+static const uint32_t Version = 1;
+static const uint32_t ChunkMagic = 0x4b4e4843;     // "CHNK"
+static const uint32_t TrailerMagic = 0x58444e49;   // "INDX"
+// Chunk and payload alignment, so mapped frames start on a cache line.
+static const int ChunkAlign = 64;
+
+enum ChunkType {
+    VideoChunk = 1,
+    AudioChunk = 2,
+    IndexChunk = 3
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;    // sizeof(FileHeader)
+    int64_t startNs;        // pipeline clock when recording started
+    uint8_t reserved[40];
+};
+
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t type;
+    uint32_t payloadSize;   // bytes of data after the header
+    uint32_t paddedSize;    // payloadSize rounded up to ChunkAlign
+    int64_t sendNs;         // pipeline clock when the send call returned
+    int64_t timecode;
+    // Video: xres, yres, line stride, FourCC, frame rate N and D.
+    // Audio: sample rate, channels, samples, channel stride.
+    int32_t params[6];
+    uint32_t reserved[2];
+};
+
+struct IndexEntry {
+    int64_t offset;         // of the ChunkHeader
+    int64_t sendNs;
+    uint32_t type;
+    uint32_t reserved;
+};
+
+struct IndexTrailer {
+    uint32_t magic;
+    uint32_t count;
+    int64_t indexOffset;    // of the index's ChunkHeader
+};
+
+static_assert(sizeof(FileHeader) == ChunkAlign, "FileHeader keeps chunks aligned");
+static_assert(sizeof(ChunkHeader) == ChunkAlign, "ChunkHeader keeps payloads aligned");
+
+inline uint32_t paddedSize(uint32_t size)
+{
+    return (size + ChunkAlign - 1) & ~uint32_t(ChunkAlign - 1);
+}
+
+}
+
+#endif // RECORDFORMAT_H
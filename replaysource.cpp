@@ -0,0 +1,326 @@
+#include "replaysource.h"
+
+#include <QDebug>
+#include <Processing.NDI.Lib.h>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <thread>
+
+#include "pipelinestats.h"
+
+using namespace RecordFormat;
+
+// Enough to fill a sender queue, with one frame held by NDI and one on its
+// way; the sender's own queue then decides what is dropped.
+static const int VideoDescriptors = 4;
+static const int AudioDescriptors = 10;
+// Long gaps are slept in slices so Stop() is not kept waiting.
+static const int64_t MaxSleepNs = 100000000;
+static const unsigned long ReleaseWaitMs = 100;
+// Gap between the last frame and the first of the next loop when there is
+// no video rate to go by: one NDI audio block.
+static const int64_t DefaultLoopGapNs = 20000000;
+
+void ReplaySource::MappedPool::allocate(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    Q_ASSERT(m_all.isEmpty());
+    for (int i = 0; i < count; ++i) {
+        FrameBuffer *buffer = new FrameBuffer;
+        memset(buffer, 0, sizeof(*buffer));
+        buffer->pool = this;
+        m_all.push_back(buffer);
+        m_free.push_back(buffer);
+    }
+    m_available = count;
+}
+
+void ReplaySource::MappedPool::free()
+{
+    QMutexLocker locker(&m_mutex);
+    Q_ASSERT(m_free.size() == m_all.size());
+    qDeleteAll(m_all);
+    m_all.clear();
+    m_free.clear();
+    m_available = 0;
+}
+
+FrameBuffer *ReplaySource::MappedPool::take()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_free.isEmpty())
+        return nullptr;
+    FrameBuffer *buffer = m_free.back();
+    m_free.pop_back();
+    m_available.fetch_sub(1, std::memory_order_release);
+    return buffer;
+}
+
+void ReplaySource::MappedPool::release(FrameBuffer *buffer)
+{
+    if (!buffer)
+        return;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_free.push_back(buffer);
+        m_available.fetch_add(1, std::memory_order_release);
+    }
+    m_source->m_released.notify();
+}
+
+ReplaySource::ReplaySource(QObject *parent)
+    : QThread(parent)
+    , m_map(nullptr)
+    , m_videoFourCC(0)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_videoPool(this)
+    , m_audioPool(this)
+    , m_pacing(RecordedPacing)
+    , m_loop(false)
+    , m_isRunning(false)
+    , m_replayed(0)
+    , m_skipped(0)
+{
+    m_videoRate.num = 0;
+    m_videoRate.den = 1;
+}
+
+ReplaySource::~ReplaySource()
+{
+    Stop();
+    close();
+}
+
+bool ReplaySource::open(const QString &path)
+{
+    Q_ASSERT(!m_map);
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot replay" << path << m_file.errorString();
+        return false;
+    }
+    const qint64 size = m_file.size();
+    // Private so frame data can be handed out as the non-const pointers NDI
+    // takes; nothing writes to it.
+    m_map = size >= qint64(sizeof(FileHeader)) ? m_file.map(0, size, QFileDevice::MapPrivateOption) : nullptr;
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(m_map);
+    if (!header || memcmp(header->magic, FileMagic, sizeof(header->magic)) != 0 || header->version != Version) {
+        qWarning() << path << "is not a stream recording";
+        close();
+        return false;
+    }
+
+    m_chunks.clear();
+    if (!readIndex(size)) {
+        qDebug() << path << "has no index, scanning the chunks";
+        m_chunks.clear();
+        scanChunks(size);
+    }
+    // The writer interleaves its channels by send time, which is close to
+    // but not always exactly sorted.
+    std::stable_sort(m_chunks.begin(), m_chunks.end(), [](const Chunk &a, const Chunk &b) {
+        return a.sendNs < b.sendNs;
+    });
+
+    m_videoSize = QSize();
+    m_sampleRate = 0;
+    for (const Chunk &chunk : m_chunks) {
+        const int32_t *p = chunk.header->params;
+        if (chunk.header->type == VideoChunk && m_videoSize.isEmpty()) {
+            m_videoSize = QSize(p[0], p[1]);
+            m_videoFourCC = p[3];
+            m_videoRate.num = p[4];
+            m_videoRate.den = qMax(1, p[5]);
+        } else if (chunk.header->type == AudioChunk && m_sampleRate == 0) {
+            m_sampleRate = p[0];
+            m_channels = p[1];
+        }
+    }
+    if (m_chunks.isEmpty()) {
+        qWarning() << path << "holds no frames";
+        close();
+        return false;
+    }
+
+    m_videoPool.allocate(hasVideo() ? VideoDescriptors : 0);
+    m_audioPool.allocate(hasAudio() ? AudioDescriptors : 0);
+    return true;
+}
+
+void ReplaySource::close()
+{
+    m_videoPool.free();
+    m_audioPool.free();
+    m_chunks.clear();
+    if (m_map)
+        m_file.unmap(m_map);
+    m_map = nullptr;
+    m_file.close();
+}
+
+// The header at offset if it is a whole chunk within the file with sane
+// parameters for its type.
+const ChunkHeader *ReplaySource::chunkAt(qint64 offset, qint64 size) const
+{
+    if (offset < qint64(sizeof(FileHeader)) || offset % ChunkAlign || offset + qint64(sizeof(ChunkHeader)) > size)
+        return nullptr;
+    const ChunkHeader *header = reinterpret_cast<const ChunkHeader *>(m_map + offset);
+    if (header->magic != ChunkMagic || header->payloadSize > header->paddedSize
+            || header->paddedSize != paddedSize(header->payloadSize)
+            || offset + qint64(sizeof(ChunkHeader)) + header->paddedSize > size)
+        return nullptr;
+
+    const int32_t *p = header->params;
+    if (header->type == VideoChunk)
+        return p[0] > 0 && p[1] > 0 && p[2] > 0 && qint64(p[2]) * p[1] <= header->payloadSize ? header : nullptr;
+    if (header->type == AudioChunk)
+        return p[0] > 0 && p[1] > 0 && p[2] > 0 && p[3] >= p[2] * int(sizeof(float))
+                && qint64(p[3]) * p[1] <= header->payloadSize ? header : nullptr;
+    return header->type == IndexChunk ? header : nullptr;
+}
+
+bool ReplaySource::readIndex(qint64 size)
+{
+    if (size < qint64(sizeof(FileHeader) + sizeof(IndexTrailer)))
+        return false;
+    // A truncated file can end anywhere, so the trailer may be unaligned.
+    IndexTrailer trailer;
+    memcpy(&trailer, m_map + size - sizeof(trailer), sizeof(trailer));
+    if (trailer.magic != TrailerMagic)
+        return false;
+    const ChunkHeader *index = chunkAt(trailer.indexOffset, size);
+    if (!index || index->type != IndexChunk || index->payloadSize != trailer.count * sizeof(IndexEntry))
+        return false;
+
+    const IndexEntry *entries = reinterpret_cast<const IndexEntry *>(index + 1);
+    m_chunks.reserve(trailer.count);
+    for (uint32_t i = 0; i < trailer.count; ++i) {
+        const ChunkHeader *header = chunkAt(entries[i].offset, size);
+        if (!header || header->type != entries[i].type || header->type == IndexChunk)
+            return false;
+        m_chunks.push_back(Chunk { header, header->sendNs });
+    }
+    return true;
+}
+
+bool ReplaySource::scanChunks(qint64 size)
+{
+    qint64 offset = sizeof(FileHeader);
+    while (const ChunkHeader *header = chunkAt(offset, size)) {
+        if (header->type == IndexChunk)
+            break;
+        m_chunks.push_back(Chunk { header, header->sendNs });
+        offset += sizeof(ChunkHeader) + header->paddedSize;
+    }
+    return !m_chunks.isEmpty();
+}
+
+void ReplaySource::Start(Pacing pacing, bool loop)
+{
+    Q_ASSERT(m_map && !isRunning());
+
+    m_pacing = pacing;
+    m_loop = loop;
+    m_replayed = 0;
+    m_skipped = 0;
+    m_isRunning = true;
+    start(QThread::HighPriority);
+}
+
+void ReplaySource::Stop()
+{
+    if (!isRunning())
+        return;
+
+    m_isRunning = false;
+    m_released.notify();
+    wait();
+}
+
+// Sleeps to deadlineNs on the pipeline clock the way FramePacer does, in
+// slices short enough to notice Stop().
+bool ReplaySource::sleepUntil(int64_t deadlineNs)
+{
+    for (;;) {
+        const int64_t left = deadlineNs - pipelineClockNs();
+        if (left <= 0 || !m_isRunning)
+            return m_isRunning;
+        if (left > 1500000)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(qMin(left - 1500000, MaxSleepNs)));
+        else
+            std::this_thread::yield();
+    }
+}
+
+void ReplaySource::run()
+{
+    const int64_t first = m_chunks.first().sendNs;
+    const int64_t gap = m_videoRate.num > 0 ? int64_t(m_videoRate.den) * 1000000000 / m_videoRate.num : DefaultLoopGapNs;
+    const int64_t loopNs = m_chunks.last().sendNs - first + gap;
+    const int64_t start = pipelineClockNs();
+    int64_t loopOffset = 0;
+
+    do {
+        for (const Chunk &chunk : m_chunks) {
+            if (m_pacing == RecordedPacing && !sleepUntil(start + loopOffset + chunk.sendNs - first))
+                return;
+            if (!m_isRunning)
+                return;
+
+            const ChunkHeader *header = chunk.header;
+            const int32_t *p = header->params;
+            const bool video = header->type == VideoChunk;
+            // The stream's audio format is fixed at open(); blocks recorded
+            // after a device change in another format are left out.
+            if (!video && (p[0] != m_sampleRate || p[1] != m_channels)) {
+                m_skipped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            MappedPool &pool = video ? m_videoPool : m_audioPool;
+            // Fast replay waits for the senders; at recorded pace a frame
+            // whose descriptors are all still queued is late and skipped.
+            FrameBuffer *frame = pool.take();
+            while (!frame && m_pacing == FastPacing && m_isRunning) {
+                m_released.wait([&] { return pool.hasFree() || !m_isRunning; }, ReleaseWaitMs);
+                frame = pool.take();
+            }
+            if (!frame) {
+                if (m_isRunning)
+                    m_skipped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            frame->data = const_cast<uint8_t *>(reinterpret_cast<const uint8_t *>(header + 1));
+            frame->capacity = int(header->payloadSize);
+            frame->len = int(header->payloadSize);
+            frame->generation = 0;
+            frame->owner = this;
+            // Original timecodes would jump back on every loop.
+            frame->timecode = NDIlib_send_timecode_synthesize;
+            if (video) {
+                frame->xres = p[0];
+                frame->yres = p[1];
+                frame->stride = p[2];
+                frame->fourCC = p[3];
+                frame->frameRateN = p[4];
+                frame->frameRateD = p[5];
+            } else {
+                frame->xres = 0;
+                frame->yres = 0;
+                frame->stride = p[3];
+                frame->len = p[3] * p[1];
+                frame->fourCC = 0;
+                frame->frameRateN = 0;
+                frame->frameRateD = 0;
+            }
+
+            m_replayed.fetch_add(1, std::memory_order_relaxed);
+            emit frameReady(frame, video, pipelineClockNs());
+        }
+        loopOffset += loopNs;
+    } while (m_loop && m_isRunning);
+}
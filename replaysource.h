@@ -0,0 +1,118 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <QFile>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+
+#include "framepacer.h"
+#include "framepool.h"
+#include "recordformat.h"
+#include "waitevent.h"
+
+// Plays back a file written by StreamRecorder. The file is mapped rather
+// than read, and frames go to the senders as FrameBuffers pointing into the
+// mapping, so replay costs no copies and the same file always produces the
+// same frames. Frames follow their recorded send times, or go out as fast
+// as the senders take them for load tests.
+class ReplaySource : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum Pacing {
+        RecordedPacing,     // the gaps between the original sends
+        FastPacing          // as soon as a frame descriptor is free
+    };
+
+    explicit ReplaySource(QObject *parent = nullptr);
+    ~ReplaySource();
+
+    // Maps the file and reads its index, or walks the chunks of a recording
+    // that was cut short.
+    bool open(const QString &path);
+    // Only once every frame handed out has been released.
+    void close();
+
+    // With loop, starts over after the last frame, shifted to follow on.
+    void Start(Pacing pacing, bool loop);
+    void Stop();
+
+    bool hasVideo() const { return !m_videoSize.isEmpty(); }
+    bool hasAudio() const { return m_sampleRate > 0; }
+    // Of the first video chunk; later ones carry their own.
+    QSize videoSize() const { return m_videoSize; }
+    int videoFourCC() const { return m_videoFourCC; }
+    FrameRate videoRate() const { return m_videoRate; }
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+    int chunkCount() const { return m_chunks.size(); }
+
+    quint64 ReplayedFrames() const { return m_replayed.load(std::memory_order_relaxed); }
+    quint64 SkippedFrames() const { return m_skipped.load(std::memory_order_relaxed); }
+
+signals:
+    // Emitted on the replay thread. The receiver pushes frame to the video
+    // or audio sender, whose release() returns it here, or releases it to
+    // frame->pool itself.
+    void frameReady(FrameBuffer *frame, bool video, qint64 captureNs);
+
+protected:
+    void run() override;
+
+private:
+    // Hands out descriptors of mapped memory; release() only returns the
+    // descriptor.
+    class MappedPool : public FramePool
+    {
+    public:
+        explicit MappedPool(ReplaySource *source) : m_source(source) {}
+        void release(FrameBuffer *buffer) override;
+        void allocate(int count);
+        void free();
+        FrameBuffer *take();
+        bool hasFree() const { return m_available.load(std::memory_order_acquire) > 0; }
+    private:
+        ReplaySource *m_source;
+        QVector<FrameBuffer *> m_all;
+        QVector<FrameBuffer *> m_free;
+        QMutex m_mutex;
+        std::atomic<int> m_available;
+    };
+
+    struct Chunk {
+        const RecordFormat::ChunkHeader *header;
+        int64_t sendNs;
+    };
+
+    bool readIndex(qint64 size);
+    bool scanChunks(qint64 size);
+    const RecordFormat::ChunkHeader *chunkAt(qint64 offset, qint64 size) const;
+    bool sleepUntil(int64_t deadlineNs);
+
+    QFile m_file;
+    uchar *m_map;
+    QVector<Chunk> m_chunks;
+
+    QSize m_videoSize;
+    int m_videoFourCC;
+    FrameRate m_videoRate;
+    int m_sampleRate;
+    int m_channels;
+
+    MappedPool m_videoPool;
+    MappedPool m_audioPool;
+    WaitEvent m_released;
+
+    Pacing m_pacing;
+    bool m_loop;
+    std::atomic<bool> m_isRunning;
+    std::atomic<quint64> m_replayed;
+    std::atomic<quint64> m_skipped;
+};
+
+#endif // REPLAYSOURCE_H
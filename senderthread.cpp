@@ -0,0 +1,220 @@
+#include "senderthread.h"
+
+#include "streampreview.h"
+#include "streamrecorder.h"
+
+// How long a stopped sender thread may sleep before rechecking m_isRunning.
+static const unsigned long SenderWaitMs = 100;
+
+SenderThread::SenderThread(NDIlib_send_instance_t instance, NDIlib_video_frame_v2_t* video_frame, NDIlib_audio_frame_v2_t* audio_frame, QObject *parent) : QThread(parent){
+    m_instance = instance;
+    m_video_frame = video_frame;
+    m_audio_frame = audio_frame;
+    m_isRunning = false;
+    m_inFlight = NULL;
+    m_stats = NULL;
+    m_recorder = NULL;
+    m_preview = NULL;
+    m_strand = NULL;
+    m_drainPosted = false;
+    m_policy = DropOldest;
+    m_dropped = 0;
+    m_highWater = 0;
+}
+
+SenderThread::~SenderThread() {
+    delete m_strand;
+}
+
+void SenderThread::SetInstance(NDIlib_send_instance_t instance) {
+    Q_ASSERT(!isRunning());
+    m_instance = instance;
+}
+
+void SenderThread::SetQueue(int capacity, OverflowPolicy policy) {
+    Q_ASSERT(!isRunning());
+    m_queue.reset(capacity);
+    m_policy = policy;
+}
+
+void SenderThread::SetStats(StreamStats *stats) {
+    Q_ASSERT(!isRunning());
+    m_stats = stats;
+}
+
+void SenderThread::SetRecorder(StreamRecorder *recorder) {
+    Q_ASSERT(!isRunning());
+    m_recorder = recorder;
+}
+
+void SenderThread::SetPreview(StreamPreview *preview) {
+    Q_ASSERT(!isRunning());
+    m_preview = preview;
+}
+
+void SenderThread::SetScheduler(StageScheduler *scheduler) {
+    Q_ASSERT(!isRunning() && !m_isRunning);
+    delete m_strand;
+    // One drain task at a time is enough; it sends whatever is queued.
+    m_strand = scheduler ? new StageScheduler::Strand(scheduler, objectName(), 1) : NULL;
+}
+
+void SenderThread::Start() {
+    m_dropped = 0;
+    m_highWater = 0;
+    m_isRunning = true;
+    m_drainPosted = false;
+    if (!m_strand)
+        start();
+}
+
+void SenderThread::Stop() {
+    m_isRunning = false;
+    m_dataReady.notify();
+    m_spaceReady.notify();
+    if (m_strand) {
+        m_strand->drain();
+        flush();
+    } else {
+        wait();
+        quit();
+    }
+}
+
+void SenderThread::drop(FrameBuffer *buffer) {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    if (m_stats)
+        m_stats->queueDrops.fetch_add(1, std::memory_order_relaxed);
+    buffer->pool->release(buffer);
+}
+
+bool SenderThread::Push(FrameBuffer *buffer) {
+    bool dropped = false;
+    buffer->enqueueNs = pipelineClockNs();
+    while (!m_queue.tryPush(buffer)) {
+        if (m_policy == DropNewest || !m_isRunning) {
+            drop(buffer);
+            return false;
+        }
+        if (m_policy == DropOldest) {
+            FrameBuffer* oldest;
+            if (m_queue.tryPop(oldest)) {
+                drop(oldest);
+                dropped = true;
+            }
+            continue;
+        }
+        m_spaceReady.wait([this] { return !m_queue.isFull() || !m_isRunning; }, SenderWaitMs);
+    }
+
+    const int depth = m_queue.size();
+    if (depth > m_highWater.load(std::memory_order_relaxed))
+        m_highWater.store(depth, std::memory_order_relaxed);
+    if (m_stats) {
+        m_stats->queueDepth.store(depth, std::memory_order_relaxed);
+        if (depth > m_stats->queueHighWater.load(std::memory_order_relaxed))
+            m_stats->queueHighWater.store(depth, std::memory_order_relaxed);
+    }
+
+    if (m_strand) {
+        if (!m_drainPosted.exchange(true))
+            m_strand->post(&SenderThread::drainTask, this);
+    } else {
+        m_dataReady.notify();
+    }
+    return !dropped;
+}
+
+// Sends everything queued. Clearing the flag first means a frame pushed while
+// this runs either gets sent here or posts another drain.
+void SenderThread::drainTask(void *ctx, qint64, qint64) {
+    SenderThread *sender = static_cast<SenderThread *>(ctx);
+    sender->m_drainPosted = false;
+    FrameBuffer* buffer;
+    while (sender->m_isRunning && sender->m_queue.tryPop(buffer)) {
+        sender->m_spaceReady.notify();
+        sender->send(buffer);
+    }
+}
+
+void SenderThread::run() {
+    while (m_isRunning) {
+        FrameBuffer* buffer;
+        if (!m_queue.tryPop(buffer)) {
+            m_dataReady.wait([this] { return !m_queue.isEmpty() || !m_isRunning; }, SenderWaitMs);
+            continue;
+        }
+        m_spaceReady.notify();
+        send(buffer);
+    }
+    flush();
+}
+
+void SenderThread::send(FrameBuffer *buffer) {
+    const int64_t dequeued = pipelineClockNs();
+    const int len = buffer->len;
+    const int64_t captured = buffer->captureNs;
+    if (m_stats) {
+        m_stats->queueDepth.store(m_queue.size(), std::memory_order_relaxed);
+        m_stats->queueWait.record(dequeued - buffer->enqueueNs);
+    }
+
+    if (m_video_frame) {
+        m_video_frame->xres = buffer->xres;
+        m_video_frame->yres = buffer->yres;
+        m_video_frame->line_stride_in_bytes = buffer->stride;
+        if (buffer->fourCC)
+            m_video_frame->FourCC = NDIlib_FourCC_video_type_e(buffer->fourCC);
+        if (buffer->frameRateN) {
+            m_video_frame->frame_rate_N = buffer->frameRateN;
+            m_video_frame->frame_rate_D = buffer->frameRateD;
+        }
+        m_video_frame->p_data = buffer->data;
+        m_video_frame->timecode = buffer->timecode;
+        NDIlib_send_send_video_async_v2(m_instance, m_video_frame);
+        if (m_recorder)
+            m_recorder->RecordVideo(*m_video_frame, len, pipelineClockNs());
+
+        // An async send returns once the SDK has let go of the previous frame.
+        if (m_inFlight)
+            m_inFlight->pool->release(m_inFlight);
+        m_inFlight = buffer;
+    }
+    if (m_audio_frame) {
+        m_audio_frame->no_samples = buffer->len / (sizeof(float) * m_audio_frame->no_channels);
+        m_audio_frame->channel_stride_in_bytes = buffer->stride;
+        m_audio_frame->p_data = (float*)buffer->data;
+        m_audio_frame->timecode = buffer->timecode;
+        NDIlib_send_send_audio_v2(m_instance, m_audio_frame);
+        if (m_recorder)
+            m_recorder->RecordAudio(*m_audio_frame, pipelineClockNs());
+        buffer->pool->release(buffer);
+    }
+
+    if (m_stats) {
+        const int64_t sent = pipelineClockNs();
+        m_stats->send.record(sent - dequeued);
+        if (captured)
+            m_stats->glassToWire.record(sent - captured);
+        m_stats->frames.fetch_add(1, std::memory_order_relaxed);
+        m_stats->bytes.fetch_add(len, std::memory_order_relaxed);
+    }
+
+    // After the stats, so a thumbnail never counts against the send. The
+    // buffer stays in flight until the next send, so it is still intact.
+    if (m_preview && m_video_frame && m_preview->isEnabled())
+        m_preview->offer(*m_video_frame, pipelineClockNs());
+}
+
+// Once stopped: lets NDI go of the last frame and returns what is still queued.
+void SenderThread::flush() {
+    if (m_inFlight) {
+        NDIlib_send_send_video_async_v2(m_instance, NULL);
+        m_inFlight->pool->release(m_inFlight);
+        m_inFlight = NULL;
+    }
+
+    FrameBuffer* buffer;
+    while (m_queue.tryPop(buffer))
+        buffer->pool->release(buffer);
+}
@@ -0,0 +1,85 @@
+#ifndef SENDERTHREAD_H
+#define SENDERTHREAD_H
+
+#include <QThread>
+#include <Processing.NDI.Lib.h>
+#include <atomic>
+
+#include "framepool.h"
+#include "pipelinestats.h"
+#include "spscqueue.h"
+#include "stagescheduler.h"
+#include "waitevent.h"
+
+class StreamPreview;
+class StreamRecorder;
+
+// Hands the buffers of one stream to NDI from its own thread, so a slow send
+// never stalls capture. Exactly one of video_frame and audio_frame is set.
+// Given a StageScheduler, it sends from a strand on the shared workers
+// instead of a thread of its own; frames still go out one at a time and in
+// order.
+class SenderThread : public QThread {
+    Q_OBJECT
+public:
+    // What Push() does when the queue is full.
+    enum OverflowPolicy {
+        DropOldest,     // replace the oldest queued frame, keeps latency low
+        DropNewest,     // discard the frame being pushed
+        Block           // wait for the sender to catch up
+    };
+
+    SenderThread(NDIlib_send_instance_t instance, NDIlib_video_frame_v2_t *video_frame, NDIlib_audio_frame_v2_t *audio_frame, QObject *parent = nullptr);
+    ~SenderThread();
+
+    // Only while stopped.
+    void SetInstance(NDIlib_send_instance_t instance);
+    void SetQueue(int capacity, OverflowPolicy policy);
+    void SetStats(StreamStats *stats);
+    // Every frame sent is also handed to recorder, or nothing if null.
+    void SetRecorder(StreamRecorder *recorder);
+    // Every video frame sent is also offered to preview, or nothing if null.
+    void SetPreview(StreamPreview *preview);
+    // Null for a thread of its own.
+    void SetScheduler(StageScheduler *scheduler);
+
+    void Start();
+    void Stop();
+
+    // Single producer. Returns false if a frame was dropped; dropped buffers
+    // go straight back to their pool.
+    bool Push(FrameBuffer *buffer);
+
+    quint64 DroppedFrames() const { return m_dropped.load(std::memory_order_relaxed); }
+    int HighWaterMark() const { return m_highWater.load(std::memory_order_relaxed); }
+    int QueueDepth() const { return m_queue.size(); }
+    int QueueCapacity() const { return m_queue.capacity(); }
+
+protected:
+    void run();
+    void drop(FrameBuffer *buffer);
+    void send(FrameBuffer *buffer);
+    void flush();
+    static void drainTask(void *ctx, qint64, qint64);
+
+    NDIlib_send_instance_t m_instance;
+    NDIlib_video_frame_v2_t* m_video_frame;
+    NDIlib_audio_frame_v2_t* m_audio_frame;
+    std::atomic<bool> m_isRunning;
+    FrameBuffer *m_inFlight;
+    StreamStats *m_stats;
+    StreamRecorder *m_recorder;
+    StreamPreview *m_preview;
+    StageScheduler::Strand *m_strand;
+    std::atomic<bool> m_drainPosted;
+
+    SpscQueue<FrameBuffer *> m_queue;
+    OverflowPolicy m_policy;
+    WaitEvent m_dataReady;
+    WaitEvent m_spaceReady;
+
+    std::atomic<quint64> m_dropped;
+    std::atomic<int> m_highWater;
+};
+
+#endif // SENDERTHREAD_H
@@ -0,0 +1,95 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+// Bounded single-producer/single-consumer ring of pointer-sized values.
+// Neither side locks or allocates. Pops advance the head with a CAS, which
+// also lets the producer take the oldest entry itself when it wants to drop
+// it instead of waiting for the consumer.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(int capacity = 1)
+    {
+        reset(capacity);
+    }
+
+    // Rounds capacity up to a power of two. Not thread-safe; call while idle.
+    void reset(int capacity)
+    {
+        int size = 1;
+        while (size < capacity)
+            size <<= 1;
+
+        m_slots.reset(new std::atomic<T>[size]);
+        m_capacity = capacity;
+        m_mask = size - 1;
+        m_head.store(0);
+        m_tail.store(0);
+    }
+
+    // Producer only.
+    bool tryPush(T value)
+    {
+        const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) >= uint64_t(m_capacity))
+            return false;
+
+        m_slots[tail & m_mask].store(value, std::memory_order_relaxed);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer, or the producer dropping the oldest entry.
+    bool tryPop(T &value)
+    {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        for (;;) {
+            if (head == m_tail.load(std::memory_order_acquire))
+                return false;
+
+            // The slot may be overwritten as soon as the other side wins the
+            // CAS, so the value only counts if ours succeeds.
+            const T v = m_slots[head & m_mask].load(std::memory_order_relaxed);
+            if (m_head.compare_exchange_weak(head, head + 1,
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+                value = v;
+                return true;
+            }
+        }
+    }
+
+    int size() const
+    {
+        const uint64_t head = m_head.load(std::memory_order_acquire);
+        const uint64_t tail = m_tail.load(std::memory_order_acquire);
+        return tail > head ? int(tail - head) : 0;
+    }
+
+    bool isEmpty() const { return size() == 0; }
+    bool isFull() const { return size() >= m_capacity; }
+    int capacity() const { return m_capacity; }
+
+private:
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    std::unique_ptr<std::atomic<T>[]> m_slots;
+    int m_capacity;
+    uint64_t m_mask;
+
+    // Keep head and tail on separate cache lines so the two threads don't
+    // bounce one line between cores. Padding rather than alignas, since
+    // C++11 operator new ignores over-alignment.
+    char m_pad0[64];
+    std::atomic<uint64_t> m_head;
+    char m_pad1[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> m_tail;
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,272 @@
+#include "stagescheduler.h"
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+// A strand gives its worker back after this many tasks in a row, so one busy
+// stream cannot keep others on the same worker waiting.
+static const int TasksPerTurn = 8;
+
+// The worker whose loop is running on this thread, -1 on any other thread.
+static thread_local int currentWorker = -1;
+
+StageScheduler::Strand::Strand(StageScheduler *scheduler, const QString &name, int capacity)
+    : m_scheduler(scheduler)
+    , m_name(name)
+    , m_head(0)
+    , m_count(0)
+    , m_scheduled(false)
+    , m_homeWorker(scheduler->m_nextHome.fetch_add(1, std::memory_order_relaxed))
+{
+    m_tasks.resize(qMax(1, capacity));
+}
+
+StageScheduler::Strand::~Strand()
+{
+    drain();
+    m_scheduler->unpark(this);
+}
+
+int StageScheduler::Strand::pending() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_count;
+}
+
+bool StageScheduler::Strand::post(TaskFn fn, void *ctx, qint64 a, qint64 b)
+{
+    bool schedule = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_count == m_tasks.size())
+            return false;
+        m_tasks[(m_head + m_count) % m_tasks.size()] = Task { fn, ctx, a, b };
+        ++m_count;
+        if (!m_scheduled) {
+            m_scheduled = true;
+            schedule = true;
+        }
+    }
+    // Scheduled stays set until a worker finds the strand empty, so it is
+    // in at most one deque and run by at most one worker at a time.
+    if (schedule)
+        m_scheduler->schedule(this);
+    return true;
+}
+
+void StageScheduler::Strand::drain()
+{
+    // Without workers the caller runs what is queued itself.
+    if (!m_scheduler->isRunning()) {
+        m_scheduler->unpark(this);
+        m_scheduler->runStrand(this, -1);
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    while (m_scheduled)
+        m_drained.wait(&m_mutex);
+}
+
+StageScheduler::StageScheduler()
+    : m_pinCores(false)
+    , m_running(false)
+    , m_nextHome(0)
+    , m_ready(0)
+    , m_sleeping(0)
+    , m_quit(false)
+    , m_tasksRun(0)
+    , m_steals(0)
+{
+}
+
+StageScheduler::~StageScheduler()
+{
+    stop();
+}
+
+void StageScheduler::start(int threadCount, bool pinCores)
+{
+    Q_ASSERT(!isRunning());
+
+    m_pinCores = pinCores;
+    m_quit = false;
+    m_ready = 0;
+    const int count = qMax(1, threadCount);
+    for (int i = 0; i < count; ++i) {
+        Deque *deque = new Deque;
+        deque->strands.reserve(MaxStrands);
+        m_deques.push_back(deque);
+    }
+    for (int i = 0; i < count; ++i)
+        m_workers.push_back(new Worker(this, i));
+    m_running = true;
+    for (Worker *worker : m_workers)
+        worker->start(QThread::HighPriority);
+
+    // Strands posted to before there was anyone to run them.
+    m_mutex.lock();
+    const QVector<Strand *> parked = m_parked;
+    m_parked.clear();
+    m_mutex.unlock();
+    for (Strand *strand : parked)
+        schedule(strand);
+}
+
+void StageScheduler::stop()
+{
+    if (!isRunning())
+        return;
+
+    m_mutex.lock();
+    m_quit = true;
+    m_workReady.wakeAll();
+    m_mutex.unlock();
+
+    for (Worker *worker : m_workers) {
+        worker->wait();
+        delete worker;
+    }
+    m_workers.clear();
+    m_running = false;
+
+    // Workers only quit once the deques are empty.
+    Q_ASSERT(m_ready == 0);
+    qDeleteAll(m_deques);
+    m_deques.clear();
+}
+
+void StageScheduler::schedule(Strand *strand, bool yielded)
+{
+    if (!isRunning()) {
+        QMutexLocker locker(&m_mutex);
+        m_parked.push_back(strand);
+        return;
+    }
+
+    // A strand posted from a worker, typically the next stage of the same
+    // frame, stays on that worker where the frame is still in cache. One
+    // that used up its turn goes to the far end, behind everything else.
+    const int worker = currentWorker >= 0 ? currentWorker : strand->m_homeWorker % m_deques.size();
+    Deque *deque = m_deques[worker];
+    deque->mutex.lock();
+    if (yielded)
+        deque->strands.prepend(strand);
+    else
+        deque->strands.push_back(strand);
+    deque->mutex.unlock();
+
+    m_ready.fetch_add(1);
+    if (m_sleeping.load() > 0) {
+        QMutexLocker locker(&m_mutex);
+        m_workReady.wakeOne();
+    }
+}
+
+void StageScheduler::unpark(Strand *strand)
+{
+    QMutexLocker locker(&m_mutex);
+    m_parked.removeAll(strand);
+}
+
+StageScheduler::Strand *StageScheduler::take(int worker)
+{
+    Deque *own = m_deques[worker];
+    own->mutex.lock();
+    if (!own->strands.isEmpty()) {
+        Strand *strand = own->strands.takeLast();
+        own->mutex.unlock();
+        m_ready.fetch_sub(1);
+        return strand;
+    }
+    own->mutex.unlock();
+
+    // Steal from the others, starting with the next worker so thieves spread out.
+    const int count = m_deques.size();
+    for (int i = 1; i < count; ++i) {
+        Deque *victim = m_deques[(worker + i) % count];
+        if (!victim->mutex.tryLock())
+            continue;
+        if (!victim->strands.isEmpty()) {
+            Strand *strand = victim->strands.takeFirst();
+            victim->mutex.unlock();
+            m_ready.fetch_sub(1);
+            m_steals.fetch_add(1, std::memory_order_relaxed);
+            return strand;
+        }
+        victim->mutex.unlock();
+    }
+    return nullptr;
+}
+
+// Runs up to TasksPerTurn of strand's tasks, or all of them for worker -1,
+// then either puts it back in line or marks it idle.
+void StageScheduler::runStrand(Strand *strand, int worker)
+{
+    for (int run = 0; worker < 0 || run < TasksPerTurn; ++run) {
+        Strand::Task task;
+        {
+            QMutexLocker locker(&strand->m_mutex);
+            if (strand->m_count == 0) {
+                strand->m_scheduled = false;
+                strand->m_drained.wakeAll();
+                return;
+            }
+            task = strand->m_tasks[strand->m_head];
+            strand->m_head = (strand->m_head + 1) % strand->m_tasks.size();
+            --strand->m_count;
+        }
+        task.fn(task.ctx, task.a, task.b);
+        m_tasksRun.fetch_add(1, std::memory_order_relaxed);
+    }
+    schedule(strand, true);
+}
+
+void StageScheduler::workerLoop(int index)
+{
+    currentWorker = index;
+    if (m_pinCores)
+        pinToCore(index);
+
+    for (;;) {
+        if (Strand *strand = take(index)) {
+            runStrand(strand, index);
+            continue;
+        }
+
+        m_mutex.lock();
+        m_sleeping.fetch_add(1);
+        while (m_ready.load() == 0 && !m_quit)
+            m_workReady.wait(&m_mutex);
+        m_sleeping.fetch_sub(1);
+        const bool quit = m_quit && m_ready.load() == 0;
+        m_mutex.unlock();
+        if (quit)
+            break;
+    }
+    currentWorker = -1;
+}
+
+void StageScheduler::pinToCore(int core)
+{
+    const int cores = QThread::idealThreadCount();
+    if (cores <= 0)
+        return;
+    core %= cores;
+#if defined(Q_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        qWarning() << "Cannot pin a stage worker to core" << core;
+#elif defined(Q_OS_WIN)
+    if (!SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core))
+        qWarning() << "Cannot pin a stage worker to core" << core;
+#else
+    Q_UNUSED(core)
+#endif
+}
@@ -0,0 +1,127 @@
+#ifndef STAGESCHEDULER_H
+#define STAGESCHEDULER_H
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+
+// Runs the pipeline stages of every stream on one fixed set of threads.
+// Work is posted to strands: the tasks of one strand run one at a time and
+// in the order they were posted, so each stage of each stream keeps its
+// frames in order, while different strands run in parallel. That lets one
+// stream convert frame N while its sender hands frame N-1 to NDI, and lets
+// any number of streams share the threads.
+//
+// Every worker keeps its own deque of ready strands. A worker takes the
+// newest strand from its own deque, which is still warm in its cache, and
+// when that is empty steals the oldest from another worker. Workers can be
+// pinned to a core each so their caches stay put.
+class StageScheduler
+{
+public:
+    typedef void (*TaskFn)(void *ctx, qint64 a, qint64 b);
+
+    // A serial queue of tasks. Owned by whatever posts to it; any thread may
+    // post, and posting never allocates.
+    class Strand
+    {
+    public:
+        // capacity bounds the tasks waiting to run, not counting the one
+        // running.
+        Strand(StageScheduler *scheduler, const QString &name, int capacity);
+        ~Strand();
+
+        // Returns false, running nothing, if capacity tasks are already waiting.
+        bool post(TaskFn fn, void *ctx, qint64 a = 0, qint64 b = 0);
+        // Waits until every task posted so far has run.
+        void drain();
+
+        const QString &name() const { return m_name; }
+        int pending() const;
+
+    private:
+        friend class StageScheduler;
+
+        struct Task {
+            TaskFn fn;
+            void *ctx;
+            qint64 a;
+            qint64 b;
+        };
+
+        StageScheduler *m_scheduler;
+        QString m_name;
+        mutable QMutex m_mutex;
+        QWaitCondition m_drained;
+        QVector<Task> m_tasks;      // ring
+        int m_head;
+        int m_count;
+        bool m_scheduled;           // in a deque or being run
+        int m_homeWorker;
+    };
+
+    StageScheduler();
+    ~StageScheduler();
+
+    // Starts threadCount workers, each pinned to one core if pinCores is
+    // set. Tasks posted while stopped wait for start().
+    void start(int threadCount = QThread::idealThreadCount(), bool pinCores = false);
+    // Runs what is queued, then stops the workers.
+    void stop();
+
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+    int threadCount() const { return m_workers.size(); }
+    bool pinsCores() const { return m_pinCores; }
+
+    quint64 TasksRun() const { return m_tasksRun.load(std::memory_order_relaxed); }
+    quint64 Steals() const { return m_steals.load(std::memory_order_relaxed); }
+
+    // Deque space reserved per worker, so scheduling does not allocate.
+    static const int MaxStrands = 256;
+
+private:
+    class Worker : public QThread
+    {
+    public:
+        Worker(StageScheduler *scheduler, int index) : m_scheduler(scheduler), m_index(index) {}
+    protected:
+        void run() override { m_scheduler->workerLoop(m_index); }
+    private:
+        StageScheduler *m_scheduler;
+        int m_index;
+    };
+
+    // A worker's ready strands. The owner pops the back, thieves the front.
+    struct Deque {
+        QMutex mutex;
+        QVector<Strand *> strands;
+    };
+
+    void schedule(Strand *strand, bool yielded = false);
+    void unpark(Strand *strand);
+    Strand *take(int worker);
+    void runStrand(Strand *strand, int worker);
+    void workerLoop(int index);
+    static void pinToCore(int core);
+
+    QVector<Worker *> m_workers;
+    QVector<Deque *> m_deques;
+    QVector<Strand *> m_parked;     // posted to while stopped
+    bool m_pinCores;
+    std::atomic<bool> m_running;
+    std::atomic<int> m_nextHome;
+
+    QMutex m_mutex;
+    QWaitCondition m_workReady;
+    std::atomic<int> m_ready;       // strands in the deques
+    std::atomic<int> m_sleeping;
+    bool m_quit;
+
+    std::atomic<quint64> m_tasksRun;
+    std::atomic<quint64> m_steals;
+};
+
+#endif // STAGESCHEDULER_H
@@ -0,0 +1,252 @@
+#include "statsreporter.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+
+static LatencyHistogram::Snapshot delta(const LatencyHistogram::Snapshot &now, const LatencyHistogram::Snapshot &before)
+{
+    LatencyHistogram::Snapshot d(now);
+    for (int i = 0; i < d.size() && i < before.size(); ++i)
+        d[i] -= before[i];
+    return d;
+}
+
+static QJsonObject latencyJson(const LatencyHistogram::Snapshot &counts)
+{
+    QJsonObject o;
+    o["count"] = double(LatencyHistogram::total(counts));
+    o["p50_us"] = LatencyHistogram::percentile(counts, 50) / 1000.0;
+    o["p99_us"] = LatencyHistogram::percentile(counts, 99) / 1000.0;
+    o["max_us"] = LatencyHistogram::percentile(counts, 100) / 1000.0;
+    return o;
+}
+
+StatsReporter::StatsReporter(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(report()));
+
+    QString path = QString::fromLocal8Bit(qgetenv("NDI_STATS_FILE"));
+    if (path.isEmpty()) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        QDir().mkpath(dir);
+        path = dir + "/stats.jsonl";
+    }
+    setLogFile(path);
+}
+
+void StatsReporter::addStream(const QString &name, StreamStats *stats, NDIlib_send_instance_t instance)
+{
+    Stream stream;
+    stream.name = name;
+    stream.stats = stats;
+    stream.instance = instance;
+    stream.glassToWireP50 = 0;
+    m_streams.push_back(stream);
+    resetBaseline(m_streams.last());
+}
+
+void StatsReporter::removeStream(StreamStats *stats)
+{
+    for (int i = m_streams.size() - 1; i >= 0; --i) {
+        if (m_streams[i].stats == stats) {
+            reportQualityChanges(m_streams[i], nullptr);
+            m_streams.removeAt(i);
+        }
+    }
+}
+
+void StatsReporter::clearStreams()
+{
+    for (const Stream &s : m_streams)
+        reportQualityChanges(s, nullptr);
+    m_streams.clear();
+}
+
+void StatsReporter::setLogFile(const QString &path)
+{
+    m_log.close();
+    m_log.setFileName(path);
+}
+
+void StatsReporter::start(int intervalMs)
+{
+    if (!m_log.fileName().isEmpty() && !m_log.isOpen()
+            && !m_log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        qWarning() << "Cannot write stats to" << m_log.fileName();
+
+    resetBaselines();
+    m_interval.start();
+    m_timer.start(intervalMs);
+}
+
+void StatsReporter::stop()
+{
+    if (m_timer.isActive()) {
+        m_timer.stop();
+        report();
+    }
+    m_log.flush();
+}
+
+void StatsReporter::resetBaselines()
+{
+    for (Stream &s : m_streams)
+        resetBaseline(s);
+}
+
+void StatsReporter::resetBaseline(Stream &s)
+{
+    s.frames = s.stats->frames;
+    s.bytes = s.stats->bytes;
+    s.drops = s.stats->captureDrops + s.stats->queueDrops;
+    s.idleSkips = s.stats->idleSkips;
+    s.convert = s.stats->convert.snapshot();
+    s.queueWait = s.stats->queueWait.snapshot();
+    s.send = s.stats->send.snapshot();
+    s.glassToWire = s.stats->glassToWire.snapshot();
+    s.stats->queueHighWater = 0;
+}
+
+// Logs and drains the governor steps queued since the last call; summary,
+// if given, gets a line for each.
+void StatsReporter::reportQualityChanges(const Stream &s, QString *summary)
+{
+    const int64_t nowNs = pipelineClockNs();
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    for (const QualityChange &c : s.stats->takeQualityChanges()) {
+        QJsonObject line;
+        line["ts"] = now.addMSecs(-(nowNs - c.timeNs) / 1000000).toString(Qt::ISODateWithMs);
+        line["stream"] = s.name;
+        line["event"] = "quality";
+        line["from"] = c.from;
+        line["to"] = c.to;
+        line["level"] = c.level;
+        line["trigger"] = c.trigger;
+        line["value"] = c.value;
+        line["limit"] = c.limit;
+        line["budget_ms"] = c.budgetMs;
+        line["convert_p95_ms"] = c.convertMs;
+        line["queue_p95_ms"] = c.queueMs;
+        line["send_p95_ms"] = c.sendMs;
+        line["frames"] = double(c.frames);
+        line["drops"] = double(c.drops);
+        if (m_log.isOpen())
+            m_log.write(QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n');
+
+        if (summary) {
+            *summary += QString("%1  quality %2 -> %3 on %4 %5 of %6, now %7\n")
+                    .arg(s.name, -13)
+                    .arg(c.from)
+                    .arg(c.to)
+                    .arg(c.trigger)
+                    .arg(c.value, 0, 'f', 1)
+                    .arg(c.limit, 0, 'f', 1)
+                    .arg(c.level);
+        }
+    }
+}
+
+void StatsReporter::report()
+{
+    const double seconds = qMax<qint64>(1, m_interval.restart()) / 1000.0;
+    const QString timestamp = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    QString summary;
+
+    for (Stream &s : m_streams) {
+        const quint64 frames = s.stats->frames;
+        const quint64 bytes = s.stats->bytes;
+        const quint64 drops = s.stats->captureDrops + s.stats->queueDrops;
+        const quint64 idleSkips = s.stats->idleSkips;
+        const LatencyHistogram::Snapshot convert = s.stats->convert.snapshot();
+        const LatencyHistogram::Snapshot queueWait = s.stats->queueWait.snapshot();
+        const LatencyHistogram::Snapshot send = s.stats->send.snapshot();
+        const LatencyHistogram::Snapshot glassToWire = s.stats->glassToWire.snapshot();
+        const int connections = s.instance ? NDIlib_send_get_no_connections(s.instance, 0) : 0;
+
+        const double fps = (frames - s.frames) / seconds;
+        const double bytesPerSecond = (bytes - s.bytes) / seconds;
+        const LatencyHistogram::Snapshot g2w = delta(glassToWire, s.glassToWire);
+
+        QJsonObject latency;
+        latency["convert"] = latencyJson(delta(convert, s.convert));
+        latency["queue"] = latencyJson(delta(queueWait, s.queueWait));
+        latency["send"] = latencyJson(delta(send, s.send));
+        latency["glass_to_wire"] = latencyJson(g2w);
+
+        // Against the first stream of the same sender, reported earlier in
+        // this same pass.
+        s.glassToWireP50 = LatencyHistogram::total(g2w) ? LatencyHistogram::percentile(g2w, 50) : 0;
+        const Stream *pair = nullptr;
+        for (const Stream &other : m_streams) {
+            if (&other == &s)
+                break;
+            if (s.instance && other.instance == s.instance) {
+                pair = &other;
+                break;
+            }
+        }
+        const bool hasOffset = pair && pair->glassToWireP50 && s.glassToWireP50;
+        const double offsetMs = hasOffset ? (s.glassToWireP50 - pair->glassToWireP50) / 1e6 : 0.0;
+
+        QJsonObject line;
+        line["ts"] = timestamp;
+        line["stream"] = s.name;
+        line["fps"] = fps;
+        line["bytes_per_s"] = bytesPerSecond;
+        line["drops"] = double(drops - s.drops);
+        line["queue_depth"] = s.stats->queueDepth.load();
+        line["queue_high_water"] = s.stats->queueHighWater.load();
+        line["connections"] = connections;
+        line["idle_skips"] = double(idleSkips - s.idleSkips);
+        line["idle"] = s.stats->idle.load();
+        line["quality_level"] = s.stats->qualityLevel.load();
+        line["latency"] = latency;
+        if (hasOffset)
+            line["av_offset_ms"] = offsetMs;
+        if (m_log.isOpen())
+            m_log.write(QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n');
+
+        summary += QString("%1  %2 fps  %3 MB/s  q %4/%5  drops %6  rx %7  g2w p50 %8 p99 %9 ms\n")
+                .arg(s.name, -13)
+                .arg(fps, 5, 'f', 1)
+                .arg(bytesPerSecond / 1e6, 6, 'f', 1)
+                .arg(s.stats->queueDepth.load())
+                .arg(s.stats->queueHighWater.load())
+                .arg(drops - s.drops)
+                .arg(connections)
+                .arg(LatencyHistogram::percentile(g2w, 50) / 1e6, 0, 'f', 1)
+                .arg(LatencyHistogram::percentile(g2w, 99) / 1e6, 0, 'f', 1);
+        if (hasOffset) {
+            summary.chop(1);
+            summary += QString("  a/v %1%2 ms\n").arg(offsetMs >= 0 ? "+" : "").arg(offsetMs, 0, 'f', 1);
+        }
+        if (s.stats->idle.load()) {
+            summary.chop(1);
+            summary += "  idle, no receivers\n";
+        }
+        // Only shown once the governor has stepped a stream down.
+        if (s.stats->qualityLevel.load() > 0) {
+            summary.chop(1);
+            summary += QString("  quality -%1\n").arg(s.stats->qualityLevel.load());
+        }
+        reportQualityChanges(s, &summary);
+
+        s.frames = frames;
+        s.bytes = bytes;
+        s.drops = drops;
+        s.idleSkips = idleSkips;
+        s.convert = convert;
+        s.queueWait = queueWait;
+        s.send = send;
+        s.glassToWire = glassToWire;
+        s.stats->queueHighWater = 0;
+    }
+    m_log.flush();
+
+    emit updated(summary.trimmed());
+}
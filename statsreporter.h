@@ -0,0 +1,73 @@
+#ifndef STATSREPORTER_H
+#define STATSREPORTER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QTimer>
+#include <Processing.NDI.Lib.h>
+
+#include "pipelinestats.h"
+
+// Turns the StreamStats of every registered stream into per-interval rates
+// and percentiles. Each report is appended to a JSON-lines file and emitted
+// as a short text summary for the UI. A stream sharing its sender with one
+// added before it, the audio of a video stream, also reports how much later
+// than that one it leaves after capture: the A/V offset receivers will see.
+// Quality governor steps are logged as lines of their own, every one of
+// them, including those of a stream removed between reports.
+class StatsReporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StatsReporter(QObject *parent = nullptr);
+
+    // instance may be shared by several streams (video and audio of one sender).
+    // Streams can be added and removed while reporting; a new one is measured
+    // from the moment it is added.
+    void addStream(const QString &name, StreamStats *stats, NDIlib_send_instance_t instance);
+    void removeStream(StreamStats *stats);
+    void clearStreams();
+
+    // Defaults to $NDI_STATS_FILE, else stats.jsonl in the app data directory.
+    // An empty path turns the log off.
+    void setLogFile(const QString &path);
+
+    void start(int intervalMs = 1000);
+    void stop();
+
+signals:
+    void updated(const QString &summary);
+
+private slots:
+    void report();
+
+private:
+    struct Stream {
+        QString name;
+        StreamStats *stats;
+        NDIlib_send_instance_t instance;
+        quint64 frames;
+        quint64 bytes;
+        quint64 drops;
+        quint64 idleSkips;
+        LatencyHistogram::Snapshot convert;
+        LatencyHistogram::Snapshot queueWait;
+        LatencyHistogram::Snapshot send;
+        LatencyHistogram::Snapshot glassToWire;
+        qint64 glassToWireP50;      // last interval's, 0 if nothing was sent
+    };
+
+    void resetBaselines();
+    static void resetBaseline(Stream &s);
+    void reportQualityChanges(const Stream &s, QString *summary);
+
+    QList<Stream> m_streams;
+    QTimer m_timer;
+    QElapsedTimer m_interval;
+    QFile m_log;
+};
+
+#endif // STATSREPORTER_H
@@ -0,0 +1,344 @@
+#include "streamconfig.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QStringList>
+
+StreamConfig::StreamConfig()
+    : video(NoVideo)
+    , format(VideoUYVY)
+    , matrix(MatrixAuto)
+    , range(LimitedRange)
+    , scaleFilter(FrameScaler::Box)
+    , audioRate(48000)
+    , audioChannels(2)
+    , audioBufferMs(40)
+    , audioPeriodMs(10)
+    , unchangedPolicy(SkipUnchanged)
+    , latencyBudgetMs(0)
+    , idleWithoutReceivers(true)
+    , replayPacing(RecordedPace)
+    , replayLoop(false)
+{
+    frameRate.num = 30;
+    frameRate.den = 1;
+}
+
+// Accepts a device name, { "device": name, "gain": dB }, or a list of either.
+static bool parseAudioInputs(const QJsonValue &value, QList<AudioInput> &inputs)
+{
+    inputs.clear();
+    if (value.isUndefined() || value.isNull())
+        return true;
+    if (value.isString()) {
+        if (!value.toString().isEmpty())
+            inputs.push_back(AudioInput(value.toString()));
+        return true;
+    }
+    if (!value.isArray())
+        return false;
+
+    for (const QJsonValue &item : value.toArray()) {
+        AudioInput input;
+        if (item.isString()) {
+            input.device = item.toString();
+        } else if (item.isObject()) {
+            const QJsonObject object = item.toObject();
+            input.device = object.value("device").toString();
+            const QJsonValue gain = object.value("gain");
+            if (!gain.isUndefined() && !gain.isDouble())
+                return false;
+            input.gainDb = gain.toDouble(0);
+        }
+        if (input.device.isEmpty() || input.gainDb < -96 || input.gainDb > 24)
+            return false;
+        inputs.push_back(input);
+    }
+    return true;
+}
+
+// Accepts "30", "29.97", "30000/1001" or a JSON number.
+static bool parseFrameRate(const QJsonValue &value, FrameRate &rate)
+{
+    if (value.isDouble()) {
+        const double fps = value.toDouble();
+        if (fps <= 0)
+            return false;
+        rate.num = qRound(fps * 1000);
+        rate.den = 1000;
+        if (rate.num % 1000 == 0) {
+            rate.num /= 1000;
+            rate.den = 1;
+        }
+        // Snap the NTSC rates to their exact fractions.
+        if (qAbs(fps * 1001 - qRound(fps * 1.001) * 1000) < 1) {
+            rate.num = qRound(fps * 1.001) * 1000;
+            rate.den = 1001;
+        }
+        return true;
+    }
+
+    const QString text = value.toString().trimmed();
+    const int slash = text.indexOf('/');
+    if (slash < 0) {
+        bool ok = false;
+        const double fps = text.toDouble(&ok);
+        return ok && parseFrameRate(QJsonValue(fps), rate);
+    }
+
+    bool okNum = false, okDen = false;
+    rate.num = text.left(slash).toInt(&okNum);
+    rate.den = text.mid(slash + 1).toInt(&okDen);
+    return okNum && okDen && rate.num > 0 && rate.den > 0;
+}
+
+// Accepts "WxH", "H" or "Hp"; a height alone keeps the source aspect ratio.
+static bool parseOutputSize(const QString &text, QSize &size)
+{
+    bool okWidth = true, okHeight = false;
+    const int x = text.indexOf('x');
+    int width = 0;
+    if (x >= 0)
+        width = text.left(x).toInt(&okWidth);
+    QString height = text.mid(x + 1);
+    if (x < 0 && height.endsWith('p'))
+        height.chop(1);
+    size = QSize(width, height.toInt(&okHeight));
+    return okWidth && okHeight && width >= 0 && size.height() > 0 && (x < 0 || width > 0);
+}
+
+// Accepts "WxH+X+Y" or "WxH", as in X geometry strings.
+static bool parseRegion(const QString &text, QRect &region)
+{
+    const QStringList parts = text.split('+');
+    const QStringList size = parts[0].split('x');
+    if (size.size() != 2 || (parts.size() != 1 && parts.size() != 3))
+        return false;
+    bool ok[4] = { false, false, true, true };
+    region = QRect(0, 0, size[0].toInt(&ok[0]), size[1].toInt(&ok[1]));
+    if (parts.size() == 3)
+        region.moveTo(parts[1].toInt(&ok[2]), parts[2].toInt(&ok[3]));
+    return ok[0] && ok[1] && ok[2] && ok[3] && !region.isEmpty() && region.x() >= 0 && region.y() >= 0;
+}
+
+static bool parseStream(const QJsonObject &object, StreamConfig &config, QString *error)
+{
+    config.ndiName = object.value("name").toString();
+    if (config.ndiName.isEmpty()) {
+        *error = "stream without a \"name\"";
+        return false;
+    }
+
+    const QString video = object.value("video").toString("none").toLower();
+    if (video == "screen")
+        config.video = StreamConfig::ScreenVideo;
+    else if (video == "camera")
+        config.video = StreamConfig::CameraVideo;
+    else if (video == "test")
+        config.video = StreamConfig::TestPatternVideo;
+    else if (video == "replay")
+        config.video = StreamConfig::ReplayVideo;
+    else if (video == "window")
+        config.video = StreamConfig::WindowVideo;
+    else if (video == "none")
+        config.video = StreamConfig::NoVideo;
+    else {
+        *error = QString("%1: unknown video source \"%2\"").arg(config.ndiName, video);
+        return false;
+    }
+    config.videoDevice = object.value("device").toVariant().toString();
+    if (config.video == StreamConfig::ReplayVideo && config.videoDevice.isEmpty()) {
+        *error = QString("%1: a replay needs the recording as \"device\"").arg(config.ndiName);
+        return false;
+    }
+    if (config.video == StreamConfig::WindowVideo && config.videoDevice.isEmpty()) {
+        *error = QString("%1: a window needs its title or id as \"device\"").arg(config.ndiName);
+        return false;
+    }
+
+    const QString region = object.value("region").toString().trimmed().toLower();
+    if (region.isEmpty())
+        config.region = QRect();
+    else if (!parseRegion(region, config.region)) {
+        *error = QString("%1: \"region\" must be WxH+X+Y").arg(config.ndiName);
+        return false;
+    }
+
+    const QString format = object.value("format").toString("UYVY").toUpper();
+    bool knownFormat = false;
+    for (int f = VideoUYVY; f <= VideoRGBA && !knownFormat; ++f) {
+        if (format == videoFormatName(VideoFormat(f))) {
+            config.format = VideoFormat(f);
+            knownFormat = true;
+        }
+    }
+    if (!knownFormat) {
+        *error = QString("%1: unsupported format \"%2\"").arg(config.ndiName, format);
+        return false;
+    }
+
+    QString matrix = object.value("matrix").toVariant().toString().toLower();
+    if (matrix.startsWith("bt"))
+        matrix = matrix.mid(2).remove('.');
+    if (matrix.isEmpty() || matrix == "auto")
+        config.matrix = MatrixAuto;
+    else if (matrix == "601")
+        config.matrix = MatrixBT601;
+    else if (matrix == "709")
+        config.matrix = MatrixBT709;
+    else if (matrix == "2020")
+        config.matrix = MatrixBT2020;
+    else {
+        *error = QString("%1: \"matrix\" must be auto, 601, 709 or 2020").arg(config.ndiName);
+        return false;
+    }
+
+    const QString range = object.value("range").toString("limited").toLower();
+    if (range == "limited")
+        config.range = LimitedRange;
+    else if (range == "full")
+        config.range = FullRange;
+    else {
+        *error = QString("%1: \"range\" must be limited or full").arg(config.ndiName);
+        return false;
+    }
+
+    const QString output = object.value("output").toVariant().toString().trimmed().toLower();
+    if (output.isEmpty() || output == "source")
+        config.outputSize = QSize();
+    else if (!parseOutputSize(output, config.outputSize)) {
+        *error = QString("%1: \"output\" must be WxH or a height such as 720p").arg(config.ndiName);
+        return false;
+    }
+
+    const QString scale = object.value("scale").toString("box").toLower();
+    if (scale == "box")
+        config.scaleFilter = FrameScaler::Box;
+    else if (scale == "bilinear")
+        config.scaleFilter = FrameScaler::Bilinear;
+    else {
+        *error = QString("%1: \"scale\" must be box or bilinear").arg(config.ndiName);
+        return false;
+    }
+
+    if (object.contains("frameRate") && !parseFrameRate(object.value("frameRate"), config.frameRate)) {
+        *error = QString("%1: bad frame rate").arg(config.ndiName);
+        return false;
+    }
+
+    if (!parseAudioInputs(object.value("audio"), config.audioInputs)) {
+        *error = QString("%1: \"audio\" must be a device or a list of devices with gains from -96 to 24 dB")
+                 .arg(config.ndiName);
+        return false;
+    }
+    config.audioRate = object.value("audioRate").toInt(48000);
+    config.audioChannels = object.value("audioChannels").toInt(2);
+    // NDI audio goes out in 20 ms blocks of whole samples.
+    if (config.audioRate < 8000 || config.audioRate > 192000 || config.audioRate % 50) {
+        *error = QString("%1: \"audioRate\" must be a multiple of 50 Hz from 8000 to 192000").arg(config.ndiName);
+        return false;
+    }
+    if (config.audioChannels < 1 || config.audioChannels > 16) {
+        *error = QString("%1: \"audioChannels\" must be 1 to 16").arg(config.ndiName);
+        return false;
+    }
+    config.audioBufferMs = object.value("audioBuffer").toInt(40);
+    config.audioPeriodMs = object.value("audioPeriod").toInt(10);
+    if (config.audioPeriodMs < 1 || config.audioPeriodMs > 100) {
+        *error = QString("%1: \"audioPeriod\" must be 1 to 100 ms").arg(config.ndiName);
+        return false;
+    }
+    if (config.audioBufferMs < 2 * config.audioPeriodMs || config.audioBufferMs > 250) {
+        *error = QString("%1: \"audioBuffer\" must be two periods to 250 ms").arg(config.ndiName);
+        return false;
+    }
+
+    const QString unchanged = object.value("unchanged").toString("skip").toLower();
+    if (unchanged == "skip")
+        config.unchangedPolicy = SkipUnchanged;
+    else if (unchanged == "resend")
+        config.unchangedPolicy = ResendUnchanged;
+    else {
+        *error = QString("%1: \"unchanged\" must be skip or resend").arg(config.ndiName);
+        return false;
+    }
+
+    const QJsonValue budgetValue = object.value("latencyBudget");
+    const int budget = budgetValue.toInt(0);
+    if ((!budgetValue.isUndefined() && !budgetValue.isDouble()) || budget < 0) {
+        *error = QString("%1: \"latencyBudget\" must be milliseconds, 0 for none").arg(config.ndiName);
+        return false;
+    }
+    config.latencyBudgetMs = budget;
+
+    const QJsonValue idle = object.value("idle");
+    if (!idle.isUndefined() && !idle.isBool()) {
+        *error = QString("%1: \"idle\" must be true or false").arg(config.ndiName);
+        return false;
+    }
+    config.idleWithoutReceivers = idle.toBool(true);
+
+    const QString replay = object.value("replay").toString("recorded").toLower();
+    if (replay == "recorded")
+        config.replayPacing = StreamConfig::RecordedPace;
+    else if (replay == "fast")
+        config.replayPacing = StreamConfig::FastPace;
+    else {
+        *error = QString("%1: \"replay\" must be recorded or fast").arg(config.ndiName);
+        return false;
+    }
+
+    const QJsonValue loop = object.value("loop");
+    if (!loop.isUndefined() && !loop.isBool()) {
+        *error = QString("%1: \"loop\" must be true or false").arg(config.ndiName);
+        return false;
+    }
+    config.replayLoop = loop.toBool(false);
+
+    config.recordPath = object.value("record").toString();
+    return true;
+}
+
+bool loadStreamConfigs(const QString &path, QList<StreamConfig> &configs, QString *error)
+{
+    QString dummy;
+    if (!error)
+        error = &dummy;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (doc.isNull()) {
+        *error = parseError.errorString();
+        return false;
+    }
+
+    const QJsonArray streams = doc.object().value("streams").toArray();
+    if (streams.isEmpty()) {
+        *error = "no \"streams\" defined";
+        return false;
+    }
+
+    QSet<QString> names;
+    configs.clear();
+    for (const QJsonValue &value : streams) {
+        StreamConfig config;
+        if (!parseStream(value.toObject(), config, error))
+            return false;
+        if (names.contains(config.ndiName)) {
+            *error = QString("duplicate stream name \"%1\"").arg(config.ndiName);
+            return false;
+        }
+        names.insert(config.ndiName);
+        configs.push_back(config);
+    }
+    return true;
+}
@@ -0,0 +1,116 @@
+#ifndef STREAMCONFIG_H
+#define STREAMCONFIG_H
+
+#include <QList>
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+#include "colorconvert.h"
+#include "damagetracker.h"
+#include "framepacer.h"
+#include "framescaler.h"
+
+// One audio input device mixed into a stream: its name, or "default" for
+// the system default, and the gain it is mixed at.
+struct AudioInput {
+    QString device;
+    double gainDb;
+
+    AudioInput(const QString &device = QString(), double gainDb = 0)
+        : device(device), gainDb(gainDb) {}
+    bool operator==(const AudioInput &other) const { return device == other.device && gainDb == other.gainDb; }
+    bool operator!=(const AudioInput &other) const { return !(*this == other); }
+};
+
+// Everything that describes one NDI source: where its video and audio come
+// from and how they are sent.
+struct StreamConfig {
+    enum VideoSource {
+        NoVideo,
+        ScreenVideo,
+        CameraVideo,
+        TestPatternVideo,
+        ReplayVideo,
+        WindowVideo
+    };
+
+    // How a ReplayVideo stream paces the recording.
+    enum ReplayPacing {
+        RecordedPace,
+        FastPace
+    };
+
+    QString ndiName;
+    VideoSource video;
+    // Screen name or index, camera device name or description. Empty picks
+    // the primary screen or the default camera. Test patterns take a size
+    // such as "3840x2160", 1080p by default. On Linux a /dev/videoN node is
+    // read through V4L2, so the vivid driver can stand in for a camera.
+    // Replays take the path of a recording, whose audio is replayed too.
+    // Windows take a title, or part of one, or a native window id such as
+    // "0x3a00007"; the window is followed as it moves and resizes.
+    QString videoDevice;
+    // Part of the screen to capture, relative to its top-left corner. Only
+    // this area is read and converted; empty captures the whole screen.
+    QRect region;
+    VideoFormat format;
+    ColorMatrix matrix;
+    ColorRange range;
+    // Size sent over NDI. Empty sends the source size; a zero width keeps the
+    // source aspect ratio at the given height. Sources are only downscaled.
+    QSize outputSize;
+    FrameScaler::Filter scaleFilter;
+    FrameRate frameRate;
+    // Audio inputs mixed into the one sent; empty for no audio.
+    QList<AudioInput> audioInputs;
+    // What audio is sent as, whatever the device captures: it is resampled
+    // and its channels repeated or mixed down to match.
+    int audioRate;
+    int audioChannels;
+    // How much each input device buffers and how often it is read: what a
+    // sample can wait before it is mixed, on top of the 20 ms block.
+    int audioBufferMs;
+    int audioPeriodMs;
+    UnchangedFramePolicy unchangedPolicy;
+    // Glass-to-wire p95 latency the QualityGovernor defends; 0 turns it off.
+    int latencyBudgetMs;
+    // Stop capturing and converting while no receiver is connected.
+    bool idleWithoutReceivers;
+    ReplayPacing replayPacing;
+    bool replayLoop;
+    // Records everything sent to this file; empty for no recording.
+    QString recordPath;
+
+    StreamConfig();
+};
+
+// Reads a JSON file of the form
+//
+//   { "streams": [ { "name": "Desk", "video": "screen", "device": "0",
+//                    "format": "UYVY", "matrix": "709", "range": "limited",
+//                    "output": "1280x720", "scale": "box",
+//                    "frameRate": "60000/1001", "audio": "default",
+//                    "unchanged": "skip", "idle": true,
+//                    "latencyBudget": 100, "record": "desk.ndirec" },
+//                  { "name": "Editor", "video": "window",
+//                    "device": "Visual Studio Code" },
+//                  { "name": "Slides", "video": "screen", "device": "1",
+//                    "region": "1280x720+320+180" },
+//                  { "name": "Replay", "video": "replay",
+//                    "device": "desk.ndirec", "replay": "fast",
+//                    "loop": true }, ... ] }
+//
+// "output" also takes a height alone, such as "720" or "720p". "scale" is
+// box or bilinear. "region" is WxH+X+Y, or WxH at the top-left corner.
+// "audio" is one input device, or a list of them mixed together, each a
+// name or { "device": name, "gain": dB }, such as
+// [ "default", { "device": "Line In", "gain": -6 } ].
+// "audioRate" (48000) and "audioChannels" (2) set what audio is sent as;
+// "audioBuffer" (40) and "audioPeriod" (10) are the capture buffer and read
+// interval in milliseconds.
+// "replay" is recorded or fast. Only "name" is required. Returns false and
+// describes the first problem in error if the file cannot be used.
+bool loadStreamConfigs(const QString &path, QList<StreamConfig> &configs, QString *error);
+
+#endif // STREAMCONFIG_H
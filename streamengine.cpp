@@ -0,0 +1,231 @@
+#include "streamengine.h"
+
+#include <QDebug>
+#include <QThread>
+#include <QTimer>
+
+#include "framepool.h"
+#include "ndistream.h"
+#include "pipelinestats.h"
+#include "stagescheduler.h"
+#include "statsreporter.h"
+#include "stripepool.h"
+
+// How often a pool nothing draws from is checked again for buffers a running
+// sender has yet to return.
+static const int PoolRetryMs = 200;
+
+StreamEngine::StreamEngine(QObject *parent)
+    : QObject(parent)
+    , m_stripePool(new StripePool)
+    , m_scheduler(new StageScheduler)
+    , m_stageWorkers(QThread::idealThreadCount())
+    , m_pinCores(false)
+    , m_statsReporter(new StatsReporter(this))
+    , m_poolRetryPending(false)
+    , m_running(false)
+{
+}
+
+StreamEngine::~StreamEngine()
+{
+    stop();
+
+    // Streams hold pacer and sender threads that use the stripe pool, and
+    // strands on the scheduler.
+    qDeleteAll(m_streams);
+    m_streams.clear();
+    delete m_scheduler;
+    delete m_stripePool;
+}
+
+NdiStream *StreamEngine::addStream(const StreamConfig &config)
+{
+    Q_ASSERT(!m_running);
+    NdiStream *stream = new NdiStream(config, m_stripePool, m_scheduler);
+    m_streams.push_back(stream);
+    return stream;
+}
+
+void StreamEngine::removeStream(NdiStream *stream)
+{
+    Q_ASSERT(!m_running);
+    if (m_streams.removeOne(stream))
+        delete stream;
+}
+
+void StreamEngine::setStageWorkers(int threadCount, bool pinCores)
+{
+    Q_ASSERT(!m_running);
+    m_stageWorkers = threadCount > 0 ? threadCount : QThread::idealThreadCount();
+    m_pinCores = pinCores;
+}
+
+int StreamEngine::start()
+{
+    Q_ASSERT(!m_running);
+    m_running = true;
+    m_scheduler->start(m_stageWorkers, m_pinCores);
+
+    // Streams acquire with their own buffer count as the limit, so a pool
+    // sized for the sum always has a buffer for a stream below its count: a
+    // stream that falls behind drops its own frames, not a peer's.
+    QList<NdiStream *> opened;
+    QMap<int, int> counts;
+    for (NdiStream *stream : m_streams) {
+        if (!stream->open())
+            continue;
+        opened.push_back(stream);
+        if (stream->videoBufferSize())
+            counts[stream->videoBufferSize()] += NdiStream::VideoBufferCount;
+        if (stream->audioBufferSize())
+            counts[stream->audioBufferSize()] += NdiStream::AudioBufferCount;
+    }
+
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        FramePool *pool = new FramePool;
+        pool->reset(it.value(), it.key());
+        m_pools.insert(it.key(), pool);
+    }
+
+    m_statsReporter->clearStreams();
+    for (NdiStream *stream : opened) {
+        FramePool *videoPool = m_pools.value(stream->videoBufferSize());
+        FramePool *audioPool = m_pools.value(stream->audioBufferSize());
+        stream->start(videoPool, audioPool);
+        registerStats(stream);
+    }
+    m_statsReporter->start();
+
+    qDebug() << "Streaming" << opened.size() << "of" << m_streams.size() << "streams from" << counts.size() << "buffer pools on"
+             << m_scheduler->threadCount() << (m_pinCores ? "pinned" : "") << "stage workers";
+    return opened.size();
+}
+
+void StreamEngine::stop()
+{
+    if (!m_running)
+        return;
+
+    for (NdiStream *stream : m_streams)
+        stream->stop();
+    m_statsReporter->stop();
+    m_scheduler->stop();
+
+    // The senders have flushed NDI and returned every buffer by now.
+    qDeleteAll(m_pools);
+    m_pools.clear();
+    qDeleteAll(m_extraPools);
+    m_extraPools.clear();
+    m_running = false;
+}
+
+double StreamEngine::reconfigure(NdiStream *stream, const StreamConfig &config)
+{
+    if (!m_running) {
+        stream->setConfig(config);
+        return 0;
+    }
+
+    const int64_t started = pipelineClockNs();
+    const int changes = NdiStream::configChanges(stream->config(), config);
+    if (changes == NdiStream::NoChange && stream->isRunning())
+        return 0;
+
+    // A stream keeps the pools it has as long as its buffers still fit. A
+    // pool holds a full buffer count for every stream started on it, so one
+    // that grows gets a pool of its own rather than a larger share of a
+    // shared one, whose peers would then run short; the share it leaves
+    // behind stays allocated until no stream uses that pool.
+    FramePool *videoPool = stream->videoPool();
+    FramePool *audioPool = stream->audioPool();
+    m_statsReporter->removeStream(&stream->videoStats());
+    m_statsReporter->removeStream(&stream->audioStats());
+    if ((changes & NdiStream::SenderChange) || !stream->isRunning()) {
+        stream->stop();
+        stream->setConfig(config);
+        if (stream->open()) {
+            stream->start(poolFor(videoPool, stream->videoBufferSize(), NdiStream::VideoBufferCount),
+                          poolFor(audioPool, stream->audioBufferSize(), NdiStream::AudioBufferCount));
+        }
+    } else {
+        stream->reconfigure(config, changes);
+        stream->resume(poolFor(videoPool, stream->videoBufferSize(), NdiStream::VideoBufferCount),
+                       poolFor(audioPool, stream->audioBufferSize(), NdiStream::AudioBufferCount));
+    }
+    if (stream->isRunning())
+        registerStats(stream);
+    freeUnusedPools();
+
+    const double ms = (pipelineClockNs() - started) / 1e6;
+    qDebug() << stream->config().ndiName << "reconfigured" << NdiStream::describeChanges(changes) << "in" << ms << "ms";
+    return ms;
+}
+
+FramePool *StreamEngine::poolFor(FramePool *current, int bufferSize, int count)
+{
+    if (!bufferSize)
+        return nullptr;
+    if (current && current->bufferSize() >= bufferSize)
+        return current;
+
+    FramePool *pool = new FramePool;
+    pool->reset(count, bufferSize);
+    m_extraPools.push_back(pool);
+    return pool;
+}
+
+// Frees pools no stream draws from any more once all their buffers are back.
+// A stream that moved to another pool without stopping may still be sending
+// a few of the old pool's buffers, so a busy pool is checked again shortly.
+void StreamEngine::freeUnusedPools()
+{
+    bool busy = false;
+    QList<FramePool *> used;
+    for (NdiStream *stream : m_streams) {
+        if (stream->videoPool())
+            used.push_back(stream->videoPool());
+        if (stream->audioPool())
+            used.push_back(stream->audioPool());
+    }
+
+    auto unused = [&](FramePool *pool) {
+        if (used.contains(pool))
+            return false;
+        if (pool->available() != pool->count()) {
+            busy = true;
+            return false;
+        }
+        delete pool;
+        return true;
+    };
+    for (auto it = m_pools.begin(); it != m_pools.end();) {
+        if (unused(it.value()))
+            it = m_pools.erase(it);
+        else
+            ++it;
+    }
+    for (auto it = m_extraPools.begin(); it != m_extraPools.end();) {
+        if (unused(*it))
+            it = m_extraPools.erase(it);
+        else
+            ++it;
+    }
+
+    if (busy && !m_poolRetryPending) {
+        m_poolRetryPending = true;
+        QTimer::singleShot(PoolRetryMs, this, [this] {
+            m_poolRetryPending = false;
+            if (m_running)
+                freeUnusedPools();
+        });
+    }
+}
+
+void StreamEngine::registerStats(NdiStream *stream)
+{
+    if (stream->hasVideo())
+        m_statsReporter->addStream(stream->config().ndiName + " video", &stream->videoStats(), stream->instance());
+    if (stream->hasAudio())
+        m_statsReporter->addStream(stream->config().ndiName + " audio", &stream->audioStats(), stream->instance());
+}
@@ -0,0 +1,69 @@
+#ifndef STREAMENGINE_H
+#define STREAMENGINE_H
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+
+#include "streamconfig.h"
+
+class FramePool;
+class NdiStream;
+class StageScheduler;
+class StatsReporter;
+class StripePool;
+
+// Runs any number of NdiStreams on one set of conversion workers and one
+// stage scheduler. Buffer pools are shared by every stream whose buffers have
+// the same size, so the memory held grows with the number of distinct
+// formats, not streams.
+class StreamEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamEngine(QObject *parent = nullptr);
+    ~StreamEngine();
+
+    // Only while stopped. The engine owns the stream.
+    NdiStream *addStream(const StreamConfig &config);
+    void removeStream(NdiStream *stream);
+    const QList<NdiStream *> &streams() const { return m_streams; }
+
+    // Only while stopped. Threads shared by every stream's capture,
+    // conversion and send stages, by default one per core, optionally
+    // pinned to a core each.
+    void setStageWorkers(int threadCount, bool pinCores);
+    StageScheduler *scheduler() const { return m_scheduler; }
+
+    // Opens every stream, sizes the shared pools and starts the streams that
+    // could be opened. Returns how many are running.
+    int start();
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    // Applies config to one stream. While running, only what changed is
+    // rebuilt and every other stream keeps sending; a new NDI name restarts
+    // just that stream. Returns how long the change took in milliseconds.
+    double reconfigure(NdiStream *stream, const StreamConfig &config);
+
+    StatsReporter *statsReporter() const { return m_statsReporter; }
+
+private:
+    FramePool *poolFor(FramePool *current, int bufferSize, int count);
+    void freeUnusedPools();
+    void registerStats(NdiStream *stream);
+
+    StripePool *m_stripePool;
+    StageScheduler *m_scheduler;
+    int m_stageWorkers;
+    bool m_pinCores;
+    StatsReporter *m_statsReporter;
+    QList<NdiStream *> m_streams;
+    QMap<int, FramePool *> m_pools;     // by buffer size
+    QList<FramePool *> m_extraPools;    // added by reconfigure(), freed once unused
+    bool m_poolRetryPending;
+    bool m_running;
+};
+
+#endif // STREAMENGINE_H
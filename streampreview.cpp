@@ -0,0 +1,329 @@
+#include "streampreview.h"
+#include "cpufeatures.h"
+#include "pipelinestats.h"
+
+#include <QMutexLocker>
+#include <string.h>
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+// YUV to RGB in 16-bit fixed point with 6 fractional bits, which is plenty
+// for a thumbnail and keeps every product within a signed 16-bit lane.
+struct YuvCoefficients {
+    int16_t offset;     // black level of Y
+    int16_t y;
+    int16_t vr;
+    int16_t ug;
+    int16_t vg;
+    int16_t ub;
+};
+
+// By range, then BT.601, BT.709 and BT.2020.
+static const YuvCoefficients Coefficients[2][3] = {
+    { { 16, 75, 102, 25, 52, 129 }, { 16, 75, 115, 14, 34, 135 }, { 16, 75, 107, 12, 42, 137 } },
+    { { 0, 64, 90, 22, 46, 113 }, { 0, 64, 101, 12, 30, 119 }, { 0, 64, 94, 11, 37, 120 } }
+};
+
+static inline uint8_t clampByte(int v)
+{
+    return uint8_t(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static void yuvToRGB32_C(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, int count,
+                         const YuvCoefficients &k)
+{
+    for (int i = 0; i < count; ++i) {
+        const int luma = (y[i] - k.offset) * k.y + 32;
+        const int cb = u[i] - 128, cr = v[i] - 128;
+        const uint8_t r = clampByte((luma + cr * k.vr) >> 6);
+        const uint8_t g = clampByte((luma - cb * k.ug - cr * k.vg) >> 6);
+        const uint8_t b = clampByte((luma + cb * k.ub) >> 6);
+        dst[i] = 0xff000000u | uint32_t(r) << 16 | uint32_t(g) << 8 | b;
+    }
+}
+
+static void packRGB32_C(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint32_t *dst, int count)
+{
+    for (int i = 0; i < count; ++i)
+        dst[i] = 0xff000000u | uint32_t(r[i]) << 16 | uint32_t(g[i]) << 8 | b[i];
+}
+
+#ifdef CPU_X86
+// Interleaves the low eight bytes of b, g and r into eight opaque QRgb words.
+CPU_TARGET_SSE2 static inline void storeRGB32_SSE2(uint32_t *dst, __m128i b, __m128i g, __m128i r)
+{
+    const __m128i bg = _mm_unpacklo_epi8(b, g);
+    const __m128i ra = _mm_unpacklo_epi8(r, _mm_set1_epi8(char(0xff)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4), _mm_unpackhi_epi16(bg, ra));
+}
+
+CPU_TARGET_SSE2 static inline __m128i load8_SSE2(const uint8_t *p)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), _mm_setzero_si128());
+}
+
+// Matches yuvToRGB32_C: the saturating adds only clip sums that would be
+// clamped to 255 anyway.
+CPU_TARGET_SSE2 static void yuvToRGB32_SSE2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst,
+                                            int count, const YuvCoefficients &k)
+{
+    const __m128i offset = _mm_set1_epi16(k.offset);
+    const __m128i round = _mm_set1_epi16(32);
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i ky = _mm_set1_epi16(k.y), kvr = _mm_set1_epi16(k.vr), kug = _mm_set1_epi16(k.ug);
+    const __m128i kvg = _mm_set1_epi16(k.vg), kub = _mm_set1_epi16(k.ub);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i luma = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(load8_SSE2(y + i), offset), ky), round);
+        const __m128i cb = _mm_sub_epi16(load8_SSE2(u + i), half);
+        const __m128i cr = _mm_sub_epi16(load8_SSE2(v + i), half);
+        const __m128i r = _mm_srai_epi16(_mm_adds_epi16(luma, _mm_mullo_epi16(cr, kvr)), 6);
+        const __m128i g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(luma, _mm_mullo_epi16(cb, kug)),
+                                                        _mm_mullo_epi16(cr, kvg)), 6);
+        const __m128i b = _mm_srai_epi16(_mm_adds_epi16(luma, _mm_mullo_epi16(cb, kub)), 6);
+        storeRGB32_SSE2(dst + i, _mm_packus_epi16(b, b), _mm_packus_epi16(g, g), _mm_packus_epi16(r, r));
+    }
+    yuvToRGB32_C(y + i, u + i, v + i, dst + i, count - i, k);
+}
+
+CPU_TARGET_SSE2 static void packRGB32_SSE2(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint32_t *dst, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        storeRGB32_SSE2(dst + i, _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i)),
+                        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(g + i)),
+                        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(r + i)));
+    }
+    packRGB32_C(r + i, g + i, b + i, dst + i, count - i);
+}
+#endif
+
+static void yuvToRGB32(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, int count,
+                       const YuvCoefficients &k)
+{
+#ifdef CPU_X86
+    static const bool sse2 = cpuHasSSE2();
+    if (sse2) {
+        yuvToRGB32_SSE2(y, u, v, dst, count, k);
+        return;
+    }
+#endif
+    yuvToRGB32_C(y, u, v, dst, count, k);
+}
+
+static void packRGB32(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint32_t *dst, int count)
+{
+#ifdef CPU_X86
+    static const bool sse2 = cpuHasSSE2();
+    if (sse2) {
+        packRGB32_SSE2(r, g, b, dst, count);
+        return;
+    }
+#endif
+    packRGB32_C(r, g, b, dst, count);
+}
+
+static inline uint8_t average2(int a, int b)
+{
+    return uint8_t((a + b + 1) >> 1);
+}
+
+StreamPreview::StreamPreview()
+    : m_enabled(false)
+    , m_width(DefaultWidth)
+    , m_intervalMs(DefaultIntervalMs)
+    , m_matrix(MatrixAuto)
+    , m_range(LimitedRange)
+    , m_dueNs(0)
+    , m_columnsFor(0)
+    , m_serial(0)
+    , m_costNs(0)
+    , m_dropped(0)
+{
+}
+
+void StreamPreview::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+void StreamPreview::setWidth(int width)
+{
+    m_width = qMax(16, width);
+}
+
+void StreamPreview::setInterval(int ms)
+{
+    m_intervalMs = qMax(1, ms);
+}
+
+void StreamPreview::setColorimetry(ColorMatrix matrix, ColorRange range)
+{
+    m_matrix = matrix;
+    m_range = range;
+}
+
+void StreamPreview::offer(const NDIlib_video_frame_v2_t &frame, int64_t nowNs)
+{
+    if (!m_enabled.load(std::memory_order_relaxed) || nowNs < m_dueNs)
+        return;
+    m_dueNs = nowNs + int64_t(m_intervalMs.load(std::memory_order_relaxed)) * 1000000;
+    capture(frame);
+}
+
+bool StreamPreview::capture(const NDIlib_video_frame_v2_t &frame)
+{
+    const int64_t start = pipelineClockNs();
+    if (!decimate(frame))
+        return false;
+
+    if (!m_lock.tryLock()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_front.swap(m_work);
+    qSwap(m_frontSize, m_workSize);
+    ++m_serial;
+    m_lock.unlock();
+
+    m_costNs.store(pipelineClockNs() - start, std::memory_order_relaxed);
+    return true;
+}
+
+// Each thumbnail pixel averages a pixel pair on an even column of an even row,
+// which shares one chroma sample in every subsampled format. Reading a second
+// row as well would smooth little and double the cache lines touched.
+bool StreamPreview::decimate(const NDIlib_video_frame_v2_t &frame)
+{
+    const int xres = frame.xres, yres = frame.yres;
+    if (xres < 2 || yres < 2 || !frame.p_data)
+        return false;
+
+    const float aspect = frame.picture_aspect_ratio > 0 ? frame.picture_aspect_ratio : float(xres) / yres;
+    const int width = qMin(m_width.load(std::memory_order_relaxed), xres / 2);
+    const int height = qBound(1, int(width / aspect + 0.5f), yres / 2);
+    if (m_columnsFor != xres || m_columns.size() != width) {
+        m_columns.resize(width);
+        for (int x = 0; x < width; ++x)
+            m_columns[x] = int(int64_t(x) * xres / width) & ~1;
+        m_columnsFor = xres;
+        m_planes.resize(width * 3);
+    }
+    if (m_workSize != QSize(width, height)) {
+        m_work.resize(width * height);
+        m_workSize = QSize(width, height);
+    }
+
+    int matrix = m_matrix.load(std::memory_order_relaxed);
+    if (matrix == MatrixAuto)
+        matrix = resolveColorMatrix(MatrixAuto, yres);
+    const YuvCoefficients &k = Coefficients[m_range.load(std::memory_order_relaxed) == FullRange][matrix - 1];
+
+    const int *columns = m_columns.constData();
+    uint8_t *c0 = m_planes.data(), *c1 = c0 + width, *c2 = c1 + width;
+    const uint8_t *data = frame.p_data;
+    const int stride = frame.line_stride_in_bytes;
+    const uint8_t *chroma = data + stride * yres;
+    const int chromaStride = stride / 2;
+    const int chromaPlane = chromaStride * ((yres + 1) / 2);
+
+    for (int y = 0; y < height; ++y) {
+        const int sy = int(int64_t(y) * yres / height) & ~1;
+        const uint8_t *row = data + sy * stride;
+        uint32_t *out = m_work.data() + y * width;
+        switch (frame.FourCC) {
+        case NDIlib_FourCC_video_type_UYVY:
+        case NDIlib_FourCC_video_type_UYVA:
+            for (int x = 0; x < width; ++x) {
+                const uint8_t *p = row + columns[x] * 2;
+                c0[x] = average2(p[1], p[3]);
+                c1[x] = p[0];
+                c2[x] = p[2];
+            }
+            yuvToRGB32(c0, c1, c2, out, width, k);
+            break;
+        case NDIlib_FourCC_video_type_P216:
+        case NDIlib_FourCC_video_type_PA16: {
+            // Little-endian 16-bit samples: only the high bytes are read.
+            const uint8_t *uv = chroma + sy * stride;
+            for (int x = 0; x < width; ++x) {
+                const int i = columns[x] * 2;
+                c0[x] = average2(row[i + 1], row[i + 3]);
+                c1[x] = uv[i + 1];
+                c2[x] = uv[i + 3];
+            }
+            yuvToRGB32(c0, c1, c2, out, width, k);
+            break;
+        }
+        case NDIlib_FourCC_video_type_NV12: {
+            const uint8_t *uv = chroma + (sy / 2) * stride;
+            for (int x = 0; x < width; ++x) {
+                const int i = columns[x];
+                c0[x] = average2(row[i], row[i + 1]);
+                c1[x] = uv[i];
+                c2[x] = uv[i + 1];
+            }
+            yuvToRGB32(c0, c1, c2, out, width, k);
+            break;
+        }
+        case NDIlib_FourCC_video_type_I420:
+        case NDIlib_FourCC_video_type_YV12: {
+            const uint8_t *first = chroma + (sy / 2) * chromaStride, *second = first + chromaPlane;
+            const bool i420 = frame.FourCC == NDIlib_FourCC_video_type_I420;
+            const uint8_t *u = i420 ? first : second, *v = i420 ? second : first;
+            for (int x = 0; x < width; ++x) {
+                const int i = columns[x];
+                c0[x] = average2(row[i], row[i + 1]);
+                c1[x] = u[i / 2];
+                c2[x] = v[i / 2];
+            }
+            yuvToRGB32(c0, c1, c2, out, width, k);
+            break;
+        }
+        case NDIlib_FourCC_video_type_RGBA:
+        case NDIlib_FourCC_video_type_RGBX:
+        case NDIlib_FourCC_video_type_BGRA:
+        case NDIlib_FourCC_video_type_BGRX: {
+            // c0 gets the first byte of each pixel, c2 the third.
+            for (int x = 0; x < width; ++x) {
+                const uint8_t *p = row + columns[x] * 4;
+                c0[x] = average2(p[0], p[4]);
+                c1[x] = average2(p[1], p[5]);
+                c2[x] = average2(p[2], p[6]);
+            }
+            const bool rgb = frame.FourCC == NDIlib_FourCC_video_type_RGBA || frame.FourCC == NDIlib_FourCC_video_type_RGBX;
+            if (rgb)
+                packRGB32(c0, c1, c2, out, width);
+            else
+                packRGB32(c2, c1, c0, out, width);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StreamPreview::latest(QImage *image, quint64 *serial)
+{
+    QMutexLocker locker(&m_lock);
+    if (m_serial == *serial || m_frontSize.isEmpty())
+        return false;
+    if (image->size() != m_frontSize || image->format() != QImage::Format_RGB32)
+        *image = QImage(m_frontSize, QImage::Format_RGB32);
+    const int width = m_frontSize.width();
+    for (int y = 0; y < m_frontSize.height(); ++y)
+        memcpy(image->scanLine(y), m_front.constData() + y * width, width * sizeof(uint32_t));
+    *serial = m_serial;
+    return true;
+}
+
+void StreamPreview::clear()
+{
+    QMutexLocker locker(&m_lock);
+    m_frontSize = QSize();
+}
@@ -0,0 +1,84 @@
+#ifndef STREAMPREVIEW_H
+#define STREAMPREVIEW_H
+
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QVector>
+#include <Processing.NDI.Lib.h>
+#include <atomic>
+#include <stdint.h>
+
+#include "colorconvert.h"
+
+// A confidence monitor for one stream: thumbnails of the video frames as they
+// are handed to NDI, so an operator sees what receivers get without running
+// a receiver.
+//
+// The sender offers every frame it sends, and unless a thumbnail is due, at
+// most one per interval whatever the frame rate, that costs a comparison. A
+// due thumbnail averages a pixel pair every few pixels of every few rows of
+// the frame, in whatever format it went out in, and converts only those
+// samples to RGB32, so its cost follows the thumbnail's size rather than the
+// frame's. It is published only if the reader is not copying the previous
+// one at that moment and dropped otherwise, so the sender never waits.
+class StreamPreview
+{
+public:
+    static const int DefaultWidth = 240;
+    static const int DefaultIntervalMs = 200;
+
+    StreamPreview();
+
+    // Any time, from any thread. Off until enabled.
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setWidth(int width);
+    void setInterval(int ms);
+    // How YUV frames were encoded; MatrixAuto goes by the frame height, as
+    // receivers do.
+    void setColorimetry(ColorMatrix matrix, ColorRange range);
+
+    // Sender side, with each frame sent while NDI still holds it.
+    void offer(const NDIlib_video_frame_v2_t &frame, int64_t nowNs);
+    // Thumbnails the frame now, whether or not one is due. False if its
+    // format has no thumbnail or the reader held the last one.
+    bool capture(const NDIlib_video_frame_v2_t &frame);
+
+    // Reader side. Copies the latest thumbnail into image if it is newer
+    // than serial, which is updated.
+    bool latest(QImage *image, quint64 *serial);
+    // Forgets the last thumbnail, such as when the stream stops.
+    void clear();
+
+    // What the last thumbnail took, and how many were dropped for a busy reader.
+    int64_t lastCostNs() const { return m_costNs.load(std::memory_order_relaxed); }
+    quint64 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    bool decimate(const NDIlib_video_frame_v2_t &frame);
+
+    std::atomic<bool> m_enabled;
+    std::atomic<int> m_width;
+    std::atomic<int> m_intervalMs;
+    std::atomic<int> m_matrix;
+    std::atomic<int> m_range;
+
+    // Sender only.
+    int64_t m_dueNs;
+    QVector<int> m_columns;     // first source column of each thumbnail pixel
+    int m_columnsFor;           // source width the columns were laid out for
+    QVector<uint8_t> m_planes;  // one thumbnail row of Y, U, V or R, G, B
+    QVector<uint32_t> m_work;
+    QSize m_workSize;
+
+    QMutex m_lock;              // the sender only ever tries it
+    QVector<uint32_t> m_front;
+    QSize m_frontSize;
+    quint64 m_serial;
+
+    std::atomic<int64_t> m_costNs;
+    std::atomic<quint64> m_dropped;
+};
+
+#endif // STREAMPREVIEW_H
@@ -0,0 +1,341 @@
+#include "streamrecorder.h"
+
+#include <QDebug>
+#include <QVarLengthArray>
+#include <string.h>
+
+#include "pipelinestats.h"
+
+using namespace RecordFormat;
+
+// Writes go out in whole blocks of this size, aligned in the file.
+static const qint64 BlockBytes = 4 << 20;
+static const int BlockAlign = 4096;
+static const unsigned long WriterWaitMs = 100;
+
+StreamRecorder::StreamRecorder(QObject *parent)
+    : QThread(parent)
+    , m_block(nullptr)
+    , m_blockFill(0)
+    , m_fileOffset(0)
+    , m_writeFailed(false)
+    , m_isRunning(false)
+    , m_recorded(0)
+    , m_skipped(0)
+{
+    for (Ring &ring : m_rings) {
+        ring.data = nullptr;
+        ring.capacity = 0;
+        ring.head = 0;
+        ring.tail = 0;
+    }
+    for (int c = 0; c < ChannelCount; ++c) {
+        m_oversized[c] = 0;
+        m_oversizeReported[c] = false;
+    }
+}
+
+StreamRecorder::~StreamRecorder()
+{
+    Stop();
+}
+
+qint64 StreamRecorder::ringBytesFor(qint64 frameBytes)
+{
+    const qint64 chunk = sizeof(ChunkHeader) + paddedSize(uint32_t(frameBytes));
+    return qMax<qint64>(DefaultRingBytes, MinRingFrames * chunk);
+}
+
+bool StreamRecorder::Start(const QString &path, qint64 videoRingBytes, qint64 audioRingBytes)
+{
+    Q_ASSERT(!isRunning());
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        qWarning() << "Cannot record to" << path << m_file.errorString();
+        return false;
+    }
+
+    const qint64 ringBytes[ChannelCount] = { videoRingBytes, audioRingBytes };
+    for (int c = 0; c < ChannelCount; ++c) {
+        Ring &ring = m_rings[c];
+        const quint64 capacity = (quint64(qMax<qint64>(ringBytes[c], 1 << 20)) + BlockAlign - 1) & ~quint64(BlockAlign - 1);
+        ring.data = static_cast<uint8_t *>(qMallocAligned(capacity, BlockAlign));
+        ring.capacity = capacity;
+        ring.head = 0;
+        ring.tail = 0;
+    }
+    m_block = static_cast<uint8_t *>(qMallocAligned(BlockBytes, BlockAlign));
+    m_blockFill = 0;
+    m_fileOffset = 0;
+    m_index.clear();
+    m_writeFailed = false;
+    m_recorded = 0;
+    m_skipped = 0;
+    for (int c = 0; c < ChannelCount; ++c) {
+        m_oversized[c] = 0;
+        m_oversizeReported[c] = false;
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FileMagic, sizeof(header.magic));
+    header.version = Version;
+    header.headerSize = sizeof(header);
+    header.startNs = pipelineClockNs();
+    stage(&header, sizeof(header));
+
+    m_isRunning = true;
+    start(QThread::LowPriority);
+    return true;
+}
+
+void StreamRecorder::Stop()
+{
+    if (!m_file.isOpen())
+        return;
+
+    // The senders are stopped by now, so the writer drains everything.
+    m_isRunning = false;
+    m_dataReady.notify();
+    wait();
+
+    ChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ChunkMagic;
+    header.type = IndexChunk;
+    header.payloadSize = uint32_t(m_index.size() * sizeof(IndexEntry));
+    header.paddedSize = paddedSize(header.payloadSize);
+    header.sendNs = pipelineClockNs();
+
+    IndexTrailer trailer;
+    trailer.magic = TrailerMagic;
+    trailer.count = uint32_t(m_index.size());
+    trailer.indexOffset = m_fileOffset + m_blockFill;
+
+    static const uint8_t zeros[ChunkAlign] = {};
+    stage(&header, sizeof(header));
+    stage(m_index.constData(), header.payloadSize);
+    stage(zeros, header.paddedSize - header.payloadSize);
+    stage(&trailer, sizeof(trailer));
+    flushBlock(m_blockFill);
+    m_file.close();
+
+    qDebug() << "Recorded" << RecordedFrames() << "frames," << m_fileOffset / (1 << 20) << "MB to" << m_file.fileName()
+             << "-" << SkippedFrames() << "skipped because the disk fell behind";
+
+    for (Ring &ring : m_rings) {
+        qFreeAligned(ring.data);
+        ring.data = nullptr;
+        ring.capacity = 0;
+    }
+    qFreeAligned(m_block);
+    m_block = nullptr;
+    m_index.clear();
+}
+
+void StreamRecorder::RecordVideo(const NDIlib_video_frame_v2_t &frame, int len, int64_t sendNs)
+{
+    ChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = VideoChunk;
+    header.sendNs = sendNs;
+    header.timecode = frame.timecode;
+    header.params[0] = frame.xres;
+    header.params[1] = frame.yres;
+    header.params[2] = frame.line_stride_in_bytes;
+    header.params[3] = frame.FourCC;
+    header.params[4] = frame.frame_rate_N;
+    header.params[5] = frame.frame_rate_D;
+
+    const uint8_t *planes[] = { frame.p_data };
+    const int sizes[] = { len };
+    append(VideoChannel, header, planes, sizes, 1);
+}
+
+void StreamRecorder::RecordAudio(const NDIlib_audio_frame_v2_t &frame, int64_t sendNs)
+{
+    ChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = AudioChunk;
+    header.sendNs = sendNs;
+    header.timecode = frame.timecode;
+    header.params[0] = frame.sample_rate;
+    header.params[1] = frame.no_channels;
+    header.params[2] = frame.no_samples;
+    header.params[3] = frame.no_samples * int(sizeof(float));
+
+    // Channels are stored back to back, whatever their stride was.
+    const int channels = frame.no_channels;
+    QVarLengthArray<const uint8_t *, 16> planes(channels);
+    QVarLengthArray<int, 16> sizes(channels);
+    for (int c = 0; c < channels; ++c) {
+        planes[c] = reinterpret_cast<const uint8_t *>(frame.p_data) + c * frame.channel_stride_in_bytes;
+        sizes[c] = header.params[3];
+    }
+    append(AudioChannel, header, planes.constData(), sizes.constData(), channels);
+}
+
+void StreamRecorder::append(Channel channel, const ChunkHeader &chunk, const uint8_t *const *planes,
+                            const int *planeSizes, int planeCount)
+{
+    Ring &ring = m_rings[channel];
+    if (!ring.data)
+        return;
+
+    ChunkHeader header = chunk;
+    header.magic = ChunkMagic;
+    header.payloadSize = 0;
+    for (int i = 0; i < planeCount; ++i)
+        header.payloadSize += planeSizes[i];
+    header.paddedSize = paddedSize(header.payloadSize);
+
+    const quint64 size = sizeof(header) + header.paddedSize;
+    const quint64 head = ring.head.load(std::memory_order_relaxed);
+    if (size > ring.capacity - (head - ring.tail.load(std::memory_order_acquire))) {
+        m_skipped.fetch_add(1, std::memory_order_relaxed);
+        // The writer reports it; a sender must not stop to log.
+        if (size > ring.capacity && size > m_oversized[channel].load(std::memory_order_relaxed)) {
+            m_oversized[channel].store(size, std::memory_order_relaxed);
+            m_dataReady.notify();
+        }
+        return;
+    }
+
+    // Copies into the ring at a running position, wrapping as needed.
+    quint64 at = head;
+    auto put = [&](const void *src, quint64 len) {
+        const uint8_t *s = static_cast<const uint8_t *>(src);
+        while (len > 0) {
+            const quint64 offset = at % ring.capacity;
+            const quint64 n = qMin(len, ring.capacity - offset);
+            memcpy(ring.data + offset, s, n);
+            s += n;
+            at += n;
+            len -= n;
+        }
+    };
+    put(&header, sizeof(header));
+    for (int i = 0; i < planeCount; ++i)
+        put(planes[i], planeSizes[i]);
+    // Padding bytes are left as they are; readers only look at payloadSize.
+    ring.head.store(head + size, std::memory_order_release);
+    m_recorded.fetch_add(1, std::memory_order_relaxed);
+    m_dataReady.notify();
+}
+
+void StreamRecorder::copyFromRing(const Ring &ring, quint64 at, void *dst, quint64 len) const
+{
+    uint8_t *d = static_cast<uint8_t *>(dst);
+    while (len > 0) {
+        const quint64 offset = at % ring.capacity;
+        const quint64 n = qMin(len, ring.capacity - offset);
+        memcpy(d, ring.data + offset, n);
+        d += n;
+        at += n;
+        len -= n;
+    }
+}
+
+// Moves one chunk from ring into the write blocks and indexes it.
+bool StreamRecorder::drainOne(Ring &ring)
+{
+    const quint64 tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail == ring.head.load(std::memory_order_acquire))
+        return false;
+
+    ChunkHeader header;
+    copyFromRing(ring, tail, &header, sizeof(header));
+    const quint64 size = sizeof(header) + header.paddedSize;
+
+    IndexEntry entry;
+    entry.offset = m_fileOffset + m_blockFill;
+    entry.sendNs = header.sendNs;
+    entry.type = header.type;
+    entry.reserved = 0;
+    m_index.push_back(entry);
+
+    quint64 at = tail;
+    quint64 left = size;
+    while (left > 0) {
+        const quint64 n = qMin<quint64>(left, BlockBytes - m_blockFill);
+        copyFromRing(ring, at, m_block + m_blockFill, n);
+        m_blockFill += n;
+        at += n;
+        left -= n;
+        if (m_blockFill == BlockBytes)
+            flushBlock(BlockBytes);
+    }
+    ring.tail.store(tail + size, std::memory_order_release);
+    return true;
+}
+
+void StreamRecorder::stage(const void *data, quint64 len)
+{
+    const uint8_t *s = static_cast<const uint8_t *>(data);
+    while (len > 0) {
+        const quint64 n = qMin<quint64>(len, BlockBytes - m_blockFill);
+        memcpy(m_block + m_blockFill, s, n);
+        m_blockFill += n;
+        s += n;
+        len -= n;
+        if (m_blockFill == BlockBytes)
+            flushBlock(BlockBytes);
+    }
+}
+
+bool StreamRecorder::flushBlock(qint64 len)
+{
+    if (len > 0 && !m_writeFailed && m_file.write(reinterpret_cast<const char *>(m_block), len) != len) {
+        qWarning() << "Recording to" << m_file.fileName() << "failed:" << m_file.errorString();
+        m_writeFailed = true;
+    }
+    m_fileOffset += len;
+    m_blockFill = 0;
+    return !m_writeFailed;
+}
+
+void StreamRecorder::run()
+{
+    Ring &video = m_rings[VideoChannel];
+    Ring &audio = m_rings[AudioChannel];
+    auto pending = [](const Ring &ring) {
+        return ring.tail.load(std::memory_order_relaxed) != ring.head.load(std::memory_order_acquire);
+    };
+
+    for (;;) {
+        // Of the two next chunks, the earlier send goes first, so the file
+        // stays close to send order.
+        while (pending(video) || pending(audio)) {
+            Ring *next = &video;
+            if (!pending(video)) {
+                next = &audio;
+            } else if (pending(audio)) {
+                int64_t videoNs, audioNs;
+                copyFromRing(video, video.tail + offsetof(ChunkHeader, sendNs), &videoNs, sizeof(videoNs));
+                copyFromRing(audio, audio.tail + offsetof(ChunkHeader, sendNs), &audioNs, sizeof(audioNs));
+                if (audioNs < videoNs)
+                    next = &audio;
+            }
+            drainOne(*next);
+        }
+
+        for (int c = 0; c < ChannelCount; ++c) {
+            const quint64 oversized = m_oversized[c].load(std::memory_order_relaxed);
+            if (oversized && !m_oversizeReported[c]) {
+                qWarning() << "Recording to" << m_file.fileName() << "leaves out every"
+                           << (c == VideoChannel ? "video" : "audio") << "frame of" << oversized / 1024
+                           << "KB: the ring holds only" << m_rings[c].capacity / 1024 << "KB";
+                m_oversizeReported[c] = true;
+            }
+        }
+
+        if (!m_isRunning && !pending(video) && !pending(audio))
+            break;
+        m_dataReady.wait([&] {
+            return pending(video) || pending(audio) || !m_isRunning
+                || (m_oversized[VideoChannel] && !m_oversizeReported[VideoChannel])
+                || (m_oversized[AudioChannel] && !m_oversizeReported[AudioChannel]);
+        }, WriterWaitMs);
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef STREAMRECORDER_H
+#define STREAMRECORDER_H
+
+#include <QFile>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <Processing.NDI.Lib.h>
+#include <atomic>
+
+#include "recordformat.h"
+#include "waitevent.h"
+
+// Records what a stream's senders hand to NDI into a RecordFormat file.
+// Each sender copies its frames into its own lock-free ring right after the
+// send call and moves on; if the ring is full the frame is left out of the
+// recording rather than making the sender wait. A writer thread drains both
+// rings into page-aligned blocks and writes only whole blocks until Stop(),
+// which appends the timestamp index.
+class StreamRecorder : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum Channel {
+        VideoChannel,
+        AudioChannel,
+        ChannelCount
+    };
+
+    explicit StreamRecorder(QObject *parent = nullptr);
+    ~StreamRecorder();
+
+    // The ring bytes are the memory per channel; they bound how far the disk
+    // may fall behind before frames are skipped. A chunk larger than its
+    // ring can never be recorded, see ringBytesFor().
+    bool Start(const QString &path, qint64 videoRingBytes = DefaultRingBytes, qint64 audioRingBytes = DefaultRingBytes);
+    void Stop();
+
+    // Each from the one thread that sends that channel.
+    void RecordVideo(const NDIlib_video_frame_v2_t &frame, int len, int64_t sendNs);
+    void RecordAudio(const NDIlib_audio_frame_v2_t &frame, int64_t sendNs);
+
+    quint64 RecordedFrames() const { return m_recorded.load(std::memory_order_relaxed); }
+    quint64 SkippedFrames() const { return m_skipped.load(std::memory_order_relaxed); }
+    qint64 BytesWritten() const { return m_fileOffset; }
+
+    static const int DefaultRingBytes = 64 << 20;
+    // Frames of a channel its ring holds at least.
+    static const int MinRingFrames = 3;
+    // The ring size for a channel whose frames are at most frameBytes.
+    static qint64 ringBytesFor(qint64 frameBytes);
+
+protected:
+    void run() override;
+
+private:
+    struct Ring {
+        uint8_t *data;
+        quint64 capacity;
+        std::atomic<quint64> head;      // bytes appended, only grows
+        std::atomic<quint64> tail;      // bytes the writer has taken
+    };
+
+    void append(Channel channel, const RecordFormat::ChunkHeader &header, const uint8_t *const *planes,
+                const int *planeSizes, int planeCount);
+    bool drainOne(Ring &ring);
+    void copyFromRing(const Ring &ring, quint64 at, void *dst, quint64 len) const;
+    void stage(const void *data, quint64 len);
+    bool flushBlock(qint64 len);
+
+    Ring m_rings[ChannelCount];
+    QFile m_file;
+    uint8_t *m_block;
+    qint64 m_blockFill;
+    qint64 m_fileOffset;
+    QVector<RecordFormat::IndexEntry> m_index;
+    bool m_writeFailed;
+
+    std::atomic<bool> m_isRunning;
+    std::atomic<quint64> m_recorded;
+    std::atomic<quint64> m_skipped;
+    // Largest chunk per channel that could never fit its ring, and the
+    // writer's note of whether it said so.
+    std::atomic<quint64> m_oversized[ChannelCount];
+    bool m_oversizeReported[ChannelCount];
+    WaitEvent m_dataReady;
+};
+
+#endif // STREAMRECORDER_H
@@ -0,0 +1,126 @@
+#include "stripepool.h"
+
+StripePool::StripePool(int threadCount)
+    : m_fn(nullptr)
+    , m_ctx(nullptr)
+    , m_height(0)
+    , m_stripeRows(0)
+    , m_stripes(0)
+    , m_generation(0)
+    , m_open(false)
+    , m_quit(false)
+    , m_busy(0)
+    , m_nextStripe(0)
+    , m_remaining(0)
+{
+    for (int i = 1; i < threadCount; ++i) {
+        Worker *worker = new Worker(this);
+        m_workers.push_back(worker);
+        worker->start();
+    }
+}
+
+StripePool::~StripePool()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_workReady.wakeAll();
+    m_mutex.unlock();
+
+    for (Worker *worker : m_workers) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+void StripePool::dispatch(int height, int minStripeRows, StripeFn fn, void *ctx)
+{
+    if (height <= 0)
+        return;
+
+    const int threads = threadCount();
+    if (threads == 1 || height < minStripeRows * 2 || !m_dispatchMutex.tryLock()) {
+        fn(ctx, 0, height);
+        return;
+    }
+
+    // A few stripes per thread keeps the tail short when one core is busy
+    // with something else.
+    int stripes = qMin(threads * 4, height / minStripeRows);
+    int stripeRows = (height + stripes - 1) / stripes;
+    if (minStripeRows > 1)
+        stripeRows = (stripeRows + 1) & ~1;
+    stripes = (height + stripeRows - 1) / stripeRows;
+
+    m_mutex.lock();
+    m_fn = fn;
+    m_ctx = ctx;
+    m_height = height;
+    m_stripeRows = stripeRows;
+    m_stripes = stripes;
+    m_nextStripe.store(0);
+    m_remaining.store(stripes);
+    m_open = true;
+    ++m_generation;
+    m_workReady.wakeAll();
+    m_mutex.unlock();
+
+    drain(fn, ctx, height, stripeRows, stripes);
+
+    // Close the job only once no worker can still be looking at it, so the
+    // next dispatch may reset the stripe counter safely.
+    m_mutex.lock();
+    while (m_remaining.load() > 0 || m_busy > 0)
+        m_workDone.wait(&m_mutex);
+    m_open = false;
+    m_mutex.unlock();
+
+    m_dispatchMutex.unlock();
+}
+
+void StripePool::drain(StripeFn fn, void *ctx, int height, int stripeRows, int stripes)
+{
+    for (;;) {
+        const int stripe = m_nextStripe.fetch_add(1);
+        if (stripe >= stripes)
+            break;
+
+        const int y0 = stripe * stripeRows;
+        fn(ctx, y0, qMin(height, y0 + stripeRows));
+
+        if (m_remaining.fetch_sub(1) == 1) {
+            m_mutex.lock();
+            m_workDone.wakeAll();
+            m_mutex.unlock();
+        }
+    }
+}
+
+void StripePool::workerLoop()
+{
+    quint64 seen = 0;
+
+    m_mutex.lock();
+    for (;;) {
+        while (!m_quit && (seen == m_generation || !m_open))
+            m_workReady.wait(&m_mutex);
+        if (m_quit)
+            break;
+
+        seen = m_generation;
+        StripeFn fn = m_fn;
+        void *ctx = m_ctx;
+        const int height = m_height;
+        const int stripeRows = m_stripeRows;
+        const int stripes = m_stripes;
+        ++m_busy;
+        m_mutex.unlock();
+
+        drain(fn, ctx, height, stripeRows, stripes);
+
+        m_mutex.lock();
+        if (--m_busy == 0)
+            m_workDone.wakeAll();
+    }
+    m_mutex.unlock();
+}
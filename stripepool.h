@@ -0,0 +1,79 @@
+#ifndef STRIPEPOOL_H
+#define STRIPEPOOL_H
+
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+
+// Persistent pool that splits a frame into horizontal stripes and converts
+// them in parallel. The calling thread works on stripes too and run() only
+// returns once every stripe is done, so callers see a plain blocking call.
+// Streams on different threads may share a pool; while one frame is being
+// dispatched, other callers convert theirs alone rather than wait.
+class StripePool
+{
+public:
+    explicit StripePool(int threadCount = QThread::idealThreadCount());
+    ~StripePool();
+
+    // Calls fn(y0, y1) for disjoint row ranges covering [0, height). Stripe
+    // heights are even so 4:2:0 destinations never share a chroma row.
+    // Callers iterating over coarser units such as tile rows pass
+    // minStripeRows = 1, which also drops the even-height rounding.
+    template <typename Fn>
+    void run(int height, const Fn &fn, int minStripeRows = DefaultMinStripeRows)
+    {
+        dispatch(height, minStripeRows, &StripePool::invoke<Fn>, const_cast<Fn *>(&fn));
+    }
+
+    int threadCount() const { return m_workers.size() + 1; }
+
+    // Frames smaller than this many rows per thread are not worth waking
+    // workers for.
+    static const int DefaultMinStripeRows = 32;
+
+private:
+    typedef void (*StripeFn)(void *ctx, int y0, int y1);
+
+    class Worker : public QThread
+    {
+    public:
+        explicit Worker(StripePool *pool) : m_pool(pool) {}
+    protected:
+        void run() override { m_pool->workerLoop(); }
+    private:
+        StripePool *m_pool;
+    };
+
+    template <typename Fn>
+    static void invoke(void *ctx, int y0, int y1) { (*static_cast<Fn *>(ctx))(y0, y1); }
+
+    void dispatch(int height, int minStripeRows, StripeFn fn, void *ctx);
+    void drain(StripeFn fn, void *ctx, int height, int stripeRows, int stripes);
+    void workerLoop();
+
+    QVector<Worker *> m_workers;
+
+    QMutex m_dispatchMutex;
+    QMutex m_mutex;
+    QWaitCondition m_workReady;
+    QWaitCondition m_workDone;
+
+    // Current job; written under m_mutex while no worker is draining.
+    StripeFn m_fn;
+    void *m_ctx;
+    int m_height;
+    int m_stripeRows;
+    int m_stripes;
+    quint64 m_generation;
+    bool m_open;
+    bool m_quit;
+    int m_busy;
+
+    std::atomic<int> m_nextStripe;
+    std::atomic<int> m_remaining;
+};
+
+#endif // STRIPEPOOL_H
@@ -0,0 +1,134 @@
+#include "syntheticsource.h"
+
+#include <cmath>
+
+// SMPTE-style bars in QRgb order.
+static const uint32_t bars[] = {
+    0xffc0c0c0, 0xffc0c000, 0xff00c0c0, 0xff00c000,
+    0xffc000c0, 0xffc00000, 0xff0000c0, 0xff101010
+};
+static const int BarCount = sizeof(bars) / sizeof(bars[0]);
+
+static const double TwoPi = 6.283185307179586;
+
+SyntheticVideoSource::SyntheticVideoSource(Motion motion)
+    : m_motion(motion)
+    , m_width(0)
+    , m_height(0)
+    , m_stride(0)
+    , m_frame(0)
+    , m_boxX(0)
+    , m_boxY(0)
+{
+}
+
+bool SyntheticVideoSource::open(const QRect &geometry)
+{
+    if (geometry.width() <= 0 || geometry.height() <= 0)
+        return false;
+
+    m_width = geometry.width();
+    m_height = geometry.height();
+    m_frame = 0;
+
+    // Full motion scrolls a window across an image one period wider than the
+    // frame, so a new frame costs nothing to produce.
+    const int paintedWidth = m_motion == FullMotion ? m_width + ScrollPeriod : m_width;
+    m_stride = paintedWidth;
+    m_pixels.resize(m_stride * m_height);
+    paintBackground(0, 0, paintedWidth, m_height);
+
+    m_boxX = 0;
+    m_boxY = (m_height - BoxSize) / 2;
+    return true;
+}
+
+void SyntheticVideoSource::close()
+{
+    m_pixels.clear();
+    m_width = m_height = m_stride = 0;
+}
+
+void SyntheticVideoSource::paintBackground(int x0, int y0, int w, int h)
+{
+    // Top two thirds bars, then a horizontal luma ramp and a chroma ramp, all
+    // repeating every ScrollPeriod pixels so scrolling wraps seamlessly.
+    const int barsEnd = m_height * 2 / 3;
+    const int rampEnd = m_height * 5 / 6;
+    for (int y = y0; y < y0 + h; ++y) {
+        uint32_t *row = m_pixels.data() + y * m_stride;
+        for (int x = x0; x < x0 + w; ++x) {
+            const int phase = x % ScrollPeriod;
+            uint32_t pixel;
+            if (y < barsEnd) {
+                pixel = bars[phase * BarCount / ScrollPeriod];
+            } else if (y < rampEnd) {
+                const uint32_t v = phase;
+                pixel = 0xff000000 | (v << 16) | (v << 8) | v;
+            } else {
+                const uint32_t v = phase;
+                pixel = 0xff000000 | (v << 16) | ((255 - v) << 8) | ((v * 3) & 0xff);
+            }
+            row[x] = pixel;
+        }
+    }
+}
+
+void SyntheticVideoSource::paintBox(int x0, int y0, uint32_t colour)
+{
+    const int x1 = qMin(x0 + BoxSize, m_width);
+    const int y1 = qMin(y0 + BoxSize, m_height);
+    for (int y = qMax(y0, 0); y < y1; ++y) {
+        uint32_t *row = m_pixels.data() + y * m_stride;
+        for (int x = qMax(x0, 0); x < x1; ++x)
+            row[x] = colour;
+    }
+}
+
+bool SyntheticVideoSource::grab(CaptureFrame &frame)
+{
+    if (m_pixels.isEmpty())
+        return false;
+
+    int offset = 0;
+    if (m_motion == FullMotion) {
+        offset = int(m_frame % ScrollPeriod);
+    } else {
+        paintBackground(qMax(m_boxX, 0), qMax(m_boxY, 0), qMin(BoxSize, m_width - m_boxX), qMin(BoxSize, m_height - m_boxY));
+        const int travel = qMax(1, m_width - BoxSize);
+        m_boxX = int((m_frame * 8) % travel);
+        paintBox(m_boxX, m_boxY, 0xffffffff - uint32_t(m_frame & 0xff));
+    }
+
+    frame.data = reinterpret_cast<const uint8_t *>(m_pixels.constData() + offset);
+    frame.stride = m_stride * 4;
+    frame.width = m_width;
+    frame.height = m_height;
+    ++m_frame;
+    return true;
+}
+
+SyntheticAudioSource::SyntheticAudioSource(int sampleRate, int channels, double baseFrequency)
+    : m_sampleRate(sampleRate)
+    , m_channels(channels)
+    , m_phase(channels, 0.0)
+    , m_step(channels)
+{
+    for (int c = 0; c < channels; ++c)
+        m_step[c] = TwoPi * baseFrequency * (c + 1) / sampleRate;
+}
+
+void SyntheticAudioSource::generate(float *interleaved, int frames)
+{
+    const double amplitude = 0.25;  // -12 dBFS
+    for (int c = 0; c < m_channels; ++c) {
+        double phase = m_phase[c];
+        const double step = m_step[c];
+        float *out = interleaved + c;
+        for (int i = 0; i < frames; ++i) {
+            out[i * m_channels] = float(amplitude * std::sin(phase));
+            phase += step;
+        }
+        m_phase[c] = std::fmod(phase, TwoPi);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef SYNTHETICSOURCE_H
+#define SYNTHETICSOURCE_H
+
+#include <QVector>
+#include <stdint.h>
+
+#include "capturesource.h"
+
+// Deterministic moving test pattern, for test streams and benchmarks. The
+// content only depends on the frame index, so runs are comparable.
+class SyntheticVideoSource : public CaptureSource
+{
+public:
+    enum Motion {
+        FullMotion,     // colour bars and ramps scrolling sideways, every tile changes
+        MovingBox       // static bars with one box moving across, few tiles change
+    };
+
+    explicit SyntheticVideoSource(Motion motion = FullMotion);
+
+    // Only the size of geometry is used.
+    bool open(const QRect &geometry) override;
+    void close() override;
+    bool grab(CaptureFrame &frame) override;
+
+    const char *name() const override { return "synthetic"; }
+
+    quint64 frameIndex() const { return m_frame; }
+
+    // Period of the scrolling pattern in pixels.
+    static const int ScrollPeriod = 256;
+    static const int BoxSize = 128;
+
+private:
+    void paintBackground(int x, int y, int w, int h);
+    void paintBox(int x, int y, uint32_t colour);
+
+    Motion m_motion;
+    int m_width;
+    int m_height;
+    int m_stride;
+    QVector<uint32_t> m_pixels;
+    quint64 m_frame;
+    int m_boxX;
+    int m_boxY;
+};
+
+// Sine tones, one frequency per channel, as interleaved float samples.
+class SyntheticAudioSource
+{
+public:
+    SyntheticAudioSource(int sampleRate, int channels, double baseFrequency = 440.0);
+
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+
+    // Channel c plays baseFrequency * (c + 1) at -12 dBFS.
+    void generate(float *interleaved, int frames);
+
+private:
+    int m_sampleRate;
+    int m_channels;
+    QVector<double> m_phase;
+    QVector<double> m_step;
+};
+
+#endif // SYNTHETICSOURCE_H
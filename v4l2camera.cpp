@@ -0,0 +1,361 @@
+#include "v4l2camera.h"
+
+#include <QDebug>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+#include "pipelinestats.h"
+
+// How long the capture thread may block before rechecking m_isRunning.
+static const int PollTimeoutMs = 100;
+
+static int xioctl(int fd, unsigned long request, void *arg)
+{
+    int r;
+    do {
+        r = ioctl(fd, request, arg);
+    } while (r < 0 && errno == EINTR);
+    return r;
+}
+
+static quint32 fourccOf(V4l2Camera::PixelFormat format)
+{
+    switch (format) {
+    case V4l2Camera::UYVY: return V4L2_PIX_FMT_UYVY;
+    case V4l2Camera::YUYV: return V4L2_PIX_FMT_YUYV;
+    case V4l2Camera::NV12: return V4L2_PIX_FMT_NV12;
+    default: return 0;
+    }
+}
+
+// The cheapest format the device offers to turn into UYVY.
+static V4l2Camera::PixelFormat pickFormat(int fd)
+{
+    bool offered[4] = { false, false, false, false };
+    v4l2_fmtdesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    while (xioctl(fd, VIDIOC_ENUM_FMT, &desc) == 0) {
+        for (int f = V4l2Camera::UYVY; f <= V4l2Camera::NV12; ++f) {
+            if (desc.pixelformat == fourccOf(V4l2Camera::PixelFormat(f)))
+                offered[f] = true;
+        }
+        ++desc.index;
+    }
+    return offered[V4l2Camera::UYVY] ? V4l2Camera::UYVY
+         : offered[V4l2Camera::YUYV] ? V4l2Camera::YUYV
+         : offered[V4l2Camera::NV12] ? V4l2Camera::NV12 : V4l2Camera::NoFormat;
+}
+
+V4l2Camera::V4l2Camera(QObject *parent)
+    : QThread(parent)
+    , m_fd(-1)
+    , m_format(NoFormat)
+    , m_stride(0)
+    , m_imageBytes(0)
+    , m_pool(this)
+    , m_streaming(false)
+    , m_isRunning(false)
+    , m_dropped(0)
+    , m_broken(0)
+    , m_lastSequence(0)
+    , m_haveSequence(false)
+{
+    m_rate.num = 0;
+    m_rate.den = 1;
+}
+
+V4l2Camera::~V4l2Camera()
+{
+    Stop();
+    close();
+}
+
+const char *V4l2Camera::formatName(PixelFormat format)
+{
+    switch (format) {
+    case UYVY: return "UYVY";
+    case YUYV: return "YUYV";
+    case NV12: return "NV12";
+    default: return "none";
+    }
+}
+
+QSize V4l2Camera::largestSize(const QString &device)
+{
+    const int fd = ::open(device.toLocal8Bit().constData(), O_RDWR | O_NONBLOCK);
+    if (fd < 0)
+        return QSize();
+
+    QSize largest;
+    const PixelFormat format = pickFormat(fd);
+    v4l2_frmsizeenum sizes;
+    memset(&sizes, 0, sizeof(sizes));
+    sizes.pixel_format = fourccOf(format);
+    while (format != NoFormat && xioctl(fd, VIDIOC_ENUM_FRAMESIZES, &sizes) == 0) {
+        // Stepwise and continuous ranges come as a single entry.
+        const QSize size = sizes.type == V4L2_FRMSIZE_TYPE_DISCRETE
+                ? QSize(sizes.discrete.width, sizes.discrete.height)
+                : QSize(sizes.stepwise.max_width, sizes.stepwise.max_height);
+        if (size.width() * size.height() > largest.width() * largest.height())
+            largest = size;
+        if (sizes.type != V4L2_FRMSIZE_TYPE_DISCRETE)
+            break;
+        ++sizes.index;
+    }
+
+    // Drivers that cannot enumerate sizes at least report their current one.
+    if (largest.isEmpty()) {
+        v4l2_format fmt;
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (xioctl(fd, VIDIOC_G_FMT, &fmt) == 0)
+            largest = QSize(fmt.fmt.pix.width, fmt.fmt.pix.height);
+    }
+
+    ::close(fd);
+    return largest;
+}
+
+bool V4l2Camera::open(const QString &device, const QSize &size, FrameRate rate)
+{
+    Q_ASSERT(m_fd < 0);
+    m_device = device;
+    m_fd = ::open(device.toLocal8Bit().constData(), O_RDWR | O_NONBLOCK);
+    if (m_fd < 0) {
+        qWarning() << "Cannot open" << device << strerror(errno);
+        return false;
+    }
+
+    v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (xioctl(m_fd, VIDIOC_QUERYCAP, &cap) < 0
+            || !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) || !(cap.capabilities & V4L2_CAP_STREAMING)) {
+        qWarning() << device << "is not a streaming capture device";
+        close();
+        return false;
+    }
+
+    m_format = pickFormat(m_fd);
+    if (m_format == NoFormat) {
+        qWarning() << device << "offers none of UYVY, YUYV or NV12";
+        close();
+        return false;
+    }
+
+    v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = size.width();
+    fmt.fmt.pix.height = size.height();
+    fmt.fmt.pix.pixelformat = fourccOf(m_format);
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(m_fd, VIDIOC_S_FMT, &fmt) < 0 || fmt.fmt.pix.pixelformat != fourccOf(m_format)) {
+        qWarning() << device << "rejected" << formatName(m_format) << strerror(errno);
+        close();
+        return false;
+    }
+    m_size = QSize(fmt.fmt.pix.width, fmt.fmt.pix.height);
+    m_stride = fmt.fmt.pix.bytesperline;
+    // NV12's chroma plane adds half the luma rows.
+    m_imageBytes = quint32(m_stride) * (m_format == NV12 ? m_size.height() * 3 / 2 : m_size.height());
+
+    // Drivers without frame interval control run at whatever rate they have.
+    m_rate = rate;
+    v4l2_streamparm parm;
+    memset(&parm, 0, sizeof(parm));
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(m_fd, VIDIOC_G_PARM, &parm) == 0 && (parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
+        parm.parm.capture.timeperframe.numerator = rate.den;
+        parm.parm.capture.timeperframe.denominator = rate.num;
+        if (xioctl(m_fd, VIDIOC_S_PARM, &parm) == 0 && parm.parm.capture.timeperframe.numerator > 0) {
+            m_rate.num = parm.parm.capture.timeperframe.denominator;
+            m_rate.den = parm.parm.capture.timeperframe.numerator;
+        }
+    }
+
+    v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = DriverBufferCount;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(m_fd, VIDIOC_REQBUFS, &req) < 0 || req.count < 2) {
+        qWarning() << device << "cannot allocate mmap buffers" << strerror(errno);
+        close();
+        return false;
+    }
+
+    m_buffers.resize(req.count);
+    for (int i = 0; i < int(req.count); ++i) {
+        Mapping &m = m_buffers[i];
+        m.start = MAP_FAILED;
+        m.frame = NULL;
+
+        v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (xioctl(m_fd, VIDIOC_QUERYBUF, &buf) < 0)
+            break;
+        m.length = buf.length;
+        m.start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, buf.m.offset);
+        if (m.start == MAP_FAILED)
+            break;
+
+        FrameBuffer *frame = new FrameBuffer;
+        memset(frame, 0, sizeof(*frame));
+        frame->data = static_cast<uint8_t *>(m.start);
+        frame->capacity = int(buf.length);
+        frame->xres = m_size.width();
+        frame->yres = m_size.height();
+        frame->stride = m_stride;
+        frame->owner = this;
+        frame->pool = &m_pool;
+        m.frame = frame;
+    }
+    for (const Mapping &m : m_buffers) {
+        if (!m.frame) {
+            qWarning() << device << "cannot map driver buffers" << strerror(errno);
+            close();
+            return false;
+        }
+    }
+
+    qDebug() << device << "streaming" << formatName(m_format) << m_size << "at" << m_rate.num << "/" << m_rate.den
+             << "through" << m_buffers.size() << "driver buffers";
+    return true;
+}
+
+void V4l2Camera::close()
+{
+    Q_ASSERT(!isRunning());
+    if (m_fd < 0)
+        return;
+
+    if (m_streaming) {
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(m_fd, VIDIOC_STREAMOFF, &type);
+        m_streaming = false;
+    }
+
+    for (const Mapping &m : m_buffers) {
+        if (m.start != MAP_FAILED)
+            munmap(m.start, m.length);
+        delete m.frame;
+    }
+    m_buffers.clear();
+
+    v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    xioctl(m_fd, VIDIOC_REQBUFS, &req);
+
+    ::close(m_fd);
+    m_fd = -1;
+    m_format = NoFormat;
+}
+
+void V4l2Camera::Start()
+{
+    Q_ASSERT(m_fd >= 0 && !m_streaming);
+
+    for (int i = 0; i < m_buffers.size(); ++i)
+        requeue(i);
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(m_fd, VIDIOC_STREAMON, &type) < 0) {
+        qWarning() << m_device << "cannot start streaming" << strerror(errno);
+        return;
+    }
+    m_streaming = true;
+
+    m_dropped = 0;
+    m_broken = 0;
+    m_haveSequence = false;
+    m_isRunning = true;
+    start(QThread::HighPriority);
+}
+
+void V4l2Camera::Stop()
+{
+    // Streaming itself stops in close(), once every buffer is back.
+    m_isRunning = false;
+    wait();
+}
+
+void V4l2Camera::requeue(int index)
+{
+    v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (xioctl(m_fd, VIDIOC_QBUF, &buf) < 0)
+        qWarning() << m_device << "cannot queue buffer" << index << strerror(errno);
+}
+
+void V4l2Camera::DriverPool::release(FrameBuffer *buffer)
+{
+    for (int i = 0; i < m_camera->m_buffers.size(); ++i) {
+        if (m_camera->m_buffers[i].frame == buffer) {
+            m_camera->requeue(i);
+            return;
+        }
+    }
+}
+
+void V4l2Camera::run()
+{
+    pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+
+    while (m_isRunning) {
+        const int ready = poll(&pfd, 1, PollTimeoutMs);
+        if (ready < 0 && errno != EINTR) {
+            qWarning() << m_device << "poll failed" << strerror(errno);
+            break;
+        }
+        if (ready <= 0)
+            continue;
+
+        v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(m_fd, VIDIOC_DQBUF, &buf) < 0) {
+            if (errno != EAGAIN)
+                qWarning() << m_device << "cannot dequeue" << strerror(errno);
+            continue;
+        }
+
+        if (m_haveSequence && buf.sequence > m_lastSequence + 1)
+            m_dropped.fetch_add(buf.sequence - m_lastSequence - 1, std::memory_order_relaxed);
+        m_lastSequence = buf.sequence;
+        m_haveSequence = true;
+
+        // A corrupt or partly filled frame is worse than none.
+        if ((buf.flags & V4L2_BUF_FLAG_ERROR) || buf.bytesused < m_imageBytes) {
+            requeue(buf.index);
+            m_broken.fetch_add(1, std::memory_order_relaxed);
+            emit frameBroken();
+            continue;
+        }
+
+        // Monotonic driver timestamps are on the same clock as the pipeline's.
+        qint64 captureNs = pipelineClockNs();
+        if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+            captureNs = qint64(buf.timestamp.tv_sec) * 1000000000 + qint64(buf.timestamp.tv_usec) * 1000;
+
+        FrameBuffer *frame = m_buffers[buf.index].frame;
+        frame->len = buf.bytesused;
+        emit frameReady(buf.index, captureNs);
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef V4L2CAMERA_H
+#define V4L2CAMERA_H
+
+#include <QSize>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+
+#include "framepacer.h"
+#include "framepool.h"
+
+// Streams a V4L2 capture device through mmap'd driver buffers, delivering
+// frames at sensor rate from its own thread. Of the formats the driver
+// offers, UYVY is preferred because NDI sends it as is; YUYV and NV12 only
+// need repacking. Works with any V4L2 driver, including vivid for testing.
+class V4l2Camera : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum PixelFormat {
+        NoFormat,
+        UYVY,
+        YUYV,
+        NV12
+    };
+
+    explicit V4l2Camera(QObject *parent = nullptr);
+    ~V4l2Camera();
+
+    // The largest size the device captures in the format open() would pick,
+    // or an empty size if it cannot tell.
+    static QSize largestSize(const QString &device);
+
+    // Negotiates the native format and the size and rate closest to the
+    // requested ones, then maps the driver buffers.
+    bool open(const QString &device, const QSize &size, FrameRate rate);
+    // Only once every driver buffer handed out has been released.
+    void close();
+
+    void Start();
+    void Stop();
+
+    PixelFormat format() const { return m_format; }
+    QSize size() const { return m_size; }
+    int stride() const { return m_stride; }
+    FrameRate rate() const { return m_rate; }
+    static const char *formatName(PixelFormat format);
+
+    // Driver buffer index as a FrameBuffer. Releasing it to its pool queues
+    // it back to the driver, which cannot fill it until then.
+    FrameBuffer *driverBuffer(int index) { return m_buffers[index].frame; }
+    // Gives a buffer whose content was copied out straight back.
+    void requeue(int index);
+
+    // Frames the driver skipped because no buffer was queued.
+    quint64 DroppedFrames() const { return m_dropped.load(std::memory_order_relaxed); }
+    // Buffers the driver flagged as corrupt or returned short, requeued
+    // without being delivered.
+    quint64 BrokenFrames() const { return m_broken.load(std::memory_order_relaxed); }
+
+signals:
+    // Emitted on the camera thread for every filled buffer. The receiver
+    // either requeue()s index or sends driverBuffer(index) and lets the
+    // sender release it.
+    void frameReady(int index, qint64 captureNs);
+    // Emitted on the camera thread for every broken buffer.
+    void frameBroken();
+
+protected:
+    void run() override;
+
+private:
+    class DriverPool : public FramePool
+    {
+    public:
+        explicit DriverPool(V4l2Camera *camera) : m_camera(camera) {}
+        void release(FrameBuffer *buffer) override;
+    private:
+        V4l2Camera *m_camera;
+    };
+
+    struct Mapping {
+        void *start;
+        size_t length;
+        FrameBuffer *frame;
+    };
+
+    // A full sender queue, the frame NDI holds and two for the driver.
+    static const int DriverBufferCount = 6;
+
+    int m_fd;
+    QString m_device;
+    PixelFormat m_format;
+    QSize m_size;
+    int m_stride;
+    quint32 m_imageBytes;   // what a complete frame fills
+    FrameRate m_rate;
+    QVector<Mapping> m_buffers;
+    DriverPool m_pool;
+    bool m_streaming;
+
+    std::atomic<bool> m_isRunning;
+    std::atomic<quint64> m_dropped;
+    std::atomic<quint64> m_broken;
+    quint32 m_lastSequence;
+    bool m_haveSequence;
+};
+
+#endif // V4L2CAMERA_H
@@ -0,0 +1,54 @@
+#ifndef WAITEVENT_H
+#define WAITEVENT_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+// Lets a thread sleep until a lock-free condition becomes true. notify() is a
+// single atomic load unless somebody is actually asleep, so producers can call
+// it on every push.
+class WaitEvent
+{
+public:
+    WaitEvent() : m_waiters(0) {}
+
+    template <typename Pred>
+    bool wait(Pred pred, unsigned long timeoutMs)
+    {
+        if (pred())
+            return true;
+
+        m_waiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        m_mutex.lock();
+        bool ready = pred();
+        if (!ready) {
+            m_cond.wait(&m_mutex, timeoutMs);
+            ready = pred();
+        }
+        m_mutex.unlock();
+
+        m_waiters.fetch_sub(1);
+        return ready;
+    }
+
+    // Call after publishing the state the waiter's predicate checks.
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) > 0) {
+            m_mutex.lock();
+            m_cond.wakeAll();
+            m_mutex.unlock();
+        }
+    }
+
+private:
+    std::atomic<int> m_waiters;
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+};
+
+#endif // WAITEVENT_H
@@ -2,67 +2,46 @@
 #include "ui_widget.h"
 
 #include <QDebug>
+#include <QGuiApplication>
+#include <QLabel>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QPixmap>
+#include <QSignalBlocker>
 
-#include "utils.h"
-#include "global.h"
-#include "audioinfo.h"
-
-float frameRates[] = { 60, 60, 50, 30, 30, 25 };
-
-SenderThread::SenderThread(NDIlib_send_instance_t instance, NDIlib_video_frame_v2_t* video_frame, NDIlib_audio_frame_v2_t* audio_frame, QObject *parent) : QThread(parent){
-    m_instance = instance;
-    m_video_frame = video_frame;
-    m_audio_frame = audio_frame;
-}
-
-void SenderThread::Start() {
-    m_isRunning = true;
-    start();
-}
-
-void SenderThread::Stop() {
-    m_isRunning = false;
-    wait();
-    quit();
-}
-
-void SenderThread::Push(SendData *data) {
-    m_mutex.lock();
-    m_data.push_back(data);
-    m_mutex.unlock();
-}
-
-void SenderThread::run() {
-    while (m_isRunning) {
-        m_mutex.lock();
-        if (m_data.empty()) {
-            msleep(1);
-            m_mutex.unlock();
-            continue;
-        }
-        SendData* data = m_data.first();
-        m_mutex.unlock();
-        m_data.pop_front();
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <dbt.h>
+#endif
 
-        if (m_video_frame) {
-            memmove(m_video_frame->p_data, data->buf, data->len);
-            NDIlib_send_send_video_v2(m_instance, m_video_frame);
-        }
-        if (m_audio_frame) {
-            memmove(m_audio_frame->p_data, data->buf, data->len);
-            NDIlib_send_send_audio_v2(m_instance, m_audio_frame);
-        }
-        delete data->buf;
-
-        delete data;
-    }
-}
-
-Widget::Widget(QWidget *parent)
+#include "global.h"
+#include "ndistream.h"
+#include "statsreporter.h"
+#include "streamengine.h"
+
+// Rows of the frame rate combo boxes, in order.
+static const FrameRate frameRates[] = {
+    { 60, 1 },          // 60p
+    { 60000, 1001 },    // 59.94p (NTSC)
+    { 50, 1 },          // 50p
+    { 30, 1 },          // 30p
+    { 30000, 1001 },    // 29.97p (NTSC)
+    { 25, 1 }           // 25p (PAL)
+};
+
+// Output heights of the size combo boxes, in order; 0 sends the source size.
+static const int outputHeights[] = { 0, 1080, 720, 540 };
+
+Widget::Widget(const QElapsedTimer &launch, QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::Widget)
+    , m_launch(launch)
+    , m_sendersReadyMs(-1)
+    , m_shownMs(-1)
+    , m_devicesCurrentMs(-1)
+    , m_fromSnapshot(false)
+    , m_screenPreviewSerial(0)
+    , m_cameraPreviewSerial(0)
 {
     ui->setupUi(this);
     setStyleSheet(loadScss("main"));
@@ -70,61 +49,32 @@ Widget::Widget(QWidget *parent)
     setMouseTracking(false);
     m_pressed = false;
 
-    m_screens.push_back(0);
-    QList<QScreen*> screens = QGuiApplication::screens();
-    for (int i = 0; i < screens.size(); ++i) {
-        QScreen *screen = screens.at(i);
-        ui->cb_screen_video->addItem(screen->name());
-        m_screens.push_back(screen);
-    }
-
-    m_cameras.push_back(QCameraInfo());
-    QList<QCameraInfo> cameras = QCameraInfo::availableCameras();
-    for (const QCameraInfo &cameraInfo : cameras) {
-        QString name = cameraInfo.description();
-        if (name.contains("NDI Webcam")) continue;
-        ui->cb_camera_video->addItem(name);
-        m_cameras.push_back(cameraInfo);
-    }
-
-    m_audios.push_back(QAudioDeviceInfo());
-    QList<QAudioDeviceInfo> devices = QAudioDeviceInfo::availableDevices(QAudio::AudioInput);
-    for (const QAudioDeviceInfo &device : devices) {
-        QString name = device.deviceName();
-        if (name.contains("NDI Webcam")) continue;
-        ui->cb_camera_audio->addItem(name);
-        ui->cb_screen_audio->addItem(name);
-        m_audios.push_back(device);
-    }
-
-    NDIlib_send_create_t NDI_send_create_desc_camera;
-    NDI_send_create_desc_camera.p_ndi_name = "My Camera";
-    pNDI_send_camera = NDIlib_send_create(&NDI_send_create_desc_camera);
-
-    NDIlib_send_create_t NDI_send_create_desc_screen;
-    NDI_send_create_desc_screen.p_ndi_name = "My Screen";
-    pNDI_send_screen = NDIlib_send_create(&NDI_send_create_desc_screen);
-
-    m_curCamera = NULL;
-    m_curScreen = NULL;
-    m_curAudioCamera = NULL;
-    m_curAudioScreen = NULL;
-    m_imageCapture = NULL;
-
-    m_senderCamera = new SenderThread(pNDI_send_camera, &NDI_video_frame_camera, NULL);
-    m_senderScreen = new SenderThread(pNDI_send_screen, &NDI_video_frame_screen, NULL);
-    m_senderAudioCamera = new SenderThread(pNDI_send_camera, NULL, &NDI_audio_frame_camera);
-    m_senderAudioScreen = new SenderThread(pNDI_send_screen, NULL, &NDI_audio_frame_screen);
-
-    NDI_video_frame_camera.p_data = NULL;
-    NDI_video_frame_screen.p_data = NULL;
-    NDI_audio_frame_camera.p_data = NULL;
-    NDI_audio_frame_screen.p_data = NULL;
-
-    m_screenTimer = new QTimer(this);
-    connect(m_screenTimer, SIGNAL(timeout()), this, SLOT(on_screen_timeout()));
-    m_cameraTimer = new QTimer(this);
-    connect(m_cameraTimer, SIGNAL(timeout()), this, SLOT(on_camera_timeout()));
+    // Qt already knows the screens. Cameras and audio inputs start as the
+    // last run found them and are enumerated again in the background, so
+    // neither the window nor the senders wait for slow capture drivers.
+    m_fromSnapshot = m_devices.loadSnapshot();
+    fillScreens();
+    fillCameras();
+    fillAudioInputs();
+    connect(&m_devices, SIGNAL(devicesChanged(int)), this, SLOT(on_devices_changed(int)));
+    connect(&m_devices, SIGNAL(enumerationFinished(qint64)), this, SLOT(on_enumeration_finished(qint64)));
+    connect(qGuiApp, SIGNAL(screenAdded(QScreen*)), this, SLOT(on_screens_changed()));
+    connect(qGuiApp, SIGNAL(screenRemoved(QScreen*)), this, SLOT(on_screen_removed(QScreen*)));
+    m_devices.refresh();
+    m_devices.watch();
+
+    m_engine = new StreamEngine(this);
+    m_streamCamera = m_engine->addStream(cameraConfig());
+    m_streamScreen = m_engine->addStream(screenConfig());
+    connect(m_engine->statsReporter(), SIGNAL(updated(const QString&)), this, SLOT(on_stats(const QString&)));
+    m_sendersReadyMs = m_launch.elapsed();
+
+    // Previews are polled at the rate they are taken; a thumbnail that has
+    // not changed since the last poll costs a comparison.
+    m_previewTimer.setInterval(StreamPreview::DefaultIntervalMs);
+    connect(&m_previewTimer, SIGNAL(timeout()), this, SLOT(on_preview_timer()));
+    ui->l_screen_preview->setVisible(false);
+    ui->l_camera_preview->setVisible(false);
 
     ui->pb_start->setEnabled(true);
     ui->pb_stop->setEnabled(false);
@@ -134,144 +84,179 @@ Widget::~Widget()
 {
     on_pb_stop_clicked();
 
-    if (pNDI_send_camera)
-        NDIlib_send_destroy(pNDI_send_camera);
-    if (pNDI_send_screen)
-        NDIlib_send_destroy(pNDI_send_screen);
-
+    delete m_engine;
     delete ui;
 }
 
-void Widget::clearFrames()
+StreamConfig Widget::screenConfig() const
 {
-    if (NDI_video_frame_camera.p_data)
-        free(NDI_video_frame_camera.p_data);
-    NDI_video_frame_camera.p_data = NULL;
-
-    if (NDI_video_frame_screen.p_data)
-        free(NDI_video_frame_screen.p_data);
-    NDI_video_frame_screen.p_data = NULL;
+    StreamConfig config;
+    config.ndiName = "My Screen";
+    QScreen *screen = m_screens[ui->cb_screen_video->currentIndex()];
+    config.video = screen ? StreamConfig::ScreenVideo : StreamConfig::NoVideo;
+    config.videoDevice = screen ? screen->name() : QString();
+    // Format rows follow VideoFormat; the matrix is picked from the frame height.
+    config.format = VideoFormat(ui->cb_screen_compression->currentIndex());
+    config.outputSize = QSize(0, outputHeights[ui->cb_screen_size->currentIndex()]);
+    config.frameRate = frameRates[ui->cb_screen_frame_rate->currentIndex()];
+    config.audioInputs = audioInputs(ui->cb_screen_audio->currentIndex());
+    return config;
 }
 
-void Widget::on_pb_start_clicked()
+StreamConfig Widget::cameraConfig() const
 {
-    ui->pb_start->setEnabled(false);
-    ui->pb_stop->setEnabled(true);
-
-    int screenIndex = ui->cb_screen_video->currentIndex();
-    int cameraIndex = ui->cb_camera_video->currentIndex();
-    int screenAudioIndex = ui->cb_screen_audio->currentIndex();
-    int cameraAudioIndex = ui->cb_camera_audio->currentIndex();
-    int screenComp = ui->cb_screen_compression->currentIndex();
-    int cameraComp = ui->cb_camera_compression->currentIndex();
-
-    m_curScreen = m_screens[screenIndex];
-    NDI_video_frame_screen.xres = m_curScreen ? m_curScreen->size().width() : 0;
-    NDI_video_frame_screen.yres = m_curScreen ? m_curScreen->size().height() : 0;
-    NDI_video_frame_screen.FourCC = screenComp == 0 ? NDIlib_FourCC_video_type_UYVY : NDIlib_FourCC_video_type_RGBA;
-    NDI_video_frame_screen.p_data = (uint8_t*)malloc(NDI_video_frame_screen.xres * NDI_video_frame_screen.yres * 4 / (2 - screenComp));
+    StreamConfig config;
+    config.ndiName = "My Camera";
+    const DeviceEntry &camera = m_cameras[ui->cb_camera_video->currentIndex()];
+    config.video = camera.name.isEmpty() ? StreamConfig::NoVideo : StreamConfig::CameraVideo;
+    config.videoDevice = camera.name;
+    config.format = VideoFormat(ui->cb_camera_compression->currentIndex());
+    config.outputSize = QSize(0, outputHeights[ui->cb_camera_size->currentIndex()]);
+    config.frameRate = frameRates[ui->cb_camera_frame_rate->currentIndex()];
+    config.audioInputs = audioInputs(ui->cb_camera_audio->currentIndex());
+    return config;
+}
 
-    Q_ASSERT(m_curCamera == NULL && m_imageCapture == NULL);
-    m_curCamera = new QCamera(m_cameras[cameraIndex]);
-    m_imageCapture = new QCameraImageCapture(m_curCamera);
-    m_imageCapture->setCaptureDestination(QCameraImageCapture::CaptureToBuffer);
-    QObject::connect(m_imageCapture, SIGNAL(imageCaptured(int, const QImage&)), this, SLOT(on_camera_image(int, const QImage&)));
-    m_curCamera->start();
-    QSize camSize = m_curCamera->viewfinderSettings().resolution();
-    NDI_video_frame_camera.xres = camSize.width();
-    NDI_video_frame_camera.yres = camSize.height();
-    NDI_video_frame_camera.FourCC = cameraComp == 0 ? NDIlib_FourCC_video_type_UYVY : NDIlib_FourCC_video_type_RGBA;
-    NDI_video_frame_camera.p_data = (uint8_t*)malloc(NDI_video_frame_camera.xres * NDI_video_frame_camera.yres * 4 / (2 - cameraComp));
+// The device picked in an audio combo box; the first row is none.
+QList<AudioInput> Widget::audioInputs(int index) const
+{
+    QList<AudioInput> inputs;
+    if (index > 0 && index < m_audios.size())
+        inputs.push_back(AudioInput(m_audios[index].name));
+    return inputs;
+}
 
-    QAudioDeviceInfo screenAudio = m_audios[screenAudioIndex];
-    QAudioDeviceInfo cameraAudio = m_audios[cameraAudioIndex];
+// Replaces every row after None without signalling, then selects current.
+static void refillRows(QComboBox *combo, const QStringList &labels, int current)
+{
+    QSignalBlocker blocker(combo);
+    while (combo->count() > 1)
+        combo->removeItem(1);
+    combo->addItems(labels);
+    combo->setCurrentIndex(current);
+}
 
-    NDI_audio_frame_screen.sample_rate = 44100;
-    NDI_audio_frame_screen.no_channels = 1;
-    NDI_audio_frame_screen.no_samples = 1764;
-    NDI_audio_frame_screen.p_data = (float*)malloc(sizeof(float) * 1764);
+// Each fill keeps what was picked if it is still there. A running stream
+// whose device went away is reconfigured without it.
+void Widget::fillScreens(QScreen *removed)
+{
+    QScreen *picked = m_screens.value(ui->cb_screen_video->currentIndex());
+    m_screens.clear();
+    m_screens.push_back(0);
+    QStringList labels;
+    int current = 0;
+    for (QScreen *screen : QGuiApplication::screens()) {
+        if (screen == removed)
+            continue;
+        if (screen == picked)
+            current = m_screens.size();
+        labels << screen->name();
+        m_screens.push_back(screen);
+    }
+    refillRows(ui->cb_screen_video, labels, current);
+    if (picked && !current)
+        on_cb_screen_video_currentIndexChanged(0);
+}
 
-    NDI_audio_frame_camera.sample_rate = 44100;
-    NDI_audio_frame_camera.no_channels = 1;
-    NDI_audio_frame_camera.no_samples = 1764;
-    NDI_audio_frame_camera.p_data = (float*)malloc(sizeof(float) * 1764);
+void Widget::fillCameras()
+{
+    const QString picked = m_cameras.value(ui->cb_camera_video->currentIndex()).name;
+    m_cameras.clear();
+    m_cameras.push_back(DeviceEntry());
+    QStringList labels;
+    int current = 0;
+    for (const DeviceEntry &camera : m_devices.cameras()) {
+        if (camera.description.contains("NDI Webcam")) continue;
+        if (!picked.isEmpty() && camera.name == picked)
+            current = m_cameras.size();
+        labels << camera.description;
+        m_cameras.push_back(camera);
+    }
+    refillRows(ui->cb_camera_video, labels, current);
+    if (!picked.isEmpty() && !current)
+        on_cb_camera_video_currentIndexChanged(0);
+}
 
-    m_curAudioScreen = new AudioInfo(screenAudio);
-    m_curAudioCamera = new AudioInfo(cameraAudio);
-    connect(m_curAudioCamera, SIGNAL(emitAudioData(float*, qint64)), this, SLOT(on_audio_camera(float*, qint64)));
-    connect(m_curAudioScreen, SIGNAL(emitAudioData(float*, qint64)), this, SLOT(on_audio_screen(float*, qint64)));
+void Widget::fillAudioInputs()
+{
+    const QString screenPicked = m_audios.value(ui->cb_screen_audio->currentIndex()).name;
+    const QString cameraPicked = m_audios.value(ui->cb_camera_audio->currentIndex()).name;
+    m_audios.clear();
+    m_audios.push_back(DeviceEntry());
+    QStringList labels;
+    int screenCurrent = 0, cameraCurrent = 0;
+    for (const DeviceEntry &device : m_devices.audioInputs()) {
+        if (device.name.contains("NDI Webcam")) continue;
+        if (!screenPicked.isEmpty() && device.name == screenPicked)
+            screenCurrent = m_audios.size();
+        if (!cameraPicked.isEmpty() && device.name == cameraPicked)
+            cameraCurrent = m_audios.size();
+        labels << device.description;
+        m_audios.push_back(device);
+    }
+    refillRows(ui->cb_screen_audio, labels, screenCurrent);
+    refillRows(ui->cb_camera_audio, labels, cameraCurrent);
+    if (!screenPicked.isEmpty() && !screenCurrent)
+        on_cb_screen_audio_currentIndexChanged(0);
+    if (!cameraPicked.isEmpty() && !cameraCurrent)
+        on_cb_camera_audio_currentIndexChanged(0);
+}
 
-    m_curAudioScreen->start();
-    m_curAudioCamera->start();
+void Widget::on_devices_changed(int kinds)
+{
+    if (kinds & DeviceCatalog::Cameras)
+        fillCameras();
+    if (kinds & DeviceCatalog::AudioInputs)
+        fillAudioInputs();
+}
 
-    m_screenTimer->start(1000.0f / frameRates[ui->cb_screen_frame_rate->currentIndex()]);
-    m_cameraTimer->start(1000.0f / frameRates[ui->cb_camera_frame_rate->currentIndex()]);
+void Widget::on_enumeration_finished(qint64 ms)
+{
+    if (m_devicesCurrentMs >= 0)
+        return;
+    m_devicesCurrentMs = m_launch.elapsed();
+    qDebug() << "Devices enumerated in" << ms << "ms";
+    reportStartup();
+}
 
-    m_senderCamera->Start();
-    m_senderScreen->Start();
-    m_senderAudioCamera->Start();
-    m_senderAudioScreen->Start();
+void Widget::on_screens_changed()
+{
+    fillScreens();
 }
 
-void Widget::on_audio_camera(float *data, qint64 len)
+void Widget::on_screen_removed(QScreen *screen)
 {
-    SendData* sdata = new SendData;
-    sdata->buf = new char[len * sizeof(float)];
-    sdata->len = len * sizeof(float);
-    memcpy((void*)sdata->buf, data, len * sizeof(float));
+    fillScreens(screen);
+}
 
-    m_senderAudioCamera->Push(sdata);
+// Once the window is up and the device lists are current.
+void Widget::reportStartup()
+{
+    if (m_shownMs < 0 || m_devicesCurrentMs < 0)
+        return;
+    qDebug() << "Startup: senders ready after" << m_sendersReadyMs << "ms, window shown after" << m_shownMs
+             << "ms, device lists current after" << m_devicesCurrentMs << "ms"
+             << (m_fromSnapshot ? "(shown from the last run's until then)" : "(empty until then, no snapshot yet)");
 }
 
-void Widget::on_audio_screen(float *data, qint64 len)
+void Widget::on_pb_start_clicked()
 {
-    SendData* sdata = new SendData;
-    sdata->buf = new char[len * sizeof(float)];
-    sdata->len = len * sizeof(float);
-    memcpy((void*)sdata->buf, data, len * sizeof(float));
+    ui->pb_start->setEnabled(false);
+    ui->pb_stop->setEnabled(true);
 
-    m_senderAudioScreen->Push(sdata);
+    m_streamScreen->setConfig(screenConfig());
+    m_streamCamera->setConfig(cameraConfig());
+    m_engine->start();
 }
 
 void Widget::on_pb_stop_clicked()
 {
-    m_senderCamera->Stop();
-    m_senderScreen->Stop();
-    m_senderAudioCamera->Stop();
-    m_senderAudioScreen->Stop();
+    m_engine->stop();
+    ui->l_screen_preview->clear();
+    ui->l_camera_preview->clear();
 
     ui->pb_start->setEnabled(true);
     ui->pb_stop->setEnabled(false);
-
-    clearFrames();
-    m_screenTimer->stop();
-    m_cameraTimer->stop();
-
-    if (m_curCamera) {
-        m_curCamera->stop();
-        m_curCamera->unload();
-    }
-    delete m_curCamera;
-    m_curCamera = NULL;
-
-    if (m_imageCapture) {
-        m_imageCapture->cancelCapture();
-        delete m_imageCapture;
-    }
-    m_imageCapture = NULL;
-
-    if (m_curAudioCamera)
-        delete m_curAudioCamera;
-    m_curAudioCamera = NULL;
-
-    if (m_curAudioScreen)
-        delete m_curAudioScreen;
-    m_curAudioScreen = NULL;
-
-    free(NDI_video_frame_camera.p_data);
-    free(NDI_video_frame_screen.p_data);
-    free(NDI_audio_frame_camera.p_data);
-    free(NDI_audio_frame_screen.p_data);
 }
 
 void Widget::on_pb_close_clicked()
@@ -279,114 +264,111 @@ void Widget::on_pb_close_clicked()
     exit(0);
 }
 
-void Widget::makeVideoFrame_RGBA(SendData *sdata, QPixmap pix)
+void Widget::on_stats(const QString& summary)
 {
-    QImage img = pix.toImage();
-    if (img.format() != QImage::Format_RGBA8888)
-        img = img.convertToFormat(QImage::Format_RGBA8888);
-    Q_ASSERT(img.byteCount() == pix.width() * pix.height() * 4);
-
-    const uchar* data = img.constBits();
-    sdata->len = img.byteCount();
-    sdata->buf = new char[sdata->len];
-    memcpy((void*)sdata->buf, data, img.byteCount());
+    ui->l_stats->setText(summary);
 }
 
-void Widget::makeVideoFrame_UYVY(SendData *sdata, QPixmap pix)
+void Widget::on_ck_screen_preview_toggled(bool checked)
 {
-    std::vector<unsigned char> data = convertQPixmapToUYVY(pix);
-    Q_ASSERT(data.size() == pix.width() * pix.height() * 2);
+    enablePreview(m_streamScreen, ui->l_screen_preview, checked);
+}
 
-    sdata->len = data.size();
-    sdata->buf = new char[sdata->len];
-    memcpy((void*)sdata->buf, data.data(), data.size());
+void Widget::on_ck_camera_preview_toggled(bool checked)
+{
+    enablePreview(m_streamCamera, ui->l_camera_preview, checked);
 }
 
-void Widget::on_screen_timeout()
+// Thumbnails are taken to fit the label, so showing one needs no scaling
+// unless its aspect differs.
+void Widget::enablePreview(NdiStream *stream, QLabel *label, bool enabled)
 {
-    if (m_curScreen) {
-        QPixmap screen = grabWindow(0, m_curScreen->geometry());
-        SendData *data = new SendData;
-        if (ui->cb_screen_compression->currentIndex() == 0)
-            makeVideoFrame_UYVY(data, screen);
-        else
-            makeVideoFrame_RGBA(data, screen);
-        m_senderScreen->Push(data);
-    }
+    stream->preview().setWidth(label->contentsRect().width());
+    stream->preview().setEnabled(enabled);
+    label->clear();
+    label->setVisible(enabled);
+
+    const bool any = ui->ck_screen_preview->isChecked() || ui->ck_camera_preview->isChecked();
+    if (any && !m_previewTimer.isActive())
+        m_previewTimer.start();
+    else if (!any)
+        m_previewTimer.stop();
 }
 
-void Widget::on_camera_timeout()
+void Widget::showPreview(NdiStream *stream, QLabel *label, QImage *image, quint64 *serial)
 {
-    if (m_imageCapture && m_imageCapture->isReadyForCapture()) {
-        m_imageCapture->capture();
-    }
+    if (!stream->preview().isEnabled() || !stream->preview().latest(image, serial))
+        return;
+    QPixmap pixmap = QPixmap::fromImage(*image);
+    if (pixmap.height() > label->contentsRect().height())
+        pixmap = pixmap.scaled(label->contentsRect().size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    label->setPixmap(pixmap);
 }
 
-void Widget::on_camera_image(int id, const QImage& img)
+void Widget::on_preview_timer()
 {
-    SendData *data = new SendData;
-    if (ui->cb_camera_compression->currentIndex() == 0)
-        makeVideoFrame_UYVY(data, QPixmap::fromImage(img));
-    else
-        makeVideoFrame_RGBA(data, QPixmap::fromImage(img));
-    NDIlib_send_send_video_v2(pNDI_send_camera, &NDI_video_frame_camera);
-    m_senderCamera->Push(data);
+    showPreview(m_streamScreen, ui->l_screen_preview, &m_screenPreview, &m_screenPreviewSerial);
+    showPreview(m_streamCamera, ui->l_camera_preview, &m_cameraPreview, &m_cameraPreviewSerial);
 }
 
 void Widget::on_cb_camera_audio_currentIndexChanged(int index)
 {
     if (ui->pb_start->isEnabled()) return;
-    on_pb_stop_clicked();
-    on_pb_start_clicked();
+    m_engine->reconfigure(m_streamCamera, cameraConfig());
 }
 
 void Widget::on_cb_camera_compression_currentIndexChanged(int index)
 {
     if (ui->pb_start->isEnabled()) return;
-    on_pb_stop_clicked();
-    on_pb_start_clicked();
+    m_engine->reconfigure(m_streamCamera, cameraConfig());
 }
 
 void Widget::on_cb_camera_frame_rate_currentIndexChanged(int index)
 {
     if (ui->pb_start->isEnabled()) return;
-    on_pb_stop_clicked();
-    on_pb_start_clicked();
+    m_engine->reconfigure(m_streamCamera, cameraConfig());
+}
+
+void Widget::on_cb_camera_size_currentIndexChanged(int index)
+{
+    if (ui->pb_start->isEnabled()) return;
+    m_engine->reconfigure(m_streamCamera, cameraConfig());
 }
 
 void Widget::on_cb_camera_video_currentIndexChanged(int index)
 {
     if (ui->pb_start->isEnabled()) return;
-    on_pb_stop_clicked();
-    on_pb_start_clicked();
+    m_engine->reconfigure(m_streamCamera, cameraConfig());
 }
 
 void Widget::on_cb_screen_audio_currentIndexChanged(int index)
 {
     if (ui->pb_start->isEnabled()) return;
-    on_pb_stop_clicked();
-    on_pb_start_clicked();
+    m_engine->reconfigure(m_streamScreen, screenConfig());
 }
 
 void Widget::on_cb_screen_compression_currentIndexChanged(int index)
 {
     if (ui->pb_start->isEnabled()) return;
-    on_pb_stop_clicked();
-    on_pb_start_clicked();
+    m_engine->reconfigure(m_streamScreen, screenConfig());
 }
 
 void Widget::on_cb_screen_frame_rate_currentIndexChanged(int index)
 {
     if (ui->pb_start->isEnabled()) return;
-    on_pb_stop_clicked();
-    on_pb_start_clicked();
+    m_engine->reconfigure(m_streamScreen, screenConfig());
+}
+
+void Widget::on_cb_screen_size_currentIndexChanged(int index)
+{
+    if (ui->pb_start->isEnabled()) return;
+    m_engine->reconfigure(m_streamScreen, screenConfig());
 }
 
 void Widget::on_cb_screen_video_currentIndexChanged(int index)
 {
     if (ui->pb_start->isEnabled()) return;
-    on_pb_stop_clicked();
-    on_pb_start_clicked();
+    m_engine->reconfigure(m_streamScreen, screenConfig());
 }
 
 void Widget::mousePressEvent(QMouseEvent *event)
@@ -419,6 +401,27 @@ void Widget::mouseReleaseEvent(QMouseEvent *event)
     m_pressed = false;
 }
 
+void Widget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    if (m_shownMs >= 0)
+        return;
+    m_shownMs = m_launch.elapsed();
+    reportStartup();
+}
+
+#ifdef Q_OS_WIN
+// Windows broadcasts this to every top-level window whenever a device is
+// added or removed, without saying which kind.
+bool Widget::nativeEvent(const QByteArray &eventType, void *message, long *result)
+{
+    const MSG *msg = static_cast<const MSG *>(message);
+    if (msg->message == WM_DEVICECHANGE && msg->wParam == DBT_DEVNODES_CHANGED)
+        m_devices.devicesMayHaveChanged();
+    return QWidget::nativeEvent(eventType, message, result);
+}
+#endif
+
 void Widget::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
@@ -4,53 +4,29 @@
 #include <QWidget>
 #include <Processing.NDI.Lib.h>
 
+#include <QElapsedTimer>
+#include <QImage>
 #include <QScreen>
-#include <QCameraInfo>
-#include <QCameraImageCapture>
-#include <QAudioDeviceInfo>
-#include <QAudioInput>
-#include <QThread>
 #include <QTimer>
-#include <QMutex>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class Widget; }
 QT_END_NAMESPACE
 
-class AudioInfo;
+#include "devicecatalog.h"
+#include "streamconfig.h"
 
-struct SendData {
-    const char *buf;
-    int len;
-};
-
-class SenderThread : public QThread {
-    Q_OBJECT
-public:
-    SenderThread(NDIlib_send_instance_t instance, NDIlib_video_frame_v2_t *video_frame, NDIlib_audio_frame_v2_t *audio_frame, QObject *parent = nullptr);
-
-    void Start();
-    void Stop();
-    void Push(SendData *data);
-
-protected:
-    void run();
-
-    NDIlib_send_instance_t m_instance;
-    NDIlib_video_frame_v2_t* m_video_frame;
-    NDIlib_audio_frame_v2_t* m_audio_frame;
-    bool m_isRunning;
-    QList<SendData *> m_data;
-
-    QMutex m_mutex;
-};
+class NdiStream;
+class QLabel;
+class StreamEngine;
 
 class Widget : public QWidget
 {
     Q_OBJECT
 
 public:
-    Widget(QWidget *parent = nullptr);
+    // launch started with the process, to report how long startup took.
+    explicit Widget(const QElapsedTimer &launch, QWidget *parent = nullptr);
     ~Widget();
 
 public slots:
@@ -60,56 +36,72 @@ public slots:
 
     void on_cb_screen_video_currentIndexChanged(int );
     void on_cb_screen_compression_currentIndexChanged(int );
+    void on_cb_screen_size_currentIndexChanged(int );
     void on_cb_screen_frame_rate_currentIndexChanged(int );
     void on_cb_screen_audio_currentIndexChanged(int );
     void on_cb_camera_video_currentIndexChanged(int );
     void on_cb_camera_compression_currentIndexChanged(int );
+    void on_cb_camera_size_currentIndexChanged(int );
     void on_cb_camera_frame_rate_currentIndexChanged(int );
     void on_cb_camera_audio_currentIndexChanged(int );
 
-    void on_screen_timeout();
-    void on_camera_timeout();
-    void on_audio_camera(float* data, qint64 len);
-    void on_audio_screen(float* data, qint64 len);
-    void on_camera_image(int id, const QImage&);
+    void on_ck_screen_preview_toggled(bool checked);
+    void on_ck_camera_preview_toggled(bool checked);
+
+    void on_stats(const QString& summary);
+
+private slots:
+    void on_devices_changed(int kinds);
+    void on_enumeration_finished(qint64 ms);
+    void on_screens_changed();
+    void on_screen_removed(QScreen *screen);
+    void on_preview_timer();
 
 protected:
     void mousePressEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
     void paintEvent(QPaintEvent *event);
+    void showEvent(QShowEvent *event);
+#ifdef Q_OS_WIN
+    bool nativeEvent(const QByteArray &eventType, void *message, long *result);
+#endif
 
 private:
     Ui::Widget *ui;
 
-    NDIlib_send_instance_t pNDI_send_camera;
-    NDIlib_send_instance_t pNDI_send_screen;
-    NDIlib_video_frame_v2_t NDI_video_frame_camera;
-    NDIlib_video_frame_v2_t NDI_video_frame_screen;
-    NDIlib_audio_frame_v2_t NDI_audio_frame_camera;
-    NDIlib_audio_frame_v2_t NDI_audio_frame_screen;
-
+    // Each list has a combo box row per entry; the first is none.
     QList<QScreen*> m_screens;
-    QList<QCameraInfo> m_cameras;
-    QList<QAudioDeviceInfo> m_audios;
-
-    QTimer* m_screenTimer;
-    QTimer* m_cameraTimer;
-
-    SenderThread* m_senderCamera;
-    SenderThread* m_senderScreen;
-    SenderThread* m_senderAudioCamera;
-    SenderThread* m_senderAudioScreen;
-
-    QScreen* m_curScreen;
-    QCamera* m_curCamera;
-    AudioInfo* m_curAudioScreen;
-    AudioInfo* m_curAudioCamera;
-    QCameraImageCapture* m_imageCapture;
-
-    void makeVideoFrame_RGBA(SendData* data, QPixmap pix);
-    void makeVideoFrame_UYVY(SendData* data, QPixmap pix);
-    void clearFrames();
+    QList<DeviceEntry> m_cameras;
+    QList<DeviceEntry> m_audios;
+    DeviceCatalog m_devices;
+
+    StreamEngine* m_engine;
+    NdiStream* m_streamScreen;
+    NdiStream* m_streamCamera;
+
+    StreamConfig screenConfig() const;
+    StreamConfig cameraConfig() const;
+    QList<AudioInput> audioInputs(int index) const;
+    void fillScreens(QScreen *removed = nullptr);
+    void fillCameras();
+    void fillAudioInputs();
+    void reportStartup();
+    void enablePreview(NdiStream *stream, QLabel *label, bool enabled);
+    void showPreview(NdiStream *stream, QLabel *label, QImage *image, quint64 *serial);
+
+    QElapsedTimer m_launch;
+    qint64 m_sendersReadyMs;
+    qint64 m_shownMs;
+    qint64 m_devicesCurrentMs;
+    bool m_fromSnapshot;
+
+    // Polls the streams' thumbnails while a preview is on.
+    QTimer m_previewTimer;
+    QImage m_screenPreview;
+    QImage m_cameraPreview;
+    quint64 m_screenPreviewSerial;
+    quint64 m_cameraPreviewSerial;
 
     QPoint m_prevPos;
     bool m_pressed;
@@ -0,0 +1,332 @@
+// Qt headers must come before Xlib, which #defines names like None and Bool.
+#include <QDebug>
+
+#include "x11capturesource.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <X11/Xatom.h>
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+// Window managers are meant to send a synthetic ConfigureNotify when they
+// move a window, but not all do; the position is also polled this often.
+static const int WindowPollGrabs = 30;
+
+// A followed window can vanish between any two requests, and Xlib's default
+// handler exits on the BadWindow that follows. Those errors are left to the
+// failed request's return value; all others go to the previous handler.
+static XErrorHandler previousErrorHandler = nullptr;
+
+static int ignoreVanishedWindows(Display *display, XErrorEvent *error)
+{
+    if (error->error_code == BadWindow || error->error_code == BadDrawable)
+        return 0;
+    return previousErrorHandler ? previousErrorHandler(display, error) : 0;
+}
+
+// XShmAttach always returns True; a server that cannot attach, such as a
+// remote one, answers with an error that only arrives at the next XSync and
+// would make Xlib's default handler exit. While attaching, errors on the
+// attach are recorded instead. Handlers are process-wide, so attaches from
+// several sources take turns.
+static QMutex shmAttachMutex;
+static const int ShmAttachRequest = 1;  // X_ShmAttach, from the wire protocol headers
+static int shmMajorOpcode = 0;
+static bool shmAttachFailed = false;
+static XErrorHandler attachPreviousHandler = nullptr;
+
+static int recordShmAttachError(Display *display, XErrorEvent *error)
+{
+    if (error->request_code == shmMajorOpcode && error->minor_code == ShmAttachRequest) {
+        shmAttachFailed = true;
+        return 0;
+    }
+    return attachPreviousHandler ? attachPreviousHandler(display, error) : 0;
+}
+
+static bool attachShm(Display *display, XShmSegmentInfo *shm)
+{
+    QMutexLocker locker(&shmAttachMutex);
+    int event = 0, error = 0;
+    if (!XQueryExtension(display, "MIT-SHM", &shmMajorOpcode, &event, &error))
+        return false;
+    shmAttachFailed = false;
+    XSync(display, False);
+    attachPreviousHandler = XSetErrorHandler(recordShmAttachError);
+    XShmAttach(display, shm);
+    XSync(display, False);
+    XSetErrorHandler(attachPreviousHandler);
+    return !shmAttachFailed;
+}
+
+X11CaptureSource::X11CaptureSource()
+    : m_display(nullptr)
+    , m_root(0)
+    , m_visual(nullptr)
+    , m_depth(0)
+    , m_image(nullptr)
+    , m_useShm(false)
+    , m_attached(false)
+    , m_window(0)
+    , m_windowVisible(false)
+    , m_grabsSinceQuery(0)
+{
+    m_shm.shmid = -1;
+    m_shm.shmaddr = nullptr;
+}
+
+X11CaptureSource::~X11CaptureSource()
+{
+    close();
+}
+
+bool X11CaptureSource::openDisplay()
+{
+    m_display = XOpenDisplay(nullptr);
+    if (!m_display) {
+        qWarning() << "X11 capture: cannot open display";
+        return false;
+    }
+
+    const int screen = DefaultScreen(m_display);
+    m_root = RootWindow(m_display, screen);
+    m_visual = DefaultVisual(m_display, screen);
+    m_depth = DefaultDepth(m_display, screen);
+    if (m_depth != 24 && m_depth != 32) {
+        qWarning() << "X11 capture: unsupported depth" << m_depth;
+        return false;
+    }
+
+    XWindowAttributes attributes;
+    XGetWindowAttributes(m_display, m_root, &attributes);
+    m_rootRect = QRect(0, 0, attributes.width, attributes.height);
+    m_useShm = XShmQueryExtension(m_display);
+    return true;
+}
+
+bool X11CaptureSource::open(const QRect &geometry)
+{
+    close();
+    if (geometry.isEmpty() || !openDisplay()) {
+        close();
+        return false;
+    }
+
+    // Clip to the root window; QScreen geometry can extend past it briefly
+    // while monitors are being rearranged.
+    m_geometry = geometry.intersected(m_rootRect);
+    if (m_geometry.isEmpty() || !createImage(m_geometry.size())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool X11CaptureSource::openWindow(quintptr window, const QSize &maxSize)
+{
+    close();
+    if (!window || maxSize.isEmpty() || !openDisplay()) {
+        close();
+        return false;
+    }
+
+    static const XErrorHandler installed = previousErrorHandler = XSetErrorHandler(ignoreVanishedWindows);
+    Q_UNUSED(installed)
+
+    m_window = Window(window);
+    m_maxSize = maxSize;
+    XSelectInput(m_display, m_window, StructureNotifyMask);
+    m_windowVisible = followWindow();
+    if (!m_windowVisible || !createImage(m_geometry.size())) {
+        qWarning() << "X11 capture: window" << QString::number(window, 16) << "is not visible";
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Takes the window's current area of the desktop as the captured geometry.
+// False if it is gone, unmapped or entirely off screen.
+bool X11CaptureSource::followWindow()
+{
+    m_grabsSinceQuery = 0;
+    XWindowAttributes attributes;
+    Window child;
+    int x = 0, y = 0;
+    if (!XGetWindowAttributes(m_display, m_window, &attributes) || attributes.map_state != IsViewable
+            || !XTranslateCoordinates(m_display, m_window, m_root, 0, 0, &x, &y, &child))
+        return false;
+
+    QRect area = QRect(x, y, attributes.width, attributes.height).intersected(m_rootRect);
+    area.setSize(area.size().boundedTo(m_maxSize));
+    if (area.isEmpty())
+        return false;
+    m_geometry = area;
+    return true;
+}
+
+bool X11CaptureSource::createImage(const QSize &size)
+{
+    if (m_useShm) {
+        m_image = XShmCreateImage(m_display, m_visual, m_depth, ZPixmap, nullptr, &m_shm,
+                                  size.width(), size.height());
+        if (m_image) {
+            m_shm.shmid = shmget(IPC_PRIVATE, m_image->bytes_per_line * m_image->height, IPC_CREAT | 0600);
+            if (m_shm.shmid >= 0) {
+                m_shm.shmaddr = m_image->data = static_cast<char *>(shmat(m_shm.shmid, nullptr, 0));
+                m_shm.readOnly = False;
+                m_attached = m_shm.shmaddr != reinterpret_cast<char *>(-1) && attachShm(m_display, &m_shm);
+                // Mark for removal now; the segment lives until both sides detach.
+                shmctl(m_shm.shmid, IPC_RMID, nullptr);
+            }
+        }
+        if (!m_attached) {
+            qWarning() << "X11 capture: MIT-SHM unavailable, falling back to XGetSubImage";
+            destroyImage();
+            XCloseDisplay(m_display);
+            m_display = XOpenDisplay(nullptr);
+            if (!m_display)
+                return false;
+            if (m_window)
+                XSelectInput(m_display, m_window, StructureNotifyMask);
+            m_useShm = false;
+        }
+    }
+
+    if (!m_useShm) {
+        const int bytesPerLine = size.width() * 4;
+        char *data = static_cast<char *>(malloc(size_t(bytesPerLine) * size.height()));
+        m_image = XCreateImage(m_display, DefaultVisual(m_display, DefaultScreen(m_display)), m_depth, ZPixmap, 0, data,
+                               size.width(), size.height(), 32, bytesPerLine);
+        if (!m_image) {
+            free(data);
+            return false;
+        }
+    }
+
+    if (m_image->bits_per_pixel != 32) {
+        qWarning() << "X11 capture: unsupported pixel size" << m_image->bits_per_pixel;
+        destroyImage();
+        return false;
+    }
+    return true;
+}
+
+void X11CaptureSource::destroyImage()
+{
+    if (m_attached)
+        XShmDetach(m_display, &m_shm);
+    if (m_image) {
+        if (m_shm.shmaddr)
+            m_image->data = nullptr;    // shared memory, not ours to free
+        XDestroyImage(m_image);
+    }
+    if (m_shm.shmaddr && m_shm.shmaddr != reinterpret_cast<char *>(-1))
+        shmdt(m_shm.shmaddr);
+
+    m_image = nullptr;
+    m_attached = false;
+    m_shm.shmid = -1;
+    m_shm.shmaddr = nullptr;
+}
+
+void X11CaptureSource::close()
+{
+    destroyImage();
+    if (m_display)
+        XCloseDisplay(m_display);
+
+    m_display = nullptr;
+    m_window = 0;
+    m_windowVisible = false;
+}
+
+bool X11CaptureSource::grab(CaptureFrame &frame)
+{
+    if (!m_display)
+        return false;
+
+    if (m_window) {
+        bool changed = ++m_grabsSinceQuery >= WindowPollGrabs;
+        XEvent event;
+        while (XCheckWindowEvent(m_display, m_window, StructureNotifyMask, &event))
+            changed = true;
+        if (changed)
+            m_windowVisible = followWindow();
+        if (!m_windowVisible)
+            return false;
+        if (!m_image || m_image->width != m_geometry.width() || m_image->height != m_geometry.height()) {
+            destroyImage();
+            if (!createImage(m_geometry.size()))
+                return false;
+        }
+    }
+    if (!m_image)
+        return false;
+
+    if (m_useShm) {
+        if (!XShmGetImage(m_display, m_root, m_image, m_geometry.x(), m_geometry.y(), AllPlanes))
+            return false;
+    } else {
+        if (!XGetSubImage(m_display, m_root, m_geometry.x(), m_geometry.y(),
+                          m_geometry.width(), m_geometry.height(), AllPlanes, ZPixmap, m_image, 0, 0))
+            return false;
+    }
+
+    frame.data = reinterpret_cast<const uint8_t *>(m_image->data);
+    frame.stride = m_image->bytes_per_line;
+    frame.width = m_image->width;
+    frame.height = m_image->height;
+    return true;
+}
+
+CaptureSource *CaptureSource::create()
+{
+    return new X11CaptureSource;
+}
+
+// The window manager's client list, titled by _NET_WM_NAME or WM_NAME.
+QList<CaptureWindow> CaptureSource::windows()
+{
+    QList<CaptureWindow> result;
+    Display *display = XOpenDisplay(nullptr);
+    if (!display)
+        return result;
+
+    const Atom clientList = XInternAtom(display, "_NET_CLIENT_LIST", True);
+    const Atom netName = XInternAtom(display, "_NET_WM_NAME", True);
+    const Atom utf8 = XInternAtom(display, "UTF8_STRING", True);
+    Atom type;
+    int format;
+    unsigned long count = 0, remaining;
+    unsigned char *data = nullptr;
+    if (clientList != 0
+            && XGetWindowProperty(display, DefaultRootWindow(display), clientList, 0, 4096, False, XA_WINDOW,
+                                  &type, &format, &count, &remaining, &data) == Success && data) {
+        const Window *clients = reinterpret_cast<const Window *>(data);
+        for (unsigned long i = 0; i < count; ++i) {
+            CaptureWindow window;
+            window.id = clients[i];
+            unsigned long length = 0;
+            unsigned char *name = nullptr;
+            if (netName != 0 && utf8 != 0
+                    && XGetWindowProperty(display, clients[i], netName, 0, 1024, False, utf8,
+                                          &type, &format, &length, &remaining, &name) == Success && name) {
+                window.title = QString::fromUtf8(reinterpret_cast<const char *>(name), int(length));
+                XFree(name);
+            }
+            char *legacyName = nullptr;
+            if (window.title.isEmpty() && XFetchName(display, clients[i], &legacyName) && legacyName) {
+                window.title = QString::fromLocal8Bit(legacyName);
+                XFree(legacyName);
+            }
+            result.push_back(window);
+        }
+        XFree(data);
+    }
+    XCloseDisplay(display);
+    return result;
+}
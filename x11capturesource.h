@@ -0,0 +1,56 @@
+#ifndef X11CAPTURESOURCE_H
+#define X11CAPTURESOURCE_H
+
+#include "capturesource.h"
+
+#include <QSize>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+// Reads the root window into one reusable shared-memory XImage with
+// XShmGetImage. Falls back to XGetSubImage into a preallocated image when the
+// server has no MIT-SHM (remote displays). Uses its own display connection so
+// it can be driven from any thread.
+//
+// A followed window is watched for StructureNotify events, so its position
+// is only queried again after it moved, resized or was (un)mapped, and the
+// image is only reallocated when its size changed.
+class X11CaptureSource : public CaptureSource
+{
+public:
+    X11CaptureSource();
+    ~X11CaptureSource() override;
+
+    bool open(const QRect &geometry) override;
+    bool openWindow(quintptr window, const QSize &maxSize) override;
+    void close() override;
+    bool grab(CaptureFrame &frame) override;
+
+    const char *name() const override { return m_useShm ? "x11-shm" : "x11"; }
+
+private:
+    bool openDisplay();
+    bool createImage(const QSize &size);
+    void destroyImage();
+    bool followWindow();
+
+    QRect m_geometry;
+    QRect m_rootRect;
+    Display *m_display;
+    Window m_root;
+    Visual *m_visual;
+    int m_depth;
+    XImage *m_image;
+    XShmSegmentInfo m_shm;
+    bool m_useShm;
+    bool m_attached;
+
+    Window m_window;
+    QSize m_maxSize;
+    bool m_windowVisible;
+    int m_grabsSinceQuery;
+};
+
+#endif // X11CAPTURESOURCE_H